@@ -9,20 +9,23 @@
 #error only the libtransmission announcer module should #include this header.
 #endif
 
+#include <algorithm>
 #include <array>
 #include <chrono>
-#include <cstdint> // uint64_t
+#include <cstddef> // size_t
+#include <cstdint> // SIZE_MAX, uint64_t
 #include <ctime>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <utility> // std::pair
 #include <vector>
 
 #include "libtransmission/announcer.h"
 #include "libtransmission/interned-string.h"
 #include "libtransmission/net.h"
 #include "libtransmission/peer-mgr.h" // tr_pex
-#include "libtransmission/types.h" // tr_peer_id_t
+#include "libtransmission/types.h" // tr_peer_id_t, tr_torrent_id_t
 #include "libtransmission/utils.h"
 
 struct tr_url_parsed_t;
@@ -171,10 +174,19 @@ struct tr_announce_response
  *  - xbtt has no upper bound
  *
  * This is only an upper bound: if the tracker complains about
- * length, announcer will incrementally lower the batch size.
+ * length, announcer will incrementally lower the batch size,
+ * then raise it again -- below the size that failed -- as
+ * full batches succeed.
  */
 auto inline constexpr TrMultiscrapeMax = 60U;
 
+/* how many infohashes to remove when we get a scrape-too-long error,
+ * or to add back after enough full scrapes succeed */
+auto inline constexpr TrMultiscrapeStep = 5U;
+
+/* how many full multiscrapes in a row must succeed before trying a bigger one */
+auto inline constexpr TrMultiscrapeGrowAfter = 4U;
+
 auto inline constexpr TrAnnounceTimeoutSec = std::chrono::seconds{ 45 };
 auto inline constexpr TrScrapeTimeoutSec = std::chrono::seconds{ 30 };
 
@@ -193,6 +205,98 @@ struct tr_scrape_request
     size_t info_hash_count = 0U;
 };
 
+// Per-scrape-URL state: how many info hashes the tracker will take
+// in one multiscrape, and the batch that tiers are being gathered into.
+struct tr_scrape_info
+{
+    size_t multiscrape_max;
+
+    // the smallest batch size this tracker has rejected as too long
+    size_t multiscrape_too_big = SIZE_MAX;
+
+    // how many full batches in a row the tracker has accepted
+    size_t multiscrape_full_successes = 0U;
+
+    // the scrape time that tiers on this URL are being gathered into,
+    // and how many have joined it, so they can share a multiscrape
+    time_t batch_at = 0;
+    size_t batch_size = 0U;
+
+    tr_interned_string scrape_url;
+
+    constexpr tr_scrape_info(tr_interned_string scrape_url_in, size_t const multiscrape_max_in)
+        : multiscrape_max{ multiscrape_max_in }
+        , scrape_url{ scrape_url_in }
+    {
+    }
+
+    // @return when to scrape a tier that wants to be scraped at `at`.
+    // If a batch for this URL is due a little later, join it instead.
+    [[nodiscard]] constexpr time_t coalesce(time_t const at, time_t const slack) noexcept
+    {
+        if (batch_size < multiscrape_max && at <= batch_at && batch_at <= at + slack)
+        {
+            ++batch_size;
+            return batch_at;
+        }
+
+        if (at >= batch_at)
+        {
+            batch_at = at;
+            batch_size = 1U;
+        }
+
+        return at;
+    }
+
+    // Called when the tracker accepted a multiscrape of `row_count` hashes.
+    // After enough full batches, grow back towards the largest size
+    // it hasn't rejected.
+    // @return the new multiscrape_max if it changed
+    constexpr std::optional<size_t> on_batch_accepted(size_t const row_count) noexcept
+    {
+        if (row_count < multiscrape_max)
+        {
+            return {};
+        }
+
+        auto const limit = std::min(size_t{ TrMultiscrapeMax }, multiscrape_too_big - 1U);
+        if (multiscrape_max >= limit || ++multiscrape_full_successes < TrMultiscrapeGrowAfter)
+        {
+            return {};
+        }
+
+        multiscrape_max = std::min(multiscrape_max + TrMultiscrapeStep, limit);
+        multiscrape_full_successes = 0U;
+        return multiscrape_max;
+    }
+
+    // Called when the tracker said a multiscrape of `row_count` hashes was too long.
+    // @return the new multiscrape_max if it changed
+    constexpr std::optional<size_t> on_batch_too_big(size_t const row_count) noexcept
+    {
+        multiscrape_full_successes = 0U;
+        multiscrape_too_big = std::min(multiscrape_too_big, row_count);
+
+        // Lower the max only if it hasn't already lowered for a similar
+        // error. So if N parallel multiscrapes all have the same `max`
+        // and error out, lower the value once for that batch, not N times.
+        if (multiscrape_max < row_count)
+        {
+            return {};
+        }
+
+        auto const n = multiscrape_max > TrMultiscrapeStep ? multiscrape_max - TrMultiscrapeStep : 1U;
+        if (multiscrape_max == n)
+        {
+            return {};
+        }
+
+        multiscrape_max = n;
+        return multiscrape_max;
+    }
+};
+
 struct tr_scrape_response_row
 {
     /* the torrent's info_hash */
@@ -237,3 +341,77 @@ struct tr_scrape_response
      * this is an unofficial extension that some trackers won't support. */
     time_t min_request_interval;
 };
+
+// --- UPKEEP
+
+// Min-heap of when tiers next need an announce or scrape,
+// so that upkeep doesn't have to walk every tier of every torrent.
+// Stale wakeups are harmless: the tier is rechecked when popped.
+class tr_announcer_wakeups
+{
+public:
+    using Key = std::pair<tr_torrent_id_t, size_t>; // torrent id, tier id
+
+    void wake_at(time_t const at, tr_torrent_id_t const tor_id, size_t const tier_id)
+    {
+        if (at == 0)
+        {
+            return;
+        }
+
+        wakeups_.push_back({ at, { tor_id, tier_id } });
+        std::ranges::push_heap(wakeups_, Later{});
+    }
+
+    // Pops every wakeup that has come due.
+    // A tier can have several wakeups queued, but is only returned once.
+    [[nodiscard]] std::vector<Key> pop_due(time_t const now)
+    {
+        auto keys = std::vector<Key>{};
+
+        while (!std::empty(wakeups_) && wakeups_.front().first <= now)
+        {
+            std::ranges::pop_heap(wakeups_, Later{});
+            keys.push_back(wakeups_.back().second);
+            wakeups_.pop_back();
+        }
+
+        std::ranges::sort(keys);
+        auto const [first, last] = std::ranges::unique(keys);
+        keys.erase(first, last);
+        return keys;
+    }
+
+    // Whether a tier that was popped at `now` still has work to do --
+    // e.g. it was busy with another request, or there weren't enough
+    // announce slots this time -- and so needs to be woken again.
+    [[nodiscard]] static constexpr bool is_overdue(
+        time_t const now,
+        time_t const announce_at,
+        bool const has_announce_events,
+        time_t const scrape_at,
+        bool const can_scrape) noexcept
+    {
+        auto const announce_due = announce_at != 0 && announce_at <= now && has_announce_events;
+        auto const scrape_due = scrape_at != 0 && scrape_at <= now && can_scrape;
+        return announce_due || scrape_due;
+    }
+
+    [[nodiscard]] auto size() const noexcept
+    {
+        return std::size(wakeups_);
+    }
+
+private:
+    using Wakeup = std::pair<time_t, Key>;
+
+    struct Later
+    {
+        [[nodiscard]] constexpr bool operator()(Wakeup const& a, Wakeup const& b) const noexcept
+        {
+            return a.first > b.first;
+        }
+    };
+
+    std::vector<Wakeup> wakeups_;
+};
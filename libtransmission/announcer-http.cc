@@ -280,11 +280,12 @@ void tr_tracker_http_announce(
     options.timeout_secs = TrAnnounceTimeoutSec;
     options.sndbuf = 4096;
     options.rcvbuf = 4096;
+    options.prefer_reuse = true;
 
     auto do_make_request = [&](std::string_view const& protocol_name, tr_web::FetchOptions&& opt)
     {
         tr_logAddTrace(fmt::format("Sending {} announce to libcurl: '{}'", protocol_name, opt.url), request.log_name);
-        session->fetch(std::move(opt));
+        session->fetch_tracker(std::move(opt));
     };
 
     /*
@@ -557,7 +558,8 @@ void tr_tracker_http_scrape(tr_session const* session, tr_scrape_request const&
     options.timeout_secs = TrScrapeTimeoutSec;
     options.sndbuf = 4096;
     options.rcvbuf = 4096;
-    session->fetch(std::move(options));
+    options.prefer_reuse = true;
+    session->fetch_tracker(std::move(options));
 }
 
 void tr_announcerParseHttpScrapeResponse(tr_scrape_response& response, std::string_view benc, std::string_view log_name)
@@ -7,7 +7,7 @@
 #include <array>
 #include <chrono> // operator""ms
 #include <cstddef> // size_t
-#include <cstdint>
+#include <cstdint> // SIZE_MAX
 #include <ctime>
 #include <deque>
 #include <iterator>
@@ -60,8 +60,9 @@ auto constexpr Numwant = 80;
 auto constexpr MaxAnnouncesPerUpkeep = 20;
 auto constexpr MaxScrapesPerUpkeep = 20;
 
-/* how many infohashes to remove when we get a scrape-too-long error */
-auto constexpr TrMultiscrapeStep = 5U;
+/* a scrape may be pushed back by up to 1/Nth of its interval
+ * so that it can share a multiscrape with other torrents */
+auto constexpr ScrapeCoalesceDivisor = time_t{ 10 };
 
 struct StopsCompare
 {
@@ -98,18 +99,7 @@ struct StopsCompare
 
 // ---
 
-struct tr_scrape_info
-{
-    size_t multiscrape_max;
-
-    tr_interned_string scrape_url;
-
-    constexpr tr_scrape_info(tr_interned_string scrape_url_in, size_t const multiscrape_max_in)
-        : multiscrape_max{ multiscrape_max_in }
-        , scrape_url{ scrape_url_in }
-    {
-    }
-};
+struct tr_tier;
 
 /**
  * "global" (per-tr_session) fields
@@ -206,6 +196,14 @@ public:
         }
     }
 
+    // Have upkeep() look at this tier again once `at` comes due.
+    void wake_tier_at(time_t at, tr_torrent_id_t tor_id, size_t tier_id)
+    {
+        wakeups_.wake_at(at, tor_id, tier_id);
+    }
+
+    [[nodiscard]] std::vector<tr_tier*> pop_due_tiers(time_t now);
+
     tr_session* const session;
 
 private:
@@ -229,6 +227,8 @@ private:
 
     std::set<tr_announce_request, StopsCompare> stops_;
 
+    tr_announcer_wakeups wakeups_;
+
     bool is_shutting_down_ = false;
 };
 
@@ -362,6 +362,7 @@ struct tr_tier
 {
     tr_tier(tr_announcer_impl* announcer, tr_torrent* tor_in, std::vector<tr_announce_list::tracker_info const*> const& infos)
         : tor{ tor_in }
+        , announcer_{ announcer }
     {
         trackers.reserve(std::size(infos));
         for (auto const* info : infos)
@@ -438,6 +439,10 @@ struct tr_tier
         lastAnnounceStartTime = 0;
         lastScrapeStartTime = 0;
 
+        // the new tracker may be ready for work the old one wasn't
+        wakeAt(scrapeAt);
+        wakeAt(announceAt);
+
         return currentTracker();
     }
 
@@ -479,7 +484,20 @@ struct tr_tier
 
     void scheduleNextScrape(time_t interval_secs)
     {
-        this->scrapeAt = getNextScrapeTime(tor->session, this, interval_secs);
+        auto at = getNextScrapeTime(tor->session, this, interval_secs);
+
+        if (auto* const tracker = currentTracker(); at != 0 && tracker != nullptr && tracker->scrape_info != nullptr)
+        {
+            at = tracker->scrape_info->coalesce(at, interval_secs / ScrapeCoalesceDivisor);
+        }
+
+        this->scrapeAt = at;
+        wakeAt(this->scrapeAt);
+    }
+
+    void wakeAt(time_t at)
+    {
+        announcer_->wake_tier_at(at, tor->id(), id);
     }
 
     std::deque<tr_announce_event> announce_events;
@@ -553,6 +571,8 @@ private:
         return ret;
     }
 
+    tr_announcer_impl* const announcer_;
+
     static inline size_t next_key = {};
 };
 
@@ -847,6 +867,7 @@ void tier_announce_event_push(tr_tier* tier, tr_announce_event e, time_t announc
     /* add it */
     events.push_back(e);
     tier->announceAt = announce_at;
+    tier->wakeAt(announce_at);
     tier_update_announce_priority(tier);
 
     tr_logAddTrace_tier_announce_queue(tier);
@@ -1275,11 +1296,6 @@ void on_scrape_error(tr_session const* /*session*/, tr_tier* tier, char const* e
 
 void checkMultiscrapeMax(tr_announcer_impl* announcer, tr_scrape_response const& response)
 {
-    if (!multiscrape_too_big(response.errmsg))
-    {
-        return;
-    }
-
     auto const& url = response.scrape_url;
     auto* const scrape_info = announcer->scrape_info(url);
     if (scrape_info == nullptr)
@@ -1287,22 +1303,25 @@ void checkMultiscrapeMax(tr_announcer_impl* announcer, tr_scrape_response const&
         return;
     }
 
-    // Lower the max only if it hasn't already lowered for a similar
-    // error. So if N parallel multiscrapes all have the same `max`
-    // and error out, lower the value once for that batch, not N times.
-    auto& multiscrape_max = scrape_info->multiscrape_max;
-    if (multiscrape_max < response.row_count)
+    if (!multiscrape_too_big(response.errmsg))
     {
+        // If the tracker took a full batch, maybe it'd take a bigger one.
+        auto const accepted = response.did_connect && !response.did_timeout && std::empty(response.errmsg);
+        if (accepted)
+        {
+            if (auto const n = scrape_info->on_batch_accepted(response.row_count); n)
+            {
+                tr_logAddDebug(fmt::format("Raising multiscrape max to {:d}", *n), tr_urlTrackerLogName(url));
+            }
+        }
+
         return;
     }
 
-    auto const n = multiscrape_max > TrMultiscrapeStep ? multiscrape_max - TrMultiscrapeStep : 1U;
-    if (multiscrape_max != n)
+    if (auto const n = scrape_info->on_batch_too_big(response.row_count); n)
     {
         // don't log the full URL, since that might have a personal announce id
-        tr_logAddDebug(fmt::format("Reducing multiscrape max to {:d}", n), tr_urlTrackerLogName(url));
-
-        multiscrape_max = n;
+        tr_logAddDebug(fmt::format("Reducing multiscrape max to {:d}", *n), tr_urlTrackerLogName(url));
     }
 }
 } // namespace on_scrape_done_helpers
@@ -1553,21 +1572,19 @@ void scrapeAndAnnounceMore(tr_announcer_impl* announcer)
     auto const now = tr_time();
 
     /* build a list of tiers that need to be announced */
+    auto const due = announcer->pop_due_tiers(now);
     auto announce_me = std::vector<tr_tier*>{};
     auto scrape_me = std::vector<tr_tier*>{};
-    for (auto* const tor : announcer->session->torrents())
+    for (auto* const tier : due)
     {
-        for (auto& tier : tor->torrent_announcer->tiers)
+        if (tier->needsToAnnounce(now))
         {
-            if (tier.needsToAnnounce(now))
-            {
-                announce_me.push_back(&tier);
-            }
+            announce_me.push_back(tier);
+        }
 
-            if (tier.needsToScrape(now))
-            {
-                scrape_me.push_back(&tier);
-            }
+        if (tier->needsToScrape(now))
+        {
+            scrape_me.push_back(tier);
         }
     }
 
@@ -1594,10 +1611,44 @@ void scrapeAndAnnounceMore(tr_announcer_impl* announcer)
         tr_logAddTraceTier(tier, "Announcing to tracker");
         tierAnnounce(announcer, tier);
     }
+
+    /* Anything that's still overdue -- because there weren't enough
+     * slots this time, or because the tier is busy with another
+     * request -- gets looked at again on the next upkeep. */
+    for (auto* const tier : due)
+    {
+        auto const* const tracker = tier->currentTracker();
+        auto const has_events = !std::empty(tier->announce_events);
+        auto const can_scrape = tracker != nullptr && tracker->scrape_info != nullptr;
+
+        if (tr_announcer_wakeups::is_overdue(now, tier->announceAt, has_events, tier->scrapeAt, can_scrape))
+        {
+            tier->wakeAt(now + 1);
+        }
+    }
 }
 } // namespace upkeep_helpers
 } // namespace
 
+std::vector<tr_tier*> tr_announcer_impl::pop_due_tiers(time_t const now)
+{
+    auto tiers = std::vector<tr_tier*>{};
+
+    for (auto const& [tor_id, tier_id] : wakeups_.pop_due(now))
+    {
+        // the torrent or tier may have been removed since this was queued
+        if (auto* const tor = session->torrents().get(tor_id); tor != nullptr && tor->torrent_announcer != nullptr)
+        {
+            if (auto* const tier = tor->torrent_announcer->getTier(tier_id); tier != nullptr)
+            {
+                tiers.push_back(tier);
+            }
+        }
+    }
+
+    return tiers;
+}
+
 void tr_announcer_impl::upkeep()
 {
     using namespace upkeep_helpers;
@@ -8,6 +8,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <initializer_list>
+#include <iterator> // std::next
 #include <limits>
 #include <memory>
 #include <ranges>
@@ -17,7 +18,6 @@
 #include <fmt/format.h>
 
 #include "libtransmission/bandwidth.h"
-#include "libtransmission/crypto-utils.h"
 #include "libtransmission/log.h"
 #include "libtransmission/peer-io.h"
 #include "libtransmission/tr-assert.h"
@@ -119,6 +119,16 @@ void tr_bandwidth::deparent() noexcept
     }
 
     remove_child(parent_->children_, this);
+
+    for (uint8_t idx = 0U; idx < 2U; ++idx)
+    {
+        if (is_active_[idx])
+        {
+            remove_child(parent_->active_children_[idx], this);
+            is_active_[idx] = false;
+        }
+    }
+
     parent_ = nullptr;
 }
 
@@ -138,41 +148,119 @@ void tr_bandwidth::set_parent(tr_bandwidth* new_parent)
 
         new_parent->children_.push_back(this);
         parent_ = new_parent;
+
+        // if this subtree has pending peers, the new parent needs to know
+        for (auto const dir : { tr_direction::Up, tr_direction::Down })
+        {
+            if (auto const idx = static_cast<uint8_t>(dir); is_pending_[idx] || !std::empty(active_children_[idx]))
+            {
+                activate(dir);
+            }
+        }
     }
 }
 
 // ---
 
-void tr_bandwidth::allocate_bandwidth(
-    tr_priority_t parent_priority,
-    uint64_t period_msec,
-    std::vector<std::shared_ptr<tr_peerIo>>& peer_pool)
+void tr_bandwidth::refill(Band& band, uint64_t const now) noexcept
 {
+    auto const bytes_per_second = band.desired_speed_.base_quantity();
+    auto const burst = static_cast<size_t>(bytes_per_second * BurstMSec / 1000U);
+
+    if (band.bytes_left_ >= burst)
+    {
+        band.bytes_left_ = burst;
+        band.refilled_at_ = now;
+        return;
+    }
+
+    if (now <= band.refilled_at_)
+    {
+        return;
+    }
+
+    auto const elapsed_msec = std::min(now - band.refilled_at_, uint64_t{ BurstMSec });
+    auto const earned = static_cast<size_t>(bytes_per_second * elapsed_msec / 1000U);
+    if (earned == 0U)
+    {
+        // Don't move `refilled_at_` until we've earned at least a byte,
+        // or slow speeds would keep getting rounded down to nothing.
+        return;
+    }
+
+    band.bytes_left_ = std::min(burst, band.bytes_left_ + earned);
+    band.refilled_at_ = now;
+}
+
+// ---
+
+void tr_bandwidth::set_pending(tr_direction const dir)
+{
+    is_pending_[static_cast<uint8_t>(dir)] = true;
+    activate(dir);
+}
+
+void tr_bandwidth::activate(tr_direction const dir)
+{
+    auto const idx = static_cast<uint8_t>(dir);
+
+    // walk up until we reach a node that's already listed
+    for (auto* node = this; node->parent_ != nullptr && !node->is_active_[idx]; node = node->parent_)
+    {
+        node->is_active_[idx] = true;
+        node->parent_->active_children_[idx].push_back(node);
+    }
+}
+
+bool tr_bandwidth::collect_pending(
+    tr_direction const dir,
+    tr_priority_t const parent_priority,
+    std::vector<std::shared_ptr<tr_peerIo>>& refs,
+    PeersByPriority& peers)
+{
+    auto const idx = static_cast<uint8_t>(dir);
     auto const priority = std::min(parent_priority, priority_);
 
-    // set the available bandwidth
-    for (auto const dir : { tr_direction::Up, tr_direction::Down })
+    // add this bandwidth's peer, if it's waiting
+    if (is_pending_[idx])
     {
-        if (auto& bandwidth = band_[static_cast<uint8_t>(dir)]; bandwidth.is_limited_)
+        if (auto shared = peer_.lock(); shared)
         {
-            auto const next_pulse_speed = bandwidth.desired_speed_;
-            bandwidth.bytes_left_ = next_pulse_speed.base_quantity() * period_msec / 1000U;
+            TR_ASSERT(tr_isPriority(priority));
+            shared->set_priority(priority);
+            peers[static_cast<size_t>(TR_PRI_HIGH - priority)].push_back(shared.get());
+            refs.push_back(std::move(shared));
+        }
+        else
+        {
+            is_pending_[idx] = false;
         }
     }
 
-    // add this bandwidth's peer, if any, to the peer pool
-    if (auto shared = peer_.lock(); shared)
+    // traverse & repeat for the active subtrees,
+    // dropping the ones that have nothing pending anymore
+    auto& active = active_children_[idx];
+    for (size_t i = 0U; i < std::size(active);)
     {
-        TR_ASSERT(tr_isPriority(priority));
-        shared->set_priority(priority);
-        peer_pool.push_back(std::move(shared));
+        if (auto* const child = active[i]; child->collect_pending(dir, priority, refs, peers))
+        {
+            ++i;
+        }
+        else
+        {
+            child->is_active_[idx] = false;
+            std::swap(active[i], active.back());
+            active.pop_back();
+        }
     }
 
-    // traverse & repeat for the subtree
-    for (auto* child : children_)
+    // start with a different child next time so the same subtree isn't always first in line
+    if (std::size(active) > 1U)
     {
-        child->allocate_bandwidth(priority, period_msec, peer_pool);
+        std::ranges::rotate(active, std::next(std::begin(active)));
     }
+
+    return is_pending_[idx] || !std::empty(active);
 }
 
 void tr_bandwidth::phase_one(std::vector<tr_peerIo*>& peers, tr_direction dir)
@@ -182,95 +270,86 @@ void tr_bandwidth::phase_one(std::vector<tr_peerIo*>& peers, tr_direction dir)
     tr_logAddTrace(
         fmt::format("{} peers to go round-robin for {}", peers.size(), dir == tr_direction::Up ? "upload" : "download"));
 
-    // Shuffle the peers so they all have equal chance to be first in line.
-    static thread_local auto urbg = tr_urbg<size_t>{};
-    std::shuffle(std::begin(peers), std::end(peers), urbg);
+    // Value of 3000 bytes chosen so that when using µTP we'll send a full-size
+    // frame right away and leave enough buffered data for the next frame to go
+    // out in a timely manner.
+    static auto constexpr Increment = size_t{ 3000U };
 
-    // Give each peer `Increment` bandwidth bytes to use. Repeat this
-    // process until we run out of bandwidth and/or peers that can use it.
+    auto const idx = static_cast<uint8_t>(dir);
+
+    // Give each peer `Increment` bandwidth bytes to use, plus whatever it was
+    // shortchanged on its last turn. Repeat this process until we run out of
+    // bandwidth and/or peers that can use it.
     for (size_t n_unfinished = std::size(peers); n_unfinished > 0U;)
     {
         for (size_t i = 0U; i < n_unfinished;)
         {
-            // Value of 3000 bytes chosen so that when using µTP we'll send a full-size
-            // frame right away and leave enough buffered data for the next frame to go
-            // out in a timely manner.
-            static auto constexpr Increment = 3000U;
+            auto* const io = peers[i];
+            auto& deficit = io->bandwidth().deficit_[idx];
+            auto const offered = deficit + Increment;
 
-            auto const bytes_used = peers[i]->flush(dir, Increment);
+            auto const bytes_used = io->flush(dir, offered);
             tr_logAddTrace(fmt::format("peer #{} of {} used {} bytes in this pass", i, n_unfinished, bytes_used));
 
-            if (bytes_used != Increment)
-            {
-                // peer is done writing for now; move it to the end of the list
-                std::swap(peers[i], peers[n_unfinished - 1]);
-                --n_unfinished;
-            }
-            else
+            if (bytes_used == offered)
             {
+                deficit = 0U;
                 ++i;
+                continue;
             }
+
+            // The peer is done for now. If it stopped because it ran out of
+            // bandwidth, it gets the rest of its share back on its next turn.
+            deficit = io->has_bandwidth_left(dir) ? 0U : std::min(offered - bytes_used, Increment);
+
+            // move it to the end of the list
+            std::swap(peers[i], peers[n_unfinished - 1]);
+            --n_unfinished;
         }
     }
 }
 
-void tr_bandwidth::allocate(uint64_t period_msec)
+void tr_bandwidth::allocate()
 {
-    // keep these peers alive for the scope of this function
-    auto refs = std::vector<std::shared_ptr<tr_peerIo>>{};
-
-    auto peer_arrays = std::array<std::vector<tr_peerIo*>, 3>{};
-    auto& high = peer_arrays[0];
-    auto& normal = peer_arrays[1];
-    auto& low = peer_arrays[2];
-
-    // allocateBandwidth () is a helper function with two purposes:
-    // 1. allocate bandwidth to b and its subtree
-    // 2. accumulate an array of all the peerIos from b and its subtree.
-    allocate_bandwidth(std::numeric_limits<tr_priority_t>::max(), period_msec, refs);
-
-    for (auto const& io : refs)
+    for (auto const dir : { tr_direction::Up, tr_direction::Down })
     {
-        io->flush_outgoing_protocol_msgs();
+        auto const idx = static_cast<uint8_t>(dir);
 
-        switch (io->priority())
-        {
-        case TR_PRI_HIGH:
-            high.push_back(io.get());
-            [[fallthrough]];
+        // keep these peers alive for the scope of this function
+        auto refs = std::vector<std::shared_ptr<tr_peerIo>>{};
 
-        case TR_PRI_NORMAL:
-            normal.push_back(io.get());
-            [[fallthrough]];
+        // the peers that are waiting for bandwidth, in high/normal/low priority order
+        auto peers = PeersByPriority{};
+        collect_pending(dir, std::numeric_limits<tr_priority_t>::max(), refs, peers);
 
-        case TR_PRI_LOW:
-            low.push_back(io.get());
-            break;
+        if (dir == tr_direction::Up)
+        {
+            for (auto const& io : refs)
+            {
+                io->flush_outgoing_protocol_msgs();
+            }
+        }
 
-        default:
-            TR_ASSERT_MSG(false, "invalid priority");
-            break;
+        // First phase of IO. Tries to distribute bandwidth fairly to keep faster
+        // peers from starving the others. Higher-priority peers go first.
+        for (auto& prio_peers : peers)
+        {
+            phase_one(prio_peers, dir);
         }
-    }
 
-    // First phase of IO. Tries to distribute bandwidth fairly to keep faster
-    // peers from starving the others. Loop through the peers, giving each a
-    // small chunk of bandwidth. Keep looping until we run out of bandwidth
-    // and/or peers that can use it
-    for (auto& peers : peer_arrays)
-    {
-        phase_one(peers, tr_direction::Up);
-        phase_one(peers, tr_direction::Down);
-    }
+        // Second phase of IO. To help us scale in high bandwidth situations,
+        // enable on-demand IO for peers with bandwidth left to burn.
+        // Those peers drop out of the scheduler until they run short again.
+        for (auto const& io : refs)
+        {
+            auto const has_bandwidth_left = io->has_bandwidth_left(dir);
+            io->set_enabled(dir, has_bandwidth_left);
 
-    // Second phase of IO. To help us scale in high bandwidth situations,
-    // enable on-demand IO for peers with bandwidth left to burn.
-    // This on-demand IO is enabled until (1) the peer runs out of bandwidth,
-    // or (2) the next tr_bandwidth::allocate () call, when we start over again.
-    for (auto const& io : refs)
-    {
-        io->set_enabled(tr_direction::Up, io->has_bandwidth_left(tr_direction::Up));
-        io->set_enabled(tr_direction::Down, io->has_bandwidth_left(tr_direction::Down));
+            if (has_bandwidth_left)
+            {
+                io->bandwidth().is_pending_[idx] = false;
+            }
+        }
     }
 }
 
@@ -280,9 +359,10 @@ size_t tr_bandwidth::clamp(tr_direction const dir, size_t byte_count) const noex
 {
     auto const idx = static_cast<uint8_t>(dir);
 
-    if (band_[idx].is_limited_)
+    if (auto& band = band_[idx]; band.is_limited_)
     {
-        byte_count = std::min(byte_count, band_[idx].bytes_left_);
+        refill(band, tr_time_msec());
+        byte_count = std::min(byte_count, band.bytes_left_);
     }
 
     if (parent_ != nullptr && band_[idx].honor_parent_limits_ && byte_count > 0U)
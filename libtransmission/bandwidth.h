@@ -22,6 +22,11 @@
 
 class tr_peerIo;
 
+namespace tr::test
+{
+class BandwidthTest;
+} // namespace tr::test
+
 /**
  * @addtogroup networked_io Networked IO
  * @{
@@ -62,17 +67,24 @@ struct tr_bandwidth_limits
  *
  * CONSTRAINING
  *
- *   Call `tr_bandwidth::allocate()` periodically. `tr_bandwidth` knows its current
- *   speed and will decide how many bytes to make available over the
- *   user-specified period to reach the user-specified desired speed.
- *   If appropriate, it notifies its peer-ios that new bandwidth is available.
- *
- *   `tr_bandwidth::allocate()` operates on the `tr_bandwidth` subtree, so usually
- *   you'll only need to invoke it for the top-level `tr_session` bandwidth.
+ *   Each limited `tr_bandwidth` is a token bucket that refills at its desired
+ *   speed and can bank up to `BurstMSec` worth of unused bandwidth.
  *
  *   The peer-ios all have a pointer to their associated `tr_bandwidth` object,
  *   and call `tr_bandwidth::clamp()` before performing I/O to see how much
- *   bandwidth they can safely use.
+ *   bandwidth they can safely use. When that's less than they wanted, they call
+ *   `tr_bandwidth::set_pending()` to get in line for more.
+ *
+ * SCHEDULING
+ *
+ *   Every node keeps a list of the children that have a pending peer somewhere
+ *   in their subtree, so the scheduler only visits the peers that are waiting
+ *   for bandwidth instead of walking every peer in the session.
+ *
+ *   Call `tr_bandwidth::allocate()` periodically on the top-level `tr_session`
+ *   bandwidth. It hands out the refilled bandwidth to the pending peers in
+ *   priority order, using deficit round-robin within each priority so that
+ *   faster peers can't starve the others.
  */
 struct tr_bandwidth
 {
@@ -84,6 +96,11 @@ private:
     static constexpr auto HistorySize = HistoryMSec / GranularityMSec;
 
 public:
+    // How much unused bandwidth a limited node can bank, in msec of its desired speed.
+    // This is about one `allocate()` period, so that bandwidth that goes unused
+    // in one period isn't carried over indefinitely.
+    static constexpr auto BurstMSec = 500U;
+
     explicit tr_bandwidth(tr_bandwidth* parent, bool is_group = false);
 
     explicit tr_bandwidth(bool is_group = false)
@@ -116,9 +133,15 @@ public:
     void notify_bandwidth_consumed(tr_direction dir, size_t byte_count, bool is_piece_data, uint64_t now);
 
     /**
-     * @brief allocate the next `period_msec`'s worth of bandwidth for the peer-ios to consume
+     * @brief Note that this bandwidth's peer-io has I/O in `dir` that's waiting for bandwidth.
+     * The next `allocate()` will give the peer-io a turn.
+     */
+    void set_pending(tr_direction dir);
+
+    /**
+     * @brief give the bandwidth that's been refilled since the last call to the pending peer-ios
      */
-    void allocate(uint64_t period_msec);
+    void allocate();
 
     void set_parent(tr_bandwidth* new_parent);
 
@@ -226,6 +249,8 @@ public:
     void set_limits(tr_bandwidth_limits const& limits);
 
 private:
+    friend class tr::test::BandwidthTest;
+
     struct RateControl
     {
         std::array<uint64_t, HistorySize> date_;
@@ -240,6 +265,7 @@ private:
         RateControl raw_;
         RateControl piece_;
         size_t bytes_left_;
+        uint64_t refilled_at_;
         Speed desired_speed_;
         bool is_limited_ = false;
         bool honor_parent_limits_ = true;
@@ -256,15 +282,41 @@ private:
 
     static void notify_bandwidth_consumed_bytes(uint64_t now, RateControl& r, size_t size);
 
+    static void refill(Band& band, uint64_t now) noexcept;
+
+    using PeersByPriority = std::array<std::vector<tr_peerIo*>, 3>;
+
     static void phase_one(std::vector<tr_peerIo*>& peers, tr_direction dir);
 
-    void allocate_bandwidth(
+    // Put this node into its ancestors' active lists.
+    void activate(tr_direction dir);
+
+    // Gathers the pending peer-ios in this subtree and prunes the nodes that have none.
+    // @return true if this subtree still has pending peer-ios
+    bool collect_pending(
+        tr_direction dir,
         tr_priority_t parent_priority,
-        uint64_t period_msec,
-        std::vector<std::shared_ptr<tr_peerIo>>& peer_pool);
+        std::vector<std::shared_ptr<tr_peerIo>>& refs,
+        PeersByPriority& peers);
 
     mutable std::array<Band, 2> band_ = {};
     std::vector<tr_bandwidth*> children_;
+
+    // Per direction: the children with pending peer-ios in their subtree.
+    // A child is only in this list if its `is_active_` is set.
+    std::array<std::vector<tr_bandwidth*>, 2> active_children_;
+
+    // Per direction: whether this node is in its parent's `active_children_`
+    std::array<bool, 2> is_active_ = {};
+
+    // Per direction: whether this node's own peer-io is waiting for bandwidth
+    std::array<bool, 2> is_pending_ = {};
+
+    // Per direction: bytes that this node's peer-io was offered but
+    // couldn't use because it ran out of bandwidth. It gets them back
+    // on its next turn.
+    std::array<size_t, 2> deficit_ = {};
+
     tr_bandwidth* parent_ = nullptr;
     std::weak_ptr<tr_peerIo> peer_;
     tr_priority_t priority_;
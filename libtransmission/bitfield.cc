@@ -7,6 +7,7 @@
 #include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstring> // std::memcpy
 #include <vector> // std::vector
 
 #include "libtransmission/bitfield.h"
@@ -49,10 +50,40 @@ void setAllTrue(uint8_t* array, size_t bit_count)
     }
 }
 
+// The bulk operations below walk the flags a word at a time instead of
+// a byte at a time. They're plain loops so that the compiler can unroll
+// and vectorize them for whatever the build targets.
+
+using Word = uint64_t;
+
+auto constexpr WordSize = sizeof(Word);
+
+[[nodiscard]] Word loadWord(uint8_t const* bytes) noexcept
+{
+    auto word = Word{};
+    std::memcpy(&word, bytes, WordSize);
+    return word;
+}
+
+void storeWord(uint8_t* bytes, Word const word) noexcept
+{
+    std::memcpy(bytes, &word, WordSize);
+}
+
 [[nodiscard]] size_t rawCountFlags(uint8_t const* flags, size_t n) noexcept
 {
     auto ret = size_t{};
 
+    /* Use 2x accumulators to help alleviate high latency of
+       popcnt instruction on many architectures. */
+    auto tmp_accum = size_t{};
+    for (; n >= WordSize * 2U; flags += WordSize * 2U, n -= WordSize * 2U)
+    {
+        ret += std::popcount(loadWord(flags));
+        tmp_accum += std::popcount(loadWord(flags + WordSize));
+    }
+    ret += tmp_accum;
+
     for (auto const* const end = flags + n; flags != end; ++flags)
     {
         ret += std::popcount(*flags);
@@ -61,6 +92,42 @@ void setAllTrue(uint8_t* array, size_t bit_count)
     return ret;
 }
 
+// flags[i] = op(flags[i], that[i]) for i in [0, n)
+template<typename Op>
+void rawApply(uint8_t* flags, uint8_t const* that, size_t n, Op const& op) noexcept
+{
+    for (; n >= WordSize; flags += WordSize, that += WordSize, n -= WordSize)
+    {
+        storeWord(flags, op(loadWord(flags), loadWord(that)));
+    }
+
+    for (auto const* const end = flags + n; flags != end; ++flags, ++that)
+    {
+        *flags = static_cast<uint8_t>(op(*flags, *that));
+    }
+}
+
+[[nodiscard]] bool rawIntersects(uint8_t const* flags, uint8_t const* that, size_t n) noexcept
+{
+    for (; n >= WordSize; flags += WordSize, that += WordSize, n -= WordSize)
+    {
+        if ((loadWord(flags) & loadWord(that)) != 0U)
+        {
+            return true;
+        }
+    }
+
+    for (auto const* const end = flags + n; flags != end; ++flags, ++that)
+    {
+        if ((*flags & *that) != 0U)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 } // namespace
 
 // ---
@@ -111,21 +178,7 @@ size_t tr_bitfield::count_flags(size_t begin, size_t end) const noexcept
         ret = std::popcount(val);
 
         /* middle bytes */
-
-        /* Use 2x accumulators to help alleviate high latency of
-           popcnt instruction on many architectures. */
-        size_t tmp_accum = 0;
-        for (size_t i = first_byte + 1; i < walk_end;)
-        {
-            tmp_accum += std::popcount(flags_[i]);
-            i += 2;
-            if (i > walk_end)
-            {
-                break;
-            }
-            ret += std::popcount(flags_[i - 1]);
-        }
-        ret += tmp_accum;
+        ret += rawCountFlags(std::data(flags_) + first_byte + 1, walk_end - first_byte - 1);
 
         /* last byte */
         if (last_byte < std::size(flags_))
@@ -441,11 +494,7 @@ tr_bitfield& tr_bitfield::operator|=(tr_bitfield const& that) noexcept
     }
 
     flags_.resize(std::max(std::size(flags_), std::size(that.flags_)));
-
-    for (size_t i = 0, n = std::size(that.flags_); i < n; ++i)
-    {
-        flags_[i] |= that.flags_[i];
-    }
+    rawApply(std::data(flags_), std::data(that.flags_), std::size(that.flags_), [](auto lhs, auto rhs) { return lhs | rhs; });
 
     rebuild_true_count();
     return *this;
@@ -465,11 +514,7 @@ tr_bitfield& tr_bitfield::operator&=(tr_bitfield const& that) noexcept
     }
 
     flags_.resize(std::min(std::size(flags_), std::size(that.flags_)));
-
-    for (size_t i = 0, n = std::size(flags_); i < n; ++i)
-    {
-        flags_[i] &= that.flags_[i];
-    }
+    rawApply(std::data(flags_), std::data(that.flags_), std::size(flags_), [](auto lhs, auto rhs) { return lhs & rhs; });
 
     rebuild_true_count();
     return *this;
@@ -487,13 +532,5 @@ bool tr_bitfield::intersects(tr_bitfield const& that) const noexcept
         return true;
     }
 
-    for (size_t i = 0, n = std::min(std::size(flags_), std::size(that.flags_)); i < n; ++i)
-    {
-        if ((flags_[i] & that.flags_[i]) != 0U)
-        {
-            return true;
-        }
-    }
-
-    return false;
+    return rawIntersects(std::data(flags_), std::data(that.flags_), std::min(std::size(flags_), std::size(that.flags_)));
 }
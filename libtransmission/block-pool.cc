@@ -0,0 +1,297 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::copy
+#include <array>
+#include <atomic>
+#include <cstddef> // std::byte, size_t
+#include <cstdint> // uintptr_t
+#include <mutex>
+#include <new> // std::align_val_t
+
+#ifndef _WIN32
+#include <sys/mman.h> // madvise()
+#endif
+
+#include "libtransmission/block-pool.h"
+#include "libtransmission/tr-assert.h"
+
+// Arenas are aligned to their own size, so a slot's arena can be found by
+// masking off the low bits of the slot's address.
+struct tr_block_pool::Arena
+{
+    [[nodiscard]] static Arena* from_slot(void const* slot) noexcept
+    {
+        return reinterpret_cast<Arena*>(reinterpret_cast<uintptr_t>(slot) & ~uintptr_t{ ArenaSize - 1U });
+    }
+
+    [[nodiscard]] std::byte* slot(size_t const idx) noexcept
+    {
+        return reinterpret_cast<std::byte*>(this) + ArenaHeaderSize + (idx * SlotSize);
+    }
+
+    // Returned slots, linked through their first bytes.
+    void* free_head = nullptr;
+
+    // Slots past this index have never been handed out. They're carved off lazily
+    // so that a new arena's pages aren't touched until they're needed.
+    size_t n_carved = {};
+
+    size_t n_free = {};
+
+    Arena* prev = nullptr;
+    Arena* next = nullptr;
+};
+
+// Trivially destructible, so it's still safe to look at while the thread is exiting.
+struct tr_block_pool::ThreadCache
+{
+    static auto constexpr Capacity = size_t{ 32U };
+    static auto constexpr Batch = Capacity / 2U;
+
+    std::array<void*, Capacity> slots;
+    size_t n_slots;
+    bool is_closed;
+};
+
+tr_block_pool& tr_block_pool::instance()
+{
+    // Deliberately leaked: blocks may still be freed by other
+    // static and thread-local destructors during shutdown.
+    static auto* const pool = new tr_block_pool{};
+    return *pool;
+}
+
+tr_block_pool::ThreadCache* tr_block_pool::thread_cache() noexcept
+{
+    static thread_local auto cache = ThreadCache{};
+
+    // hand the thread's stash back to the pool when the thread exits
+    struct Flusher
+    {
+        Flusher() = default;
+        Flusher(Flusher const&) = delete;
+        Flusher(Flusher&&) = delete;
+        Flusher& operator=(Flusher const&) = delete;
+        Flusher& operator=(Flusher&&) = delete;
+
+        ~Flusher()
+        {
+            cache.is_closed = true;
+            instance().give_slots(std::data(cache.slots), cache.n_slots);
+            cache.n_slots = 0U;
+        }
+    };
+
+    if (cache.is_closed)
+    {
+        return nullptr;
+    }
+
+    [[maybe_unused]] static thread_local auto const flusher = Flusher{};
+    return &cache;
+}
+
+void* tr_block_pool::allocate()
+{
+    auto* slot = static_cast<void*>(nullptr);
+
+    if (auto* const cache = thread_cache(); cache == nullptr)
+    {
+        [[maybe_unused]] auto const n = take_slots(&slot, 1U);
+    }
+    else
+    {
+        if (cache->n_slots == 0U)
+        {
+            cache->n_slots = take_slots(std::data(cache->slots), ThreadCache::Batch);
+        }
+
+        slot = cache->slots[--cache->n_slots];
+    }
+
+    n_in_use_.fetch_add(1U, std::memory_order_relaxed);
+    n_allocations_.fetch_add(1U, std::memory_order_relaxed);
+    return slot;
+}
+
+void tr_block_pool::deallocate(void* const ptr) noexcept
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+
+    n_in_use_.fetch_sub(1U, std::memory_order_relaxed);
+
+    auto* const cache = thread_cache();
+    if (cache == nullptr)
+    {
+        give_slots(&ptr, 1U);
+        return;
+    }
+
+    if (cache->n_slots == ThreadCache::Capacity)
+    {
+        // return the older half; the newer ones are likelier to still be in the CPU cache
+        auto* const begin = std::data(cache->slots);
+        give_slots(begin, ThreadCache::Batch);
+        std::copy(begin + ThreadCache::Batch, begin + ThreadCache::Capacity, begin);
+        cache->n_slots -= ThreadCache::Batch;
+    }
+
+    cache->slots[cache->n_slots++] = ptr;
+}
+
+tr_block_pool::Stats tr_block_pool::stats() const noexcept
+{
+    auto const n_arenas = n_arenas_.load(std::memory_order_relaxed);
+    auto const n_in_use = n_in_use_.load(std::memory_order_relaxed);
+
+    auto ret = Stats{};
+    ret.arena_count = n_arenas;
+    ret.bytes_reserved = n_arenas * ArenaSize;
+    ret.buffers_in_use = n_in_use;
+    ret.buffers_free = std::max(n_arenas * SlotsPerArena, n_in_use) - n_in_use;
+    ret.allocation_count = n_allocations_.load(std::memory_order_relaxed);
+    return ret;
+}
+
+// ---
+
+size_t tr_block_pool::take_slots(void** const setme, size_t const n)
+{
+    auto const lock = std::scoped_lock{ mutex_ };
+
+    auto n_taken = size_t{};
+    while (n_taken < n)
+    {
+        if (available_head_ == nullptr)
+        {
+            if (n_taken > 0U)
+            {
+                break;
+            }
+
+            link_back(new_arena());
+        }
+
+        auto* const arena = available_head_;
+        if (arena->n_free == SlotsPerArena)
+        {
+            --n_idle_arenas_;
+        }
+
+        for (; n_taken < n && arena->n_free > 0U; --arena->n_free)
+        {
+            if (auto* const slot = arena->free_head; slot != nullptr)
+            {
+                arena->free_head = *static_cast<void**>(slot);
+                setme[n_taken++] = slot;
+            }
+            else
+            {
+                setme[n_taken++] = arena->slot(arena->n_carved++);
+            }
+        }
+
+        if (arena->n_free == 0U)
+        {
+            unlink(arena);
+        }
+    }
+
+    return n_taken;
+}
+
+void tr_block_pool::give_slots(void* const* const slots, size_t const n) noexcept
+{
+    auto const lock = std::scoped_lock{ mutex_ };
+
+    for (size_t i = 0U; i < n; ++i)
+    {
+        auto* const slot = slots[i];
+        auto* const arena = Arena::from_slot(slot);
+        TR_ASSERT(arena->n_free < SlotsPerArena);
+
+        *static_cast<void**>(slot) = arena->free_head;
+        arena->free_head = slot;
+
+        if (++arena->n_free == 1U)
+        {
+            link_front(arena);
+        }
+
+        if (arena->n_free == SlotsPerArena)
+        {
+            unlink(arena);
+
+            if (n_idle_arenas_ < MaxIdleArenas)
+            {
+                ++n_idle_arenas_;
+                link_back(arena);
+            }
+            else
+            {
+                release_arena(arena);
+            }
+        }
+    }
+}
+
+tr_block_pool::Arena* tr_block_pool::new_arena()
+{
+    static_assert(sizeof(Arena) <= ArenaHeaderSize);
+    static_assert(ArenaHeaderSize % alignof(std::max_align_t) == 0U);
+    static_assert(SlotSize % alignof(std::max_align_t) == 0U);
+
+    auto* const mem = ::operator new(ArenaSize, std::align_val_t{ ArenaSize });
+
+#ifdef MADV_HUGEPAGE
+    // Must happen before the pages are first touched to have any effect.
+    if (huge_pages_enabled_.load(std::memory_order_relaxed))
+    {
+        ::madvise(mem, ArenaSize, MADV_HUGEPAGE);
+    }
+#endif
+
+    auto* const arena = new (mem) Arena{};
+    arena->n_free = SlotsPerArena;
+
+    ++n_idle_arenas_;
+    n_arenas_.fetch_add(1U, std::memory_order_relaxed);
+    return arena;
+}
+
+void tr_block_pool::release_arena(Arena* const arena) noexcept
+{
+    arena->~Arena();
+    ::operator delete(arena, std::align_val_t{ ArenaSize });
+    n_arenas_.fetch_sub(1U, std::memory_order_relaxed);
+}
+
+void tr_block_pool::link_front(Arena* const arena) noexcept
+{
+    arena->prev = nullptr;
+    arena->next = available_head_;
+    (available_head_ != nullptr ? available_head_->prev : available_tail_) = arena;
+    available_head_ = arena;
+}
+
+void tr_block_pool::link_back(Arena* const arena) noexcept
+{
+    arena->prev = available_tail_;
+    arena->next = nullptr;
+    (available_tail_ != nullptr ? available_tail_->next : available_head_) = arena;
+    available_tail_ = arena;
+}
+
+void tr_block_pool::unlink(Arena* const arena) noexcept
+{
+    (arena->prev != nullptr ? arena->prev->next : available_head_) = arena->next;
+    (arena->next != nullptr ? arena->next->prev : available_tail_) = arena->prev;
+    arena->prev = nullptr;
+    arena->next = nullptr;
+}
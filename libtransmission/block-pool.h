@@ -0,0 +1,107 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+#include <atomic>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <mutex>
+
+#include "libtransmission/block-info.h"
+
+// A process-wide pool of fixed-size buffers for 16 KiB blocks.
+//
+// Blocks move between the peer, webseed and cache code constantly, so
+// instead of going through malloc one at a time they're carved out of
+// 2 MiB arenas. Each thread keeps a small stash of free slots so that
+// most allocations don't need to take the pool's lock at all.
+class tr_block_pool
+{
+public:
+    // Big enough for a block and the container that holds it.
+    static auto constexpr SlotSize = size_t{ tr_block_info::BlockSize } + 64U;
+
+    // One transparent hugepage on x86-64 and most arm64 systems.
+    static auto constexpr ArenaSize = size_t{ 2U } * 1024U * 1024U;
+
+    // Each arena starts with a small header that tracks its free slots.
+    static auto constexpr ArenaHeaderSize = size_t{ 64U };
+    static auto constexpr SlotsPerArena = (ArenaSize - ArenaHeaderSize) / SlotSize;
+
+    // How many completely unused arenas to keep around to absorb bursts.
+    static auto constexpr MaxIdleArenas = size_t{ 1U };
+
+    struct Stats
+    {
+        size_t arena_count = {};
+        size_t bytes_reserved = {};
+        size_t buffers_in_use = {};
+        size_t buffers_free = {};
+        uint64_t allocation_count = {};
+    };
+
+    tr_block_pool(tr_block_pool const&) = delete;
+    tr_block_pool(tr_block_pool&&) = delete;
+    tr_block_pool& operator=(tr_block_pool const&) = delete;
+    tr_block_pool& operator=(tr_block_pool&&) = delete;
+
+    [[nodiscard]] static tr_block_pool& instance();
+
+    // @return a SlotSize buffer. Throws std::bad_alloc if out of memory.
+    [[nodiscard]] void* allocate();
+    void deallocate(void* ptr) noexcept;
+
+    // If enabled, ask the OS to back new arenas with hugepages.
+    // This is only a hint; arenas that are already mapped are unaffected.
+    void set_huge_pages_enabled(bool enabled) noexcept
+    {
+        huge_pages_enabled_.store(enabled, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] Stats stats() const noexcept;
+
+private:
+    struct Arena;
+    struct ThreadCache;
+
+    tr_block_pool() = default;
+    ~tr_block_pool() = default;
+
+    // @return this thread's stash of free slots, or nullptr if the thread is exiting
+    [[nodiscard]] static ThreadCache* thread_cache() noexcept;
+
+    // Move up to `n` free slots into `setme`, making a new arena if needed.
+    // @return how many slots were moved; always at least one.
+    [[nodiscard]] size_t take_slots(void** setme, size_t n);
+
+    // Return slots to their arenas, releasing arenas that end up unused.
+    void give_slots(void* const* slots, size_t n) noexcept;
+
+    [[nodiscard]] Arena* new_arena();
+    void release_arena(Arena* arena) noexcept;
+
+    void link_front(Arena* arena) noexcept;
+    void link_back(Arena* arena) noexcept;
+    void unlink(Arena* arena) noexcept;
+
+    std::mutex mutex_;
+
+    // Arenas that have at least one free slot. Partly-used arenas are kept at
+    // the front and unused ones at the back, so that allocations pack into the
+    // same few arenas and the rest can be released.
+    Arena* available_head_ = nullptr;
+    Arena* available_tail_ = nullptr;
+    size_t n_idle_arenas_ = {};
+
+    std::atomic<bool> huge_pages_enabled_ = false;
+    std::atomic<size_t> n_arenas_ = {};
+    std::atomic<size_t> n_in_use_ = {};
+    std::atomic<uint64_t> n_allocations_ = {};
+};
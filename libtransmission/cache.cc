@@ -7,15 +7,22 @@
 #include <cerrno> // EINVAL
 #include <cstddef>
 #include <cstdint> // uint8_t
-#include <iterator> // std::distance(), std::next(), std::prev()
+#include <functional>
+#include <iterator> // std::next(), std::prev()
 #include <memory>
-#include <numeric> // std::accumulate()
+#include <optional>
 #include <utility> // std::make_pair()
 #include <vector>
 
 #include <fmt/format.h>
 
+#include <small/vector.hpp>
+
+#include "libtransmission/block-pool.h"
 #include "libtransmission/cache.h"
+#include "libtransmission/crypto-utils.h"
+#include "libtransmission/disk-io.h"
+#include "libtransmission/file.h" // tr_sys_file_iovec
 #include "libtransmission/inout.h"
 #include "libtransmission/log.h"
 #include "libtransmission/torrent.h"
@@ -23,85 +30,90 @@
 #include "libtransmission/tr-assert.h"
 #include "libtransmission/types.h"
 
+void* Cache::BlockData::operator new(size_t const size)
+{
+    static_assert(sizeof(BlockData) <= tr_block_pool::SlotSize);
+    TR_ASSERT(size <= tr_block_pool::SlotSize);
+
+    return tr_block_pool::instance().allocate();
+}
+
+void Cache::BlockData::operator delete(void* const ptr) noexcept
+{
+    tr_block_pool::instance().deallocate(ptr);
+}
+
+// ---
+
 Cache::Key Cache::make_key(tr_torrent const& tor, tr_block_info::Location const loc) noexcept
 {
     return std::make_pair(tor.id(), loc.block);
 }
 
-Cache::CIter Cache::find_span_end(CIter const& span_begin, CIter const& end) noexcept
+void Cache::add_span(Key const& begin, size_t const n_blocks)
 {
-    static constexpr auto NotAdjacent = [](CacheBlock const& block1, CacheBlock const& block2)
-    {
-        return block1.key.first != block2.key.first || block1.key.second + 1 != block2.key.second;
-    };
-    auto const span_end = std::adjacent_find(span_begin, end, NotAdjacent);
-    return span_end == end ? end : std::next(span_end);
+    spans_.try_emplace(begin, n_blocks);
+    spans_by_size_.emplace(n_blocks, begin);
 }
 
-std::pair<Cache::CIter, Cache::CIter> Cache::find_biggest_span(CIter const& begin, CIter const& end) noexcept
+void Cache::remove_span(Spans::iterator const iter)
 {
-    auto biggest_begin = begin;
-    auto biggest_end = begin;
-    auto biggest_len = std::distance(biggest_begin, biggest_end);
+    spans_by_size_.erase(std::make_pair(iter->second, iter->first));
+    spans_.erase(iter);
+}
 
-    for (auto span_begin = begin; span_begin < end;)
-    {
-        auto span_end = find_span_end(span_begin, end);
+void Cache::add_to_spans(Key const& key)
+{
+    auto const& [tor_id, block] = key;
+    auto begin = key;
+    auto n_blocks = size_t{ 1U };
 
-        if (auto const len = std::distance(span_begin, span_end); len > biggest_len)
+    // merge with the span that ends right before this block, if any
+    if (auto iter = spans_.lower_bound(key); iter != std::begin(spans_))
+    {
+        if (iter = std::prev(iter); iter->first.first == tor_id && iter->first.second + iter->second == block)
         {
-            biggest_begin = span_begin;
-            biggest_end = span_end;
-            biggest_len = len;
+            begin = iter->first;
+            n_blocks += iter->second;
+            remove_span(iter);
         }
+    }
 
-        span_begin = span_end;
+    // merge with the span that starts right after this block, if any
+    if (auto const iter = spans_.find(Key{ tor_id, block + 1U }); iter != std::end(spans_))
+    {
+        n_blocks += iter->second;
+        remove_span(iter);
     }
 
-    return { biggest_begin, biggest_end };
+    add_span(begin, n_blocks);
 }
 
-int Cache::write_contiguous(CIter const& begin, CIter const& end) const
+int Cache::write_contiguous(Key const& begin, size_t const n_blocks) const
 {
-    // The most common case without an extra data copy.
-    auto const* out = std::data(*begin->buf);
-    auto outlen = std::size(*begin->buf);
+    auto const& [torrent_id, first_block] = begin;
 
-    // Contiguous area to join more than one block, if any.
-    auto buf = std::vector<uint8_t>{};
-
-    if (end - begin > 1)
+    // Write straight from the cached blocks instead of joining them first.
+    auto iov = small::vector<tr_sys_file_iovec, 64U>{};
+    iov.reserve(n_blocks);
+    auto outlen = size_t{};
+    for (size_t i = 0U; i < n_blocks; ++i)
     {
-        // copy blocks into contiguous memory
-        auto const buflen = std::accumulate(
-            begin,
-            end,
-            size_t{},
-            [](size_t sum, auto const& block) { return sum + std::size(*block.buf); });
-        buf.resize(buflen);
-        auto* walk = std::data(buf);
-        for (auto iter = begin; iter != end; ++iter)
-        {
-            TR_ASSERT(begin->key.first == iter->key.first);
-            TR_ASSERT(begin->key.second + std::distance(begin, iter) == iter->key.second);
-            walk = std::copy_n(std::data(*iter->buf), std::size(*iter->buf), walk);
-        }
-        TR_ASSERT(std::data(buf) + std::size(buf) == walk);
-        out = std::data(buf);
-        outlen = std::size(buf);
+        auto& block_buf = *blocks_.at(Key{ torrent_id, first_block + i });
+        iov.push_back(tr_sys_file_iovec{ std::data(block_buf), std::size(block_buf) });
+        outlen += std::size(block_buf);
     }
 
     // save it
-    auto const& [torrent_id, block] = begin->key;
     auto* const tor = torrents_.get(torrent_id);
     if (tor == nullptr)
     {
         return EINVAL;
     }
 
-    auto const loc = tor->block_loc(block);
+    auto const loc = tor->block_loc(first_block);
 
-    if (auto const err = tr_ioWrite(*tor, loc, outlen, out); err != 0)
+    if (auto const err = tr_ioWritev(*tor, loc, { std::data(iov), std::size(iov) }); err != 0)
     {
         return err;
     }
@@ -111,6 +123,98 @@ int Cache::write_contiguous(CIter const& begin, CIter const& end) const
     return {};
 }
 
+void Cache::write_span_async(Key const& begin, size_t const n_blocks)
+{
+    auto const& [tor_id, first_block] = begin;
+
+    remove_span(spans_.find(begin));
+
+    auto* const tor = torrents_.get(tor_id);
+
+    // move the blocks out of the cache and into the write job
+    auto blocks = std::make_shared<std::vector<std::unique_ptr<BlockData>>>();
+    blocks->reserve(n_blocks);
+    auto iov = small::vector<tr_sys_file_iovec, 64U>{};
+    iov.reserve(n_blocks);
+    auto outlen = size_t{};
+    for (size_t i = 0U; i < n_blocks; ++i)
+    {
+        auto node = blocks_.extract(Key{ tor_id, first_block + i });
+        auto& block_buf = node.mapped();
+        iov.push_back(tr_sys_file_iovec{ std::data(*block_buf), std::size(*block_buf) });
+        outlen += std::size(*block_buf);
+        if (auto const [iter, is_new] = writing_.insert_or_assign(node.key(), block_buf.get()); !is_new && tor != nullptr)
+        {
+            // it was already being written, so it's only unflushed once now
+            count_unflushed(tor->block_info(), iter->first, -1);
+        }
+        blocks->emplace_back(std::move(block_buf));
+    }
+
+    if (tor == nullptr)
+    {
+        // the torrent is gone, so there's nowhere to write these
+        for (size_t i = 0U; i < n_blocks; ++i)
+        {
+            writing_.erase(Key{ tor_id, first_block + i });
+        }
+
+        drop_unflushed(tor_id);
+        return;
+    }
+
+    ++disk_writes_;
+    disk_write_bytes_ += outlen;
+
+    tr_ioWritevAsync(
+        *disk_io_,
+        *tor,
+        tor->block_loc(first_block),
+        { std::data(iov), std::size(iov) },
+        [this, begin, blocks, block_info = tor->block_info()](int /*err*/)
+        {
+            // forget the blocks unless they've been written again since
+            for (size_t i = 0U, n = std::size(*blocks); i < n; ++i)
+            {
+                auto const key = Key{ begin.first, begin.second + static_cast<tr_block_index_t>(i) };
+                if (auto const iter = writing_.find(key); iter != std::end(writing_) && iter->second == (*blocks)[i].get())
+                {
+                    writing_.erase(iter);
+                    count_unflushed(block_info, key, -1);
+                }
+            }
+        });
+}
+
+void Cache::wait_for_writes(tr_torrent_id_t const tor_id)
+{
+    disk_io_->wait(tor_id);
+
+    // those blocks are on disk now, even if their callbacks haven't run yet
+    auto const* const tor = torrents_.get(tor_id);
+    std::erase_if(
+        writing_,
+        [this, tor_id, tor](auto const& item)
+        {
+            if (item.first.first != tor_id)
+            {
+                return false;
+            }
+
+            if (tor != nullptr)
+            {
+                count_unflushed(tor->block_info(), item.first, -1);
+            }
+
+            return true;
+        });
+
+    if (tor == nullptr)
+    {
+        drop_unflushed(tor_id);
+    }
+}
+
 int Cache::set_limit(Memory const max_size)
 {
     max_blocks_ = get_max_blocks(max_size);
@@ -119,9 +223,18 @@ int Cache::set_limit(Memory const max_size)
     return cache_trim();
 }
 
-Cache::Cache(tr_torrents const& torrents, Memory const max_size)
+void Cache::set_read_limit(Memory const max_size)
+{
+    max_read_bytes_ = max_size.base_quantity();
+    tr_logAddDebug(fmt::format("Maximum read cache size set to {}", max_size.to_string()));
+
+    read_trim();
+}
+
+Cache::Cache(tr_torrents const& torrents, tr_session_thread& session_thread, Memory const max_size)
     : torrents_{ torrents }
     , max_blocks_{ get_max_blocks(max_size) }
+    , disk_io_{ std::make_unique<tr_disk_io>(session_thread) }
 {
 }
 
@@ -129,76 +242,487 @@ Cache::Cache(tr_torrents const& torrents, Memory const max_size)
 
 int Cache::write_block(tr_torrent_id_t const tor_id, tr_block_index_t const block, std::unique_ptr<BlockData> writeme)
 {
+    auto* const tor = torrents_.get(tor_id);
+    if (tor == nullptr)
+    {
+        return EINVAL;
+    }
+
+    hash_block(*tor, block, *writeme);
+    drop_read_pieces_for_block(*tor, block);
+
     if (max_blocks_ == 0U)
     {
         TR_ASSERT(std::empty(blocks_));
 
+        if (!std::empty(writing_))
+        {
+            wait_for_writes(tor_id);
+        }
+
         // Bypass cache. This may be helpful for those whose filesystem
         // already has a cache layer for the very purpose of this cache
         // https://github.com/transmission/transmission/pull/5668
-        auto* const tor = torrents_.get(tor_id);
-        return tor == nullptr ? EINVAL : tr_ioWrite(*tor, tor->block_loc(block), std::size(*writeme), std::data(*writeme));
+        return tr_ioWrite(*tor, tor->block_loc(block), std::size(*writeme), std::data(*writeme));
     }
 
-    auto const key = Key{ tor_id, block };
-    auto iter = std::lower_bound(std::begin(blocks_), std::end(blocks_), key, CompareCacheBlockByKey);
-    if (iter == std::end(blocks_) || iter->key != key)
+    auto const [iter, is_new] = blocks_.insert_or_assign(Key{ tor_id, block }, std::move(writeme));
+    if (is_new)
     {
-        iter = blocks_.emplace(iter);
-        iter->key = key;
+        add_to_spans(iter->first);
+        count_unflushed(tor->block_info(), iter->first, +1);
     }
 
-    iter->buf = std::move(writeme);
-
     ++cache_writes_;
-    cache_write_bytes_ += std::size(*iter->buf);
+    cache_write_bytes_ += std::size(*iter->second);
 
     return cache_trim();
 }
 
-Cache::CIter Cache::get_block(tr_torrent const& tor, tr_block_info::Location const& loc) noexcept
+Cache::BlockData const* Cache::get_block(tr_torrent const& tor, tr_block_info::Location const& loc) const noexcept
 {
-    if (auto const [begin, end] = std::equal_range(
-            std::begin(blocks_),
-            std::end(blocks_),
-            make_key(tor, loc),
-            CompareCacheBlockByKey);
-        begin < end)
+    auto const key = make_key(tor, loc);
+
+    if (auto const iter = blocks_.find(key); iter != std::end(blocks_))
     {
-        return begin;
+        return iter->second.get();
     }
 
-    return std::end(blocks_);
+    if (auto const iter = writing_.find(key); iter != std::end(writing_))
+    {
+        return iter->second;
+    }
+
+    return nullptr;
 }
 
 int Cache::read_block(tr_torrent const& tor, tr_block_info::Location const& loc, size_t len, uint8_t* setme)
 {
-    if (auto const iter = get_block(tor, loc); iter != std::end(blocks_))
+    if (auto const* const buf = get_block(tor, loc); buf != nullptr)
     {
-        std::copy_n(std::begin(*iter->buf), len, setme);
+        std::copy_n(std::begin(*buf), len, setme);
         return {};
     }
 
     return tr_ioRead(tor, loc, len, setme);
 }
 
+int Cache::read_upload_block(
+    tr_torrent const& tor,
+    tr_block_info::Location const& loc,
+    size_t const len,
+    uint8_t* const setme,
+    tr_piece_index_t const n_more_pieces,
+    std::function<void()> on_ready)
+{
+    if (max_read_bytes_ == 0U || get_block(tor, loc) != nullptr)
+    {
+        return read_block(tor, loc, len, setme);
+    }
+
+    auto const key = PieceKey{ tor.id(), loc.piece };
+    if (auto const node = read_errors_.extract(key); node)
+    {
+        return node.mapped();
+    }
+
+    auto iter = read_pieces_.find(key);
+    if (iter != std::end(read_pieces_) && !iter->second.contains(loc.piece_offset, len))
+    {
+        // only a window of this piece was read, and the peer has moved past it
+        drop_read_piece(iter);
+        iter = std::end(read_pieces_);
+    }
+
+    if (iter == std::end(read_pieces_))
+    {
+        if (auto const reading = reading_.find(key); reading != std::end(reading_))
+        {
+            wait_for_read(reading->second, std::move(on_ready));
+            return EAGAIN;
+        }
+
+        if (read_ahead(tor, loc, len, n_more_pieces))
+        {
+            wait_for_read(next_read_job_ - 1U, std::move(on_ready));
+            return EAGAIN;
+        }
+
+        // The piece couldn't be read ahead, e.g. it has unflushed blocks.
+        // If other read-aheads are using up the space, wait for them instead.
+        if (std::empty(reading_))
+        {
+            return tr_ioRead(tor, loc, len, setme);
+        }
+
+        wait_for_read(std::begin(reading_)->second, std::move(on_ready));
+        return EAGAIN;
+    }
+
+    auto& piece = iter->second;
+    read_lru_.splice(std::begin(read_lru_), read_lru_, piece.lru);
+    std::copy_n(std::data(piece.data) + (loc.piece_offset - piece.begin), len, setme);
+    return {};
+}
+
+// ---
+
+bool Cache::has_unflushed_blocks(tr_torrent const& tor, tr_piece_index_t const piece) const
+{
+    return unflushed_.contains(PieceKey{ tor.id(), piece });
+}
+
+void Cache::count_unflushed(tr_block_info const& block_info, Key const& key, int const delta)
+{
+    // a block can straddle the boundary between two pieces
+    auto const [tor_id, block] = key;
+    for (auto piece = block_info.block_loc(block).piece, last = block_info.block_last_loc(block).piece; piece <= last; ++piece)
+    {
+        auto& n_blocks = unflushed_[PieceKey{ tor_id, piece }];
+        TR_ASSERT(delta > 0 || n_blocks > 0U);
+        n_blocks += delta;
+        if (n_blocks == 0U)
+        {
+            unflushed_.erase(PieceKey{ tor_id, piece });
+        }
+    }
+}
+
+void Cache::drop_unflushed(tr_torrent_id_t const tor_id)
+{
+    unflushed_.erase(unflushed_.lower_bound(PieceKey{ tor_id, 0U }), unflushed_.lower_bound(PieceKey{ tor_id + 1, 0U }));
+}
+
+bool Cache::read_ahead(
+    tr_torrent const& tor,
+    tr_block_info::Location const& loc,
+    size_t const len,
+    tr_piece_index_t const n_more_pieces)
+{
+    auto const tor_id = tor.id();
+    auto const piece = loc.piece;
+
+    struct Window
+    {
+        tr_piece_index_t piece;
+        uint32_t begin;
+        std::vector<uint8_t> data;
+    };
+
+    auto windows = std::make_shared<std::vector<Window>>();
+    auto n_bytes = size_t{};
+
+    if (auto const piece_size = tor.piece_size(piece); piece_size > max_read_bytes_)
+    {
+        // The piece is too big to keep whole, so read a window of it instead,
+        // starting at the wanted block. Half the read cache leaves room for
+        // another peer's window, or for this one's next window to be read
+        // while the current one is still being sent.
+        auto const window_size = std::max(
+            size_t{ tr_block_info::BlockSize },
+            max_read_bytes_ / 2U / tr_block_info::BlockSize * tr_block_info::BlockSize);
+        auto const begin = loc.piece_offset / tr_block_info::BlockSize * tr_block_info::BlockSize;
+        auto const end = std::min(size_t{ piece_size }, std::max(begin + window_size, loc.piece_offset + len));
+        if (reading_bytes_ + (end - begin) <= max_read_bytes_ && !has_unflushed_blocks(tor, piece))
+        {
+            windows->push_back(Window{ piece, begin, std::vector<uint8_t>(end - begin) });
+            n_bytes = end - begin;
+        }
+    }
+    else
+    {
+        // read as many of the wanted pieces as fit, stopping at the first one that
+        // can't be read ahead or already is, so that it's all one contiguous read
+        for (auto cur = piece, end = std::min(tor.piece_count(), piece + 1U + n_more_pieces); cur < end; ++cur)
+        {
+            auto const key = PieceKey{ tor_id, cur };
+            if (cur != piece && (!tor.has_piece(cur) || read_pieces_.contains(key) || reading_.contains(key)))
+            {
+                break;
+            }
+
+            auto const cur_size = tor.piece_size(cur);
+            if (reading_bytes_ + n_bytes + cur_size > max_read_bytes_ || has_unflushed_blocks(tor, cur))
+            {
+                break;
+            }
+
+            windows->push_back(Window{ cur, 0U, std::vector<uint8_t>(cur_size) });
+            n_bytes += cur_size;
+        }
+    }
+
+    if (std::empty(*windows))
+    {
+        return false;
+    }
+
+    auto const job = next_read_job_++;
+    auto iov = small::vector<tr_sys_file_iovec, 8U>{};
+    iov.reserve(std::size(*windows));
+    for (auto& window : *windows)
+    {
+        iov.push_back(tr_sys_file_iovec{ std::data(window.data), std::size(window.data) });
+        reading_.try_emplace(PieceKey{ tor_id, window.piece }, job);
+    }
+    reading_bytes_ += n_bytes;
+
+    tr_ioReadvAsync(
+        *disk_io_,
+        tor,
+        tor.piece_loc(piece, windows->front().begin),
+        { std::data(iov), std::size(iov) },
+        [this, tor_id, piece, job, n_bytes, windows](int const err)
+        {
+            reading_bytes_ -= n_bytes;
+
+            // add them last-to-first so that `piece` is the most recently used
+            for (auto it = std::rbegin(*windows), end = std::rend(*windows); it != end; ++it)
+            {
+                auto& window = *it;
+                auto const key = PieceKey{ tor_id, window.piece };
+
+                // skip pieces that were dropped, e.g. written to, while they were being read
+                if (auto const reading = reading_.find(key); reading == std::end(reading_) || reading->second != job)
+                {
+                    continue;
+                }
+
+                reading_.erase(key);
+
+                if (err != 0)
+                {
+                    if (window.piece == piece)
+                    {
+                        read_errors_.insert_or_assign(key, err);
+                    }
+
+                    continue;
+                }
+
+                read_bytes_ += std::size(window.data);
+                read_pieces_.try_emplace(
+                    key,
+                    ReadPiece{ std::move(window.data), read_lru_.insert(std::begin(read_lru_), key), window.begin });
+            }
+
+            read_trim();
+
+            if (auto node = read_waiters_.extract(job); node)
+            {
+                for (auto const& on_ready : node.mapped())
+                {
+                    on_ready();
+                }
+            }
+        });
+
+    return true;
+}
+
+void Cache::wait_for_read(uint64_t const job, std::function<void()>&& on_ready)
+{
+    if (on_ready)
+    {
+        read_waiters_[job].emplace_back(std::move(on_ready));
+    }
+}
+
+void Cache::drop_read_piece(ReadPieces::iterator const iter)
+{
+    read_bytes_ -= std::size(iter->second.data);
+    read_lru_.erase(iter->second.lru);
+    read_pieces_.erase(iter);
+}
+
+void Cache::drop_read_pieces_for_block(tr_torrent const& tor, tr_block_index_t const block)
+{
+    if (std::empty(read_pieces_) && std::empty(reading_))
+    {
+        return;
+    }
+
+    // a block can straddle the boundary between two pieces
+    auto const& block_info = tor.block_info();
+    for (auto piece = block_info.block_loc(block).piece, last = block_info.block_last_loc(block).piece; piece <= last; ++piece)
+    {
+        auto const key = PieceKey{ tor.id(), piece };
+
+        if (auto const iter = read_pieces_.find(key); iter != std::end(read_pieces_))
+        {
+            drop_read_piece(iter);
+        }
+
+        reading_.erase(key);
+        read_errors_.erase(key);
+    }
+}
+
+void Cache::drop_read_pieces(tr_torrent_id_t const tor_id)
+{
+    auto iter = read_pieces_.lower_bound(PieceKey{ tor_id, 0U });
+    auto const end = read_pieces_.lower_bound(PieceKey{ tor_id + 1, 0U });
+    while (iter != end)
+    {
+        drop_read_piece(iter++);
+    }
+
+    auto const begin_key = PieceKey{ tor_id, 0U };
+    auto const end_key = PieceKey{ tor_id + 1, 0U };
+    reading_.erase(reading_.lower_bound(begin_key), reading_.lower_bound(end_key));
+    read_errors_.erase(read_errors_.lower_bound(begin_key), read_errors_.lower_bound(end_key));
+}
+
+void Cache::read_trim()
+{
+    while (read_bytes_ > max_read_bytes_ && !std::empty(read_lru_))
+    {
+        drop_read_piece(read_pieces_.find(read_lru_.back()));
+    }
+}
+
 // ---
 
-int Cache::flush_span(CIter const& begin, CIter const& end)
+void Cache::hash_block(tr_torrent const& tor, tr_block_index_t const block, BlockData const& data)
 {
-    for (auto span_begin = begin; span_begin < end;)
+    auto const& block_info = tor.block_info();
+    auto const block_begin = block_info.block_loc(block).byte;
+    auto const block_end = block_begin + std::size(data);
+
+    // a block can straddle the boundary between two pieces
+    for (auto piece = block_info.block_loc(block).piece, last = block_info.block_last_loc(block).piece; piece <= last; ++piece)
     {
-        auto const span_end = find_span_end(span_begin, end);
+        auto const [piece_begin, piece_end] = block_info.byte_span_for_piece(piece);
+        auto const key = PieceKey{ tor.id(), piece };
+
+        auto iter = piece_hashes_.find(key);
+        if (iter == std::end(piece_hashes_))
+        {
+            // only start hashing a piece at its first byte,
+            // and not when a block we already have is written again
+            if (block_begin > piece_begin || tor.has_block(block))
+            {
+                continue;
+            }
+
+            iter = piece_hashes_.try_emplace(key).first;
+            iter->second.v2.start(tor.merkle_pieces(), piece);
+        }
+
+        auto& piece_hash = iter->second;
+        auto const next_byte = piece_begin + piece_hash.n_bytes;
+
+        // this block was hashed before and may have changed; read it back at check time
+        if (next_byte >= block_end)
+        {
+            piece_hashes_.erase(iter);
+            continue;
+        }
+
+        // still waiting for an earlier block
+        if (next_byte < block_begin)
+        {
+            continue;
+        }
+
+        auto const n_bytes = std::min(block_end, piece_end) - next_byte;
+        piece_hash.sha.add(std::data(data) + (next_byte - block_begin), n_bytes);
+        piece_hash.v2.add(std::data(data) + (next_byte - block_begin), n_bytes);
+        piece_hash.n_bytes += n_bytes;
 
-        if (auto const err = write_contiguous(span_begin, span_end); err != 0)
+        // catch up on any later blocks that arrived before this one
+        while (piece_begin + piece_hash.n_bytes < piece_end)
+        {
+            auto const loc = block_info.byte_loc(piece_begin + piece_hash.n_bytes);
+            auto const* const cached = get_block(tor, loc);
+            if (cached == nullptr)
+            {
+                break;
+            }
+
+            auto const& buf = *cached;
+            auto const n_cached = std::min(uint64_t{ std::size(buf) } - loc.block_offset, piece_end - loc.byte);
+            piece_hash.sha.add(std::data(buf) + loc.block_offset, n_cached);
+            piece_hash.v2.add(std::data(buf) + loc.block_offset, n_cached);
+            piece_hash.n_bytes += n_cached;
+        }
+    }
+}
+
+std::optional<tr_sha1_digest_t> Cache::take_piece_hash(tr_torrent const& tor, tr_piece_index_t const piece)
+{
+    auto node = piece_hashes_.extract(PieceKey{ tor.id(), piece });
+    if (!node || node.mapped().n_bytes != tor.piece_size(piece) || !node.mapped().v2.finish())
+    {
+        return {};
+    }
+
+    return node.mapped().sha.finish();
+}
+
+void Cache::drop_piece_hashes(tr_torrent_id_t const tor_id)
+{
+    piece_hashes_.erase(
+        piece_hashes_.lower_bound(PieceKey{ tor_id, 0U }),
+        piece_hashes_.lower_bound(PieceKey{ tor_id + 1, 0U }));
+}
+
+// ---
+
+int Cache::flush_range(Key const& begin, Key const& end)
+{
+    // don't let an older write on a disk thread land after these
+    wait_for_writes(begin.first);
+
+    // start with the span that holds `begin`, if any
+    auto iter = spans_.upper_bound(begin);
+    if (iter != std::begin(spans_))
+    {
+        if (auto const prev = std::prev(iter); prev->first.first == begin.first && prev->first.second + prev->second > begin.second)
+        {
+            iter = prev;
+        }
+    }
+
+    while (iter != std::end(spans_) && iter->first < end)
+    {
+        auto const [span_begin, n_blocks] = *iter;
+        auto const& [tor_id, span_first] = span_begin;
+        auto const span_last = span_first + static_cast<tr_block_index_t>(n_blocks); // exclusive
+
+        // the part of this span that's in [begin, end)
+        auto const first = tor_id == begin.first ? std::max(span_first, begin.second) : span_first;
+        auto const last = tor_id == end.first ? std::min(span_last, end.second) : span_last;
+
+        if (auto const err = write_contiguous(Key{ tor_id, first }, last - first); err != 0)
         {
             return err;
         }
 
-        span_begin = span_end;
+        remove_span(iter);
+        if (span_first < first)
+        {
+            add_span(span_begin, first - span_first);
+        }
+        if (last < span_last)
+        {
+            add_span(Key{ tor_id, last }, span_last - last);
+        }
+
+        auto const* const tor = torrents_.get(tor_id);
+        for (auto block = first; block < last; ++block)
+        {
+            blocks_.erase(Key{ tor_id, block });
+
+            if (tor != nullptr)
+            {
+                count_unflushed(tor->block_info(), Key{ tor_id, block }, -1);
+            }
+        }
+
+        iter = spans_.lower_bound(Key{ tor_id, last });
     }
 
-    blocks_.erase(begin, end);
     return {};
 }
 
@@ -207,34 +731,32 @@ int Cache::flush_file(tr_torrent const& tor, tr_file_index_t const file)
     auto const tor_id = tor.id();
     auto const [block_begin, block_end] = tor.block_span_for_file(file);
 
-    return flush_span(
-        std::lower_bound(std::begin(blocks_), std::end(blocks_), std::make_pair(tor_id, block_begin), CompareCacheBlockByKey),
-        std::lower_bound(std::begin(blocks_), std::end(blocks_), std::make_pair(tor_id, block_end), CompareCacheBlockByKey));
+    return flush_range(Key{ tor_id, block_begin }, Key{ tor_id, block_end });
 }
 
 int Cache::flush_torrent(tr_torrent_id_t const tor_id)
 {
-    return flush_span(
-        std::lower_bound(std::begin(blocks_), std::end(blocks_), std::make_pair(tor_id, 0), CompareCacheBlockByKey),
-        std::lower_bound(std::begin(blocks_), std::end(blocks_), std::make_pair(tor_id + 1, 0), CompareCacheBlockByKey));
+    return flush_range(Key{ tor_id, 0U }, Key{ tor_id + 1, 0U });
 }
 
 int Cache::flush_biggest()
 {
-    auto const [begin, end] = find_biggest_span(std::begin(blocks_), std::end(blocks_));
-
-    if (begin == end) // nothing to flush
+    if (std::empty(spans_by_size_)) // nothing to flush
     {
         return 0;
     }
 
-    if (auto const err = write_contiguous(begin, end); err != 0)
+    auto const [n_blocks, begin] = *std::rbegin(spans_by_size_);
+
+    // If the disk is keeping up, write this span on a disk thread. If a whole
+    // cache's worth is still waiting to be written, wait for the disk instead.
+    if (std::size(writing_) < max_blocks_)
     {
-        return err;
+        write_span_async(begin, n_blocks);
+        return {};
     }
 
-    blocks_.erase(begin, end);
-    return 0;
+    return flush_range(begin, Key{ begin.first, begin.second + static_cast<tr_block_index_t>(n_blocks) });
 }
 
 int Cache::cache_trim()
@@ -11,59 +11,150 @@
 
 #include <cstddef> // for size_t
 #include <cstdint> // for intX_t, uintX_t
+#include <functional> // for std::function
+#include <list>
+#include <map>
 #include <memory> // for std::unique_ptr
+#include <optional>
+#include <set>
+#include <unordered_map>
 #include <utility> // for std::pair
 #include <vector>
 
 #include <small/vector.hpp>
 
 #include "libtransmission/block-info.h"
+#include "libtransmission/crypto-utils.h"
+#include "libtransmission/disk-io.h"
+#include "libtransmission/lru-cache.h" // tr_torrent_item_hash
+#include "libtransmission/merkle.h"
 #include "libtransmission/values.h"
 #include "libtransmission/types.h"
 
+class tr_session_thread;
 class tr_torrents;
 struct tr_torrent;
 
 class Cache
 {
 public:
-    using BlockData = small::max_size_vector<uint8_t, tr_block_info::BlockSize>;
+    // A block's worth of data. These come from tr_block_pool
+    // rather than the general heap, since so many are made and freed.
+    class BlockData final : public small::max_size_vector<uint8_t, tr_block_info::BlockSize>
+    {
+    public:
+        using Base = small::max_size_vector<uint8_t, tr_block_info::BlockSize>;
+        using Base::Base;
+
+        [[nodiscard]] static void* operator new(size_t size);
+        static void operator delete(void* ptr) noexcept;
+    };
+
     using Memory = tr::Values::Memory;
 
-    Cache(tr_torrents const& torrents, Memory max_size);
+    Cache(tr_torrents const& torrents, tr_session_thread& session_thread, Memory max_size);
 
     int set_limit(Memory max_size);
 
+    // Set the memory limit for pieces read ahead for uploads. 0 disables read-ahead.
+    void set_read_limit(Memory max_size);
+
     // @return any error code from cacheTrim()
     int write_block(tr_torrent_id_t tor, tr_block_index_t block, std::unique_ptr<BlockData> writeme);
 
     int read_block(tr_torrent const& tor, tr_block_info::Location const& loc, size_t len, uint8_t* setme);
+
+    // Like read_block(), but for a block that's being uploaded to a peer.
+    // Peers tend to ask for the rest of a piece next, so on a miss the block's
+    // whole piece -- and up to `n_more_pieces` pieces after it -- are read in
+    // one go on a disk thread and kept in an LRU read cache. Pieces that are
+    // bigger than the read cache are read a window at a time instead.
+    // @return EAGAIN if the piece is still being read; try again once
+    // `on_ready` has been called on the session thread.
+    int read_upload_block(
+        tr_torrent const& tor,
+        tr_block_info::Location const& loc,
+        size_t len,
+        uint8_t* setme,
+        tr_piece_index_t n_more_pieces = 0U,
+        std::function<void()> on_ready = {});
+
     int flush_torrent(tr_torrent_id_t tor_id);
     int flush_file(tr_torrent const& tor, tr_file_index_t file);
 
+    // Whether any of `piece`'s blocks are cached or still being written,
+    // i.e. whether what's on disk for that piece may be out of date.
+    [[nodiscard]] bool has_unflushed_blocks(tr_torrent const& tor, tr_piece_index_t piece) const;
+
+    // If every block of `piece` was hashed as it was written, return the
+    // piece's SHA-1 without reading anything back. Either way, the piece's
+    // running hash is forgotten, so this is only good for one check.
+    // Hybrid torrents' pieces are checked against their v2 trees as well;
+    // if that fails, nothing is returned, so the piece is read back instead.
+    [[nodiscard]] std::optional<tr_sha1_digest_t> take_piece_hash(tr_torrent const& tor, tr_piece_index_t piece);
+
+    // Forget a torrent's running piece hashes, e.g. because its files
+    // are being closed and may change on disk before it's started again.
+    void drop_piece_hashes(tr_torrent_id_t tor_id);
+
+    // Forget a torrent's read-ahead pieces, e.g. because its files are
+    // being closed and may change on disk before they're read again.
+    void drop_read_pieces(tr_torrent_id_t tor_id);
+
 private:
     using Key = std::pair<tr_torrent_id_t, tr_block_index_t>;
 
-    struct CacheBlock
+    // A piece's SHA-1, fed as its blocks are written in order. Blocks that
+    // arrive early wait in the cache until the gap before them is filled.
+    struct PieceHash
     {
-        Key key;
-        std::unique_ptr<BlockData> buf;
+        tr_sha1 sha;
+        tr_merkle_piece_checker v2;
+        uint64_t n_bytes = {}; // how much of the piece has been hashed
     };
 
-    using Blocks = std::vector<CacheBlock>;
-    using CIter = Blocks::const_iterator;
+    using PieceKey = std::pair<tr_torrent_id_t, tr_piece_index_t>;
 
-    [[nodiscard]] static Key make_key(tr_torrent const& tor, tr_block_info::Location loc) noexcept;
+    // A piece read ahead for uploads. Only pieces with no unflushed
+    // blocks are read ahead, and writing a block drops its pieces,
+    // so these never hold stale data. Pieces bigger than the read
+    // cache only have a window of their data here, starting at `begin`.
+    struct ReadPiece
+    {
+        [[nodiscard]] constexpr bool contains(uint32_t const offset, size_t const len) const noexcept
+        {
+            return begin <= offset && offset + len <= begin + std::size(data);
+        }
+
+        std::vector<uint8_t> data;
+        std::list<PieceKey>::iterator lru;
+        uint32_t begin = {};
+    };
+
+    using ReadPieces = std::map<PieceKey, ReadPiece>;
 
-    [[nodiscard]] static std::pair<CIter, CIter> find_biggest_span(CIter const& begin, CIter const& end) noexcept;
+    // Every cached block, for O(1) lookups.
+    using Blocks = std::unordered_map<Key, std::unique_ptr<BlockData>, tr_torrent_item_hash>;
 
-    [[nodiscard]] static CIter find_span_end(CIter const& span_begin, CIter const& end) noexcept;
+    // Runs of cached blocks with consecutive indices in the same torrent,
+    // keyed by their first block. The value is the number of blocks in the run.
+    using Spans = std::map<Key, size_t>;
+
+    [[nodiscard]] static Key make_key(tr_torrent const& tor, tr_block_info::Location loc) noexcept;
 
     // @return any error code from tr_ioWrite()
-    [[nodiscard]] int write_contiguous(CIter const& begin, CIter const& end) const;
+    [[nodiscard]] int write_contiguous(Key const& begin, size_t n_blocks) const;
+
+    // Hand the span of blocks at `begin` to the disk threads and drop it from
+    // the cache. The blocks stay readable in `writing_` until the write is done.
+    void write_span_async(Key const& begin, size_t n_blocks);
 
+    // Wait for a torrent's writes on the disk threads to finish.
+    void wait_for_writes(tr_torrent_id_t tor_id);
+
+    // Write the cached blocks in [begin, end) and drop them from the cache.
     // @return any error code from writeContiguous()
-    [[nodiscard]] int flush_span(CIter const& begin, CIter const& end);
+    [[nodiscard]] int flush_range(Key const& begin, Key const& end);
 
     // @return any error code from writeContiguous()
     [[nodiscard]] int flush_biggest();
@@ -71,32 +162,86 @@ private:
     // @return any error code from writeContiguous()
     [[nodiscard]] int cache_trim();
 
+    void add_span(Key const& begin, size_t n_blocks);
+    void remove_span(Spans::iterator iter);
+
+    // Add a newly-cached block to the span index, merging it with its neighbours.
+    void add_to_spans(Key const& key);
+
     [[nodiscard]] static constexpr size_t get_max_blocks(Memory const max_size) noexcept
     {
         return max_size.base_quantity() / tr_block_info::BlockSize;
     }
 
-    [[nodiscard]] CIter get_block(tr_torrent const& tor, tr_block_info::Location const& loc) noexcept;
+    [[nodiscard]] BlockData const* get_block(tr_torrent const& tor, tr_block_info::Location const& loc) const noexcept;
+
+    void hash_block(tr_torrent const& tor, tr_block_index_t block, BlockData const& data);
+
+    // Add `delta` to the unflushed count of the pieces that `key`'s block is in.
+    void count_unflushed(tr_block_info const& block_info, Key const& key, int delta);
+    void drop_unflushed(tr_torrent_id_t tor_id);
+
+    // Start reading the piece at `loc` and up to `n_more_pieces` pieces after it into the read cache.
+    // @return false if the piece couldn't be read ahead
+    [[nodiscard]] bool read_ahead(
+        tr_torrent const& tor,
+        tr_block_info::Location const& loc,
+        size_t len,
+        tr_piece_index_t n_more_pieces);
+
+    // Call `on_ready` when read-ahead job `job` is done.
+    void wait_for_read(uint64_t job, std::function<void()>&& on_ready);
+
+    void drop_read_piece(ReadPieces::iterator iter);
+    void drop_read_pieces_for_block(tr_torrent const& tor, tr_block_index_t block);
+    void read_trim();
 
     tr_torrents const& torrents_;
 
     Blocks blocks_;
+    Spans spans_;
+
+    // Blocks that are being written on the disk threads, owned by their
+    // write jobs. If a block is written again before then, this points
+    // to the newest copy that's being written.
+    std::unordered_map<Key, BlockData const*, tr_torrent_item_hash> writing_;
+
+    // the same spans sorted by size, to find the biggest one to flush
+    std::set<std::pair<size_t, Key>> spans_by_size_;
+
     size_t max_blocks_ = 0;
 
+    std::map<PieceKey, PieceHash> piece_hashes_;
+
+    // How many of each piece's blocks are in `blocks_`, plus how many are
+    // in `writing_`, so has_unflushed_blocks() doesn't look up every block.
+    std::map<PieceKey, size_t> unflushed_;
+
+    ReadPieces read_pieces_;
+
+    // read-ahead pieces, most recently used first
+    std::list<PieceKey> read_lru_;
+
+    // pieces being read ahead on the disk threads, and by which job
+    std::map<PieceKey, uint64_t> reading_;
+
+    // callers waiting for a read-ahead job, by job
+    std::map<uint64_t, std::vector<std::function<void()>>> read_waiters_;
+
+    // pieces whose read-ahead failed, so the next read can report it
+    std::map<PieceKey, int> read_errors_;
+
+    size_t read_bytes_ = 0;
+    size_t reading_bytes_ = 0;
+    size_t max_read_bytes_ = 0;
+    uint64_t next_read_job_ = 0;
+
     mutable size_t disk_writes_ = 0;
     mutable size_t disk_write_bytes_ = 0;
     mutable size_t cache_writes_ = 0;
     mutable size_t cache_write_bytes_ = 0;
 
-    static constexpr struct
-    {
-        [[nodiscard]] constexpr bool operator()(Key const& key, CacheBlock const& block) const
-        {
-            return key < block.key;
-        }
-        [[nodiscard]] constexpr bool operator()(CacheBlock const& block, Key const& key) const
-        {
-            return block.key < key;
-        }
-    } CompareCacheBlockByKey{};
+    // Declared last so that it's destroyed first, which finishes
+    // its jobs and drops their callbacks before the rest of the cache goes.
+    std::unique_ptr<tr_disk_io> disk_io_;
 };
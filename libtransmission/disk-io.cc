@@ -0,0 +1,193 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <cstddef> // size_t
+#include <functional> // std::hash
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility> // std::move
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "libtransmission/disk-io.h"
+#include "libtransmission/error.h"
+#include "libtransmission/file.h"
+#include "libtransmission/session-thread.h"
+#include "libtransmission/tr-assert.h"
+#include "libtransmission/tr-strbuf.h"
+#include "libtransmission/types.h"
+
+tr_disk_io::tr_disk_io(tr_session_thread& session_thread, size_t const n_threads)
+    : session_thread_{ session_thread }
+{
+    TR_ASSERT(n_threads > 0U);
+
+    threads_.reserve(n_threads);
+    for (size_t i = 0U; i < n_threads; ++i)
+    {
+        threads_.emplace_back(&tr_disk_io::worker_thread_func, this);
+    }
+}
+
+tr_disk_io::~tr_disk_io()
+{
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        is_stopping_ = true;
+    }
+    work_cv_.notify_all();
+
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+tr_disk_io::DeviceId tr_disk_io::device_id(std::string_view const dir)
+{
+    if (auto const iter = device_ids_.find(dir); iter != std::end(device_ids_))
+    {
+        return iter->second;
+    }
+
+#ifdef _WIN32
+    // use the drive letter or network share that `dir` is on
+    auto const root = dir.substr(0, dir.find_first_of("\\/", 2U));
+    auto const id = DeviceId{ std::hash<std::string_view>{}(root) };
+#else
+    struct stat sb = {};
+    if (stat(tr_pathbuf{ dir }, &sb) != 0)
+    {
+        // maybe it hasn't been created yet; don't remember this guess
+        return {};
+    }
+
+    auto const id = DeviceId{ sb.st_dev };
+#endif
+
+    device_ids_.try_emplace(std::string{ dir }, id);
+    return id;
+}
+
+void tr_disk_io::add(std::string_view const dir, tr_torrent_id_t const tor_id, Work work, Done done)
+{
+    auto const device = device_id(dir);
+
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        devices_[device].jobs.emplace_back(Job{ tor_id, std::move(work), std::move(done) });
+        ++n_jobs_[tor_id];
+    }
+
+    work_cv_.notify_one();
+}
+
+void tr_disk_io::wait(tr_torrent_id_t const tor_id)
+{
+    auto lock = std::unique_lock{ mutex_ };
+    idle_cv_.wait(lock, [this, tor_id]() { return !n_jobs_.contains(tor_id); });
+}
+
+size_t tr_disk_io::size() const
+{
+    auto const lock = std::scoped_lock{ mutex_ };
+
+    auto n_jobs = size_t{};
+    for (auto const& [tor_id, n] : n_jobs_)
+    {
+        n_jobs += n;
+    }
+
+    return n_jobs;
+}
+
+// ---
+
+tr_disk_io::Device* tr_disk_io::next_device()
+{
+    for (auto& [id, device] : devices_)
+    {
+        if (!device.is_busy && !std::empty(device.jobs))
+        {
+            return &device;
+        }
+    }
+
+    return nullptr;
+}
+
+void tr_disk_io::worker_thread_func()
+{
+    auto lock = std::unique_lock{ mutex_ };
+
+    for (;;)
+    {
+        auto* device = static_cast<Device*>(nullptr);
+        work_cv_.wait(lock, [this, &device]() { return (device = next_device()) != nullptr || is_stopping_; });
+        if (device == nullptr)
+        {
+            return; // stopping, and there's nothing left for this thread to do
+        }
+
+        auto job = std::move(device->jobs.front());
+        device->jobs.pop_front();
+        device->is_busy = true;
+
+        lock.unlock();
+        auto error = tr_error{};
+        job.work(error);
+        lock.lock();
+
+        device->is_busy = false;
+        if (auto const iter = n_jobs_.find(job.tor_id); --iter->second == 0U)
+        {
+            n_jobs_.erase(iter);
+        }
+
+        done_.emplace_back(std::move(job.done), std::move(error));
+        if (!is_delivery_queued_)
+        {
+            is_delivery_queued_ = true;
+            session_thread_.queue(
+                [this, alive = std::weak_ptr<bool>{ alive_ }]()
+                {
+                    if (!alive.expired())
+                    {
+                        deliver();
+                    }
+                });
+        }
+
+        // another thread may be waiting to take this device's next job
+        work_cv_.notify_all();
+        idle_cv_.notify_all();
+    }
+}
+
+void tr_disk_io::deliver()
+{
+    auto done = decltype(done_){};
+
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        std::swap(done, done_);
+        is_delivery_queued_ = false;
+    }
+
+    for (auto& [callback, error] : done)
+    {
+        if (callback)
+        {
+            callback(error);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "libtransmission/error.h"
+#include "libtransmission/file.h" // tr_sys_file_t
+#include "libtransmission/lru-cache.h"
+#include "libtransmission/types.h"
+
+class tr_session_thread;
+
+// Runs reads and writes of torrent data on a pool of worker threads,
+// so that a slow or stalled disk doesn't freeze the session thread.
+//
+// Jobs are queued per storage device. Each device's jobs run one at a time
+// in the order they were added, so writes to the same file land in order and
+// a spinning disk isn't made to seek between several jobs at once. Jobs for
+// different devices run in parallel.
+class tr_disk_io
+{
+public:
+    // Runs on a worker thread. Must not touch session state.
+    using Work = std::function<void(tr_error& error)>;
+
+    // Runs on the session thread once `Work` is done.
+    using Done = std::function<void(tr_error const& error)>;
+
+    static auto constexpr DefaultThreadCount = size_t{ 4U };
+
+    explicit tr_disk_io(tr_session_thread& session_thread, size_t n_threads = DefaultThreadCount);
+
+    // Finishes every job that's been added, but
+    // drops any `Done` callbacks that haven't run yet.
+    ~tr_disk_io();
+
+    tr_disk_io(tr_disk_io const&) = delete;
+    tr_disk_io(tr_disk_io&&) = delete;
+    tr_disk_io& operator=(tr_disk_io const&) = delete;
+    tr_disk_io& operator=(tr_disk_io&&) = delete;
+
+    // Queue a job for a torrent whose data is in `dir`.
+    void add(std::string_view dir, tr_torrent_id_t tor_id, Work work, Done done);
+
+    // Block until every job for `tor_id` has run. Their `Done`
+    // callbacks may still be waiting for the session thread.
+    void wait(tr_torrent_id_t tor_id);
+
+    // The number of jobs that are queued or running.
+    [[nodiscard]] size_t size() const;
+
+private:
+    using DeviceId = uint64_t;
+
+    struct Job
+    {
+        tr_torrent_id_t tor_id = {};
+        Work work;
+        Done done;
+    };
+
+    struct Device
+    {
+        std::deque<Job> jobs;
+        bool is_busy = false;
+    };
+
+    [[nodiscard]] DeviceId device_id(std::string_view dir);
+    [[nodiscard]] Device* next_device();
+
+    void worker_thread_func();
+    void deliver();
+
+    tr_session_thread& session_thread_;
+
+    // session thread only
+    std::map<std::string, DeviceId, std::less<>> device_ids_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;
+
+    std::map<DeviceId, Device> devices_;
+
+    // how many jobs each torrent has queued or running
+    std::map<tr_torrent_id_t, size_t> n_jobs_;
+
+    // finished jobs whose callbacks haven't been run on the session thread yet
+    std::vector<std::pair<Done, tr_error>> done_;
+    bool is_delivery_queued_ = false;
+
+    bool is_stopping_ = false;
+
+    // lets queued deliveries notice that `this` is gone
+    std::shared_ptr<bool> const alive_ = std::make_shared<bool>(true);
+
+    std::vector<std::thread> threads_;
+};
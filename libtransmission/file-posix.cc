@@ -21,6 +21,7 @@
 #include <dirent.h>
 #include <fcntl.h> /* O_LARGEFILE, posix_fadvise(), [posix_]fallocate(), fcntl() */
 #include <sys/stat.h>
+#include <sys/uio.h> /* preadv(), pwritev() */
 #include <unistd.h> /* lseek(), write(), ftruncate(), pread(), pwrite(), pathconf(), etc */
 
 #ifdef HAVE_FLOCK
@@ -681,6 +682,152 @@ bool tr_sys_file_write_at(
     return ret;
 }
 
+namespace
+{
+namespace iovec_helpers
+{
+#if defined(HAVE_PREADV) || defined(HAVE_PWRITEV)
+
+#ifdef IOV_MAX
+auto constexpr MaxIovecs = std::min(size_t{ 256U }, size_t{ IOV_MAX });
+#else
+auto constexpr MaxIovecs = size_t{ 16U }; // _XOPEN_IOV_MAX
+#endif
+
+using NativeIovecs = std::array<struct iovec, MaxIovecs>;
+
+// @return how many native iovecs were filled in
+[[nodiscard]] int to_native(tr_sys_file_iovec const* const iov, size_t const iov_count, NativeIovecs& setme)
+{
+    auto const n = std::min(iov_count, std::size(setme));
+
+    for (size_t i = 0U; i < n; ++i)
+    {
+        setme[i].iov_base = iov[i].base;
+        setme[i].iov_len = iov[i].len;
+    }
+
+    return static_cast<int>(n);
+}
+
+#endif
+
+#if !defined(HAVE_PREADV) || !defined(HAVE_PWRITEV)
+
+// without preadv() or pwritev(), just do the first non-empty buffer
+[[nodiscard]] tr_sys_file_iovec const* first_nonempty(tr_sys_file_iovec const* const iov, size_t const iov_count)
+{
+    auto const* const end = iov + iov_count;
+    auto const* const it = std::find_if(iov, end, [](auto const& vec) { return vec.len != 0U; });
+    return it != end ? it : nullptr;
+}
+
+#endif
+} // namespace iovec_helpers
+} // namespace
+
+bool tr_sys_file_read_at_v(
+    tr_sys_file_t handle,
+    tr_sys_file_iovec const* iov,
+    size_t iov_count,
+    uint64_t offset,
+    uint64_t* bytes_read,
+    tr_error* error)
+{
+    using namespace iovec_helpers;
+
+    TR_ASSERT(handle != TR_BAD_SYS_FILE);
+    TR_ASSERT(iov != nullptr || iov_count == 0);
+    /* seek requires signed offset, so it should be in mod range */
+    TR_ASSERT(offset < UINT64_MAX / 2);
+
+#ifdef HAVE_PREADV
+
+    auto native = NativeIovecs{};
+    auto const my_bytes_read = preadv(handle, std::data(native), to_native(iov, iov_count, native), offset);
+    static_assert(sizeof(*bytes_read) >= sizeof(my_bytes_read));
+
+    if (my_bytes_read > 0)
+    {
+        if (bytes_read != nullptr)
+        {
+            *bytes_read = my_bytes_read;
+        }
+
+        return true;
+    }
+
+    if (error != nullptr && my_bytes_read == -1)
+    {
+        error->set_from_errno(errno);
+    }
+
+    return false;
+
+#else
+
+    auto const* const vec = first_nonempty(iov, iov_count);
+    return vec != nullptr && tr_sys_file_read_at(handle, vec->base, vec->len, offset, bytes_read, error);
+
+#endif
+}
+
+bool tr_sys_file_write_at_v(
+    tr_sys_file_t handle,
+    tr_sys_file_iovec const* iov,
+    size_t iov_count,
+    uint64_t offset,
+    uint64_t* bytes_written,
+    tr_error* error)
+{
+    using namespace iovec_helpers;
+
+    TR_ASSERT(handle != TR_BAD_SYS_FILE);
+    TR_ASSERT(iov != nullptr || iov_count == 0);
+    /* seek requires signed offset, so it should be in mod range */
+    TR_ASSERT(offset < UINT64_MAX / 2);
+
+#ifdef HAVE_PWRITEV
+
+    auto native = NativeIovecs{};
+    auto const my_bytes_written = pwritev(handle, std::data(native), to_native(iov, iov_count, native), offset);
+    static_assert(sizeof(*bytes_written) >= sizeof(my_bytes_written));
+
+    if (my_bytes_written != -1)
+    {
+        if (bytes_written != nullptr)
+        {
+            *bytes_written = my_bytes_written;
+        }
+
+        return true;
+    }
+
+    if (error != nullptr)
+    {
+        error->set_from_errno(errno);
+    }
+
+    return false;
+
+#else
+
+    auto const* const vec = first_nonempty(iov, iov_count);
+    if (vec == nullptr)
+    {
+        if (bytes_written != nullptr)
+        {
+            *bytes_written = 0U;
+        }
+
+        return true;
+    }
+
+    return tr_sys_file_write_at(handle, vec->base, vec->len, offset, bytes_written, error);
+
+#endif
+}
+
 bool tr_sys_file_truncate(tr_sys_file_t handle, uint64_t size, tr_error* error)
 {
     TR_ASSERT(handle != TR_BAD_SYS_FILE);
@@ -795,6 +942,54 @@ bool tr_sys_file_preallocate(tr_sys_file_t handle, uint64_t size, int flags, tr_
     return false;
 }
 
+bool tr_sys_file_advise(
+    tr_sys_file_t handle,
+    [[maybe_unused]] uint64_t offset,
+    [[maybe_unused]] uint64_t size,
+    tr_sys_file_advice_t advice,
+    [[maybe_unused]] tr_error* error)
+{
+    TR_ASSERT(handle != TR_BAD_SYS_FILE);
+    TR_ASSERT(advice == TR_SYS_FILE_ADVICE_WILL_NEED || advice == TR_SYS_FILE_ADVICE_DONT_NEED);
+
+#if defined(HAVE_POSIX_FADVISE)
+
+    int const native_advice = advice == TR_SYS_FILE_ADVICE_WILL_NEED ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED;
+
+    if (int const code = posix_fadvise(handle, offset, size, native_advice); code != 0)
+    {
+        if (error != nullptr)
+        {
+            error->set_from_errno(code);
+        }
+
+        return false;
+    }
+
+#elif defined(__APPLE__)
+
+    if (advice == TR_SYS_FILE_ADVICE_WILL_NEED)
+    {
+        auto radv = radvisory{};
+        radv.ra_offset = offset;
+        radv.ra_count = static_cast<int>(std::min(size, uint64_t{ INT_MAX }));
+
+        if (fcntl(handle, F_RDADVISE, &radv) == -1)
+        {
+            if (error != nullptr)
+            {
+                error->set_from_errno(errno);
+            }
+
+            return false;
+        }
+    }
+
+#endif
+
+    return true;
+}
+
 bool tr_sys_file_lock([[maybe_unused]] tr_sys_file_t handle, [[maybe_unused]] int operation, tr_error* error)
 {
     TR_ASSERT(handle != TR_BAD_SYS_FILE);
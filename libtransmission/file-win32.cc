@@ -769,6 +769,51 @@ bool tr_sys_file_write_at(
     return ret;
 }
 
+// ReadFileScatter() and WriteFileGather() need unbuffered, page-aligned I/O,
+// so these just do the first non-empty buffer and let the caller loop.
+
+bool tr_sys_file_read_at_v(
+    tr_sys_file_t handle,
+    tr_sys_file_iovec const* iov,
+    size_t iov_count,
+    uint64_t offset,
+    uint64_t* bytes_read,
+    tr_error* error)
+{
+    TR_ASSERT(handle != TR_BAD_SYS_FILE);
+    TR_ASSERT(iov != nullptr || iov_count == 0);
+
+    auto const* const end = iov + iov_count;
+    auto const* const vec = std::find_if(iov, end, [](auto const& candidate) { return candidate.len != 0U; });
+    return vec != end && tr_sys_file_read_at(handle, vec->base, vec->len, offset, bytes_read, error);
+}
+
+bool tr_sys_file_write_at_v(
+    tr_sys_file_t handle,
+    tr_sys_file_iovec const* iov,
+    size_t iov_count,
+    uint64_t offset,
+    uint64_t* bytes_written,
+    tr_error* error)
+{
+    TR_ASSERT(handle != TR_BAD_SYS_FILE);
+    TR_ASSERT(iov != nullptr || iov_count == 0);
+
+    auto const* const end = iov + iov_count;
+    auto const* const vec = std::find_if(iov, end, [](auto const& candidate) { return candidate.len != 0U; });
+    if (vec == end)
+    {
+        if (bytes_written != nullptr)
+        {
+            *bytes_written = 0U;
+        }
+
+        return true;
+    }
+
+    return tr_sys_file_write_at(handle, vec->base, vec->len, offset, bytes_written, error);
+}
+
 bool tr_sys_file_truncate(tr_sys_file_t handle, uint64_t size, tr_error* error)
 {
     TR_ASSERT(handle != TR_BAD_SYS_FILE);
@@ -804,6 +849,20 @@ bool tr_sys_file_preallocate(tr_sys_file_t handle, uint64_t size, int flags, tr_
     return tr_sys_file_truncate(handle, size, error);
 }
 
+bool tr_sys_file_advise(
+    tr_sys_file_t handle,
+    uint64_t /*offset*/,
+    uint64_t /*size*/,
+    tr_sys_file_advice_t advice,
+    tr_error* /*error*/)
+{
+    TR_ASSERT(handle != TR_BAD_SYS_FILE);
+    TR_ASSERT(advice == TR_SYS_FILE_ADVICE_WILL_NEED || advice == TR_SYS_FILE_ADVICE_DONT_NEED);
+
+    // Windows has no per-range equivalent; FILE_FLAG_SEQUENTIAL_SCAN is the closest.
+    return true;
+}
+
 bool tr_sys_file_lock(tr_sys_file_t handle, int operation, tr_error* error)
 {
     TR_ASSERT(handle != TR_BAD_SYS_FILE);
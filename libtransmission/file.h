@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <cstddef> // size_t
 #include <cstdint> // uint64_t
 #include <ctime> // time_t
 #include <filesystem>
@@ -73,6 +74,19 @@ enum tr_sys_file_preallocate_flags_t : uint8_t
     TR_SYS_FILE_PREALLOC_SPARSE = (1 << 0)
 };
 
+enum tr_sys_file_advice_t : uint8_t
+{
+    TR_SYS_FILE_ADVICE_WILL_NEED,
+    TR_SYS_FILE_ADVICE_DONT_NEED
+};
+
+/** @brief One buffer in a scatter/gather read or write. */
+struct tr_sys_file_iovec
+{
+    void* base;
+    size_t len;
+};
+
 enum tr_sys_dir_create_flags_t : uint8_t
 {
     TR_SYS_DIR_CREATE_PARENTS = (1 << 0)
@@ -417,6 +431,58 @@ bool tr_sys_file_write_at(
     uint64_t* bytes_written,
     tr_error* error = nullptr);
 
+/**
+ * @brief Like `preadv()`: read into several buffers in one call.
+ *        Not thread-safe.
+ *
+ * As with `tr_sys_file_read_at()`, fewer bytes than requested may be read.
+ * Platforms without `preadv()` may only fill the first non-empty buffer.
+ *
+ * @param[in]  handle     Valid file descriptor.
+ * @param[in]  iov        Buffers to store read data to, in file order.
+ * @param[in]  iov_count  Number of buffers in `iov`.
+ * @param[in]  offset     File offset in bytes to start reading from.
+ * @param[out] bytes_read Number of bytes actually read. Optional, pass `nullptr`
+ *                        if you are not interested.
+ * @param[out] error      Pointer to error object. Optional, pass `nullptr` if
+ *                        you are not interested in error details.
+ *
+ * @return `True` on success, `false` otherwise (with `error` set accordingly).
+ */
+bool tr_sys_file_read_at_v(
+    tr_sys_file_t handle,
+    tr_sys_file_iovec const* iov,
+    size_t iov_count,
+    uint64_t offset,
+    uint64_t* bytes_read,
+    tr_error* error = nullptr);
+
+/**
+ * @brief Like `pwritev()`: write from several buffers in one call.
+ *        Not thread-safe.
+ *
+ * As with `tr_sys_file_write_at()`, fewer bytes than requested may be written.
+ * Platforms without `pwritev()` may only write the first non-empty buffer.
+ *
+ * @param[in]  handle        Valid file descriptor.
+ * @param[in]  iov           Buffers to get data being written from, in file order.
+ * @param[in]  iov_count     Number of buffers in `iov`.
+ * @param[in]  offset        File offset in bytes to start writing from.
+ * @param[out] bytes_written Number of bytes actually written. Optional, pass
+ *                           `nullptr` if you are not interested.
+ * @param[out] error         Pointer to error object. Optional, pass `nullptr`
+ *                           if you are not interested in error details.
+ *
+ * @return `True` on success, `false` otherwise (with `error` set accordingly).
+ */
+bool tr_sys_file_write_at_v(
+    tr_sys_file_t handle,
+    tr_sys_file_iovec const* iov,
+    size_t iov_count,
+    uint64_t offset,
+    uint64_t* bytes_written,
+    tr_error* error = nullptr);
+
 /**
  * @brief Portability wrapper for `ftruncate()`.
  *
@@ -442,6 +508,28 @@ bool tr_sys_file_truncate(tr_sys_file_t handle, uint64_t size, tr_error* error =
  */
 bool tr_sys_file_preallocate(tr_sys_file_t handle, uint64_t size, int flags, tr_error* error = nullptr);
 
+/**
+ * @brief Portability wrapper for `posix_fadvise()`.
+ *
+ * This is only a hint to the OS, so it is okay for it to be a no-op on
+ * platforms that have no equivalent.
+ *
+ * @param[in]  handle Valid file descriptor.
+ * @param[in]  offset File offset in bytes where the advised range begins.
+ * @param[in]  size   Number of bytes in the advised range.
+ * @param[in]  advice One of @ref tr_sys_file_advice_t values.
+ * @param[out] error  Pointer to error object. Optional, pass `nullptr` if you
+ *                    are not interested in error details.
+ *
+ * @return `True` on success, `false` otherwise (with `error` set accordingly).
+ */
+bool tr_sys_file_advise(
+    tr_sys_file_t handle,
+    uint64_t offset,
+    uint64_t size,
+    tr_sys_file_advice_t advice,
+    tr_error* error = nullptr);
+
 /**
  * @brief Portability wrapper for `flock()`.
  *
@@ -7,16 +7,28 @@
 #include <array>
 #include <cerrno>
 #include <cstddef>
+#include <cstdint> // uint8_t, uint64_t
+#include <functional>
+#include <memory>
+#include <numeric> // std::accumulate
 #include <optional>
+#include <span>
+#include <string>
 #include <string_view>
+#include <utility> // std::move
+#include <vector>
 
 #include <fmt/format.h>
 
+#include <small/vector.hpp>
+
 #include "libtransmission/block-info.h" // tr_block_info
 #include "libtransmission/crypto-utils.h"
+#include "libtransmission/disk-io.h"
 #include "libtransmission/error.h"
 #include "libtransmission/file.h"
 #include "libtransmission/inout.h"
+#include "libtransmission/merkle.h"
 #include "libtransmission/session.h"
 #include "libtransmission/string-utils.h"
 #include "libtransmission/torrent-files.h"
@@ -31,18 +43,43 @@ using namespace std::literals;
 namespace
 {
 
-bool read_entire_buf(tr_sys_file_t const fd, uint64_t file_offset, uint8_t* buf, uint64_t buflen, tr_error& error)
+using Iovecs = small::vector<tr_sys_file_iovec, 16U>;
+
+// Drop the first `n` bytes from the front of `iov`.
+void consume(std::span<tr_sys_file_iovec>& iov, uint64_t n)
+{
+    while (n > 0U && !std::empty(iov))
+    {
+        auto& front = iov.front();
+        auto const n_this = std::min(n, uint64_t{ front.len });
+        front.base = static_cast<uint8_t*>(front.base) + n_this;
+        front.len -= n_this;
+        n -= n_this;
+
+        if (front.len == 0U)
+        {
+            iov = iov.subspan(1U);
+        }
+    }
+}
+
+bool read_entire_buf(
+    tr_sys_file_t const fd,
+    uint64_t file_offset,
+    std::span<tr_sys_file_iovec> iov,
+    uint64_t buflen,
+    tr_error& error)
 {
     while (buflen > 0U)
     {
         auto n_read = uint64_t{};
 
-        if (!tr_sys_file_read_at(fd, buf, buflen, file_offset, &n_read, &error))
+        if (!tr_sys_file_read_at_v(fd, std::data(iov), std::size(iov), file_offset, &n_read, &error))
         {
             return false;
         }
 
-        buf += n_read;
+        consume(iov, n_read);
         buflen -= n_read;
         file_offset += n_read;
     }
@@ -50,18 +87,23 @@ bool read_entire_buf(tr_sys_file_t const fd, uint64_t file_offset, uint8_t* buf,
     return true;
 }
 
-bool write_entire_buf(tr_sys_file_t const fd, uint64_t file_offset, uint8_t const* buf, uint64_t buflen, tr_error& error)
+bool write_entire_buf(
+    tr_sys_file_t const fd,
+    uint64_t file_offset,
+    std::span<tr_sys_file_iovec> iov,
+    uint64_t buflen,
+    tr_error& error)
 {
     while (buflen > 0U)
     {
         auto n_written = uint64_t{};
 
-        if (!tr_sys_file_write_at(fd, buf, buflen, file_offset, &n_written, &error))
+        if (!tr_sys_file_write_at_v(fd, std::data(iov), std::size(iov), file_offset, &n_written, &error))
         {
             return false;
         }
 
-        buf += n_written;
+        consume(iov, n_written);
         buflen -= n_written;
         file_offset += n_written;
     }
@@ -128,7 +170,7 @@ void read_or_write_bytes(
     bool const writable,
     tr_file_index_t const file_index,
     uint64_t const file_offset,
-    uint8_t* const buf,
+    std::span<tr_sys_file_iovec> const iov,
     uint64_t const buflen,
     tr_error& error)
 {
@@ -151,12 +193,12 @@ void read_or_write_bytes(
     if (writable)
     {
         fmtstr = _("Couldn't save '{path}': {error} ({error_code})");
-        write_entire_buf(*fd, file_offset, buf, buflen, error);
+        write_entire_buf(*fd, file_offset, iov, buflen, error);
     }
     else
     {
         fmtstr = _("Couldn't read '{path}': {error} ({error_code})");
-        read_entire_buf(*fd, file_offset, buf, buflen, error);
+        read_entire_buf(*fd, file_offset, iov, buflen, error);
     }
 
     if (error)
@@ -171,11 +213,64 @@ void read_or_write_bytes(
     }
 }
 
+// Split `iov`, which holds exactly `buflen` bytes starting at `loc`, at file boundaries.
+// `func(file_index, file_offset, iov_part, n_bytes)` is called for each file in order
+// until it returns false. `iov`'s contents are consumed as they're used.
+template<typename Func>
+void for_each_file_part(
+    tr_torrent const& tor,
+    tr_block_info::Location const loc,
+    std::span<tr_sys_file_iovec> iov,
+    uint64_t buflen,
+    Func&& func)
+{
+    auto [file_index, file_offset] = tor.file_offset(loc);
+    while (buflen != 0U)
+    {
+        auto const bytes_this_pass = std::min(buflen, tor.file_size(file_index) - file_offset);
+
+        // find the buffers that fall in this file; the last one may straddle into the next
+        auto n_vecs = size_t{};
+        auto n_bytes = uint64_t{};
+        while (n_bytes < bytes_this_pass)
+        {
+            n_bytes += iov[n_vecs++].len;
+        }
+
+        auto const overshoot = n_bytes - bytes_this_pass;
+        auto* const last_base = overshoot != 0U ? static_cast<uint8_t*>(iov[n_vecs - 1U].base) : nullptr;
+        auto const last_len = overshoot != 0U ? iov[n_vecs - 1U].len : size_t{};
+        if (overshoot != 0U)
+        {
+            iov[n_vecs - 1U].len -= overshoot;
+        }
+
+        if (!func(file_index, file_offset, iov.first(n_vecs), bytes_this_pass))
+        {
+            return;
+        }
+
+        if (overshoot != 0U)
+        {
+            // the rest of the straddling buffer goes to the next file
+            --n_vecs;
+            iov[n_vecs].base = last_base + (last_len - overshoot);
+            iov[n_vecs].len = overshoot;
+        }
+
+        iov = iov.subspan(n_vecs);
+        buflen -= bytes_this_pass;
+        ++file_index;
+        file_offset = 0U;
+    }
+}
+
+// `iov` must hold exactly `buflen` bytes. Its contents are consumed as they're used.
 void read_or_write_piece(
     tr_torrent const& tor,
     bool const writable,
     tr_block_info::Location const loc,
-    uint8_t* buf,
+    std::span<tr_sys_file_iovec> iov,
     uint64_t buflen,
     tr_error& error)
 {
@@ -185,31 +280,184 @@ void read_or_write_piece(
         return;
     }
 
-    auto [file_index, file_offset] = tor.file_offset(loc);
     auto& session = *tor.session;
     auto& open_files = session.openFiles();
-    while (buflen != 0U && !error)
+    for_each_file_part(
+        tor,
+        loc,
+        iov,
+        buflen,
+        [&](tr_file_index_t const file_index, uint64_t const file_offset, std::span<tr_sys_file_iovec> part, uint64_t const n_bytes)
+        {
+            read_or_write_bytes(session, open_files, tor, writable, file_index, file_offset, part, n_bytes, error);
+            return !error;
+        });
+}
+
+// One file's share of a read or write that runs on a tr_disk_io thread.
+struct FilePart
+{
+    // Shared with the session's tr_open_files, so that the disk threads' files
+    // count against the open-files limit and stats like everyone else's.
+    // It stays open until the job's done, even if the pool closes it.
+    std::shared_ptr<tr_sys_file_t const> fd;
+    std::string subpath;
+    uint64_t file_offset = {};
+    uint64_t n_bytes = {};
+    std::vector<tr_sys_file_iovec> iov;
+};
+
+// Find which files `iov` maps to and get them from the session's open files.
+// Any missing files are created here, on the session thread, when writing.
+[[nodiscard]] std::vector<FilePart> plan_file_parts(
+    tr_torrent const& tor,
+    bool const writable,
+    tr_block_info::Location const loc,
+    std::span<tr_sys_file_iovec> iov,
+    uint64_t buflen,
+    tr_error& error)
+{
+    auto parts = std::vector<FilePart>{};
+
+    if (loc.piece >= tor.piece_count())
     {
-        auto const bytes_this_pass = std::min(buflen, tor.file_size(file_index) - file_offset);
-        read_or_write_bytes(session, open_files, tor, writable, file_index, file_offset, buf, bytes_this_pass, error);
-        if (buf != nullptr)
+        error.set_from_errno(EINVAL);
+        return parts;
+    }
+
+    auto& session = *tor.session;
+    auto& open_files = session.openFiles();
+    for_each_file_part(
+        tor,
+        loc,
+        iov,
+        buflen,
+        [&](tr_file_index_t const file_index, uint64_t const file_offset, std::span<tr_sys_file_iovec> part, uint64_t const n_bytes)
+        {
+            if (n_bytes == 0U)
+            {
+                return true;
+            }
+
+            auto fd = open_files.get_shared(tor.id(), file_index, writable);
+            if (!fd)
+            {
+                if (!get_fd(session, open_files, tor, writable, file_index, error))
+                {
+                    return false;
+                }
+
+                fd = open_files.get_shared(tor.id(), file_index, writable);
+            }
+
+            parts.emplace_back(
+                FilePart{ std::move(fd),
+                          std::string{ tor.file_subpath(file_index) },
+                          file_offset,
+                          n_bytes,
+                          std::vector<tr_sys_file_iovec>{ std::begin(part), std::end(part) } });
+            return true;
+        });
+
+    return parts;
+}
+
+// Called on a tr_disk_io thread.
+void read_or_write_file_parts(bool const writable, std::vector<FilePart>& parts, tr_error& error)
+{
+    for (auto& [fd, subpath, file_offset, n_bytes, iov] : parts)
+    {
+        auto fmtstr = ""sv;
+        if (writable)
         {
-            buf += bytes_this_pass;
+            fmtstr = _("Couldn't save '{path}': {error} ({error_code})");
+            write_entire_buf(*fd, file_offset, iov, n_bytes, error);
+        }
+        else
+        {
+            fmtstr = _("Couldn't read '{path}': {error} ({error_code})");
+            read_entire_buf(*fd, file_offset, iov, n_bytes, error);
+        }
+
+        fd.reset();
+
+        if (error)
+        {
+            error.set(
+                error.code(),
+                fmt::format(
+                    fmt::runtime(fmtstr),
+                    fmt::arg("path", subpath),
+                    fmt::arg("error", error.message()),
+                    fmt::arg("error_code", error.code())));
+            return;
         }
-        buflen -= bytes_this_pass;
-        ++file_index;
-        file_offset = 0U;
     }
 }
 
-std::optional<tr_sha1_digest_t> recalculate_hash(tr_torrent const& tor, tr_piece_index_t const piece)
+void read_or_write_piece_async(
+    tr_disk_io& disk_io,
+    tr_torrent const& tor,
+    bool const writable,
+    tr_block_info::Location const loc,
+    std::span<tr_sys_file_iovec const> const iov,
+    std::function<void(int)> on_done)
+{
+    auto iovecs = Iovecs{ std::begin(iov), std::end(iov) };
+    auto const len = std::accumulate(
+        std::begin(iov),
+        std::end(iov),
+        uint64_t{},
+        [](uint64_t sum, auto const& vec) { return sum + vec.len; });
+
+    auto error = tr_error{};
+    auto parts = plan_file_parts(tor, writable, loc, { std::data(iovecs), std::size(iovecs) }, len, error);
+    auto work = [writable, parts = std::move(parts), planning_error = std::move(error)](tr_error& setme) mutable
+    {
+        if (planning_error)
+        {
+            setme = std::move(planning_error);
+            return;
+        }
+
+        read_or_write_file_parts(writable, parts, setme);
+    };
+
+    auto done = [session = tor.session, tor_id = tor.id(), writable, on_done = std::move(on_done)](tr_error const& err)
+    {
+        if (err)
+        {
+            // Do not capture the torrent pointer directly; it may be freed before this runs.
+            if (auto* const torrent = session->torrents().get(tor_id); torrent != nullptr)
+            {
+                tr_logAddErrorTor(torrent, std::string{ err.message() });
+
+                // if a write failed, set torrent's error if not already set
+                if (writable && !torrent->error().is_local_error())
+                {
+                    torrent->error().set_local_error(err.message());
+                    tr_torrentStop(torrent);
+                }
+            }
+        }
+
+        if (on_done)
+        {
+            on_done(err.code());
+        }
+    };
+
+    disk_io.add(tor.current_dir().sv(), tor.id(), std::move(work), std::move(done));
+}
+
+// Read `piece` back and return its SHA-1, feeding its data to `v2` as well.
+std::optional<tr_sha1_digest_t> recalculate_hash(tr_torrent const& tor, tr_piece_index_t const piece, tr_merkle_piece_checker& v2)
 {
     TR_ASSERT(piece < tor.piece_count());
 
+    auto& cache = tor.session->cache;
     auto sha = tr_sha1{};
     auto buffer = std::array<uint8_t, tr_block_info::BlockSize>{};
-
-    auto& cache = tor.session->cache;
     auto const [begin_byte, end_byte] = tor.block_info().byte_span_for_piece(piece);
     auto const [begin_block, end_block] = tor.block_span_for_piece(piece);
     [[maybe_unused]] auto n_bytes_checked = size_t{};
@@ -236,6 +484,7 @@ std::optional<tr_sha1_digest_t> recalculate_hash(tr_torrent const& tor, tr_piece
         }
 
         sha.add(begin, end - begin);
+        v2.add(begin, end - begin);
         n_bytes_checked += (end - begin);
     }
 
@@ -247,15 +496,43 @@ std::optional<tr_sha1_digest_t> recalculate_hash(tr_torrent const& tor, tr_piece
 
 int tr_ioRead(tr_torrent const& tor, tr_block_info::Location const& loc, size_t const len, uint8_t* const setme)
 {
+    auto iov = tr_sys_file_iovec{ setme, len };
+    auto error = tr_error{};
+    read_or_write_piece(tor, false /*writable*/, loc, { &iov, 1U }, len, error);
+    return error.code();
+}
+
+int tr_ioReadv(tr_torrent const& tor, tr_block_info::Location const& loc, std::span<tr_sys_file_iovec const> const iov)
+{
+    auto iovecs = Iovecs{ std::begin(iov), std::end(iov) };
+    auto const len = std::accumulate(
+        std::begin(iov),
+        std::end(iov),
+        uint64_t{},
+        [](uint64_t sum, auto const& vec) { return sum + vec.len; });
+
     auto error = tr_error{};
-    read_or_write_piece(tor, false /*writable*/, loc, setme, len, error);
+    read_or_write_piece(tor, false /*writable*/, loc, { std::data(iovecs), std::size(iovecs) }, len, error);
     return error.code();
 }
 
 int tr_ioWrite(tr_torrent& tor, tr_block_info::Location const& loc, size_t const len, uint8_t const* const writeme)
 {
+    auto const iov = tr_sys_file_iovec{ const_cast<uint8_t*>(writeme), len };
+    return tr_ioWritev(tor, loc, { &iov, 1U });
+}
+
+int tr_ioWritev(tr_torrent& tor, tr_block_info::Location const& loc, std::span<tr_sys_file_iovec const> const iov)
+{
+    auto iovecs = Iovecs{ std::begin(iov), std::end(iov) };
+    auto const len = std::accumulate(
+        std::begin(iov),
+        std::end(iov),
+        uint64_t{},
+        [](uint64_t sum, auto const& vec) { return sum + vec.len; });
+
     auto error = tr_error{};
-    read_or_write_piece(tor, true /*writable*/, loc, const_cast<uint8_t*>(writeme), len, error);
+    read_or_write_piece(tor, true /*writable*/, loc, { std::data(iovecs), std::size(iovecs) }, len, error);
 
     // if IO failed, set torrent's error if not already set
     if (error && !tor.error().is_local_error())
@@ -267,8 +544,36 @@ int tr_ioWrite(tr_torrent& tor, tr_block_info::Location const& loc, size_t const
     return error.code();
 }
 
+void tr_ioReadvAsync(
+    tr_disk_io& disk_io,
+    tr_torrent const& tor,
+    tr_block_info::Location const& loc,
+    std::span<tr_sys_file_iovec const> const iov,
+    std::function<void(int)> on_done)
+{
+    read_or_write_piece_async(disk_io, tor, false /*writable*/, loc, iov, std::move(on_done));
+}
+
+void tr_ioWritevAsync(
+    tr_disk_io& disk_io,
+    tr_torrent& tor,
+    tr_block_info::Location const& loc,
+    std::span<tr_sys_file_iovec const> const iov,
+    std::function<void(int)> on_done)
+{
+    read_or_write_piece_async(disk_io, tor, true /*writable*/, loc, iov, std::move(on_done));
+}
+
 bool tr_ioTestPiece(tr_torrent const& tor, tr_piece_index_t const piece)
 {
-    auto const hash = recalculate_hash(tor, piece);
-    return hash && *hash == tor.piece_hash(piece);
+    // no need to read the piece back if it was hashed as it was written
+    if (auto const hash = tor.session->cache->take_piece_hash(tor, piece); hash)
+    {
+        return *hash == tor.piece_hash(piece);
+    }
+
+    auto v2 = tr_merkle_piece_checker{};
+    v2.start(tor.merkle_pieces(), piece);
+    auto const hash = recalculate_hash(tor, piece, v2);
+    return hash && *hash == tor.piece_hash(piece) && v2.finish();
 }
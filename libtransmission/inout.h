@@ -11,10 +11,14 @@
 
 #include <cstddef> // size_t
 #include <cstdint> // uint8_t, uint32_t
+#include <functional>
+#include <span>
 
 #include "libtransmission/block-info.h"
+#include "libtransmission/file.h" // tr_sys_file_iovec
 #include "libtransmission/types.h"
 
+class tr_disk_io;
 struct tr_torrent;
 
 /**
@@ -28,12 +32,50 @@ struct tr_torrent;
  */
 [[nodiscard]] int tr_ioRead(tr_torrent const& tor, tr_block_info::Location const& loc, size_t len, uint8_t* setme);
 
+/**
+ * Like tr_ioRead(), but scatters the data into several buffers,
+ * e.g. one per block, instead of one contiguous buffer.
+ * @return 0 on success, or an errno value on failure.
+ */
+[[nodiscard]] int tr_ioReadv(tr_torrent const& tor, tr_block_info::Location const& loc, std::span<tr_sys_file_iovec const> iov);
+
 /**
  * Writes the block specified by the piece index, offset, and length.
  * @return 0 on success, or an errno value on failure.
  */
 [[nodiscard]] int tr_ioWrite(tr_torrent& tor, tr_block_info::Location const& loc, size_t len, uint8_t const* writeme);
 
+/**
+ * Like tr_ioWrite(), but gathers the data from several buffers,
+ * so that they needn't be copied into one contiguous buffer first.
+ * @return 0 on success, or an errno value on failure.
+ */
+[[nodiscard]] int tr_ioWritev(tr_torrent& tor, tr_block_info::Location const& loc, std::span<tr_sys_file_iovec const> iov);
+
+/**
+ * Like tr_ioReadv(), but the read runs on one of `disk_io`'s threads.
+ * `on_done` is called in the session thread with 0 on success, or an errno value.
+ * The buffers in `iov` must stay valid until then.
+ */
+void tr_ioReadvAsync(
+    tr_disk_io& disk_io,
+    tr_torrent const& tor,
+    tr_block_info::Location const& loc,
+    std::span<tr_sys_file_iovec const> iov,
+    std::function<void(int)> on_done);
+
+/**
+ * Like tr_ioWritev(), but the write runs on one of `disk_io`'s threads.
+ * `on_done` is called in the session thread with 0 on success, or an errno value.
+ * The buffers in `iov` must stay valid until then.
+ */
+void tr_ioWritevAsync(
+    tr_disk_io& disk_io,
+    tr_torrent& tor,
+    tr_block_info::Location const& loc,
+    std::span<tr_sys_file_iovec const> iov,
+    std::function<void(int)> on_done);
+
 /**
  * @brief Test to see if the piece matches its metainfo's SHA1 checksum.
  */
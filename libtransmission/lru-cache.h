@@ -5,122 +5,144 @@
 
 #pragma once
 
-#include <array>
+#include <algorithm> // std::max
 #include <cstddef> // size_t
 #include <cstdint>
 #include <functional>
+#include <list>
+#include <unordered_map>
 #include <utility>
 
-// A fixed-size cache that erases least-recently-used items to make room for new ones.
-template<typename Key, typename Val, std::size_t N>
+#include "libtransmission/types.h" // tr_torrent_id_t
+
+// Hashes keys of one torrent's items, e.g. (torrent id, file index).
+// Torrents rarely have anywhere near 2^32 items, so the low half
+// of the index is enough to spread them out.
+struct tr_torrent_item_hash
+{
+    template<typename Index>
+    [[nodiscard]] size_t operator()(std::pair<tr_torrent_id_t, Index> const& key) const noexcept
+    {
+        auto const id = static_cast<uint32_t>(key.first);
+        auto const index = static_cast<uint32_t>(key.second);
+        return std::hash<uint64_t>{}((uint64_t{ id } << 32U) | index);
+    }
+};
+
+// A cache that erases least-recently-used items to make room for new ones.
+//
+// Lookups are hashed and the items are kept in a list ordered by last use,
+// so `get()`, `add()`, and eviction are all O(1) however big the cache gets.
+template<typename Key, typename Val, typename Hash = std::hash<Key>>
 class tr_lru_cache
 {
 public:
-    [[nodiscard]] constexpr Val* get(Key const& key) noexcept
+    explicit tr_lru_cache(size_t capacity)
+        : capacity_{ std::max(capacity, size_t{ 1U }) }
+    {
+    }
+
+    [[nodiscard]] Val* get(Key const& key)
     {
-        if (auto const found = find(key); found != nullptr)
+        if (auto const iter = index_.find(key); iter != std::end(index_))
         {
-            found->sequence_ = next_sequence_++;
-            return &found->val_;
+            entries_.splice(std::begin(entries_), entries_, iter->second);
+            return &iter->second->second;
         }
 
         return nullptr;
     }
 
-    [[nodiscard]] constexpr bool contains(Key const& key) const noexcept
+    [[nodiscard]] bool contains(Key const& key) const
     {
-        return find(key) != nullptr;
+        return index_.contains(key);
     }
 
     Val& add(Key&& key)
     {
-        auto& entry = get_free_slot();
-        entry.key_ = std::move(key);
-        entry.sequence_ = next_sequence_++;
+        erase(key);
 
-        key = {};
-        return entry.val_;
+        while (std::size(entries_) >= capacity_)
+        {
+            ++n_evictions_;
+            erase_entry(std::prev(std::end(entries_)));
+        }
+
+        entries_.emplace_front(std::move(key), Val{});
+        index_.try_emplace(entries_.front().first, std::begin(entries_));
+        return entries_.front().second;
     }
 
     void erase(Key const& key)
     {
-        if (auto* const found = find(key); found != nullptr)
+        if (auto const iter = index_.find(key); iter != std::end(index_))
         {
-            this->erase(*found);
+            erase_entry(iter->second);
         }
     }
 
     void erase_if(std::function<bool(Key const&, Val const&)> const& test)
     {
-        for (auto& entry : entries_)
+        for (auto iter = std::begin(entries_); iter != std::end(entries_);)
         {
-            if (entry.sequence_ != InvalidSeq && test(entry.key_, entry.val_))
+            auto const next = std::next(iter);
+
+            if (test(iter->first, iter->second))
             {
-                erase(entry);
+                erase_entry(iter);
             }
+
+            iter = next;
         }
     }
 
     void clear()
     {
-        for (auto& entry : entries_)
-        {
-            erase(entry);
-        }
+        index_.clear();
+        entries_.clear();
     }
 
-private:
-    struct Entry
+    // Change how many items the cache can hold,
+    // evicting the least-recently-used ones if it's shrinking.
+    void set_capacity(size_t capacity)
     {
-        Key key_ = {};
-        Val val_ = {};
-        uint64_t sequence_ = InvalidSeq;
-    };
+        capacity_ = std::max(capacity, size_t{ 1U });
 
-    void erase(Entry& entry) const
-    {
-        entry.key_ = {};
-        entry.val_ = {};
-        entry.sequence_ = InvalidSeq;
-    }
-
-    [[nodiscard]] constexpr Entry* find(Key const& key) noexcept
-    {
-        for (auto& entry : entries_)
+        while (std::size(entries_) > capacity_)
         {
-            if (entry.sequence_ != InvalidSeq && entry.key_ == key)
-            {
-                return &entry;
-            }
+            ++n_evictions_;
+            erase_entry(std::prev(std::end(entries_)));
         }
+    }
 
-        return nullptr;
+    [[nodiscard]] constexpr auto capacity() const noexcept
+    {
+        return capacity_;
     }
 
-    [[nodiscard]] constexpr Entry const* find(Key const& key) const noexcept
+    [[nodiscard]] auto size() const noexcept
     {
-        for (auto const& entry : entries_)
-        {
-            if (entry.sequence_ != InvalidSeq && entry.key_ == key)
-            {
-                return &entry;
-            }
-        }
+        return std::size(entries_);
+    }
 
-        return nullptr;
+    // how many items have been pushed out to make room for others
+    [[nodiscard]] constexpr auto evictions() const noexcept
+    {
+        return n_evictions_;
     }
 
-    Entry& get_free_slot()
+private:
+    // most-recently-used first
+    using Entries = std::list<std::pair<Key, Val>>;
+
+    void erase_entry(typename Entries::iterator iter)
     {
-        auto const iter = std::min_element(
-            std::begin(entries_),
-            std::end(entries_),
-            [](auto const& a, auto const& b) { return a.sequence_ < b.sequence_; });
-        erase(*iter);
-        return *iter;
+        index_.erase(iter->first);
+        entries_.erase(iter);
     }
 
-    std::array<Entry, N> entries_;
-    uint64_t next_sequence_ = 1U;
-    static uint64_t constexpr InvalidSeq = 0U;
+    Entries entries_;
+    std::unordered_map<Key, typename Entries::iterator, Hash> index_;
+    size_t capacity_;
+    uint64_t n_evictions_ = 0U;
 };
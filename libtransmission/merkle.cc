@@ -0,0 +1,285 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <bit> // std::bit_ceil, std::has_single_bit, std::countr_zero
+#include <cstddef> // std::byte, size_t
+#include <cstdint>
+#include <iterator> // std::prev
+#include <optional>
+#include <utility> // std::move
+#include <vector>
+
+#include "libtransmission/crypto-utils.h"
+#include "libtransmission/merkle.h"
+#include "libtransmission/torrent-metainfo.h"
+#include "libtransmission/types.h"
+
+tr_merkle_file::tr_merkle_file(
+    tr_sha256_digest_t const& pieces_root,
+    uint64_t const file_size,
+    uint32_t const piece_size,
+    std::vector<tr_sha256_digest_t> piece_layer)
+    : piece_layer_{ std::move(piece_layer) }
+    , pieces_root_{ pieces_root }
+    , file_size_{ file_size }
+    , piece_size_{ piece_size }
+{
+    // BEP 52: "piece length ... must be a power of two and at least 16KiB."
+    if (file_size_ == 0U || piece_size_ < BlockSize || !std::has_single_bit(piece_size_))
+    {
+        return;
+    }
+
+    n_pieces_ = static_cast<size_t>((file_size_ + piece_size_ - 1U) / piece_size_);
+
+    // files that fit in a single piece have no piece layer; their root is their piece hash
+    if (n_pieces_ == 1U)
+    {
+        is_valid_ = true;
+        return;
+    }
+
+    if (std::size(piece_layer_) != n_pieces_)
+    {
+        return;
+    }
+
+    auto const height = static_cast<size_t>(std::countr_zero(piece_size_ / BlockSize));
+    is_valid_ = root(piece_layer_, std::bit_ceil(n_pieces_), height) == pieces_root_;
+}
+
+uint32_t tr_merkle_file::piece_size(size_t const piece) const noexcept
+{
+    if (piece + 1U < n_pieces_)
+    {
+        return piece_size_;
+    }
+
+    auto const remainder = static_cast<uint32_t>(file_size_ % piece_size_);
+    return remainder != 0U ? remainder : piece_size_;
+}
+
+size_t tr_merkle_file::block_count(size_t const piece) const noexcept
+{
+    return (piece_size(piece) + BlockSize - 1U) / BlockSize;
+}
+
+size_t tr_merkle_file::leaf_slots(size_t const piece) const noexcept
+{
+    // a piece layer node covers a full piece's worth of leaves, even in the last piece;
+    // but a single-piece file's tree is only as wide as it needs to be.
+    return n_pieces_ == 1U ? std::bit_ceil(block_count(piece)) : piece_size_ / BlockSize;
+}
+
+bool tr_merkle_file::check_piece(size_t const piece, void const* const data, size_t const data_len) const
+{
+    if (!is_valid_ || piece >= n_pieces_ || data_len != piece_size(piece))
+    {
+        return false;
+    }
+
+    return root(block_hashes(data, data_len), leaf_slots(piece)) == expected_hash(piece);
+}
+
+bool tr_merkle_file::check_block_hashes(size_t const piece, std::vector<tr_sha256_digest_t> const& block_hashes) const
+{
+    if (!is_valid_ || piece >= n_pieces_ || std::size(block_hashes) != block_count(piece))
+    {
+        return false;
+    }
+
+    return root(block_hashes, leaf_slots(piece)) == expected_hash(piece);
+}
+
+std::vector<size_t> tr_merkle_file::find_bad_blocks(
+    void const* const data,
+    size_t const data_len,
+    std::vector<tr_sha256_digest_t> const& block_hashes)
+{
+    auto const actual = tr_merkle_file::block_hashes(data, data_len);
+
+    auto bad = std::vector<size_t>{};
+    for (size_t i = 0U, n = std::max(std::size(actual), std::size(block_hashes)); i < n; ++i)
+    {
+        if (i >= std::size(actual) || i >= std::size(block_hashes) || actual[i] != block_hashes[i])
+        {
+            bad.emplace_back(i);
+        }
+    }
+
+    return bad;
+}
+
+std::vector<tr_sha256_digest_t> tr_merkle_file::block_hashes(void const* const data, size_t const data_len)
+{
+    auto const* const bytes = static_cast<std::byte const*>(data);
+
+    auto hashes = std::vector<tr_sha256_digest_t>{};
+    hashes.reserve((data_len + BlockSize - 1U) / BlockSize);
+
+    for (size_t offset = 0U; offset < data_len; offset += BlockSize)
+    {
+        auto sha = tr_sha256{};
+        sha.add(bytes + offset, std::min(size_t{ BlockSize }, data_len - offset));
+        hashes.emplace_back(sha.finish());
+    }
+
+    return hashes;
+}
+
+tr_sha256_digest_t tr_merkle_file::pad_hash(size_t const height)
+{
+    // BEP 52: "The remaining leaf hashes beyond the end of the file
+    // required to construct upper layers of the merkle tree are set to zero."
+    auto hash = tr_sha256_digest_t{};
+
+    for (size_t i = 0U; i < height; ++i)
+    {
+        hash = tr_sha256::digest(hash, hash);
+    }
+
+    return hash;
+}
+
+tr_sha256_digest_t tr_merkle_file::root(std::vector<tr_sha256_digest_t> hashes, size_t n_slots, size_t const height)
+{
+    if (std::empty(hashes) || n_slots < std::size(hashes))
+    {
+        return {};
+    }
+
+    auto pad = pad_hash(height);
+    n_slots = std::bit_ceil(n_slots);
+
+    while (n_slots > 1U)
+    {
+        auto const n_hashes = std::size(hashes);
+
+        for (size_t i = 0U; i < n_hashes; i += 2U)
+        {
+            hashes[i / 2U] = tr_sha256::digest(hashes[i], i + 1U < n_hashes ? hashes[i + 1U] : pad);
+        }
+
+        hashes.resize((n_hashes + 1U) / 2U);
+        pad = tr_sha256::digest(pad, pad);
+        n_slots /= 2U;
+    }
+
+    return hashes.front();
+}
+
+// ---
+
+tr_merkle_pieces::tr_merkle_pieces(tr_torrent_metainfo const& metainfo)
+{
+    auto const piece_size = uint64_t{ metainfo.piece_size() };
+    if (!metainfo.has_v2_metadata() || piece_size == 0U)
+    {
+        return;
+    }
+
+    auto file_begin = uint64_t{};
+    for (tr_file_index_t i = 0U, n = metainfo.file_count(); i < n; ++i)
+    {
+        if (file_begin % piece_size == 0U)
+        {
+            if (auto tree = metainfo.merkle_file(i); tree)
+            {
+                files_.push_back({ static_cast<tr_piece_index_t>(file_begin / piece_size), std::move(*tree) });
+            }
+        }
+
+        file_begin += metainfo.file_size(i);
+    }
+}
+
+std::optional<tr_merkle_pieces::FilePiece> tr_merkle_pieces::find(tr_piece_index_t const piece) const
+{
+    auto const iter = std::ranges::upper_bound(files_, piece, {}, &File::begin);
+    if (iter == std::ranges::begin(files_))
+    {
+        return {};
+    }
+
+    auto const& [begin, tree] = *std::prev(iter);
+    if (auto const file_piece = size_t{ piece - begin }; file_piece < tree.piece_count())
+    {
+        return FilePiece{ &tree, file_piece };
+    }
+
+    return {};
+}
+
+// ---
+
+void tr_merkle_piece_checker::start(tr_merkle_pieces const& pieces, tr_piece_index_t const piece)
+{
+    file_piece_ = pieces.find(piece);
+    block_hashes_.clear();
+    n_in_block_ = 0U;
+    n_left_ = 0U;
+
+    if (file_piece_)
+    {
+        n_left_ = file_piece_->file->piece_size(file_piece_->piece);
+        block_hashes_.reserve(file_piece_->file->block_count(file_piece_->piece));
+
+        if (sha_)
+        {
+            sha_->clear();
+        }
+        else
+        {
+            sha_.emplace();
+        }
+    }
+}
+
+void tr_merkle_piece_checker::add(void const* const data, size_t data_len)
+{
+    if (!file_piece_)
+    {
+        return;
+    }
+
+    auto const* bytes = static_cast<std::byte const*>(data);
+    data_len = std::min(data_len, n_left_);
+    n_left_ -= data_len;
+
+    while (data_len > 0U)
+    {
+        auto const n_bytes = std::min(data_len, size_t{ tr_merkle_file::BlockSize } - n_in_block_);
+        sha_->add(bytes, n_bytes);
+        bytes += n_bytes;
+        data_len -= n_bytes;
+        n_in_block_ += n_bytes;
+
+        if (n_in_block_ == tr_merkle_file::BlockSize)
+        {
+            block_hashes_.emplace_back(sha_->finish());
+            n_in_block_ = 0U;
+        }
+    }
+}
+
+bool tr_merkle_piece_checker::finish()
+{
+    if (!file_piece_)
+    {
+        return true;
+    }
+
+    // the file's last block may be short
+    if (n_in_block_ > 0U)
+    {
+        block_hashes_.emplace_back(sha_->finish());
+        n_in_block_ = 0U;
+    }
+
+    auto const passed = n_left_ == 0U && file_piece_->file->check_block_hashes(file_piece_->piece, block_hashes_);
+    file_piece_.reset();
+    return passed;
+}
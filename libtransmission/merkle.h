@@ -0,0 +1,174 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t, uint64_t
+#include <optional>
+#include <vector>
+
+#include "libtransmission/block-info.h"
+#include "libtransmission/crypto-utils.h" // tr_sha256
+#include "libtransmission/types.h" // tr_piece_index_t, tr_sha256_digest_t
+
+struct tr_torrent_metainfo;
+
+/**
+ * BitTorrent v2 verifies each file on its own with a SHA-256 Merkle tree
+ * whose leaves are the hashes of the file's 16 KiB blocks. The .torrent
+ * holds the tree's root ("pieces root") and, for files bigger than one
+ * piece, the layer of the tree where each node covers one piece
+ * ("piece layers").
+ *
+ * Since every block has its own leaf, a peer that sends us a block's
+ * sibling hashes lets us find a single bad block in a failed piece
+ * instead of throwing away the whole piece.
+ *
+ * https://www.bittorrent.org/beps/bep_0052.html
+ */
+class tr_merkle_file
+{
+public:
+    static auto constexpr BlockSize = tr_block_info::BlockSize;
+
+    tr_merkle_file(
+        tr_sha256_digest_t const& pieces_root,
+        uint64_t file_size,
+        uint32_t piece_size,
+        std::vector<tr_sha256_digest_t> piece_layer = {});
+
+    // True iff the piece size is usable and the piece layer
+    // (if the file is big enough to need one) matches the pieces root.
+    [[nodiscard]] constexpr auto is_valid() const noexcept
+    {
+        return is_valid_;
+    }
+
+    [[nodiscard]] constexpr auto const& pieces_root() const noexcept
+    {
+        return pieces_root_;
+    }
+
+    [[nodiscard]] constexpr auto file_size() const noexcept
+    {
+        return file_size_;
+    }
+
+    // The number of pieces in this file. Pieces are aligned to the file's start.
+    [[nodiscard]] constexpr auto piece_count() const noexcept
+    {
+        return n_pieces_;
+    }
+
+    // The number of bytes of the file in `piece`.
+    [[nodiscard]] uint32_t piece_size(size_t piece) const noexcept;
+
+    // The number of 16 KiB blocks of the file in `piece`.
+    [[nodiscard]] size_t block_count(size_t piece) const noexcept;
+
+    // Check a piece's data against the tree.
+    [[nodiscard]] bool check_piece(size_t piece, void const* data, size_t data_len) const;
+
+    // Check a piece's block hashes, e.g. ones received from a peer,
+    // against the tree. Hashes that pass can be used to find bad blocks.
+    [[nodiscard]] bool check_block_hashes(size_t piece, std::vector<tr_sha256_digest_t> const& block_hashes) const;
+
+    // Given a piece's data and its verified block hashes,
+    // return the indices of the blocks whose data doesn't match.
+    [[nodiscard]] static std::vector<size_t> find_bad_blocks(
+        void const* data,
+        size_t data_len,
+        std::vector<tr_sha256_digest_t> const& block_hashes);
+
+    // --- tree building blocks
+
+    // The hashes of each 16 KiB block in `data`. The last block may be short.
+    [[nodiscard]] static std::vector<tr_sha256_digest_t> block_hashes(void const* data, size_t data_len);
+
+    // The hash of a subtree `height` layers tall with nothing but padding in it.
+    [[nodiscard]] static tr_sha256_digest_t pad_hash(size_t height);
+
+    // The root of a subtree with `n_slots` (a power of two) nodes at `height`
+    // layers above the leaves. Slots after `hashes` are filled with padding.
+    [[nodiscard]] static tr_sha256_digest_t root(std::vector<tr_sha256_digest_t> hashes, size_t n_slots, size_t height = 0U);
+
+private:
+    // the hash that `piece`'s subtree must have
+    [[nodiscard]] tr_sha256_digest_t const& expected_hash(size_t piece) const noexcept
+    {
+        return n_pieces_ == 1U ? pieces_root_ : piece_layer_[piece];
+    }
+
+    // the number of leaf slots in `piece`'s subtree
+    [[nodiscard]] size_t leaf_slots(size_t piece) const noexcept;
+
+    std::vector<tr_sha256_digest_t> piece_layer_;
+    tr_sha256_digest_t pieces_root_ = {};
+    uint64_t file_size_ = {};
+    uint32_t piece_size_ = {};
+    size_t n_pieces_ = {};
+    bool is_valid_ = false;
+};
+
+/**
+ * The v2 trees of a hybrid torrent's files, looked up by the torrent's pieces.
+ *
+ * Hybrid torrents pad each file out to a piece boundary, so every piece of
+ * a file's tree starts at the same byte as one of the torrent's pieces. That
+ * torrent piece holds the file's piece, followed by padding if it's the
+ * file's last. Files that don't start on a piece boundary aren't checked.
+ */
+class tr_merkle_pieces
+{
+public:
+    struct FilePiece
+    {
+        tr_merkle_file const* file;
+        size_t piece; // the piece's index in `file`
+    };
+
+    tr_merkle_pieces() = default;
+    explicit tr_merkle_pieces(tr_torrent_metainfo const& metainfo);
+
+    // The file piece that torrent piece `piece` starts with, if it has a tree.
+    [[nodiscard]] std::optional<FilePiece> find(tr_piece_index_t piece) const;
+
+    [[nodiscard]] auto empty() const noexcept
+    {
+        return std::empty(files_);
+    }
+
+private:
+    struct File
+    {
+        tr_piece_index_t begin; // the torrent piece that the file starts in
+        tr_merkle_file tree;
+    };
+
+    std::vector<File> files_; // sorted by `begin`
+};
+
+// Checks a torrent piece against its v2 tree as the piece's data streams in,
+// hashing each 16 KiB block once instead of holding on to the whole piece.
+class tr_merkle_piece_checker
+{
+public:
+    // Start checking `piece`. Pieces with no v2 tree always pass.
+    void start(tr_merkle_pieces const& pieces, tr_piece_index_t piece);
+
+    // Add the piece's next `data_len` bytes. Padding after the file's end is ignored.
+    void add(void const* data, size_t data_len);
+
+    // @return true if the piece has no v2 tree or all its data matched the tree
+    [[nodiscard]] bool finish();
+
+private:
+    std::optional<tr_merkle_pieces::FilePiece> file_piece_;
+    std::vector<tr_sha256_digest_t> block_hashes_;
+    std::optional<tr_sha256> sha_; // only set up for v2 pieces
+    size_t n_left_ = {}; // how many of the file's bytes are still to come
+    size_t n_in_block_ = {}; // how many bytes of the current block are in `sha_`
+};
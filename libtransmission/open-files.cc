@@ -3,12 +3,18 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
-#include <algorithm> // std::min
+#include <algorithm> // std::clamp, std::max, std::min
 #include <array>
-#include <cstdint> // uint8_t, uint64_t
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint64_t, SIZE_MAX
+#include <memory>
 #include <string_view>
 #include <utility>
 
+#ifndef _WIN32
+#include <sys/resource.h> // getrlimit()
+#endif
+
 #include <fmt/format.h>
 
 #include "libtransmission/error-types.h"
@@ -117,10 +123,58 @@ bool preallocate_file_full(tr_sys_file_t fd, uint64_t length, tr_error* error)
     return false;
 }
 
+[[nodiscard]] std::shared_ptr<tr_sys_file_t const> make_shared_fd(tr_sys_file_t const fd)
+{
+    return { new tr_sys_file_t{ fd },
+             [](tr_sys_file_t const* pfd)
+             {
+                 tr_sys_file_close(*pfd);
+                 delete pfd;
+             } };
+}
+
+// Keep at least this many files open, no matter what the limit is.
+auto constexpr MinLimit = size_t{ 8U };
+
+// How many files we can keep open without starving the rest of
+// the process -- peer sockets, DNS, RPC -- of file descriptors.
+[[nodiscard]] size_t max_limit()
+{
+#ifndef _WIN32
+    if (auto rlim = rlimit{}; getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY)
+    {
+        return std::max(static_cast<size_t>(rlim.rlim_cur / 2U), MinLimit);
+    }
+#endif
+
+    return SIZE_MAX;
+}
+
+[[nodiscard]] size_t clamp_limit(size_t const limit)
+{
+    return std::clamp(limit, MinLimit, std::max(max_limit(), MinLimit));
+}
+
 } // unnamed namespace
 
 // ---
 
+tr_open_files::tr_open_files(size_t const limit)
+    : pool_{ clamp_limit(limit) }
+{
+}
+
+void tr_open_files::set_limit(size_t const limit)
+{
+    auto const clamped = clamp_limit(limit);
+    if (clamped < limit)
+    {
+        tr_logAddDebug(fmt::format("Limiting open files to {} instead of {} to leave room for sockets", clamped, limit));
+    }
+
+    pool_.set_capacity(clamped);
+}
+
 std::optional<tr_sys_file_t> tr_open_files::get(tr_torrent_id_t tor_id, tr_file_index_t file_num, bool writable)
 {
     if (auto* const found = pool_.get(make_key(tor_id, file_num)); found != nullptr)
@@ -130,6 +184,23 @@ std::optional<tr_sys_file_t> tr_open_files::get(tr_torrent_id_t tor_id, tr_file_
             return {};
         }
 
+        ++hits_;
+        return *found->fd_;
+    }
+
+    return {};
+}
+
+std::shared_ptr<tr_sys_file_t const> tr_open_files::get_shared(tr_torrent_id_t tor_id, tr_file_index_t file_num, bool writable)
+{
+    if (auto* const found = pool_.get(make_key(tor_id, file_num)); found != nullptr)
+    {
+        if (writable && !found->writable_)
+        {
+            return {};
+        }
+
+        ++hits_;
         return found->fd_;
     }
 
@@ -150,12 +221,15 @@ std::optional<tr_sys_file_t> tr_open_files::get(
     {
         if (!writable || found->writable_)
         {
-            return found->fd_;
+            ++hits_;
+            return *found->fd_;
         }
 
         pool_.erase(key); // close so we can re-open as writable
     }
 
+    ++misses_;
+
     // create subfolders, if any
     auto error = tr_error{};
     if (writable)
@@ -246,7 +320,7 @@ std::optional<tr_sys_file_t> tr_open_files::get(
 
     // cache it
     auto& entry = pool_.add(std::move(key));
-    entry.fd_ = fd;
+    entry.fd_ = make_shared_fd(fd);
     entry.writable_ = writable;
 
     return fd;
@@ -266,11 +340,3 @@ void tr_open_files::close_file(tr_torrent_id_t tor_id, tr_file_index_t file_num)
 {
     pool_.erase(make_key(tor_id, file_num));
 }
-
-tr_open_files::Val::~Val()
-{
-    if (is_open(fd_))
-    {
-        tr_sys_file_close(fd_);
-    }
-}
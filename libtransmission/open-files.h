@@ -11,6 +11,7 @@
 
 #include <cstddef> // for size_t
 #include <cstdint> // for uintX_t
+#include <memory> // std::shared_ptr
 #include <optional>
 #include <string_view>
 #include <utility>
@@ -30,6 +31,17 @@ public:
         Full
     };
 
+    struct Stats
+    {
+        uint64_t hits = 0U; // a cached fd was reused
+        uint64_t misses = 0U; // a file had to be opened
+        uint64_t evictions = 0U; // a file was closed to make room for another
+    };
+
+    static auto constexpr DefaultLimit = size_t{ 512U };
+
+    explicit tr_open_files(size_t limit = DefaultLimit);
+
     [[nodiscard]] std::optional<tr_sys_file_t> get(tr_torrent_id_t tor_id, tr_file_index_t file_num, bool writable);
 
     [[nodiscard]] std::optional<tr_sys_file_t> get(
@@ -40,10 +52,38 @@ public:
         Preallocation allocation,
         uint64_t file_size);
 
+    // Like get(), but for a file that's already open. The caller shares the fd,
+    // which stays open for as long as the caller holds on to it, even if the pool
+    // closes the file in the meantime. Used to send piece data with sendfile(),
+    // and to lend files to the tr_disk_io threads.
+    [[nodiscard]] std::shared_ptr<tr_sys_file_t const> get_shared(
+        tr_torrent_id_t tor_id,
+        tr_file_index_t file_num,
+        bool writable = false);
+
     void close_all();
     void close_torrent(tr_torrent_id_t tor_id);
     void close_file(tr_torrent_id_t tor_id, tr_file_index_t file_num);
 
+    // Set how many files may be kept open at once. This is capped to
+    // leave room in the process' RLIMIT_NOFILE for sockets and the like.
+    void set_limit(size_t limit);
+
+    [[nodiscard]] auto limit() const noexcept
+    {
+        return pool_.capacity();
+    }
+
+    [[nodiscard]] auto size() const noexcept
+    {
+        return pool_.size();
+    }
+
+    [[nodiscard]] Stats stats() const noexcept
+    {
+        return { hits_, misses_, pool_.evictions() };
+    }
+
 private:
     using Key = std::pair<tr_torrent_id_t, tr_file_index_t>;
 
@@ -54,25 +94,12 @@ private:
 
     struct Val
     {
-        Val() noexcept = default;
-        Val(Val const&) = delete;
-        Val& operator=(Val const&) = delete;
-        Val(Val&& that) noexcept
-        {
-            *this = std::move(that);
-        }
-        Val& operator=(Val&& that) noexcept
-        {
-            std::swap(this->fd_, that.fd_);
-            std::swap(this->writable_, that.writable_);
-            return *this;
-        }
-        ~Val();
-
-        tr_sys_file_t fd_ = TR_BAD_SYS_FILE;
+        // closed when the last user lets go of it
+        std::shared_ptr<tr_sys_file_t const> fd_;
         bool writable_ = false;
     };
 
-    static constexpr size_t MaxOpenFiles = 32U;
-    tr_lru_cache<Key, Val, MaxOpenFiles> pool_;
+    tr_lru_cache<Key, Val, tr_torrent_item_hash> pool_;
+    uint64_t hits_ = 0U;
+    uint64_t misses_ = 0U;
 };
@@ -66,7 +66,7 @@ public:
 
     Type type = Type::Error;
 
-    tr_bitfield* bitfield = nullptr; // for GotBitfield
+    tr_bitfield const* old_have = nullptr; // for GotBitfield, GotHaveAll, GotHaveNone: what the peer had before
     uint32_t pieceIndex = 0; // for GotBlock, GotHave, Cancel, Allowed, Suggest
     uint32_t offset = 0; // for GotBlock
     uint32_t length = 0; // for GotBlock, GotPieceData
@@ -88,11 +88,11 @@ public:
         return event;
     }
 
-    [[nodiscard]] constexpr static auto GotBitfield(tr_bitfield* bitfield) noexcept
+    [[nodiscard]] constexpr static auto GotBitfield(tr_bitfield const& old_have) noexcept
     {
         auto event = tr_peer_event{};
         event.type = Type::ClientGotBitfield;
-        event.bitfield = bitfield;
+        event.old_have = &old_have;
         return event;
     }
 
@@ -119,17 +119,19 @@ public:
         return event;
     }
 
-    [[nodiscard]] constexpr static auto GotHaveAll() noexcept
+    [[nodiscard]] constexpr static auto GotHaveAll(tr_bitfield const& old_have) noexcept
     {
         auto event = tr_peer_event{};
         event.type = Type::ClientGotHaveAll;
+        event.old_have = &old_have;
         return event;
     }
 
-    [[nodiscard]] constexpr static auto GotHaveNone() noexcept
+    [[nodiscard]] constexpr static auto GotHaveNone(tr_bitfield const& old_have) noexcept
     {
         auto event = tr_peer_event{};
         event.type = Type::ClientGotHaveNone;
+        event.old_have = &old_have;
         return event;
     }
 
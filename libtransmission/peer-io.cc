@@ -6,7 +6,9 @@
 #include <cerrno>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <type_traits> // std::underlying_type_t
+#include <utility> // std::move
 
 #ifdef _WIN32
 #include <ws2tcpip.h>
@@ -25,6 +27,7 @@
 #include "libtransmission/bandwidth.h"
 #include "libtransmission/block-info.h" // tr_block_info
 #include "libtransmission/error.h"
+#include "libtransmission/file.h"
 #include "libtransmission/log.h"
 #include "libtransmission/net.h"
 #include "libtransmission/peer-io.h"
@@ -192,23 +195,18 @@ void tr_peerIo::set_socket(tr_peer_socket socket_in)
     close(); // tear down the previous socket, if any
 
     socket_ = std::move(socket_in);
+    edge_triggered_ = false;
 
     if (socket_.is_tcp())
     {
+        auto* const base = session_->event_base();
+        edge_triggered_ = (event_base_get_features(base) & EV_FEATURE_ET) != 0;
+        short const flags = edge_triggered_ ? EV_ET | EV_PERSIST : 0;
+
         event_read_.reset(
-            tr::evhelpers::event_new_pri2(
-                session_->event_base(),
-                socket_.handle.tcp,
-                EV_READ,
-                &tr_peerIo::event_read_cb,
-                this));
+            tr::evhelpers::event_new_pri2(base, socket_.handle.tcp, EV_READ | flags, &tr_peerIo::event_read_cb, this));
         event_write_.reset(
-            tr::evhelpers::event_new_pri2(
-                session_->event_base(),
-                socket_.handle.tcp,
-                EV_WRITE,
-                &tr_peerIo::event_write_cb,
-                this));
+            tr::evhelpers::event_new_pri2(base, socket_.handle.tcp, EV_WRITE | flags, &tr_peerIo::event_write_cb, this));
     }
 #ifdef WITH_UTP
     else if (socket_.is_utp())
@@ -230,6 +228,8 @@ void tr_peerIo::close()
     inbuf_.clear();
     outbuf_.clear();
     outbuf_info_.clear();
+    outfiles_.clear();
+    outfile_bytes_ = 0U;
     encrypt_disable();
     decrypt_disable();
 }
@@ -303,6 +303,53 @@ void tr_peerIo::did_write_wrapper(size_t bytes_transferred)
     }
 }
 
+size_t tr_peerIo::write_some(size_t max, tr_error& error)
+{
+    auto n_written = size_t{};
+
+    while (n_written < max && !error)
+    {
+        if (std::empty(outfiles_))
+        {
+            return n_written + socket_.try_write(outbuf_, max - n_written, &error);
+        }
+
+        auto& outfile = outfiles_.front();
+        auto wanted = size_t{};
+        auto n = size_t{};
+
+        if (outfile.n_outbuf_bytes_before > 0U)
+        {
+            // send what was queued in `outbuf_` ahead of this file's data
+            wanted = std::min(max - n_written, outfile.n_outbuf_bytes_before);
+            n = socket_.try_write(outbuf_, wanted, &error);
+            outfile.n_outbuf_bytes_before -= n;
+        }
+        else
+        {
+            wanted = std::min(max - n_written, outfile.n_bytes);
+            n = socket_.try_send_file(*outfile.file, outfile.offset, wanted, &error);
+            outfile.offset += n;
+            outfile.n_bytes -= n;
+            outfile_bytes_ -= n;
+
+            if (outfile.n_bytes == 0U)
+            {
+                outfiles_.pop_front();
+            }
+        }
+
+        n_written += n;
+
+        if (n < wanted)
+        {
+            break; // the socket's send buffer is full
+        }
+    }
+
+    return n_written;
+}
+
 size_t tr_peerIo::try_write(size_t max)
 {
     static auto constexpr Dir = tr_direction::Up;
@@ -312,32 +359,54 @@ size_t tr_peerIo::try_write(size_t max)
         return {};
     }
 
-    auto& buf = outbuf_;
-    max = std::min(max, std::size(buf));
-    max = bandwidth().clamp(Dir, max);
+    auto const wanted = std::min(max, write_buffer_size());
+    max = bandwidth().clamp(Dir, wanted);
+    if (max < wanted)
+    {
+        // get in line for more bandwidth
+        bandwidth().set_pending(Dir);
+    }
+
     if (max == 0U)
     {
         set_enabled(Dir, false);
         return {};
     }
 
+    // With edge-triggered events, we won't hear about the socket again
+    // until it's gone from unwritable to writable, so keep going until
+    // either we've written `max` or the socket would block.
     auto error = tr_error{};
-    auto const n_written = socket_.try_write(buf, max, &error);
-    // enable further writes if there's more data to write
-    set_enabled(Dir, !std::empty(buf) && (!error || can_retry_from_error(error.code())));
-
-    if (error)
+    auto n_written = size_t{};
+    for (;;)
     {
-        if (!can_retry_from_error(error.code()))
+        auto const n = write_some(max - n_written, error);
+        n_written += n;
+
+        if (!edge_triggered_ || error || n == 0U || n_written == max)
         {
-            tr_logAddTraceIo(
-                this,
-                fmt::format("try_write err: wrote:{}, errno:{} ({})", n_written, error.code(), error.message()));
-            call_error_callback(error);
+            break;
         }
     }
+
+    // enable further writes if there's more data to write
+    set_enabled(Dir, write_buffer_size() != 0U && (!error || can_retry_from_error(error.code())));
+
+    if (edge_triggered_ && !error && n_written == wanted && write_buffer_size() != 0U)
+    {
+        // the socket is still writable, so there won't be another edge.
+        // Come back for the rest on the next event loop iteration.
+        event_active(event_write_.get(), EV_WRITE, 0);
+    }
+
+    if (error && !can_retry_from_error(error.code()))
+    {
+        tr_logAddTraceIo(this, fmt::format("try_write err: wrote:{}, errno:{} ({})", n_written, error.code(), error.message()));
+        call_error_callback(error);
+    }
     else if (n_written > 0U)
     {
+        // n.b. this includes what was written before the socket said EAGAIN
         did_write_wrapper(n_written);
     }
 
@@ -352,7 +421,11 @@ void tr_peerIo::event_write_cb([[maybe_unused]] evutil_socket_t fd, short /*even
     TR_ASSERT(io->socket_.is_tcp());
     TR_ASSERT(io->socket_.handle.tcp == fd);
 
-    io->pending_events_ &= ~EV_WRITE;
+    if (!io->edge_triggered_)
+    {
+        // one-shot events need to be re-armed after they fire
+        io->pending_events_ &= ~EV_WRITE;
+    }
 
     // Write as much as possible. Since the socket is non-blocking,
     // write() will return if it can't write any more without blocking
@@ -426,6 +499,13 @@ void tr_peerIo::can_read_wrapper(size_t bytes_transferred)
             break;
         }
     }
+
+    // If we stopped because the bandwidth ran out rather than the data,
+    // get in line for more so that what's buffered isn't left stranded.
+    if (!done && !err)
+    {
+        bandwidth().set_pending(tr_direction::Down);
+    }
 }
 
 size_t tr_peerIo::try_read(size_t max)
@@ -437,28 +517,53 @@ size_t tr_peerIo::try_read(size_t max)
         return {};
     }
 
-    // Do not write more than the bandwidth allows.
-    // If there is no bandwidth left available, disable writes.
-    max = bandwidth().clamp(Dir, max);
+    // Do not read more than the bandwidth allows.
+    // If there is no bandwidth left available, disable reads
+    // and get in line for more.
+    auto const wanted = max;
+    max = bandwidth().clamp(Dir, wanted);
+    if (max < wanted)
+    {
+        bandwidth().set_pending(Dir);
+    }
+
     if (max == 0U)
     {
         set_enabled(Dir, false);
         return {};
     }
 
+    // With edge-triggered events, we won't hear about the socket again
+    // until more data arrives, so keep going until either we've read
+    // `max` or the socket would block.
     auto& buf = inbuf_;
     auto error = tr_error{};
-    auto const n_read = socket_.try_read(buf, max, std::empty(buf), &error);
-    set_enabled(Dir, !error || can_retry_from_error(error.code()));
-
-    if (error)
+    auto n_read = size_t{};
+    for (;;)
     {
-        if (!can_retry_from_error(error.code()))
+        auto const n = socket_.try_read(buf, max - n_read, std::empty(buf), &error);
+        n_read += n;
+
+        if (!edge_triggered_ || error || n == 0U || n_read == max)
         {
-            tr_logAddTraceIo(this, fmt::format("try_read err: n_read:{} errno:{} ({})", n_read, error.code(), error.message()));
-            call_error_callback(error);
+            break;
         }
     }
+
+    set_enabled(Dir, !error || can_retry_from_error(error.code()));
+
+    if (edge_triggered_ && !error && n_read == wanted)
+    {
+        // there may be more waiting, and it won't trigger another edge.
+        // Come back for the rest on the next event loop iteration.
+        event_active(event_read_.get(), EV_READ, 0);
+    }
+
+    if (error && !can_retry_from_error(error.code()))
+    {
+        tr_logAddTraceIo(this, fmt::format("try_read err: n_read:{} errno:{} ({})", n_read, error.code(), error.message()));
+        call_error_callback(error);
+    }
     else if (!std::empty(buf))
     {
         can_read_wrapper(n_read);
@@ -477,11 +582,22 @@ void tr_peerIo::event_read_cb([[maybe_unused]] evutil_socket_t fd, short /*event
     TR_ASSERT(io->socket_.is_tcp());
     TR_ASSERT(io->socket_.handle.tcp == fd);
 
-    io->pending_events_ &= ~EV_READ;
+    if (!io->edge_triggered_)
+    {
+        // one-shot events need to be re-armed after they fire
+        io->pending_events_ &= ~EV_READ;
+    }
 
-    // if we don't have any bandwidth left, stop reading
+    // if the read buffer is full, stop reading until the next bandwidth pulse
     auto const n_used = std::size(io->inbuf_);
     auto const n_left = n_used >= MaxLen ? 0U : MaxLen - n_used;
+    if (n_left == 0U)
+    {
+        io->set_enabled(tr_direction::Down, false);
+        io->bandwidth().set_pending(tr_direction::Down);
+        return;
+    }
+
     io->try_read(n_left);
 }
 
@@ -605,12 +721,35 @@ void tr_peerIo::write_bytes(void const* bytes, size_t n_bytes, bool is_piece_dat
     flush_outbuf_soon();
 }
 
+void tr_peerIo::write_file(SendFile file, uint64_t const offset, size_t const n_bytes)
+{
+    TR_ASSERT(can_write_file());
+
+    if (n_bytes == 0U)
+    {
+        return;
+    }
+
+    outbuf_info_.emplace_back(n_bytes, true);
+
+    auto n_outbuf_bytes_before = std::size(outbuf_);
+    for (auto const& outfile : outfiles_)
+    {
+        n_outbuf_bytes_before -= outfile.n_outbuf_bytes_before;
+    }
+
+    outfiles_.emplace_back(OutFile{ std::move(file), offset, n_bytes, n_outbuf_bytes_before });
+    outfile_bytes_ += n_bytes;
+
+    flush_outbuf_soon();
+}
+
 // ---
 
 size_t tr_peerIo::get_write_buffer_space(uint64_t now) const noexcept
 {
     size_t const desired_len = get_desired_output_buffer_size(this, now);
-    size_t const current_len = std::size(outbuf_);
+    size_t const current_len = write_buffer_size();
     return desired_len > current_len ? desired_len - current_len : 0U;
 }
 
@@ -21,6 +21,7 @@
 
 #include "libtransmission/bandwidth.h"
 #include "libtransmission/block-info.h"
+#include "libtransmission/file.h" // tr_sys_file_t
 #include "libtransmission/peer-mse.h"
 #include "libtransmission/peer-socket.h"
 #include "libtransmission/tr-buffer.h"
@@ -154,6 +155,22 @@ public:
         buf.drain(n_bytes);
     }
 
+    // An open data file that write_file() can send piece data from.
+    // It's shared so that it stays open until everything queued from it is sent.
+    using SendFile = std::shared_ptr<tr_sys_file_t const>;
+
+    // Whether write_file() can be used on this connection. The data would
+    // skip our encryption filter, so this is only for unencrypted TCP.
+    [[nodiscard]] bool can_write_file() const noexcept
+    {
+        return !filter_.is_active() && socket_.can_send_file();
+    }
+
+    // Queue `n_bytes` of piece data from `file`, starting at `offset`.
+    // It's sent in order with the rest of the output buffer, but goes
+    // straight from the file to the socket without a copy in user space.
+    void write_file(SendFile file, uint64_t offset, size_t n_bytes);
+
     size_t flush_outgoing_protocol_msgs();
 
     size_t flush(tr_direction dir, size_t byte_limit)
@@ -361,6 +378,12 @@ private:
 
     size_t try_read(size_t max);
     size_t try_write(size_t max);
+    size_t write_some(size_t max, tr_error& error);
+
+    [[nodiscard]] size_t write_buffer_size() const noexcept
+    {
+        return std::size(outbuf_) + outfile_bytes_;
+    }
 
     // this is only public for testing purposes.
     // production code should use new_outgoing() or new_incoming()
@@ -386,6 +409,20 @@ private:
     PeerBuffer inbuf_;
     PeerBuffer outbuf_;
 
+    // Piece data that's sent straight from a file instead of from `outbuf_`.
+    struct OutFile
+    {
+        SendFile file;
+        uint64_t offset = {};
+        size_t n_bytes = {};
+
+        // how much of `outbuf_` is queued between the previous OutFile and this one
+        size_t n_outbuf_bytes_before = {};
+    };
+
+    std::deque<OutFile> outfiles_;
+    size_t outfile_bytes_ = {};
+
     tr_session* const session_;
 
     CanRead can_read_ = nullptr;
@@ -400,6 +437,11 @@ private:
 
     short int pending_events_ = 0;
 
+    // When the event backend supports it (e.g. epoll, kqueue), TCP sockets
+    // use persistent edge-triggered events so that they don't need to be
+    // re-armed after every read or write. Otherwise they use one-shot events.
+    bool edge_triggered_ = false;
+
     tr_priority_t priority_ = TR_PRI_NORMAL;
 
     bool const client_is_seed_;
@@ -0,0 +1,162 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef LIBTRANSMISSION_PEER_MODULE
+#error only the libtransmission peer module should #include this header.
+#endif
+
+#include <array>
+#include <cstdint> // uint64_t
+#include <iterator> // std::cbegin, std::cend
+#include <vector>
+
+#include "libtransmission/bitfield.h"
+#include "libtransmission/torrent.h"
+#include "libtransmission/types.h"
+
+// The swarms that the peer manager's periodic pulses visit.
+// Only swarms with connected peers are listed, so that thousands
+// of idle torrents cost next to nothing.
+//
+// `Swarm` has a range of `peers` and an `is_listed_as_having_peers`
+// flag that this list owns, e.g. tr_swarm.
+template<typename Swarm>
+class tr_swarms_with_peers
+{
+public:
+    void on_got_peer(Swarm* const swarm)
+    {
+        if (!swarm->is_listed_as_having_peers)
+        {
+            swarm->is_listed_as_having_peers = true;
+            swarms_.emplace_back(swarm);
+        }
+    }
+
+    void on_doomed(Swarm* const swarm)
+    {
+        std::erase(swarms_, swarm);
+    }
+
+    // stop visiting swarms that don't have any peers left
+    void prune()
+    {
+        std::erase_if(
+            swarms_,
+            [](Swarm* const swarm)
+            {
+                swarm->is_listed_as_having_peers = !std::empty(swarm->peers);
+                return !swarm->is_listed_as_having_peers;
+            });
+    }
+
+    [[nodiscard]] constexpr std::vector<Swarm*> const& get() const noexcept
+    {
+        return swarms_;
+    }
+
+    [[nodiscard]] auto begin() const noexcept
+    {
+        return std::cbegin(swarms_);
+    }
+
+    [[nodiscard]] auto end() const noexcept
+    {
+        return std::cend(swarms_);
+    }
+
+private:
+    std::vector<Swarm*> swarms_;
+};
+
+// The peers we might try connecting to in the next few seconds.
+// Building the list means scanning every swarm, so it's cached across
+// pulses. It's rebuilt when something changes that may give us new
+// peers to connect to, or when its TTL is up.
+template<typename Candidates>
+class tr_outbound_candidates
+{
+public:
+    explicit constexpr tr_outbound_candidates(uint64_t const ttl_msec) noexcept
+        : ttl_msec_{ ttl_msec }
+    {
+    }
+
+    // e.g. we learned about new peers or a torrent was started
+    constexpr void mark_dirty() noexcept
+    {
+        dirty_ = true;
+    }
+
+    // `rebuild` is a `void(Candidates&)` that refills the list
+    template<typename Rebuild>
+    [[nodiscard]] Candidates& get(uint64_t const now_msec, Rebuild&& rebuild)
+    {
+        if (dirty_ || now_msec >= expires_msec_)
+        {
+            candidates_.clear();
+            rebuild(candidates_);
+            dirty_ = false;
+            expires_msec_ = now_msec + ttl_msec_;
+        }
+
+        return candidates_;
+    }
+
+private:
+    Candidates candidates_;
+    uint64_t const ttl_msec_;
+    uint64_t expires_msec_ = 0U;
+    bool dirty_ = true;
+};
+
+// The pieces that we want and don't have yet, cached for updateInterest().
+// It's rebuilt after anything that changes which pieces we want or have.
+class tr_interesting_pieces
+{
+public:
+    explicit tr_interesting_pieces(tr_torrent& tor)
+        : tor_{ tor }
+        , tags_{ {
+              tor.files_wanted_changed_.connect_scoped([this](tr_torrent*, tr_file_index_t const*, tr_file_index_t, bool)
+                                                       { mark_dirty(); }),
+              tor.got_bad_piece_.connect_scoped([this](tr_torrent*, tr_piece_index_t) { mark_dirty(); }),
+              tor.got_metainfo_.connect_scoped([this](tr_torrent*) { mark_dirty(); }),
+              tor.piece_completed_.connect_scoped([this](tr_torrent*, tr_piece_index_t) { mark_dirty(); }),
+              // e.g. a verify may have changed what we have
+              tor.started_.connect_scoped([this](tr_torrent*) { mark_dirty(); }),
+          } }
+    {
+    }
+
+    constexpr void mark_dirty() noexcept
+    {
+        dirty_ = true;
+    }
+
+    [[nodiscard]] tr_bitfield const& get()
+    {
+        if (dirty_)
+        {
+            auto const n = tor_.piece_count();
+            pieces_ = tr_bitfield{ n };
+            for (tr_piece_index_t i = 0U; i < n; ++i)
+            {
+                pieces_.set(i, tor_.piece_is_wanted(i) && !tor_.has_piece(i));
+            }
+            dirty_ = false;
+        }
+
+        return pieces_;
+    }
+
+private:
+    tr_torrent const& tor_;
+    tr_bitfield pieces_{ 0U };
+    bool dirty_ = true;
+    std::array<sigslot::scoped_connection, 5U> tags_;
+};
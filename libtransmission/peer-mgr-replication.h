@@ -0,0 +1,143 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef LIBTRANSMISSION_PEER_MODULE
+#error only the libtransmission peer module should #include this header.
+#endif
+
+#include <algorithm> // std::min
+#include <cstddef> // size_t
+#include <cstdint> // uint16_t
+#include <vector>
+
+#include "libtransmission/bitfield.h"
+#include "libtransmission/types.h"
+
+// Counts how many connected peers have each piece. This is kept up to
+// date as peers come and go and tell us what they have, so that
+// availability lookups don't need to walk every peer's bitfield.
+//
+// Peers whose bitfield says "have all" are tallied separately so that
+// seeds connecting and disconnecting don't touch every piece's count.
+class tr_piece_replication
+{
+public:
+    // `peers` is a range of pointers to objects with a `has()` bitfield, e.g. tr_peerMsgs
+    template<typename Peers>
+    void rebuild(tr_piece_index_t const n_pieces, Peers const& peers)
+    {
+        counts_.assign(n_pieces, 0U);
+        n_have_all_ = 0U;
+
+        for (auto const& peer : peers)
+        {
+            add(peer->has());
+        }
+    }
+
+    [[nodiscard]] size_t count(tr_piece_index_t const piece) const noexcept
+    {
+        return n_have_all_ + (piece < std::size(counts_) ? counts_[piece] : 0U);
+    }
+
+    [[nodiscard]] constexpr bool any_peer_has_all() const noexcept
+    {
+        return n_have_all_ > 0U;
+    }
+
+    void add(tr_bitfield const& have)
+    {
+        update(have, true);
+    }
+
+    void remove(tr_bitfield const& have)
+    {
+        update(have, false);
+    }
+
+    // A peer's BITFIELD, HAVE_ALL or HAVE_NONE replaces whatever it said it had before.
+    void replace(tr_bitfield const& old_have, tr_bitfield const& new_have)
+    {
+        remove(old_have);
+        add(new_have);
+    }
+
+    // `have` is the peer's bitfield after it got `piece`
+    void add_piece(tr_piece_index_t const piece, tr_bitfield const& have)
+    {
+        if (!have.has_all())
+        {
+            if (piece < std::size(counts_))
+            {
+                ++counts_[piece];
+            }
+
+            return;
+        }
+
+        // That was the peer's last missing piece, so move it from
+        // the per-piece counts to the "have all" count.
+        for (tr_piece_index_t i = 0U, n = std::size(counts_); i < n; ++i)
+        {
+            if (i != piece)
+            {
+                dec(counts_[i]);
+            }
+        }
+
+        ++n_have_all_;
+    }
+
+private:
+    void update(tr_bitfield const& have, bool const add)
+    {
+        if (have.has_none())
+        {
+            return;
+        }
+
+        if (have.has_all())
+        {
+            inc_or_dec(n_have_all_, add);
+            return;
+        }
+
+        for (tr_piece_index_t i = 0U, n = std::min(std::size(counts_), std::size(have)); i < n; ++i)
+        {
+            if (have.test(i))
+            {
+                inc_or_dec(counts_[i], add);
+            }
+        }
+    }
+
+    template<typename T>
+    static constexpr void inc_or_dec(T& count, bool const inc) noexcept
+    {
+        if (inc)
+        {
+            ++count;
+        }
+        else
+        {
+            dec(count);
+        }
+    }
+
+    // never let these wrap around
+    template<typename T>
+    static constexpr void dec(T& count) noexcept
+    {
+        if (count > 0U)
+        {
+            --count;
+        }
+    }
+
+    std::vector<uint16_t> counts_;
+    size_t n_have_all_ = 0U;
+};
@@ -3,10 +3,11 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
-#include <algorithm> // std::adjacent_find, std::sort
+#include <algorithm> // std::adjacent_find, std::inplace_merge, std::sort, std::stable_partition
 #include <array>
 #include <cstddef>
 #include <functional>
+#include <limits>
 #include <ranges>
 #include <utility>
 #include <vector>
@@ -186,17 +187,40 @@ public:
         recalculate_salt();
     }
 
+    [[nodiscard]] std::vector<tr_block_span_t> next(size_t const n_wanted_blocks, tr_bitfield const& peer_has)
+    {
+        // Skip walking the candidates if the peer has none of the pieces
+        // that still have blocks to request. This is checked a word at a time.
+        if (peer_has.has_none() || (!peer_has.has_all() && !requestable_.intersects(peer_has)))
+        {
+            return {};
+        }
+
+        if (peer_has.has_all())
+        {
+            return next_impl(n_wanted_blocks, [](tr_piece_index_t) { return true; });
+        }
+
+        return next_impl(n_wanted_blocks, [&peer_has](tr_piece_index_t const piece) { return peer_has.test(piece); });
+    }
+
     [[nodiscard]] std::vector<tr_block_span_t> next(
-        size_t n_wanted_blocks,
-        std::function<bool(tr_piece_index_t)> const& peer_has_piece);
+        size_t const n_wanted_blocks,
+        std::function<bool(tr_piece_index_t)> const& peer_has_piece)
+    {
+        return next_impl(n_wanted_blocks, peer_has_piece);
+    }
 
 private:
+    template<typename PeerHasPiece>
+    [[nodiscard]] std::vector<tr_block_span_t> next_impl(size_t n_wanted_blocks, PeerHasPiece const& peer_has_piece);
+
     constexpr void dec_replication() noexcept
     {
         std::ranges::for_each(candidates_, [](Candidate& candidate) { --candidate.replication; });
     }
 
-    constexpr void dec_replication_bitfield(tr_bitfield const& bitfield)
+    void dec_replication_bitfield(tr_bitfield const& bitfield)
     {
         if (bitfield.has_none())
         {
@@ -209,15 +233,9 @@ private:
             return;
         }
 
-        for (auto& candidate : candidates_)
-        {
-            if (bitfield.test(candidate.piece))
-            {
-                --candidate.replication;
-            }
-        }
-
-        std::sort(std::begin(candidates_), std::end(candidates_));
+        update_candidates(
+            [&bitfield](Candidate const& candidate) { return bitfield.test(candidate.piece); },
+            [](Candidate& candidate) { --candidate.replication; });
     }
 
     constexpr void inc_replication() noexcept
@@ -238,18 +256,12 @@ private:
             return;
         }
 
-        for (auto& candidate : candidates_)
-        {
-            if (bitfield.test(candidate.piece))
-            {
-                ++candidate.replication;
-            }
-        }
-
-        std::sort(std::begin(candidates_), std::end(candidates_));
+        update_candidates(
+            [&bitfield](Candidate const& candidate) { return bitfield.test(candidate.piece); },
+            [](Candidate& candidate) { ++candidate.replication; });
     }
 
-    constexpr void inc_replication_piece(tr_piece_index_t const piece)
+    void inc_replication_piece(tr_piece_index_t const piece)
     {
         if (auto iter = find_by_piece(piece); iter != std::end(candidates_))
         {
@@ -260,7 +272,7 @@ private:
 
     // ---
 
-    constexpr void requested_block_span(tr_block_span_t const block_span)
+    void requested_block_span(tr_block_span_t const block_span)
     {
         for (auto block = block_span.begin; block < block_span.end;)
         {
@@ -287,7 +299,7 @@ private:
         }
     }
 
-    constexpr void reset_block(tr_block_index_t block)
+    void reset_block(tr_block_index_t block)
     {
         if (auto it_p = find_by_block(block); it_p != std::end(candidates_))
         {
@@ -296,31 +308,34 @@ private:
         }
     }
 
-    TR_CONSTEXPR_VEC void reset_blocks_bitfield(tr_bitfield const& requests)
+    void reset_blocks_bitfield(tr_bitfield const& requests)
     {
-        for (auto& candidate : candidates_)
+        if (requests.has_none())
         {
-            auto const [begin, end] = candidate.block_span;
-            if (requests.count(begin, end) == 0U)
-            {
-                continue;
-            }
+            return;
+        }
 
-            for (auto i = end; i > begin; --i)
+        update_candidates(
+            [&requests](Candidate const& candidate)
+            {
+                auto const [begin, end] = candidate.block_span;
+                return requests.count(begin, end) != 0U;
+            },
+            [&requests](Candidate& candidate)
             {
-                if (auto const block = i - 1U; requests.test(block))
+                for (auto [begin, i] = candidate.block_span; i > begin; --i)
                 {
-                    candidate.unrequested.insert(block);
+                    if (auto const block = i - 1U; requests.test(block))
+                    {
+                        candidate.unrequested.insert(block);
+                    }
                 }
-            }
-        }
-
-        std::sort(std::begin(candidates_), std::end(candidates_));
+            });
     }
 
     // ---
 
-    constexpr void client_got_block(tr_block_index_t block)
+    void client_got_block(tr_block_index_t block)
     {
         if (auto const iter = find_by_block(block); iter != std::end(candidates_))
         {
@@ -331,7 +346,7 @@ private:
 
     // ---
 
-    TR_CONSTEXPR_VEC void peer_disconnect(tr_bitfield const& have, tr_bitfield const& requests)
+    void peer_disconnect(tr_bitfield const& have, tr_bitfield const& requests)
     {
         dec_replication_bitfield(have);
         reset_blocks_bitfield(requests);
@@ -379,19 +394,40 @@ private:
             iter->unrequested.insert(i - 1U);
         }
 
-        std::sort(std::begin(candidates_), std::end(candidates_));
+        sort_candidates();
     }
 
     // ---
 
-    [[nodiscard]] constexpr CandidateVec::iterator find_by_piece(tr_piece_index_t const piece)
+    [[nodiscard]] CandidateVec::iterator find_by_piece(tr_piece_index_t const piece)
     {
-        return std::ranges::find_if(candidates_, [piece](auto const& c) { return c.piece == piece; });
+        if (piece >= std::size(pos_by_piece_) || pos_by_piece_[piece] == NoPos)
+        {
+            return std::end(candidates_);
+        }
+
+        return std::next(std::begin(candidates_), pos_by_piece_[piece]);
     }
 
-    [[nodiscard]] constexpr CandidateVec::iterator find_by_block(tr_block_index_t const block)
+    [[nodiscard]] CandidateVec::iterator find_by_block(tr_block_index_t const block)
     {
-        return std::ranges::find_if(candidates_, [block](auto const& c) { return c.block_belongs(block); });
+        // Find the first piece that ends after `block`. If `block` is that
+        // piece's last block, it may be shared with the next piece, so
+        // whichever of the two has it in its candidate block span owns it.
+        auto const pieces = std::views::iota(tr_piece_index_t{}, static_cast<tr_piece_index_t>(std::size(pos_by_piece_)));
+        auto const first = *std::ranges::partition_point(
+            pieces,
+            [this, block](tr_piece_index_t const piece) { return mediator_.block_span(piece).end <= block; });
+
+        for (auto piece = first; piece < first + 2U; ++piece)
+        {
+            if (auto const iter = find_by_piece(piece); iter != std::end(candidates_) && iter->block_belongs(block))
+            {
+                return iter;
+            }
+        }
+
+        return std::end(candidates_);
     }
 
     static constexpr tr_piece_index_t get_salt(
@@ -537,16 +573,21 @@ private:
             }
         }
 
-        std::sort(std::begin(candidates_), std::end(candidates_));
+        pos_by_piece_.assign(n_pieces, NoPos);
+        requestable_ = tr_bitfield{ n_pieces };
+        sort_candidates();
     }
 
     // ---
 
-    constexpr void remove_piece(tr_piece_index_t const piece)
+    void remove_piece(tr_piece_index_t const piece)
     {
         if (auto iter = find_by_piece(piece); iter != std::end(candidates_))
         {
-            candidates_.erase(iter);
+            pos_by_piece_[piece] = NoPos;
+            requestable_.unset(piece);
+            auto const next = candidates_.erase(iter);
+            reindex(next, std::end(candidates_));
         }
     }
 
@@ -563,7 +604,7 @@ private:
             candidate.salt = get_salt(candidate.piece, n_pieces, salter(), is_sequential, sequential_download_from_piece);
         }
 
-        std::sort(std::begin(candidates_), std::end(candidates_));
+        sort_candidates();
     }
 
     // ---
@@ -575,12 +616,12 @@ private:
             candidate.priority = mediator_.priority(candidate.piece);
         }
 
-        std::sort(std::begin(candidates_), std::end(candidates_));
+        sort_candidates();
     }
 
     // ---
 
-    constexpr void resort_piece(CandidateVec::iterator const& pos_old)
+    void resort_piece(CandidateVec::iterator const& pos_old)
     {
         auto const pos_begin = std::begin(candidates_);
 
@@ -589,17 +630,73 @@ private:
         {
             auto const pos_new = std::lower_bound(pos_begin, pos_old, *pos_old);
             std::rotate(pos_new, pos_old, pos_next);
+            reindex(pos_new, pos_next);
         }
         // Candidate needs to be moved towards the end of the list
         else if (auto const pos_end = std::end(candidates_); pos_next < pos_end && *pos_next < *pos_old)
         {
             auto const pos_new = std::lower_bound(pos_next, pos_end, *pos_old);
             std::rotate(pos_old, pos_next, pos_new);
+            reindex(pos_old, pos_new);
+        }
+        else
+        {
+            reindex(pos_old, pos_next);
+        }
+    }
+
+    void sort_candidates()
+    {
+        std::sort(std::begin(candidates_), std::end(candidates_));
+        reindex(std::begin(candidates_), std::end(candidates_));
+    }
+
+    // Apply `update` to the candidates that match `pred`, then put the list
+    // back in order. The candidates that didn't change are still in order,
+    // so only the changed ones need sorting before they're merged back in.
+    template<typename Pred, typename Update>
+    void update_candidates(Pred const& pred, Update const& update)
+    {
+        auto const begin = std::begin(candidates_);
+        auto const end = std::end(candidates_);
+        auto const mid = std::stable_partition(begin, end, [&pred](Candidate const& candidate) { return !pred(candidate); });
+        if (mid == end)
+        {
+            return;
+        }
+
+        std::for_each(mid, end, update);
+        if (!std::is_sorted(mid, end))
+        {
+            std::sort(mid, end);
+        }
+
+        std::inplace_merge(begin, mid, end);
+        reindex(begin, end);
+    }
+
+    // Update the lookup tables for the candidates in [first, last)
+    // after they've been added, changed, or moved.
+    void reindex(CandidateVec::iterator first, CandidateVec::iterator const last)
+    {
+        for (auto pos = static_cast<tr_piece_index_t>(std::distance(std::begin(candidates_), first)); first != last;
+             ++first, ++pos)
+        {
+            pos_by_piece_[first->piece] = pos;
+            requestable_.set(first->piece, !std::empty(first->unrequested));
         }
     }
 
+    static auto constexpr NoPos = std::numeric_limits<tr_piece_index_t>::max();
+
     CandidateVec candidates_;
 
+    // where each piece's candidate is in `candidates_`, or NoPos if it has none
+    std::vector<tr_piece_index_t> pos_by_piece_;
+
+    // the pieces whose candidates still have blocks that haven't been requested
+    tr_bitfield requestable_{ 0U };
+
     Mediator& mediator_;
 };
 
@@ -609,9 +706,8 @@ Wishlist::Impl::Impl(Mediator& mediator_in)
     candidate_list_upkeep();
 }
 
-std::vector<tr_block_span_t> Wishlist::Impl::next(
-    size_t const n_wanted_blocks,
-    std::function<bool(tr_piece_index_t)> const& peer_has_piece)
+template<typename PeerHasPiece>
+std::vector<tr_block_span_t> Wishlist::Impl::next_impl(size_t const n_wanted_blocks, PeerHasPiece const& peer_has_piece)
 {
     if (n_wanted_blocks == 0U)
     {
@@ -755,6 +851,11 @@ void Wishlist::on_sequential_download_from_piece_changed()
     impl_->on_sequential_download_from_piece_changed();
 }
 
+std::vector<tr_block_span_t> Wishlist::next(size_t const n_wanted_blocks, tr_bitfield const& peer_has)
+{
+    return impl_->next(n_wanted_blocks, peer_has);
+}
+
 std::vector<tr_block_span_t> Wishlist::next(
     size_t const n_wanted_blocks,
     std::function<bool(tr_piece_index_t)> const& peer_has_piece)
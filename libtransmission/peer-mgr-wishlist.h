@@ -58,6 +58,8 @@ public:
     void on_sequential_download_from_piece_changed();
 
     // the next blocks that we should request from a peer
+    [[nodiscard]] std::vector<tr_block_span_t> next(size_t n_wanted_blocks, tr_bitfield const& peer_has);
+
     [[nodiscard]] std::vector<tr_block_span_t> next(
         size_t n_wanted_blocks,
         std::function<bool(tr_piece_index_t)> const& peer_has_piece);
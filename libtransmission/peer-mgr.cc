@@ -38,6 +38,8 @@
 #include "libtransmission/net.h"
 #include "libtransmission/peer-common.h"
 #include "libtransmission/peer-io.h"
+#include "libtransmission/peer-mgr-caches.h"
+#include "libtransmission/peer-mgr-replication.h"
 #include "libtransmission/peer-mgr-wishlist.h"
 #include "libtransmission/peer-mgr.h"
 #include "libtransmission/peer-msgs.h"
@@ -408,9 +410,9 @@ public:
         {
         }
 
-        [[nodiscard]] auto next(size_t const n_wanted_blocks, std::function<bool(tr_piece_index_t)> const& peer_has_piece)
+        [[nodiscard]] auto next(size_t const n_wanted_blocks, tr_bitfield const& peer_has)
         {
-            return wishlist_.next(n_wanted_blocks, peer_has_piece);
+            return wishlist_.next(n_wanted_blocks, peer_has);
         }
 
         [[nodiscard]] bool client_has_block(tr_block_index_t const block) const override
@@ -440,11 +442,11 @@ public:
 
         [[nodiscard]] size_t count_piece_replication(tr_piece_index_t const piece) const override
         {
-            auto const op = [piece](size_t acc, auto const& peer)
+            auto const op = [piece](size_t acc, auto const& webseed)
             {
-                return acc + (peer->has_piece(piece) ? 1U : 0U);
+                return acc + (webseed->has_piece(piece) ? 1U : 0U);
             };
-            return std::accumulate(std::begin(swarm_.peers), std::end(swarm_.peers), size_t{}, op) +
+            return swarm_.piece_replication.count(piece) +
                 std::accumulate(std::begin(swarm_.webseeds), std::end(swarm_.webseeds), size_t{}, op);
         }
 
@@ -490,6 +492,7 @@ public:
           } }
     {
         rebuild_webseeds();
+        piece_replication.rebuild(tor->piece_count(), peers);
     }
 
     tr_swarm(tr_swarm&&) = delete;
@@ -528,6 +531,7 @@ public:
     {
         auto const lock = unique_lock();
 
+        piece_replication.remove(peer->has());
         peer_disconnect(tor, peer->has(), peer->active_requests);
 
         auto const& peer_info = peer->peer_info;
@@ -541,6 +545,8 @@ public:
             peers.erase(iter);
             TR_ASSERT(stats.peer_count == peerCount());
         }
+
+        tor->mark_changed();
     }
 
     void remove_all_peers()
@@ -645,20 +651,24 @@ public:
             break;
 
         case tr_peer_event::Type::ClientGotHave:
+            s->piece_replication.add_piece(event.pieceIndex, msgs->has());
             s->got_have(s->tor, event.pieceIndex);
             s->mark_all_upload_only_flag_dirty();
             break;
 
         case tr_peer_event::Type::ClientGotHaveAll:
+            s->piece_replication.replace(*event.old_have, msgs->has());
             s->got_have_all(s->tor);
             s->mark_all_upload_only_flag_dirty();
             break;
 
         case tr_peer_event::Type::ClientGotHaveNone:
+            s->piece_replication.replace(*event.old_have, msgs->has());
             s->mark_all_upload_only_flag_dirty();
             break;
 
         case tr_peer_event::Type::ClientGotBitfield:
+            s->piece_replication.replace(*event.old_have, msgs->has());
             s->got_bitfield(s->tor, msgs->has());
             s->mark_all_upload_only_flag_dirty();
             break;
@@ -726,14 +736,22 @@ public:
 
     bool is_running = false;
 
+    // true if tr_peerMgr has this swarm in its list of swarms with peers
+    bool is_listed_as_having_peers = false;
+
     tr_peerMgr* const manager;
 
     tr_torrent* const tor;
 
+    tr_interesting_pieces interesting_pieces{ *tor }; // depends-on: tor
+
     std::vector<std::unique_ptr<tr_webseed>> webseeds;
 
     Peers peers;
 
+    // depends-on: peers
+    tr_piece_replication piece_replication;
+
     // depends-on: tor
     std::unique_ptr<WishlistController> wishlist_controller;
 
@@ -809,13 +827,7 @@ private:
         pool_is_all_upload_only_.reset();
     }
 
-    void on_torrent_doomed()
-    {
-        auto const lock = unique_lock();
-        stop();
-        tor->swarm = nullptr;
-        delete this;
-    }
+    void on_torrent_doomed();
 
     void on_torrent_done()
     {
@@ -893,6 +905,10 @@ private:
         // the webseed list may have changed...
         rebuild_webseeds();
 
+        // now that we know how many pieces there are,
+        // recount what the peers we already have have
+        piece_replication.rebuild(tor->piece_count(), peers);
+
         for (auto const& peer : peers)
         {
             peer->on_torrent_got_metainfo();
@@ -1115,6 +1131,23 @@ public:
         rechoke_timer_->set_interval(100ms);
     }
 
+    void on_swarm_got_peer(tr_swarm* const swarm)
+    {
+        swarms_with_peers_.on_got_peer(swarm);
+    }
+
+    void on_swarm_doomed(tr_swarm* const swarm)
+    {
+        swarms_with_peers_.on_doomed(swarm);
+    }
+
+    // Something changed that may give us new peers to connect to,
+    // e.g. we learned about new peers or a torrent was started.
+    void outbound_candidates_changed() noexcept
+    {
+        outbound_candidates_.mark_dirty();
+    }
+
     [[nodiscard]] tr_swarm* get_existing_swarm(tr_sha1_digest_t const& hash) const
     {
         auto* const tor = torrents_.get(hash);
@@ -1164,7 +1197,10 @@ private:
         }
     }
 
-    OutboundCandidates outbound_candidates_;
+    tr_outbound_candidates<OutboundCandidates> outbound_candidates_{ OutboundCandidatesListTtl / 1ms };
+
+    // Swarms that have had connected peers since the last reconnect pulse.
+    tr_swarms_with_peers<tr_swarm> swarms_with_peers_;
 
     std::unique_ptr<tr::Timer> const bandwidth_timer_;
     std::unique_ptr<tr::Timer> const peer_info_timer_;
@@ -1218,7 +1254,7 @@ std::vector<tr_block_span_t> tr_peerMgrGetNextRequests(tr_torrent* torrent, tr_p
 
     if (auto& controller = torrent->swarm->wishlist_controller)
     {
-        return controller->next(numwant, [peer](tr_piece_index_t p) { return peer->has_piece(p); });
+        return controller->next(numwant, peer->has());
     }
 
     return {};
@@ -1242,9 +1278,11 @@ void create_bit_torrent_peer(
     auto const
         msgs = tr_peerMsgs::create(tor, std::move(peer_info), std::move(io), peer_id, &tr_swarm::peer_callback_bt, swarm);
     swarm->peers.emplace_back(msgs);
+    swarm->manager->on_swarm_got_peer(swarm);
 
     ++swarm->stats.peer_count;
     ++swarm->stats.peer_from_count[msgs->peer_info->from_first()];
+    tor.mark_changed();
 
     TR_ASSERT(swarm->stats.peer_count == swarm->peerCount());
     TR_ASSERT(swarm->stats.peer_from_count[msgs->peer_info->from_first()] <= swarm->stats.peer_count);
@@ -1390,6 +1428,11 @@ size_t tr_peerMgrAddPex(tr_torrent* tor, tr_peer_from from, tr_pex const* pex, s
         }
     }
 
+    if (n_used != 0U)
+    {
+        s->manager->outbound_candidates_changed();
+    }
+
     return n_used;
 }
 
@@ -1604,6 +1647,7 @@ void tr_swarm::on_torrent_started()
     auto const lock = unique_lock();
     is_running = true;
     manager->rechokeSoon();
+    manager->outbound_candidates_changed();
     wishlist_controller = std::make_unique<WishlistController>(*this);
 }
 
@@ -1612,6 +1656,15 @@ void tr_swarm::on_torrent_stopped()
     stop();
 }
 
+void tr_swarm::on_torrent_doomed()
+{
+    auto const lock = unique_lock();
+    stop();
+    manager->on_swarm_doomed(this);
+    tor->swarm = nullptr;
+    delete this;
+}
+
 void tr_peerMgrAddTorrent(tr_peerMgr* manager, tr_torrent* tor)
 {
     TR_ASSERT(tr_isTorrent(tor));
@@ -1633,8 +1686,7 @@ int8_t tr_peerMgrPieceAvailability(tr_torrent const* tor, tr_piece_index_t piece
         return -1;
     }
 
-    auto const& peers = tor->swarm->peers;
-    return std::count_if(std::begin(peers), std::end(peers), [piece](auto const& peer) { return peer->has_piece(piece); });
+    return static_cast<int8_t>(std::min(tor->swarm->piece_replication.count(piece), size_t{ INT8_MAX }));
 }
 
 void tr_peerMgrTorrentAvailability(tr_torrent const* tor, int8_t* tab, unsigned int n_tabs)
@@ -1690,13 +1742,8 @@ uint64_t tr_peerMgrGetDesiredAvailable(tr_torrent const* tor)
         return 0;
     }
 
-    auto available = tr_bitfield{ tor->piece_count() };
-    for (auto const& peer : swarm->peers)
-    {
-        available |= peer->has();
-    }
-
-    if (available.has_all())
+    auto const& replication = swarm->piece_replication;
+    if (replication.any_peer_has_all())
     {
         return tor->left_until_done();
     }
@@ -1705,7 +1752,7 @@ uint64_t tr_peerMgrGetDesiredAvailable(tr_torrent const* tor)
 
     for (tr_piece_index_t i = 0, n = tor->piece_count(); i < n; ++i)
     {
-        if (tor->piece_is_wanted(i) && available.test(i))
+        if (replication.count(i) != 0U && tor->piece_is_wanted(i))
         {
             desired_available += tor->count_missing_bytes_in_piece(i);
         }
@@ -1858,7 +1905,7 @@ namespace update_interest_helpers
 /* does this peer have any pieces that we want? */
 [[nodiscard]] bool isPeerInteresting(
     tr_torrent const* const tor,
-    std::vector<bool> const& piece_is_interesting,
+    tr_bitfield const& piece_is_interesting,
     tr_peerMsgs const* const peer)
 {
     /* these cases should have already been handled by the calling code... */
@@ -1870,15 +1917,7 @@ namespace update_interest_helpers
         return true;
     }
 
-    for (tr_piece_index_t i = 0; i < tor->piece_count(); ++i)
-    {
-        if (piece_is_interesting[i] && peer->has_piece(i))
-        {
-            return true;
-        }
-    }
-
-    return false;
+    return peer->has().intersects(piece_is_interesting);
 }
 
 // determine which peers to show interest in
@@ -1893,14 +1932,7 @@ void updateInterest(tr_swarm* swarm)
 
     if (auto const& peers = swarm->peers; !std::empty(peers))
     {
-        auto const n = tor->piece_count();
-
-        // build a bitfield of interesting pieces...
-        auto piece_is_interesting = std::vector<bool>(n);
-        for (tr_piece_index_t i = 0U; i < n; ++i)
-        {
-            piece_is_interesting[i] = tor->piece_is_wanted(i) && !tor->has_piece(i);
-        }
+        auto const& piece_is_interesting = swarm->interesting_pieces.get();
 
         for (auto const& peer : peers)
         {
@@ -2112,14 +2144,14 @@ void tr_peerMgr::rechoke_pulse() const
             // possibly stop torrents that have seeded enough
             tor->stop_if_seed_limit_reached();
         }
+    }
 
-        if (tor->is_running())
+    for (auto* const swarm : swarms_with_peers_)
+    {
+        if (swarm->tor->is_running() && swarm->stats.peer_count > 0)
         {
-            if (auto* const swarm = tor->swarm; swarm->stats.peer_count > 0)
-            {
-                rechokeUploads(swarm, now);
-                updateInterest(swarm);
-            }
+            rechokeUploads(swarm, now);
+            updateInterest(swarm);
         }
     }
 }
@@ -2261,7 +2293,7 @@ void enforceSwarmPeerLimit(tr_swarm* swarm, size_t max)
     std::ranges::for_each(peers, close_peer);
 }
 
-void enforceSessionPeerLimit(size_t global_peer_limit, tr_torrents& torrents)
+void enforceSessionPeerLimit(size_t global_peer_limit, std::vector<tr_swarm*> const& swarms)
 {
     // if we're under the limit, then no action needed
     auto const current_size = tr_peerMsgs::size();
@@ -2273,9 +2305,9 @@ void enforceSessionPeerLimit(size_t global_peer_limit, tr_torrents& torrents)
     // make a list of all the peers
     auto peers = std::vector<std::shared_ptr<tr_peerMsgs>>{};
     peers.reserve(current_size);
-    for (auto const* const tor : torrents)
+    for (auto const* const swarm : swarms)
     {
-        peers.insert(std::end(peers), std::begin(tor->swarm->peers), std::end(tor->swarm->peers));
+        peers.insert(std::end(peers), std::begin(swarm->peers), std::end(swarm->peers));
     }
 
     TR_ASSERT(current_size == std::size(peers));
@@ -2297,10 +2329,8 @@ void tr_peerMgr::reconnect_pulse()
 
     // remove crappy peers
     auto bad_peers_buf = bad_peers_t{};
-    for (auto* const tor : torrents_)
+    for (auto* const swarm : swarms_with_peers_)
     {
-        auto* const swarm = tor->swarm;
-
         if (!swarm->is_running)
         {
             swarm->remove_all_peers();
@@ -2311,17 +2341,20 @@ void tr_peerMgr::reconnect_pulse()
         }
     }
 
+    // stop visiting swarms that don't have any peers left
+    swarms_with_peers_.prune();
+
     // if we're over the per-torrent peer limits, cull some peers
-    for (auto* const tor : torrents_)
+    for (auto* const swarm : swarms_with_peers_)
     {
-        if (tor->is_running())
+        if (auto const* const tor = swarm->tor; tor->is_running())
         {
-            enforceSwarmPeerLimit(tor->swarm, tor->peer_limit());
+            enforceSwarmPeerLimit(swarm, tor->peer_limit());
         }
     }
 
     // if we're over the per-session peer limits, cull some peers
-    enforceSessionPeerLimit(session->peerLimit(), torrents_);
+    enforceSessionPeerLimit(session->peerLimit(), swarms_with_peers_.get());
 
     // try to make new peer connections
     make_new_peer_connections();
@@ -2441,8 +2474,8 @@ void tr_peerMgr::bandwidth_pulse()
     pumpAllPeers(this);
 
     // allocate bandwidth to the peers
-    static auto constexpr Msec = std::chrono::duration_cast<std::chrono::milliseconds>(BandwidthTimerPeriod).count();
-    session->top_bandwidth_.allocate(Msec);
+    static_assert(BandwidthTimerPeriod <= std::chrono::milliseconds{ tr_bandwidth::BurstMSec });
+    session->top_bandwidth_.allocate();
 
     // torrent upkeep
     for (auto* const tor : torrents_)
@@ -2700,12 +2733,10 @@ void tr_peerMgr::make_new_peer_connections()
 
     auto const lock = unique_lock();
 
-    // get the candidates if we need to
-    auto& candidates = outbound_candidates_;
-    if (std::empty(candidates))
-    {
-        get_peer_candidates(session->peerLimit(), torrents_, candidates);
-    }
+    // get the candidates, rebuilding the list if it's stale
+    auto& candidates = outbound_candidates_.get(
+        tr_time_msec(),
+        [this](OutboundCandidates& setme) { get_peer_candidates(session->peerLimit(), torrents_, setme); });
 
     // initiate connections to the last N candidates
     auto const n_this_pass = std::min(std::size(candidates), MaxConnectionsPerPulse);
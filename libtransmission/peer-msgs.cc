@@ -33,8 +33,10 @@
 #include "libtransmission/cache.h"
 #include "libtransmission/clients.h"
 #include "libtransmission/crypto-utils.h"
+#include "libtransmission/file.h"
 #include "libtransmission/interned-string.h"
 #include "libtransmission/log.h"
+#include "libtransmission/open-files.h"
 #include "libtransmission/peer-common.h"
 #include "libtransmission/peer-io.h"
 #include "libtransmission/peer-mgr.h"
@@ -185,6 +187,10 @@ auto constexpr PeerReqQDefault = 500U;
 // meet our bandwidth goals for the next N seconds
 auto constexpr RequestBufSecs = time_t{ 10 };
 
+// when uploading, how many queued pieces past the
+// current one the read cache may read ahead
+auto constexpr MaxReadAheadPieces = tr_piece_index_t{ 4U };
+
 // ---
 
 auto constexpr MaxPexPeerCount = size_t{ 50U };
@@ -219,6 +225,11 @@ struct tr_incoming
     std::optional<uint8_t> id; // the protocol message, e.g. BtPeerMsgs::Piece
     MessageBuffer payload;
 
+    // A Piece message's block, read straight out of the peer's read buffer
+    // so that it can be handed to the cache without being copied again.
+    std::unique_ptr<Cache::BlockData> block;
+    size_t n_block_bytes_read = 0U;
+
     struct incoming_piece_data
     {
         explicit incoming_piece_data(uint32_t block_size)
@@ -565,6 +576,13 @@ private:
         {
             peer_requested_.emplace_back(req);
 
+            // if the piece hasn't been checked yet, move it to the front of the
+            // piece sweeper's queue so that it's ready by the time we get to it
+            if (!tor_.is_piece_checked(req.index))
+            {
+                (void)tor_.ensure_piece_is_checked_async(req.index);
+            }
+
             fill_output_buffer(tr_time(), tr_time_msec());
         }
         else if (io_->supports_fext())
@@ -614,6 +632,9 @@ private:
     void maybe_send_metadata_requests(time_t now) const;
     [[nodiscard]] size_t add_next_metadata_piece();
     [[nodiscard]] size_t add_next_block(time_t now_sec, uint64_t now_msec);
+    [[nodiscard]] std::optional<std::pair<tr_peerIo::SendFile, uint64_t>> get_send_file(
+        tr_block_info::Location const& loc,
+        uint32_t len);
 
     [[nodiscard]] size_t fill_output_buffer_impl(time_t now_sec, uint64_t now_msec);
     void fill_output_buffer(time_t now_sec, uint64_t now_msec)
@@ -640,7 +661,7 @@ private:
     void send_ut_pex();
 
     int client_got_block(std::unique_ptr<Cache::BlockData> block_data, tr_block_index_t block);
-    ReadResult read_piece_data(MessageReader& payload);
+    ReadResult read_piece_data(MessageReader& payload, std::unique_ptr<Cache::BlockData> block_data);
     ReadResult process_peer_message(uint8_t id, MessageReader& payload);
 
     // ---
@@ -812,6 +833,18 @@ namespace protocol_send_message_helpers
     return sizeof(param);
 }
 
+// A piece message's payload when it's sent straight from a file:
+// it counts towards the message length, but nothing is added for it.
+struct FilePayload
+{
+    size_t len = {};
+};
+
+[[nodiscard]] constexpr auto get_param_length(FilePayload const& param) noexcept
+{
+    return param.len;
+}
+
 template<typename T>
 [[nodiscard]] constexpr auto get_param_length(T const& param) noexcept
 {
@@ -835,6 +868,10 @@ void add_param(MessageWriter& buffer, uint32_t param) noexcept
     buffer.add_uint32(param);
 }
 
+void add_param(MessageWriter& /*buffer*/, FilePayload const& /*param*/) noexcept
+{
+}
+
 template<typename T>
 void add_param(MessageWriter& buffer, T const& param) noexcept
 {
@@ -1525,11 +1562,14 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
         break;
 
     case BtPeerMsgs::Bitfield:
-        logtrace(this, "got a bitfield");
-        have_ = tr_bitfield{ tor_.has_metainfo() ? tor_.piece_count() : std::size(payload) * 8 };
-        have_.set_raw(reinterpret_cast<uint8_t const*>(std::data(payload)), std::size(payload));
-        peer_info->set_seed(is_seed());
-        publish(tr_peer_event::GotBitfield(&have_));
+        {
+            logtrace(this, "got a bitfield");
+            auto const n_bits = tor_.has_metainfo() ? tor_.piece_count() : std::size(payload) * 8;
+            auto const old_have = std::exchange(have_, tr_bitfield{ n_bits });
+            have_.set_raw(reinterpret_cast<uint8_t const*>(std::data(payload)), std::size(payload));
+            peer_info->set_seed(is_seed());
+            publish(tr_peer_event::GotBitfield(old_have));
+        }
         break;
 
     case BtPeerMsgs::Request:
@@ -1569,7 +1609,7 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
         }
 
     case BtPeerMsgs::Piece:
-        return read_piece_data(payload);
+        return read_piece_data(payload, {});
 
     case BtPeerMsgs::DhtPort:
         // https://www.bittorrent.org/beps/bep_0005.html
@@ -1627,9 +1667,10 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
 
         if (fext)
         {
+            auto const old_have = have_;
             have_.set_has_all();
             peer_info->set_seed();
-            publish(tr_peer_event::GotHaveAll());
+            publish(tr_peer_event::GotHaveAll(old_have));
         }
         else
         {
@@ -1644,9 +1685,10 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
 
         if (fext)
         {
+            auto const old_have = have_;
             have_.set_has_none();
             peer_info->set_seed(false);
-            publish(tr_peer_event::GotHaveNone());
+            publish(tr_peer_event::GotHaveNone(old_have));
         }
         else
         {
@@ -1693,12 +1735,13 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
     return { ReadState::Now, {} };
 }
 
-ReadResult tr_peerMsgsImpl::read_piece_data(MessageReader& payload)
+// `block_data`, if set, holds the message's <block>. Otherwise it's in `payload`.
+ReadResult tr_peerMsgsImpl::read_piece_data(MessageReader& payload, std::unique_ptr<Cache::BlockData> block_data)
 {
     // <index><begin><block>
     auto const piece = payload.to_uint32();
     auto const offset = payload.to_uint32();
-    auto const len = std::size(payload);
+    auto const len = block_data ? std::size(*block_data) : std::size(payload);
 
     auto const loc = tor_.piece_loc(piece, offset);
     auto const block = loc.block;
@@ -1734,15 +1777,26 @@ ReadResult tr_peerMsgsImpl::read_piece_data(MessageReader& payload)
 
     if (loc.block_offset == 0U && len == block_size) // simple case: one message has entire block
     {
-        auto buf = std::make_unique<Cache::BlockData>(block_size);
-        payload.to_buf(std::data(*buf), len);
-        auto const ok = client_got_block(std::move(buf), block) == 0;
+        if (!block_data)
+        {
+            block_data = std::make_unique<Cache::BlockData>(block_size);
+            payload.to_buf(std::data(*block_data), len);
+        }
+
+        auto const ok = client_got_block(std::move(block_data), block) == 0;
         return { ok ? ReadState::Now : ReadState::Err, len };
     }
 
     auto& blocks = incoming_.blocks;
     auto& incoming_block = blocks.try_emplace(block, block_size).first->second;
-    payload.to_buf(std::data(*incoming_block.buf) + loc.block_offset, len);
+    if (block_data)
+    {
+        std::copy_n(std::data(*block_data), len, std::data(*incoming_block.buf) + loc.block_offset);
+    }
+    else
+    {
+        payload.to_buf(std::data(*incoming_block.buf) + loc.block_offset, len);
+    }
 
     if (!incoming_block.add_span(loc.block_offset, loc.block_offset + len))
     {
@@ -1853,9 +1907,14 @@ ReadState tr_peerMsgsImpl::can_read(tr_peerIo* io, void* vmsgs, size_t* piece)
     }
 
     // read <payload>
+    // If this is a Piece message, only read its <index><begin> header here.
+    // Its <block> is read straight into the buffer that's given to the cache.
+    static auto constexpr PieceHeaderLen = sizeof(uint32_t) * 2U;
     auto& current_payload = msgs->incoming_.payload;
     auto const full_payload_len = *current_message_len - sizeof(*current_message_type);
-    auto n_left = full_payload_len - std::size(current_payload);
+    auto const has_block = *current_message_type == BtPeerMsgs::Piece && full_payload_len > PieceHeaderLen &&
+        full_payload_len - PieceHeaderLen <= tr_block_info::BlockSize;
+    auto n_left = (has_block ? PieceHeaderLen : full_payload_len) - std::size(current_payload);
     auto const [buf, n_this_pass] = current_payload.reserve_space(std::min(n_left, io->read_buffer_size()));
     io->read_bytes(buf, n_this_pass);
     current_payload.commit_space(n_this_pass);
@@ -1867,16 +1926,44 @@ ReadState tr_peerMsgsImpl::can_read(tr_peerIo* io, void* vmsgs, size_t* piece)
         return ReadState::Later;
     }
 
+    // read <block>
+    auto& current_block = msgs->incoming_.block;
+    if (has_block)
+    {
+        auto& n_read = msgs->incoming_.n_block_bytes_read;
+        if (!current_block)
+        {
+            current_block = std::make_unique<Cache::BlockData>(full_payload_len - PieceHeaderLen);
+            n_read = 0U;
+        }
+
+        auto const n_block_left = std::size(*current_block) - n_read;
+        auto const n_block_this_pass = std::min(n_block_left, io->read_buffer_size());
+        io->read_bytes(std::data(*current_block) + n_read, n_block_this_pass);
+        n_read += n_block_this_pass;
+        logtrace(
+            msgs,
+            fmt::format("read {:d} block bytes; {:d} left to go", n_block_this_pass, n_block_left - n_block_this_pass));
+
+        if (n_read < std::size(*current_block))
+        {
+            return ReadState::Later;
+        }
+    }
+
     // The incoming message is now complete. After processing the message
     // with `process_peer_message()`, reset the peerMsgs' incoming
     // field so it's ready to receive the next message.
 
-    auto const [read_state, n_piece_bytes_read] = msgs->process_peer_message(*current_message_type, current_payload);
+    auto const [read_state, n_piece_bytes_read] = has_block ?
+        msgs->read_piece_data(current_payload, std::move(current_block)) :
+        msgs->process_peer_message(*current_message_type, current_payload);
     *piece = n_piece_bytes_read;
 
     current_message_len.reset();
     current_message_type.reset();
     current_payload.clear();
+    current_block.reset();
 
     return read_state;
 }
@@ -2041,31 +2128,90 @@ void tr_peerMsgsImpl::check_request_timeout(time_t const now)
         return {};
     }
 
-    auto const req = peer_requested_.front();
-    peer_requested_.pop_front();
+    // Don't hash pieces on the session thread just because a peer wants them.
+    // Requests for unchecked pieces wait while the piece sweeper checks them;
+    // peers that support the fast extension are told no right away instead.
+    // The pieces were handed to the sweeper when the requests were queued.
+    auto iter = std::begin(peer_requested_);
+    if (!io_->supports_fext())
+    {
+        iter = std::ranges::find_if(
+            peer_requested_,
+            [this](peer_request const& req)
+            { return req.index >= tor_.piece_count() || !tor_.has_piece(req.index) || tor_.is_piece_checked(req.index); });
+
+        if (iter == std::end(peer_requested_))
+        {
+            return {};
+        }
+    }
+
+    auto const req = *iter;
 
-    auto buf = std::array<uint8_t, tr_block_info::BlockSize>{};
-    auto ok = is_valid_request(req) && tor_.has_piece(req.index);
+    auto buf = std::unique_ptr<Cache::BlockData>{};
+    auto send_file = std::optional<std::pair<tr_peerIo::SendFile, uint64_t>>{};
+    auto ok = is_valid_request(req) && tor_.has_piece(req.index) && tor_.is_piece_checked(req.index);
 
     if (ok)
     {
-        ok = tor_.ensure_piece_is_checked(req.index);
+        auto const loc = tor_.piece_loc(req.index, req.offset);
+        send_file = get_send_file(loc, req.length);
+    }
 
-        if (!ok)
+    if (ok && !send_file)
+    {
+        // if the peer has also asked for the pieces right after this one,
+        // let the cache read them ahead along with this one
+        auto n_more_pieces = tr_piece_index_t{};
+        while (n_more_pieces < MaxReadAheadPieces &&
+               std::ranges::any_of(
+                   peer_requested_,
+                   [next = req.index + n_more_pieces + 1U](peer_request const& other) { return other.index == next; }))
         {
-            tor_.error().set_local_error(fmt::format("Please Verify Local Data! Piece #{:d} is corrupt.", req.index));
+            ++n_more_pieces;
         }
+
+        buf = std::make_unique<Cache::BlockData>(req.length);
+        auto const loc = tor_.piece_loc(req.index, req.offset);
+        auto const err = session->cache->read_upload_block(
+            tor_,
+            loc,
+            req.length,
+            std::data(*buf),
+            n_more_pieces,
+            [weak = weak_from_this()]
+            {
+                if (auto const msgs = weak.lock())
+                {
+                    msgs->fill_output_buffer(tr_time(), tr_time_msec());
+                }
+            });
+        if (err == EAGAIN)
+        {
+            // the cache is reading the piece on a disk thread; send it when that's done
+            return {};
+        }
+
+        ok = err == 0;
     }
 
-    if (ok)
+    peer_requested_.erase(iter);
+
+    if (ok && send_file)
     {
-        ok = session->cache->read_block(tor_, tor_.piece_loc(req.index, req.offset), req.length, std::data(buf)) == 0;
+        using protocol_send_message_helpers::FilePayload;
+
+        blocks_sent_to_peer.add(now_sec, 1);
+        auto const n_header_bytes = protocol_send_message(BtPeerMsgs::Piece, req.index, req.offset, FilePayload{ req.length });
+        auto& [file, file_offset] = *send_file;
+        io_->write_file(std::move(file), file_offset, req.length);
+        return n_header_bytes + req.length;
     }
 
     if (ok)
     {
         blocks_sent_to_peer.add(now_sec, 1);
-        auto const piece_data = std::string_view{ reinterpret_cast<char const*>(std::data(buf)), req.length };
+        auto const piece_data = std::string_view{ reinterpret_cast<char const*>(std::data(*buf)), req.length };
         return protocol_send_message(BtPeerMsgs::Piece, req.index, req.offset, piece_data);
     }
 
@@ -2077,6 +2223,50 @@ void tr_peerMsgsImpl::check_request_timeout(time_t const now)
     return {};
 }
 
+// If the block at `loc` can be sent straight from its file to the peer,
+// get that file and the block's offset in it.
+std::optional<std::pair<tr_peerIo::SendFile, uint64_t>> tr_peerMsgsImpl::get_send_file(
+    tr_block_info::Location const& loc,
+    uint32_t const len)
+{
+    if (!session->is_sendfile_enabled() || !io_->can_write_file())
+    {
+        return {};
+    }
+
+    // the block must be on disk, and all in one file
+    auto const [file_index, file_offset] = tor_.file_offset(loc);
+    if (file_offset + len > tor_.file_size(file_index) || session->cache->has_unflushed_blocks(tor_, loc.piece))
+    {
+        return {};
+    }
+
+    // Send from the session's open file, so that peers don't hold descriptors
+    // of their own that the open-files limit and close_torrent_files() don't see.
+    // Anything queued from it keeps it open until it's sent, even if it's closed.
+    auto& open_files = session->openFiles();
+    auto file = open_files.get_shared(tor_.id(), file_index);
+    if (!file)
+    {
+        auto const found = tor_.find_file(file_index);
+        if (!found ||
+            !open_files.get(
+                tor_.id(),
+                file_index,
+                false /*writable*/,
+                found->filename(),
+                tr_open_files::Preallocation::None,
+                tor_.file_size(file_index)))
+        {
+            return {};
+        }
+
+        file = open_files.get_shared(tor_.id(), file_index);
+    }
+
+    return std::pair{ std::move(file), file_offset };
+}
+
 // ---
 
 bool tr_peerMsgsImpl::is_valid_request(peer_request const& req) const
@@ -6,6 +6,11 @@
 #include <algorithm> // std::min
 #include <cerrno>
 #include <cstddef> // std::byte
+#include <cstdint> // uint64_t
+
+#ifdef HAVE_SENDFILE64
+#include <sys/sendfile.h>
+#endif
 
 #include <fmt/format.h>
 
@@ -14,6 +19,7 @@
 #endif
 
 #include "libtransmission/error.h"
+#include "libtransmission/file.h"
 #include "libtransmission/log.h"
 #include "libtransmission/net.h"
 #include "libtransmission/peer-socket.h"
@@ -112,6 +118,51 @@ size_t tr_peer_socket::try_write(OutBuf& buf, size_t max, tr_error* error) const
     return {};
 }
 
+bool tr_peer_socket::can_send_file() const noexcept
+{
+#ifdef HAVE_SENDFILE64
+    return is_tcp();
+#else
+    return false;
+#endif
+}
+
+size_t tr_peer_socket::try_send_file(
+    [[maybe_unused]] tr_sys_file_t fd,
+    [[maybe_unused]] uint64_t offset,
+    size_t max,
+    tr_error* error) const
+{
+    TR_ASSERT(can_send_file());
+
+    if (max == size_t{})
+    {
+        return {};
+    }
+
+#ifdef HAVE_SENDFILE64
+    auto file_offset = static_cast<off64_t>(offset);
+    auto const n_sent = sendfile64(handle.tcp, fd, &file_offset, max);
+    if (n_sent > 0)
+    {
+        return static_cast<size_t>(n_sent);
+    }
+
+    if (error != nullptr)
+    {
+        // sending nothing at all means the file is shorter than it should be
+        error->set_from_errno(n_sent == 0 ? EIO : errno);
+    }
+#else
+    if (error != nullptr)
+    {
+        error->set_from_errno(ENOSYS);
+    }
+#endif
+
+    return {};
+}
+
 size_t tr_peer_socket::try_read(InBuf& buf, size_t max, [[maybe_unused]] bool buf_is_empty, tr_error* error) const
 {
     if (max == size_t{})
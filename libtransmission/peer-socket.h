@@ -11,9 +11,11 @@
 
 #include <atomic>
 #include <cstddef> // size_t
+#include <cstdint> // uint64_t
 #include <string>
 #include <utility> // for std::make_pair()
 
+#include "libtransmission/file.h" // tr_sys_file_t
 #include "libtransmission/net.h"
 #include "libtransmission/tr-buffer.h"
 
@@ -55,6 +57,13 @@ public:
     size_t try_read(InBuf& buf, size_t max, bool buf_is_empty, tr_error* error) const;
     size_t try_write(OutBuf& buf, size_t max, tr_error* error) const;
 
+    // Send up to `max` bytes of `fd` starting at `offset` straight from
+    // the file to the socket, without copying them into user space.
+    // Only use this if can_send_file() is true.
+    size_t try_send_file(tr_sys_file_t fd, uint64_t offset, size_t max, tr_error* error) const;
+
+    [[nodiscard]] bool can_send_file() const noexcept;
+
     [[nodiscard]] constexpr auto const& socket_address() const noexcept
     {
         return socket_address_;
@@ -0,0 +1,307 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef> // std::byte, size_t
+#include <cstdint> // uint64_t
+#include <iterator> // std::distance
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <thread>
+#include <utility> // std::move
+#include <vector>
+
+#include "libtransmission/crypto-utils.h"
+#include "libtransmission/file.h"
+#include "libtransmission/merkle.h"
+#include "libtransmission/piece-sweeper.h"
+#include "libtransmission/types.h"
+
+using namespace std::literals;
+
+namespace
+{
+auto constexpr ReadBufferSize = size_t{ 128U } * 1024U;
+
+// Background pieces are hashed with a short rest in between,
+// so that the sweep doesn't compete with active transfers for the disk.
+auto constexpr BackgroundRest = 10ms;
+} // namespace
+
+tr_piece_sweeper::Torrent::Torrent(std::unique_ptr<Mediator> mediator_in)
+    : mediator{ std::move(mediator_in) }
+{
+    auto const& metainfo = mediator->metainfo();
+    auto const n_files = metainfo.file_count();
+    files.resize(n_files);
+
+    auto file_end = uint64_t{};
+    for (tr_file_index_t file_index = 0U; file_index < n_files; ++file_index)
+    {
+        file_end += metainfo.file_size(file_index);
+        files[file_index].end = file_end;
+    }
+}
+
+bool tr_piece_sweeper::hash_piece(Torrent& torrent, tr_piece_index_t const piece, bool const re_resolve)
+{
+    auto const& mediator = *torrent.mediator;
+    auto const& metainfo = mediator.metainfo();
+    auto const [begin_byte, end_byte] = metainfo.block_info().byte_span_for_piece(piece);
+
+    if (!torrent.merkle)
+    {
+        torrent.merkle.emplace(metainfo);
+    }
+
+    auto sha = tr_sha1{};
+    auto v2 = tr_merkle_piece_checker{};
+    v2.start(*torrent.merkle, piece);
+    auto buf = std::vector<std::byte>(ReadBufferSize);
+    auto pos = begin_byte;
+
+    auto const file_iter = std::ranges::upper_bound(torrent.files, begin_byte, {}, &Torrent::File::end);
+    auto file_index = static_cast<tr_file_index_t>(std::distance(std::ranges::begin(torrent.files), file_iter));
+
+    for (auto const n_files = metainfo.file_count(); pos < end_byte && file_index < n_files; ++file_index)
+    {
+        auto& file = torrent.files[file_index];
+        auto const file_end = file.end;
+        auto const file_begin = file_end - metainfo.file_size(file_index);
+        if (file_end <= pos)
+        {
+            continue;
+        }
+
+        if (!file.is_found || re_resolve)
+        {
+            file.filename = mediator.find_file(file_index);
+            file.is_found = true;
+        }
+
+        auto const& found = file.filename;
+        auto const fd = !found ? TR_BAD_SYS_FILE : tr_sys_file_open(*found, TR_SYS_FILE_READ | TR_SYS_FILE_SEQUENTIAL, 0);
+        if (fd == TR_BAD_SYS_FILE)
+        {
+            return false;
+        }
+
+        for (auto const end = std::min(end_byte, file_end); pos < end;)
+        {
+            auto num_read = uint64_t{};
+            auto const n_wanted = std::min(uint64_t{ std::size(buf) }, end - pos);
+            if (!tr_sys_file_read_at(fd, std::data(buf), n_wanted, pos - file_begin, &num_read) || num_read == 0U)
+            {
+                tr_sys_file_close(fd);
+                return false;
+            }
+
+            sha.add(std::data(buf), num_read);
+            v2.add(std::data(buf), num_read);
+            pos += num_read;
+        }
+
+        tr_sys_file_close(fd);
+    }
+
+    return pos == end_byte && sha.finish() == metainfo.piece_hash(piece) && v2.finish();
+}
+
+// Must be called with mutex_ locked.
+bool tr_piece_sweeper::has_urgent_work() const noexcept
+{
+    return std::ranges::any_of(torrents_, [](auto const& torrent) { return !std::empty(torrent->urgent); });
+}
+
+// Must be called with mutex_ locked.
+std::optional<tr_piece_sweeper::Task> tr_piece_sweeper::next_task()
+{
+    for (auto const& torrent : torrents_)
+    {
+        if (!std::empty(torrent->urgent))
+        {
+            auto const piece = torrent->urgent.front();
+            torrent->urgent.pop_front();
+            return Task{ torrent.get(), piece, true, torrent->re_resolve.erase(piece) != 0U };
+        }
+    }
+
+    for (size_t i = 0U, n = std::size(torrents_); i < n; ++i)
+    {
+        auto& torrent = *torrents_[(next_background_ + i) % n];
+        if (!std::empty(torrent.background))
+        {
+            next_background_ = (next_background_ + i + 1U) % n;
+            auto const piece = torrent.background.extract(std::begin(torrent.background)).value();
+            return Task{ &torrent, piece, false, false };
+        }
+    }
+
+    return {};
+}
+
+void tr_piece_sweeper::sweeper_thread_func()
+{
+    auto lock = std::unique_lock{ mutex_ };
+
+    for (;;)
+    {
+        auto task = std::optional<Task>{};
+        cv_.wait(lock, [this, &task]() { return is_stopping_ || (task = next_task()).has_value(); });
+        if (is_stopping_)
+        {
+            return;
+        }
+
+        auto& torrent = *task->torrent;
+        torrent.is_busy = true;
+
+        lock.unlock();
+        auto const passed = hash_piece(torrent, task->piece, task->re_resolve);
+        lock.lock();
+
+        torrent.is_busy = false;
+        if (torrent.is_removed)
+        {
+            // no-op
+        }
+        else if (!passed && !task->re_resolve)
+        {
+            // one of its files may have been renamed since we looked it up,
+            // e.g. to drop a ".part" suffix, so make sure before calling it corrupt
+            torrent.re_resolve.insert(task->piece);
+            torrent.urgent.push_front(task->piece);
+        }
+        else
+        {
+            torrent.mediator->on_piece_checked(task->piece, passed);
+        }
+
+        // drop torrents that have nothing left to check
+        std::erase_if(
+            torrents_,
+            [](auto const& candidate)
+            { return !candidate->is_busy && std::empty(candidate->urgent) && std::empty(candidate->background); });
+        cv_.notify_all();
+
+        if (!task->is_urgent)
+        {
+            cv_.wait_for(lock, BackgroundRest, [this]() { return is_stopping_ || has_urgent_work(); });
+        }
+    }
+}
+
+void tr_piece_sweeper::add(std::unique_ptr<Mediator> mediator, std::vector<tr_piece_index_t> const& pieces)
+{
+    if (std::empty(pieces))
+    {
+        return;
+    }
+
+    auto const lock = std::scoped_lock{ mutex_ };
+
+    auto const& info_hash = mediator->metainfo().info_hash();
+    auto iter = std::ranges::find_if(
+        torrents_,
+        [&info_hash](auto const& torrent) { return !torrent->is_removed && torrent->matches(info_hash); });
+    if (iter == std::ranges::end(torrents_))
+    {
+        iter = torrents_.insert(std::ranges::end(torrents_), std::make_unique<Torrent>(std::move(mediator)));
+    }
+
+    (*iter)->background.insert(std::begin(pieces), std::end(pieces));
+
+    if (!thread_.joinable())
+    {
+        thread_ = std::thread{ &tr_piece_sweeper::sweeper_thread_func, this };
+    }
+
+    cv_.notify_all();
+}
+
+bool tr_piece_sweeper::prioritize(tr_sha1_digest_t const& info_hash, tr_piece_index_t const piece)
+{
+    auto const lock = std::scoped_lock{ mutex_ };
+
+    auto const iter = std::ranges::find_if(
+        torrents_,
+        [&info_hash](auto const& torrent) { return !torrent->is_removed && torrent->matches(info_hash); });
+    if (iter == std::ranges::end(torrents_))
+    {
+        return false;
+    }
+
+    auto& torrent = **iter;
+    if (torrent.background.erase(piece) != 0U)
+    {
+        torrent.urgent.emplace_back(piece);
+        cv_.notify_all();
+    }
+
+    return true;
+}
+
+void tr_piece_sweeper::remove(tr_sha1_digest_t const& info_hash)
+{
+    auto lock = std::unique_lock{ mutex_ };
+
+    auto const matches = [&info_hash](auto const& torrent)
+    {
+        return !torrent->is_removed && torrent->matches(info_hash);
+    };
+
+    auto const iter = std::ranges::find_if(torrents_, matches);
+    if (iter == std::ranges::end(torrents_))
+    {
+        return;
+    }
+
+    auto* const torrent = iter->get();
+    torrent->is_removed = true;
+    torrent->urgent.clear();
+    torrent->background.clear();
+    torrent->re_resolve.clear();
+
+    // the sweeper thread drops it once it's done with the current piece
+    cv_.wait(
+        lock,
+        [this, torrent]()
+        {
+            return std::ranges::none_of(torrents_, [torrent](auto const& candidate) { return candidate.get() == torrent; }) ||
+                !torrent->is_busy;
+        });
+
+    std::erase_if(torrents_, [torrent](auto const& candidate) { return candidate.get() == torrent; });
+}
+
+size_t tr_piece_sweeper::size() const
+{
+    auto const lock = std::scoped_lock{ mutex_ };
+
+    auto n_pieces = size_t{};
+    for (auto const& torrent : torrents_)
+    {
+        n_pieces += std::size(torrent->urgent) + std::size(torrent->background);
+    }
+
+    return n_pieces;
+}
+
+tr_piece_sweeper::~tr_piece_sweeper()
+{
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        is_stopping_ = true;
+        cv_.notify_all();
+    }
+
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
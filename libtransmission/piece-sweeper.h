@@ -0,0 +1,134 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libtransmission/merkle.h"
+#include "libtransmission/torrent-metainfo.h"
+#include "libtransmission/types.h"
+
+// Checks pieces that we have but haven't verified since their files last
+// changed, e.g. after a restart, on a low-priority background thread.
+// Pieces that peers are asking for can be moved to the front of the line,
+// so uploads never have to wait for a piece to be hashed on the session thread.
+class tr_piece_sweeper
+{
+public:
+    class Mediator
+    {
+    public:
+        virtual ~Mediator() = default;
+
+        [[nodiscard]] virtual tr_torrent_metainfo const& metainfo() const = 0;
+
+        // Called from the sweeper's thread. The sweeper remembers what's found,
+        // and only asks again if a piece fails, in case a file has been renamed.
+        [[nodiscard]] virtual std::optional<std::string> find_file(tr_file_index_t file_index) const = 0;
+
+        // Called from the sweeper's thread.
+        virtual void on_piece_checked(tr_piece_index_t piece, bool passed) = 0;
+    };
+
+    tr_piece_sweeper() = default;
+    ~tr_piece_sweeper();
+
+    tr_piece_sweeper(tr_piece_sweeper const&) = delete;
+    tr_piece_sweeper(tr_piece_sweeper&&) = delete;
+    tr_piece_sweeper& operator=(tr_piece_sweeper const&) = delete;
+    tr_piece_sweeper& operator=(tr_piece_sweeper&&) = delete;
+
+    // Queue a torrent's pieces to be checked in the background.
+    // If the torrent is already queued, the pieces are added to its queue.
+    void add(std::unique_ptr<Mediator> mediator, std::vector<tr_piece_index_t> const& pieces);
+
+    // Check `piece` before any background pieces.
+    // Returns false if the torrent isn't queued.
+    bool prioritize(tr_sha1_digest_t const& info_hash, tr_piece_index_t piece);
+
+    // Forget a torrent. If one of its pieces is being checked right now,
+    // this waits for that to finish; no callbacks are made after it returns.
+    void remove(tr_sha1_digest_t const& info_hash);
+
+    // The number of pieces waiting to be checked.
+    [[nodiscard]] size_t size() const;
+
+private:
+    struct Torrent
+    {
+        explicit Torrent(std::unique_ptr<Mediator> mediator_in);
+
+        [[nodiscard]] bool matches(tr_sha1_digest_t const& info_hash) const noexcept
+        {
+            return mediator->metainfo().info_hash() == info_hash;
+        }
+
+        std::unique_ptr<Mediator> mediator;
+
+        struct File
+        {
+            uint64_t end = {}; // the byte offset where the file ends, used to find a piece's first file
+            std::optional<std::string> filename; // only looked up on the sweeper's thread
+            bool is_found = false; // true if `filename` has been looked up
+        };
+
+        std::vector<File> files;
+
+        // hybrid torrents' v2 trees, built on the sweeper's thread when first needed
+        std::optional<tr_merkle_pieces> merkle;
+
+        std::deque<tr_piece_index_t> urgent;
+        std::set<tr_piece_index_t> background;
+
+        // failed pieces that have been queued again to be
+        // checked with their files' paths looked up afresh
+        std::set<tr_piece_index_t> re_resolve;
+
+        bool is_busy = false;
+        bool is_removed = false;
+    };
+
+    struct Task
+    {
+        Torrent* torrent = nullptr;
+        tr_piece_index_t piece = {};
+        bool is_urgent = false;
+        bool re_resolve = false;
+    };
+
+    [[nodiscard]] static bool hash_piece(Torrent& torrent, tr_piece_index_t piece, bool re_resolve);
+
+    [[nodiscard]] bool has_urgent_work() const noexcept;
+    [[nodiscard]] std::optional<Task> next_task();
+
+    void sweeper_thread_func();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+
+    std::vector<std::unique_ptr<Torrent>> torrents_;
+
+    // rotates through the torrents so that one big torrent can't starve the rest
+    size_t next_background_ = {};
+
+    bool is_stopping_ = false;
+
+    std::thread thread_;
+};
@@ -33,6 +33,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "addedDate"sv, // rpc
     "added_date"sv, // .resume, rpc
     "address"sv, // rpc
+    "allocation_count"sv, // rpc
     "alt-speed-down"sv, // gtk app, rpc, speed settings
     "alt-speed-enabled"sv, // gtk app, rpc, speed settings
     "alt-speed-time-begin"sv, // rpc, speed settings
@@ -59,6 +60,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "anti-brute-force-threshold"sv, // rpc server settings
     "anti_brute_force_enabled"sv, // rpc, rpc server settings
     "anti_brute_force_threshold"sv, // rpc server settings
+    "arena_count"sv, // rpc
     "arguments"sv, // json-rpc
     "availability"sv, // rpc
     "bandwidth-priority"sv, // .resume
@@ -70,6 +72,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "bind_address_ipv4"sv, // daemon, tr_session::Settings
     "bind_address_ipv6"sv, // daemon, tr_session::Settings
     "bitfield"sv, // .resume
+    "block_pool"sv, // rpc
     "blocklist-date"sv, // gtk app, qt app
     "blocklist-enabled"sv, // daemon, gtk app, rpc, tr_session::Settings
     "blocklist-size"sv, // rpc
@@ -83,12 +86,17 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "blocklist_updates_enabled"sv, // gtk app, qt app
     "blocklist_url"sv, // rpc, tr_session::Settings
     "blocks"sv, // .resume
+    "buffers_free"sv, // rpc
+    "buffers_in_use"sv, // rpc
     "bytesCompleted"sv, // rpc
     "bytes_completed"sv, // rpc
+    "bytes_reserved"sv, // rpc
     "bytes_to_client"sv, // rpc
     "bytes_to_peer"sv, // rpc
     "cache-size-mb"sv, // rpc, tr_session::Settings
     "cache_size_mib"sv, // rpc, tr_session::Settings
+    "change_cursor"sv, // rpc
+    "changed_since"sv, // rpc
     "clientIsChoked"sv, // rpc
     "clientIsInterested"sv, // rpc
     "clientName"sv, // rpc
@@ -174,6 +182,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "eta"sv, // rpc
     "etaIdle"sv, // rpc
     "eta_idle"sv, // rpc
+    "eviction_count"sv, // rpc
     "fields"sv, // rpc
     "file-count"sv, // rpc
     "fileStats"sv, // rpc
@@ -229,9 +238,11 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "haveValid"sv, // rpc
     "have_unchecked"sv, // rpc
     "have_valid"sv, // rpc
+    "hit_count"sv, // rpc
     "honorsSessionLimits"sv, // rpc
     "honors_session_limits"sv, // rpc
     "host"sv, // rpc
+    "huge_pages_enabled"sv, // tr_session::Settings
     "id"sv, // dht.dat, rpc
     "id_timestamp"sv, // dht.dat
     "idle-limit"sv, // .resume
@@ -338,6 +349,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "metadata_size"sv, // BEP0009; BT protocol
     "metainfo"sv, // rpc
     "method"sv, // json-rpc
+    "miss_count"sv, // rpc
     "move"sv, // rpc
     "msg_type"sv, // BT protocol
     "mtimes"sv, // .resume
@@ -350,6 +362,8 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "nodes6"sv, // dht.dat
     "open-dialog-dir"sv, // gtk app, qt app
     "open_dialog_dir"sv, // gtk app, qt app
+    "open_file_limit"sv, // tr_session::Settings, rpc
+    "open_files"sv, // rpc
     "p"sv, // BEP0010; BT protocol
     "params"sv, // json-rpc
     "path"sv, // .torrent, rpc
@@ -458,6 +472,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "ratio_limit_enabled"sv, // daemon, tr_session::Settings
     "ratio_mode"sv, // .resume
     "read-clipboard"sv, // qt app
+    "read_cache_size_mib"sv, // tr_session::Settings
     "read_clipboard"sv, // qt app
     "recently-active"sv, // rpc
     "recently_active"sv, // rpc
@@ -555,6 +570,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "seeder_count"sv, // rpc
     "seeding-time-seconds"sv, // .resume
     "seeding_time_seconds"sv, // .resume
+    "sendfile_enabled"sv, // tr_session::Settings
     "sequential_download"sv, // .resume, daemon, rpc, tr_session::Settings
     "sequential_download_from_piece"sv, // .resume, rpc
     "session-close"sv, // rpc
@@ -722,6 +738,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "utp-enabled"sv, // daemon, rpc, tr_session::Settings
     "utp_enabled"sv, // daemon, rpc, tr_session::Settings
     "v"sv, // BEP0010; BT protocol
+    "verify_threads"sv, // tr_session::Settings
     "version"sv, // rpc
     "wanted"sv, // rpc
     "watch-dir"sv, // daemon, gtk app, qt app
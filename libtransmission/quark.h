@@ -46,6 +46,7 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_added_date_camel_APICOMPAT,
     TR_KEY_added_date, /* rpc, resume file */
     TR_KEY_address, /* rpc */
+    TR_KEY_allocation_count, /* rpc */
     TR_KEY_alt_speed_down_kebab_APICOMPAT,
     TR_KEY_alt_speed_enabled_kebab_APICOMPAT,
     TR_KEY_alt_speed_time_begin_kebab_APICOMPAT,
@@ -72,6 +73,7 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_anti_brute_force_threshold_kebab_APICOMPAT,
     TR_KEY_anti_brute_force_enabled, /* rpc, settings */
     TR_KEY_anti_brute_force_threshold, /* rpc, settings */
+    TR_KEY_arena_count, /* rpc */
     TR_KEY_arguments, /* rpc */
     TR_KEY_availability, // rpc
     TR_KEY_bandwidth_priority_kebab_APICOMPAT,
@@ -83,6 +85,7 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_bind_address_ipv4,
     TR_KEY_bind_address_ipv6,
     TR_KEY_bitfield,
+    TR_KEY_block_pool, /* rpc */
     TR_KEY_blocklist_date_kebab_APICOMPAT,
     TR_KEY_blocklist_enabled_kebab_APICOMPAT,
     TR_KEY_blocklist_size_kebab_APICOMPAT,
@@ -96,12 +99,17 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_blocklist_updates_enabled,
     TR_KEY_blocklist_url,
     TR_KEY_blocks,
+    TR_KEY_buffers_free, /* rpc */
+    TR_KEY_buffers_in_use, /* rpc */
     TR_KEY_bytes_completed_camel_APICOMPAT,
     TR_KEY_bytes_completed,
+    TR_KEY_bytes_reserved, /* rpc */
     TR_KEY_bytes_to_client,
     TR_KEY_bytes_to_peer,
     TR_KEY_cache_size_mb_kebab_APICOMPAT,
     TR_KEY_cache_size_mib,
+    TR_KEY_change_cursor, /* rpc */
+    TR_KEY_changed_since, /* rpc */
     TR_KEY_client_is_choked_camel_APICOMPAT,
     TR_KEY_client_is_interested_camel_APICOMPAT,
     TR_KEY_client_name_camel_APICOMPAT,
@@ -187,6 +195,7 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_eta,
     TR_KEY_eta_idle_camel_APICOMPAT,
     TR_KEY_eta_idle,
+    TR_KEY_eviction_count, /* rpc */
     TR_KEY_fields,
     TR_KEY_file_count_kebab_APICOMPAT,
     TR_KEY_file_stats_camel_APICOMPAT,
@@ -242,9 +251,11 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_have_valid_camel_APICOMPAT,
     TR_KEY_have_unchecked,
     TR_KEY_have_valid,
+    TR_KEY_hit_count, /* rpc */
     TR_KEY_honors_session_limits_camel_APICOMPAT,
     TR_KEY_honors_session_limits,
     TR_KEY_host,
+    TR_KEY_huge_pages_enabled,
     TR_KEY_id,
     TR_KEY_id_timestamp,
     TR_KEY_idle_limit_kebab_APICOMPAT,
@@ -351,6 +362,7 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_metadata_size,
     TR_KEY_metainfo,
     TR_KEY_method,
+    TR_KEY_miss_count, /* rpc */
     TR_KEY_move,
     TR_KEY_msg_type,
     TR_KEY_mtimes,
@@ -363,6 +375,8 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_nodes6,
     TR_KEY_open_dialog_dir_kebab_APICOMPAT,
     TR_KEY_open_dialog_dir,
+    TR_KEY_open_file_limit,
+    TR_KEY_open_files, /* rpc */
     TR_KEY_p,
     TR_KEY_params,
     TR_KEY_path,
@@ -471,6 +485,7 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_ratio_limit_enabled,
     TR_KEY_ratio_mode,
     TR_KEY_read_clipboard_kebab_APICOMPAT,
+    TR_KEY_read_cache_size_mib,
     TR_KEY_read_clipboard,
     TR_KEY_recently_active_kebab_APICOMPAT,
     TR_KEY_recently_active,
@@ -568,6 +583,7 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_seeder_count,
     TR_KEY_seeding_time_seconds_kebab_APICOMPAT,
     TR_KEY_seeding_time_seconds,
+    TR_KEY_sendfile_enabled,
     TR_KEY_sequential_download,
     TR_KEY_sequential_download_from_piece,
     TR_KEY_session_close_kebab_APICOMPAT,
@@ -735,6 +751,7 @@ enum // NOLINT(performance-enum-size)
     TR_KEY_utp_enabled_kebab_APICOMPAT,
     TR_KEY_utp_enabled,
     TR_KEY_v,
+    TR_KEY_verify_threads,
     TR_KEY_version,
     TR_KEY_wanted,
     TR_KEY_watch_dir_kebab_APICOMPAT,
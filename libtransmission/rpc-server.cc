@@ -362,26 +362,47 @@ void handle_web_client(struct evhttp_request* req, tr_rpc_server const* server)
     }
 }
 
+void send_json_response(struct evhttp_request* req, tr_rpc_server const* server, std::string_view json)
+{
+    auto* const output_headers = evhttp_request_get_output_headers(req);
+    auto* const response = make_response(req, server, json);
+    evhttp_add_header(output_headers, "Content-Type", "application/json; charset=UTF-8");
+    evhttp_send_reply(req, HTTP_OK, "OK", response);
+    evbuffer_free(response);
+}
+
 void handle_rpc_from_json(struct evhttp_request* req, tr_rpc_server* server, std::string_view json)
 {
-    tr_rpc_request_exec(
-        server->session,
-        json,
-        // NOLINTNEXTLINE(cppcoreguidelines-rvalue-reference-param-not-moved)
-        [req, server](tr_variant&& content)
+    // NOLINTNEXTLINE(cppcoreguidelines-rvalue-reference-param-not-moved)
+    auto on_response = [req, server](tr_variant&& content)
+    {
+        if (!content.has_value())
         {
-            if (!content.has_value())
-            {
-                evhttp_send_reply(req, HTTP_NOCONTENT, "OK", nullptr);
-                return;
-            }
+            evhttp_send_reply(req, HTTP_NOCONTENT, "OK", nullptr);
+            return;
+        }
 
-            auto* const output_headers = evhttp_request_get_output_headers(req);
-            auto* const response = make_response(req, server, tr_variant_serde::json().compact().to_string(content));
-            evhttp_add_header(output_headers, "Content-Type", "application/json; charset=UTF-8");
-            evhttp_send_reply(req, HTTP_OK, "OK", response);
-            evbuffer_free(response);
-        });
+        send_json_response(req, server, tr_variant_serde::json().compact().to_string(content));
+    };
+
+    auto serde = tr_variant_serde::json().inplace();
+    auto request = serde.parse(json);
+    if (!request)
+    {
+        // let tr_rpc_request_exec() report the parse error
+        tr_rpc_request_exec(server->session, json, std::move(on_response));
+        return;
+    }
+
+    // Clients poll torrent_get often and its replies can be large,
+    // so write those straight to JSON instead of via a tr_variant.
+    if (tr_rpc_torrent_get_to_json(server->session, *request, server->json_buf_))
+    {
+        send_json_response(req, server, server->json_buf_);
+        return;
+    }
+
+    tr_rpc_request_exec(server->session, *request, std::move(on_response));
 }
 
 void handle_rpc(struct evhttp_request* req, tr_rpc_server* server)
@@ -207,6 +207,9 @@ public:
     tr::evhelpers::evhttp_unique_ptr httpd;
     tr_session* const session;
 
+    // Reused across torrent_get replies so that each poll doesn't regrow it.
+    std::string json_buf_;
+
     size_t login_attempts_ = 0U;
     int start_retry_counter = 0;
 };
@@ -10,9 +10,11 @@
 #include <ctime>
 #include <filesystem>
 #include <functional>
+#include <initializer_list>
 #include <iterator>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <set>
 #include <string>
@@ -26,9 +28,12 @@
 
 #include <libdeflate.h>
 
+#include <rapidjson/writer.h>
+
 #include "libtransmission/transmission.h"
 
 #include "libtransmission/announcer.h"
+#include "libtransmission/block-pool.h"
 #include "libtransmission/crypto-utils.h"
 #include "libtransmission/error.h"
 #include "libtransmission/file-utils.h"
@@ -702,373 +707,506 @@ namespace make_torrent_field_helpers
 }
 } // namespace make_torrent_field_helpers
 
-[[nodiscard]] auto constexpr isSupportedTorrentGetField(tr_quark key)
+// The torrent-get fields that are built from the torrent's tr_stat.
+// tr_torrentStat() isn't free, so skip it when no requested field is here.
+using TorrentStatField = std::pair<tr_quark, tr_variant (*)(tr_stat const& st)>;
+auto constexpr TorrentStatFields = std::array<TorrentStatField, 35U>{ {
+    { TR_KEY_activity_date, [](tr_stat const& st) -> tr_variant { return st.activity_date; } },
+    { TR_KEY_added_date, [](tr_stat const& st) -> tr_variant { return st.added_date; } },
+    { TR_KEY_corrupt_ever, [](tr_stat const& st) -> tr_variant { return st.corrupt_ever; } },
+    { TR_KEY_desired_available, [](tr_stat const& st) -> tr_variant { return st.desired_available; } },
+    { TR_KEY_done_date, [](tr_stat const& st) -> tr_variant { return st.done_date; } },
+    { TR_KEY_downloaded_ever, [](tr_stat const& st) -> tr_variant { return st.downloaded_ever; } },
+    { TR_KEY_edit_date, [](tr_stat const& st) -> tr_variant { return st.edit_date; } },
+    { TR_KEY_error, [](tr_stat const& st) -> tr_variant { return st.error; } },
+    { TR_KEY_error_string, [](tr_stat const& st) -> tr_variant { return st.error_string; } },
+    { TR_KEY_eta, [](tr_stat const& st) -> tr_variant { return st.eta; } },
+    { TR_KEY_eta_idle, [](tr_stat const& st) -> tr_variant { return st.eta_idle; } },
+    { TR_KEY_have_unchecked, [](tr_stat const& st) -> tr_variant { return st.have_unchecked; } },
+    { TR_KEY_have_valid, [](tr_stat const& st) -> tr_variant { return st.have_valid; } },
+    { TR_KEY_is_finished, [](tr_stat const& st) -> tr_variant { return st.finished; } },
+    { TR_KEY_is_stalled, [](tr_stat const& st) -> tr_variant { return st.is_stalled; } },
+    { TR_KEY_left_until_done, [](tr_stat const& st) -> tr_variant { return st.left_until_done; } },
+    { TR_KEY_metadata_percent_complete, [](tr_stat const& st) -> tr_variant { return st.metadata_percent_complete; } },
+    { TR_KEY_peers_connected, [](tr_stat const& st) -> tr_variant { return st.peers_connected; } },
+    { TR_KEY_peers_from, [](tr_stat const& st) -> tr_variant { return make_torrent_field_helpers::make_peer_counts_map(st); } },
+    { TR_KEY_peers_getting_from_us, [](tr_stat const& st) -> tr_variant { return st.peers_getting_from_us; } },
+    { TR_KEY_peers_sending_to_us, [](tr_stat const& st) -> tr_variant { return st.peers_sending_to_us; } },
+    { TR_KEY_percent_complete, [](tr_stat const& st) -> tr_variant { return st.percent_complete; } },
+    { TR_KEY_percent_done, [](tr_stat const& st) -> tr_variant { return st.percent_done; } },
+    { TR_KEY_queue_position, [](tr_stat const& st) -> tr_variant { return st.queue_position; } },
+    { TR_KEY_rate_download, [](tr_stat const& st) -> tr_variant { return st.piece_download_speed.base_quantity(); } },
+    { TR_KEY_rate_upload, [](tr_stat const& st) -> tr_variant { return st.piece_upload_speed.base_quantity(); } },
+    { TR_KEY_recheck_progress, [](tr_stat const& st) -> tr_variant { return st.recheck_progress; } },
+    { TR_KEY_seconds_downloading, [](tr_stat const& st) -> tr_variant { return st.seconds_downloading; } },
+    { TR_KEY_seconds_seeding, [](tr_stat const& st) -> tr_variant { return st.seconds_seeding; } },
+    { TR_KEY_size_when_done, [](tr_stat const& st) -> tr_variant { return st.size_when_done; } },
+    { TR_KEY_start_date, [](tr_stat const& st) -> tr_variant { return st.start_date; } },
+    { TR_KEY_status, [](tr_stat const& st) -> tr_variant { return st.activity; } },
+    { TR_KEY_upload_ratio, [](tr_stat const& st) -> tr_variant { return st.upload_ratio; } },
+    { TR_KEY_uploaded_ever, [](tr_stat const& st) -> tr_variant { return st.uploaded_ever; } },
+    { TR_KEY_webseeds_sending_to_us, [](tr_stat const& st) -> tr_variant { return st.webseeds_sending_to_us; } },
+} };
+
+[[nodiscard]] constexpr auto findTorrentStatField(tr_quark const key) noexcept
+{
+    auto const iter = std::ranges::find(TorrentStatFields, key, &TorrentStatField::first);
+    return iter != std::ranges::end(TorrentStatFields) ? iter->second : nullptr;
+}
+
+// The torrent-get fields that are built from the torrent itself.
+using TorrentField = tr_variant (*)(tr_torrent const& tor);
+
+[[nodiscard]] TorrentField findTorrentField(tr_quark const key) noexcept
 {
+    using namespace make_torrent_field_helpers;
+
     switch (key)
     {
-    case TR_KEY_activity_date:
-    case TR_KEY_added_date:
     case TR_KEY_availability:
+        return [](tr_torrent const& tor) -> tr_variant { return make_piece_availability_vec(tor); };
     case TR_KEY_bandwidth_priority:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.get_priority(); };
     case TR_KEY_bytes_completed:
+        return [](tr_torrent const& tor) -> tr_variant { return make_bytes_completed_vec(tor); };
     case TR_KEY_comment:
-    case TR_KEY_corrupt_ever:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.comment(); };
     case TR_KEY_creator:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.creator(); };
     case TR_KEY_date_created:
-    case TR_KEY_desired_available:
-    case TR_KEY_done_date:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.date_created(); };
     case TR_KEY_download_dir:
+        return [](tr_torrent const& tor) -> tr_variant { return tr_variant::unmanaged_string(tor.download_dir().sv()); };
     case TR_KEY_download_limit:
+        return [](tr_torrent const& tor) -> tr_variant { return tr_torrentGetSpeedLimit_KBps(&tor, tr_direction::Down); };
     case TR_KEY_download_limited:
-    case TR_KEY_downloaded_ever:
-    case TR_KEY_edit_date:
-    case TR_KEY_error:
-    case TR_KEY_error_string:
-    case TR_KEY_eta:
-    case TR_KEY_eta_idle:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.uses_speed_limit(tr_direction::Down); };
     case TR_KEY_file_count:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.file_count(); };
     case TR_KEY_file_stats:
+        return [](tr_torrent const& tor) -> tr_variant { return make_file_stats_vec(tor); };
     case TR_KEY_files:
+        return [](tr_torrent const& tor) -> tr_variant { return make_file_vec(tor); };
     case TR_KEY_group:
+        return [](tr_torrent const& tor) -> tr_variant { return tr_variant::unmanaged_string(tor.bandwidth_group().sv()); };
     case TR_KEY_hash_string:
-    case TR_KEY_have_unchecked:
-    case TR_KEY_have_valid:
+        return [](tr_torrent const& tor) -> tr_variant { return tr_variant::unmanaged_string(tor.info_hash_string().sv()); };
     case TR_KEY_honors_session_limits:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.uses_session_limits(); };
     case TR_KEY_id:
-    case TR_KEY_is_finished:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.id(); };
     case TR_KEY_is_private:
-    case TR_KEY_is_stalled:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.is_private(); };
     case TR_KEY_labels:
-    case TR_KEY_left_until_done:
+        return [](tr_torrent const& tor) -> tr_variant { return make_labels_vec(tor); };
     case TR_KEY_magnet_link:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.magnet(); };
     case TR_KEY_manual_announce_time:
+        return [](tr_torrent const& tor) -> tr_variant { return tr_announcerNextManualAnnounce(&tor); };
     case TR_KEY_max_connected_peers:
-    case TR_KEY_metadata_percent_complete:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.peer_limit(); };
     case TR_KEY_name:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.name(); };
     case TR_KEY_peer_limit:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.peer_limit(); };
     case TR_KEY_peers:
-    case TR_KEY_peers_connected:
-    case TR_KEY_peers_from:
-    case TR_KEY_peers_getting_from_us:
-    case TR_KEY_peers_sending_to_us:
-    case TR_KEY_percent_complete:
-    case TR_KEY_percent_done:
+        return [](tr_torrent const& tor) -> tr_variant { return make_peer_vec(tor); };
     case TR_KEY_piece_count:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.piece_count(); };
     case TR_KEY_piece_size:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.piece_size(); };
     case TR_KEY_pieces:
+        return [](tr_torrent const& tor) -> tr_variant { return make_piece_bitfield(tor); };
     case TR_KEY_primary_mime_type:
+        return [](tr_torrent const& tor) -> tr_variant { return tr_variant::unmanaged_string(tor.primary_mime_type()); };
     case TR_KEY_priorities:
-    case TR_KEY_queue_position:
-    case TR_KEY_rate_download:
-    case TR_KEY_rate_upload:
-    case TR_KEY_recheck_progress:
-    case TR_KEY_seconds_downloading:
-    case TR_KEY_seconds_seeding:
+        return [](tr_torrent const& tor) -> tr_variant { return make_file_priorities_vec(tor); };
     case TR_KEY_seed_idle_limit:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.idle_limit_minutes(); };
     case TR_KEY_seed_idle_mode:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.idle_limit_mode(); };
     case TR_KEY_seed_ratio_limit:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.seed_ratio(); };
     case TR_KEY_seed_ratio_mode:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.seed_ratio_mode(); };
     case TR_KEY_sequential_download:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.is_sequential_download(); };
     case TR_KEY_sequential_download_from_piece:
-    case TR_KEY_size_when_done:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.sequential_download_from_piece(); };
     case TR_KEY_source:
-    case TR_KEY_start_date:
-    case TR_KEY_status:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.source(); };
     case TR_KEY_torrent_file:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.torrent_file(); };
     case TR_KEY_total_size:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.total_size(); };
     case TR_KEY_tracker_list:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.announce_list().to_string(); };
     case TR_KEY_tracker_stats:
+        return [](tr_torrent const& tor) -> tr_variant { return make_tracker_stats_vec(tor); };
     case TR_KEY_trackers:
+        return [](tr_torrent const& tor) -> tr_variant { return make_tracker_vec(tor); };
     case TR_KEY_upload_limit:
+        return [](tr_torrent const& tor) -> tr_variant { return tr_torrentGetSpeedLimit_KBps(&tor, tr_direction::Up); };
     case TR_KEY_upload_limited:
-    case TR_KEY_upload_ratio:
-    case TR_KEY_uploaded_ever:
+        return [](tr_torrent const& tor) -> tr_variant { return tor.uses_speed_limit(tr_direction::Up); };
     case TR_KEY_wanted:
+        return [](tr_torrent const& tor) -> tr_variant { return make_file_wanted_vec(tor); };
     case TR_KEY_webseeds:
+        return [](tr_torrent const& tor) -> tr_variant { return make_webseed_vec(tor); };
     case TR_KEY_webseeds_ex:
-    case TR_KEY_webseeds_sending_to_us:
-        return true;
-
+        return [](tr_torrent const& tor) -> tr_variant { return make_webseed_ex_vec(tor); };
     default:
-        return false;
+        return nullptr;
     }
 }
 
-[[nodiscard]] tr_variant make_torrent_field(tr_torrent const& tor, tr_stat const& st, tr_quark key)
+// What torrent-get needs to build each torrent's entry.
+// Worked out once per request instead of once per torrent.
+struct TorrentGetPlan
 {
-    using namespace make_torrent_field_helpers;
+    // One requested field, resolved to the function that builds it.
+    // Exactly one of `make_stat_field` and `make_torrent_field` is set.
+    struct Field
+    {
+        tr_quark key;
+        tr_variant (*make_stat_field)(tr_stat const& st) = nullptr;
+        TorrentField make_torrent_field = nullptr;
 
-    TR_ASSERT(isSupportedTorrentGetField(key));
+        [[nodiscard]] tr_variant make(tr_torrent const& tor, tr_stat const& st) const
+        {
+            return make_stat_field != nullptr ? make_stat_field(st) : make_torrent_field(tor);
+        }
+    };
 
-    switch (key)
+    TorrentGetPlan() = default;
+
+    TorrentGetPlan(std::initializer_list<tr_quark> const keys, TrFormat const format_in)
+        : format{ format_in }
     {
-    case TR_KEY_activity_date:
-        return st.activity_date;
-    case TR_KEY_added_date:
-        return st.added_date;
-    case TR_KEY_availability:
-        return make_piece_availability_vec(tor);
-    case TR_KEY_bandwidth_priority:
-        return tor.get_priority();
-    case TR_KEY_bytes_completed:
-        return make_bytes_completed_vec(tor);
-    case TR_KEY_comment:
-        return tor.comment();
-    case TR_KEY_corrupt_ever:
-        return st.corrupt_ever;
-    case TR_KEY_creator:
-        return tor.creator();
-    case TR_KEY_date_created:
-        return tor.date_created();
-    case TR_KEY_desired_available:
-        return st.desired_available;
-    case TR_KEY_done_date:
-        return st.done_date;
-    case TR_KEY_download_dir:
-        return tr_variant::unmanaged_string(tor.download_dir().sv());
-    case TR_KEY_download_limit:
-        return tr_torrentGetSpeedLimit_KBps(&tor, tr_direction::Down);
-    case TR_KEY_download_limited:
-        return tor.uses_speed_limit(tr_direction::Down);
-    case TR_KEY_downloaded_ever:
-        return st.downloaded_ever;
-    case TR_KEY_edit_date:
-        return st.edit_date;
-    case TR_KEY_error:
-        return st.error;
-    case TR_KEY_error_string:
-        return st.error_string;
-    case TR_KEY_eta:
-        return st.eta;
-    case TR_KEY_eta_idle:
-        return st.eta_idle;
-    case TR_KEY_file_count:
-        return tor.file_count();
-    case TR_KEY_file_stats:
-        return make_file_stats_vec(tor);
-    case TR_KEY_files:
-        return make_file_vec(tor);
-    case TR_KEY_group:
-        return tr_variant::unmanaged_string(tor.bandwidth_group().sv());
-    case TR_KEY_hash_string:
-        return tr_variant::unmanaged_string(tor.info_hash_string().sv());
-    case TR_KEY_have_unchecked:
-        return st.have_unchecked;
-    case TR_KEY_have_valid:
-        return st.have_valid;
-    case TR_KEY_honors_session_limits:
-        return tor.uses_session_limits();
-    case TR_KEY_id:
-        return st.id;
-    case TR_KEY_is_finished:
-        return st.finished;
-    case TR_KEY_is_private:
-        return tor.is_private();
-    case TR_KEY_is_stalled:
-        return st.is_stalled;
-    case TR_KEY_labels:
-        return make_labels_vec(tor);
-    case TR_KEY_left_until_done:
-        return st.left_until_done;
-    case TR_KEY_magnet_link:
-        return tor.magnet();
-    case TR_KEY_manual_announce_time:
-        return tr_announcerNextManualAnnounce(&tor);
-    case TR_KEY_max_connected_peers:
-        return tor.peer_limit();
-    case TR_KEY_metadata_percent_complete:
-        return st.metadata_percent_complete;
-    case TR_KEY_name:
-        return tor.name();
-    case TR_KEY_peer_limit:
-        return tor.peer_limit();
-    case TR_KEY_peers:
-        return make_peer_vec(tor);
-    case TR_KEY_peers_connected:
-        return st.peers_connected;
-    case TR_KEY_peers_from:
-        return make_peer_counts_map(st);
-    case TR_KEY_peers_getting_from_us:
-        return st.peers_getting_from_us;
-    case TR_KEY_peers_sending_to_us:
-        return st.peers_sending_to_us;
-    case TR_KEY_percent_complete:
-        return st.percent_complete;
-    case TR_KEY_percent_done:
-        return st.percent_done;
-    case TR_KEY_piece_count:
-        return tor.piece_count();
-    case TR_KEY_piece_size:
-        return tor.piece_size();
-    case TR_KEY_pieces:
-        return make_piece_bitfield(tor);
-    case TR_KEY_primary_mime_type:
-        return tr_variant::unmanaged_string(tor.primary_mime_type());
-    case TR_KEY_priorities:
-        return make_file_priorities_vec(tor);
-    case TR_KEY_queue_position:
-        return st.queue_position;
-    case TR_KEY_rate_download:
-        return st.piece_download_speed.base_quantity();
-    case TR_KEY_rate_upload:
-        return st.piece_upload_speed.base_quantity();
-    case TR_KEY_recheck_progress:
-        return st.recheck_progress;
-    case TR_KEY_seconds_downloading:
-        return st.seconds_downloading;
-    case TR_KEY_seconds_seeding:
-        return st.seconds_seeding;
-    case TR_KEY_seed_idle_limit:
-        return tor.idle_limit_minutes();
-    case TR_KEY_seed_idle_mode:
-        return tor.idle_limit_mode();
-    case TR_KEY_seed_ratio_limit:
-        return tor.seed_ratio();
-    case TR_KEY_seed_ratio_mode:
-        return tor.seed_ratio_mode();
-    case TR_KEY_sequential_download:
-        return tor.is_sequential_download();
-    case TR_KEY_sequential_download_from_piece:
-        return tor.sequential_download_from_piece();
-    case TR_KEY_size_when_done:
-        return st.size_when_done;
-    case TR_KEY_source:
-        return tor.source();
-    case TR_KEY_start_date:
-        return st.start_date;
-    case TR_KEY_status:
-        return st.activity;
-    case TR_KEY_torrent_file:
-        return tor.torrent_file();
-    case TR_KEY_total_size:
-        return tor.total_size();
-    case TR_KEY_tracker_list:
-        return tor.announce_list().to_string();
-    case TR_KEY_tracker_stats:
-        return make_tracker_stats_vec(tor);
-    case TR_KEY_trackers:
-        return make_tracker_vec(tor);
-    case TR_KEY_upload_limit:
-        return tr_torrentGetSpeedLimit_KBps(&tor, tr_direction::Up);
-    case TR_KEY_upload_limited:
-        return tor.uses_speed_limit(tr_direction::Up);
-    case TR_KEY_upload_ratio:
-        return st.upload_ratio;
-    case TR_KEY_uploaded_ever:
-        return st.uploaded_ever;
-    case TR_KEY_wanted:
-        return make_file_wanted_vec(tor);
-    case TR_KEY_webseeds:
-        return make_webseed_vec(tor);
-    case TR_KEY_webseeds_ex:
-        return make_webseed_ex_vec(tor);
-    case TR_KEY_webseeds_sending_to_us:
-        return st.webseeds_sending_to_us;
-    default:
-        return tr_variant{};
+        for (auto const key : keys)
+        {
+            [[maybe_unused]] auto const added = add(key);
+            TR_ASSERT(added);
+        }
     }
-}
 
-[[nodiscard]] auto make_torrent_info_map(tr_torrent* const tor, tr_quark const* const fields, size_t const field_count)
+    // Returns false if `key` isn't a torrent-get field.
+    bool add(tr_quark const key)
+    {
+        // an object can only have one entry per key
+        if (format == TrFormat::Object && std::ranges::find(fields, key, &Field::key) != std::ranges::end(fields))
+        {
+            return true;
+        }
+
+        if (auto const make_stat_field = findTorrentStatField(key); make_stat_field != nullptr)
+        {
+            fields.push_back({ key, make_stat_field, nullptr });
+            needs_stat = true;
+            return true;
+        }
+
+        if (auto const make_torrent_field = findTorrentField(key); make_torrent_field != nullptr)
+        {
+            fields.push_back({ key, nullptr, make_torrent_field });
+            return true;
+        }
+
+        return false;
+    }
+
+    std::vector<Field> fields;
+    TrFormat format = TrFormat::Object;
+    bool needs_stat = false;
+};
+
+[[nodiscard]] auto make_torrent_info_map(tr_torrent const& tor, tr_stat const& st, TorrentGetPlan const& plan)
 {
-    auto const st = tr_torrentStat(tor);
-    auto info_map = tr_variant::Map{ field_count };
-    for (size_t i = 0; i < field_count; ++i)
+    auto info_map = tr_variant::Map{ std::size(plan.fields) };
+    for (auto const& field : plan.fields)
     {
-        info_map.try_emplace(fields[i], make_torrent_field(*tor, st, fields[i]));
+        info_map.try_emplace(field.key, field.make(tor, st));
     }
     return tr_variant{ std::move(info_map) };
 }
 
-[[nodiscard]] auto make_torrent_info_vec(tr_torrent* const tor, tr_quark const* const fields, size_t const field_count)
+[[nodiscard]] auto make_torrent_info_vec(tr_torrent const& tor, tr_stat const& st, TorrentGetPlan const& plan)
 {
-    auto const st = tr_torrentStat(tor);
     auto info_vec = tr_variant::Vector{};
-    info_vec.reserve(field_count);
-    for (size_t i = 0; i < field_count; ++i)
+    info_vec.reserve(std::size(plan.fields));
+    for (auto const& field : plan.fields)
     {
-        info_vec.emplace_back(make_torrent_field(*tor, st, fields[i]));
+        info_vec.emplace_back(field.make(tor, st));
     }
     return tr_variant{ std::move(info_vec) };
 }
 
-[[nodiscard]] auto make_torrent_info(
-    tr_torrent* const tor,
-    TrFormat const format,
-    tr_quark const* const fields,
-    size_t const field_count)
+[[nodiscard]] auto make_torrent_info(tr_torrent* const tor, TorrentGetPlan const& plan)
 {
-    return format == TrFormat::Table ? make_torrent_info_vec(tor, fields, field_count) :
-                                       make_torrent_info_map(tor, fields, field_count);
+    auto const st = plan.needs_stat ? tr_torrentStat(tor) : tr_stat{};
+    return plan.format == TrFormat::Table ? make_torrent_info_vec(*tor, st, plan) : make_torrent_info_map(*tor, st, plan);
 }
 
-[[nodiscard]] std::pair<JsonRpc::Error::Code, std::string> torrentGet(
-    tr_session* session,
-    tr_variant::Map const& args_in,
-    tr_variant::Map& args_out)
+// What a torrent_get request asks for. This is shared by
+// torrentGet() and the streaming reply in tr_rpc_torrent_get_to_json().
+struct TorrentGetRequest
 {
-    using namespace JsonRpc;
+    std::vector<tr_torrent*> torrents;
+    TorrentGetPlan plan;
+    std::optional<time_t> change_cursor;
+    std::optional<std::vector<tr_torrent_id_t>> removed;
+};
 
-    auto const torrents = getTorrents(session, args_in);
-    auto torrents_vec = tr_variant::Vector{};
+[[nodiscard]] TorrentGetRequest parseTorrentGet(tr_session* session, tr_variant::Map const& args_in)
+{
+    auto ret = TorrentGetRequest{};
+    auto& torrents = ret.torrents;
+    auto& plan = ret.plan;
+
+    torrents = getTorrents(session, args_in);
+
+    plan.format = args_in.value_if<std::string_view>(TR_KEY_format).value_or("object"sv) == "table"sv ? TrFormat::Table :
+                                                                                                         TrFormat::Object;
 
-    auto const format = args_in.value_if<std::string_view>(TR_KEY_format).value_or("object"sv) == "table"sv ? TrFormat::Table :
-                                                                                                              TrFormat::Object;
+    auto removed_cutoff = std::optional<time_t>{};
 
     if (auto val = args_in.value_if<std::string_view>(TR_KEY_ids); val == tr_quark_get_string_view(TR_KEY_recently_active))
     {
-        auto const cutoff = tr_time() - RecentlyActiveSeconds;
-        auto const ids = session->torrents().removedSince(cutoff);
+        removed_cutoff = tr_time() - RecentlyActiveSeconds;
+    }
 
-        auto removed_vec = tr_variant::Vector{};
-        removed_vec.reserve(std::size(ids));
-        for (auto const& id : ids)
-        {
-            removed_vec.emplace_back(id);
-        }
-        args_out.try_emplace(TR_KEY_removed, std::move(removed_vec));
+    // Let clients poll for just what's changed since their last poll.
+    // Change times are only tracked to the second, so torrents changed
+    // during the cursor's second are sent again rather than risk missing one.
+    if (auto const changed_since = args_in.value_if<int64_t>(TR_KEY_changed_since))
+    {
+        auto const cutoff = static_cast<time_t>(*changed_since);
+        std::erase_if(torrents, [cutoff](tr_torrent const* tor) { return !tor->has_changed_since(cutoff - 1); });
+        removed_cutoff = std::min(removed_cutoff.value_or(cutoff), cutoff);
+        ret.change_cursor = tr_time();
+    }
+
+    if (removed_cutoff)
+    {
+        ret.removed = session->torrents().removedSince(*removed_cutoff);
     }
 
-    auto keys = std::vector<tr_quark>{};
     if (auto const* const fields_vec = args_in.find_if<tr_variant::Vector>(TR_KEY_fields); fields_vec != nullptr)
     {
-        auto const n_fields = std::size(*fields_vec);
-        keys.reserve(n_fields);
+        plan.fields.reserve(std::size(*fields_vec));
         for (auto const& field : *fields_vec)
         {
             if (auto const field_sv = field.value_if<std::string_view>())
             {
-                if (auto const key = tr_quark_lookup(*field_sv); key && isSupportedTorrentGetField(*key))
+                if (auto const key = tr_quark_lookup(*field_sv); key)
                 {
-                    keys.emplace_back(*key);
+                    plan.add(*key);
                 }
             }
         }
     }
 
-    if (std::empty(keys))
+    return ret;
+}
+
+[[nodiscard]] std::pair<JsonRpc::Error::Code, std::string> torrentGet(
+    tr_session* session,
+    tr_variant::Map const& args_in,
+    tr_variant::Map& args_out)
+{
+    using namespace JsonRpc;
+
+    auto const [torrents, plan, change_cursor, removed] = parseTorrentGet(session, args_in);
+
+    if (change_cursor)
+    {
+        args_out.try_emplace(TR_KEY_change_cursor, *change_cursor);
+    }
+
+    if (removed)
+    {
+        auto removed_vec = tr_variant::Vector{};
+        removed_vec.reserve(std::size(*removed));
+        for (auto const& id : *removed)
+        {
+            removed_vec.emplace_back(id);
+        }
+        args_out.try_emplace(TR_KEY_removed, std::move(removed_vec));
+    }
+
+    if (std::empty(plan.fields))
     {
         return { Error::INVALID_PARAMS, "no fields specified"s };
     }
 
-    if (format == TrFormat::Table)
+    auto torrents_vec = tr_variant::Vector{};
+    torrents_vec.reserve(std::size(torrents) + 1U);
+
+    if (plan.format == TrFormat::Table)
     {
         /* first entry is an array of property names */
         auto names = tr_variant::Vector{};
-        names.reserve(std::size(keys));
-        std::ranges::transform(keys, std::back_inserter(names), [](tr_quark key) { return tr_quark_get_string_view(key); });
+        names.reserve(std::size(plan.fields));
+        std::ranges::transform(
+            plan.fields,
+            std::back_inserter(names),
+            [](auto const& field) { return tr_variant::unmanaged_string(tr_quark_get_string_view(field.key)); });
         torrents_vec.emplace_back(std::move(names));
     }
 
     for (auto* const tor : torrents)
     {
-        torrents_vec.emplace_back(make_torrent_info(tor, format, std::data(keys), std::size(keys)));
+        torrents_vec.emplace_back(make_torrent_info(tor, plan));
     }
 
     args_out.try_emplace(TR_KEY_torrents, std::move(torrents_vec));
     return { Error::SUCCESS, {} }; // no error message
 }
 
+namespace torrent_get_json_helpers
+{
+// implements RapidJSON's write-only stream concept by appending to a std::string.
+// See <rapidjson/stream.h> for details.
+struct StringOutputStream
+{
+    using Ch = char;
+
+    void Put(Ch const ch)
+    {
+        str.push_back(ch);
+    }
+
+    void Flush()
+    {
+    }
+
+    std::string& str;
+};
+
+using Writer = rapidjson::Writer<StringOutputStream>;
+
+void write_string(Writer& writer, std::string_view const sv)
+{
+    // Writer::String() asserts that its pointer isn't nullptr, even when empty
+    char const* data = std::data(sv);
+    writer.String(data != nullptr ? data : "", static_cast<rapidjson::SizeType>(std::size(sv)));
+}
+
+void write_key(Writer& writer, tr_quark const key)
+{
+    auto const sv = tr_quark_get_string_view(key);
+    writer.Key(std::data(sv), static_cast<rapidjson::SizeType>(std::size(sv)));
+}
+
+void write_value(Writer& writer, tr_variant const& var)
+{
+    switch (var.index())
+    {
+    case tr_variant::BoolIndex:
+        writer.Bool(*var.get_if<tr_variant::BoolIndex>());
+        break;
+    case tr_variant::IntIndex:
+        writer.Int64(*var.get_if<tr_variant::IntIndex>());
+        break;
+    case tr_variant::DoubleIndex:
+        writer.Double(*var.get_if<tr_variant::DoubleIndex>());
+        break;
+    case tr_variant::StringIndex:
+    case tr_variant::StringViewIndex:
+        write_string(writer, *var.value_if<std::string_view>());
+        break;
+    case tr_variant::VectorIndex:
+    case tr_variant::MapIndex:
+        {
+            // Few fields are lists, e.g. `files` or `trackers`.
+            // They're built as a tr_variant and serialized in place.
+            auto const json = tr_variant_serde::json().compact().to_string(var);
+            auto const type = var.index() == tr_variant::VectorIndex ? rapidjson::kArrayType : rapidjson::kObjectType;
+            writer.RawValue(std::data(json), std::size(json), type);
+            break;
+        }
+    default:
+        writer.Null();
+        break;
+    }
+}
+
+// Writes the same response that tr_rpc_request_exec() would build,
+// one field at a time, instead of building a tr_variant tree for it.
+void write_torrent_get_response(Writer& writer, tr_variant const& id, TorrentGetRequest const& request)
+{
+    auto const& [torrents, plan, change_cursor, removed] = request;
+
+    writer.StartObject();
+    write_key(writer, TR_KEY_jsonrpc);
+    write_string(writer, JsonRpc::Version);
+    write_key(writer, TR_KEY_result);
+    writer.StartObject();
+
+    if (change_cursor)
+    {
+        write_key(writer, TR_KEY_change_cursor);
+        writer.Int64(*change_cursor);
+    }
+
+    if (removed)
+    {
+        write_key(writer, TR_KEY_removed);
+        writer.StartArray();
+        for (auto const torrent_id : *removed)
+        {
+            writer.Int64(torrent_id);
+        }
+        writer.EndArray();
+    }
+
+    write_key(writer, TR_KEY_torrents);
+    writer.StartArray();
+
+    if (plan.format == TrFormat::Table)
+    {
+        /* first entry is an array of property names */
+        writer.StartArray();
+        for (auto const& field : plan.fields)
+        {
+            write_string(writer, tr_quark_get_string_view(field.key));
+        }
+        writer.EndArray();
+    }
+
+    for (auto* const tor : torrents)
+    {
+        auto const st = plan.needs_stat ? tr_torrentStat(tor) : tr_stat{};
+
+        if (plan.format == TrFormat::Table)
+        {
+            writer.StartArray();
+            for (auto const& field : plan.fields)
+            {
+                write_value(writer, field.make(*tor, st));
+            }
+            writer.EndArray();
+        }
+        else
+        {
+            writer.StartObject();
+            for (auto const& field : plan.fields)
+            {
+                write_key(writer, field.key);
+                write_value(writer, field.make(*tor, st));
+            }
+            writer.EndObject();
+        }
+    }
+
+    writer.EndArray();
+    writer.EndObject();
+    write_key(writer, TR_KEY_id);
+    write_value(writer, id);
+    writer.EndObject();
+}
+} // namespace torrent_get_json_helpers
+
 // ---
 
 [[nodiscard]] std::tuple<tr_torrent::labels_t, JsonRpc::Error::Code, std::string> make_labels(
@@ -1666,24 +1804,16 @@ void add_torrent_impl(struct tr_rpc_idle_data* data, tr_ctor& ctor)
         return;
     }
 
-    static auto constexpr Fields = std::array<tr_quark, 3U>{
-        TR_KEY_id,
-        TR_KEY_name,
-        TR_KEY_hash_string,
-    };
+    auto const plan = TorrentGetPlan{ { TR_KEY_id, TR_KEY_name, TR_KEY_hash_string }, TrFormat::Object };
     if (duplicate_of != nullptr)
     {
-        data->args_out.try_emplace(
-            TR_KEY_torrent_duplicate,
-            make_torrent_info(duplicate_of, TrFormat::Object, std::data(Fields), std::size(Fields)));
+        data->args_out.try_emplace(TR_KEY_torrent_duplicate, make_torrent_info(duplicate_of, plan));
         tr_rpc_idle_done(data, Error::SUCCESS, {});
         return;
     }
 
     data->session->rpcNotify(TR_RPC_TORRENT_ADDED, tor);
-    data->args_out.try_emplace(
-        TR_KEY_torrent_added,
-        make_torrent_info(tor, TrFormat::Object, std::data(Fields), std::size(Fields)));
+    data->args_out.try_emplace(TR_KEY_torrent_added, make_torrent_info(tor, plan));
     tr_rpc_idle_done(data, Error::SUCCESS, {});
 }
 
@@ -2014,11 +2144,30 @@ void add_strings_from_var(std::set<std::string_view>& strings, tr_variant const&
         std::end(torrents),
         [](auto const* tor) { return tor->is_running(); });
 
-    args_out.reserve(std::size(args_out) + 7U);
+    auto const pool_stats = tr_block_pool::instance().stats();
+    auto pool_map = tr_variant::Map{ 5U };
+    pool_map.try_emplace(TR_KEY_allocation_count, pool_stats.allocation_count);
+    pool_map.try_emplace(TR_KEY_arena_count, pool_stats.arena_count);
+    pool_map.try_emplace(TR_KEY_buffers_free, pool_stats.buffers_free);
+    pool_map.try_emplace(TR_KEY_buffers_in_use, pool_stats.buffers_in_use);
+    pool_map.try_emplace(TR_KEY_bytes_reserved, pool_stats.bytes_reserved);
+
+    auto const& open_files = session->openFiles();
+    auto const files_stats = open_files.stats();
+    auto files_map = tr_variant::Map{ 5U };
+    files_map.try_emplace(TR_KEY_eviction_count, files_stats.evictions);
+    files_map.try_emplace(TR_KEY_file_count, std::size(open_files));
+    files_map.try_emplace(TR_KEY_hit_count, files_stats.hits);
+    files_map.try_emplace(TR_KEY_miss_count, files_stats.misses);
+    files_map.try_emplace(TR_KEY_open_file_limit, open_files.limit());
+
+    args_out.reserve(std::size(args_out) + 9U);
     args_out.try_emplace(TR_KEY_active_torrent_count, n_running);
+    args_out.try_emplace(TR_KEY_block_pool, std::move(pool_map));
     args_out.try_emplace(TR_KEY_cumulative_stats, make_stats_map(session->stats().cumulative()));
     args_out.try_emplace(TR_KEY_current_stats, make_stats_map(session->stats().current()));
     args_out.try_emplace(TR_KEY_download_speed, session->piece_speed(tr_direction::Down).base_quantity());
+    args_out.try_emplace(TR_KEY_open_files, std::move(files_map));
     args_out.try_emplace(TR_KEY_paused_torrent_count, total - n_running);
     args_out.try_emplace(TR_KEY_torrent_count, total);
     args_out.try_emplace(TR_KEY_upload_speed, session->piece_speed(tr_direction::Up).base_quantity());
@@ -2970,6 +3119,49 @@ void tr_rpc_request_exec_batch(tr_session* session, tr_variant::Vector& requests
 }
 } // namespace
 
+bool tr_rpc_torrent_get_to_json(tr_session* session, tr_variant const& request, std::string& setme)
+{
+    using namespace JsonRpc;
+    using namespace torrent_get_json_helpers;
+
+    // Only plain JSON-RPC 2.0 requests. Legacy requests need api_compat,
+    // and batches and notifications are left to tr_rpc_request_exec().
+    auto const* const map = request.get_if<tr_variant::Map>();
+    if (map == nullptr || map->value_if<std::string_view>(TR_KEY_jsonrpc) != Version)
+    {
+        return false;
+    }
+
+    if (auto const method = map->value_if<std::string_view>(TR_KEY_method);
+        !method || tr_quark_lookup(*method) != TR_KEY_torrent_get)
+    {
+        return false;
+    }
+
+    auto const id_iter = map->find(TR_KEY_id);
+    if (id_iter == std::end(*map) || !is_valid_id(id_iter->second))
+    {
+        return false;
+    }
+
+    auto const lock = session->unique_lock();
+
+    auto const empty_params = tr_variant::Map{};
+    auto const* const params = map->find_if<tr_variant::Map>(TR_KEY_params);
+    auto const torrent_get = parseTorrentGet(session, params != nullptr ? *params : empty_params);
+    if (std::empty(torrent_get.plan.fields))
+    {
+        // let tr_rpc_request_exec() report the error
+        return false;
+    }
+
+    setme.clear();
+    auto stream = StringOutputStream{ setme };
+    auto writer = Writer{ stream };
+    write_torrent_get_response(writer, id_iter->second, torrent_get);
+    return true;
+}
+
 // TODO(tearfur): take `tr_variant const& request` after removing api_compat
 void tr_rpc_request_exec(tr_session* session, tr_variant& request, tr_rpc_response_func&& callback)
 {
@@ -7,6 +7,8 @@
 
 #include <cstdint> // int16_t
 #include <functional>
+#include <string>
+#include <string_view>
 
 struct tr_session;
 struct tr_variant;
@@ -53,3 +55,9 @@ using tr_rpc_response_func = std::function<void(tr_variant&& response)>;
 void tr_rpc_request_exec(tr_session* session, tr_variant& request, tr_rpc_response_func&& callback = {});
 
 void tr_rpc_request_exec(tr_session* session, std::string_view request, tr_rpc_response_func&& callback = {});
+
+// Serves a JSON-RPC 2.0 `torrent_get` request by writing its JSON response
+// straight into `setme`, without building a tr_variant tree for the reply.
+// Returns false and leaves `setme` untouched for any other request,
+// which should be passed to tr_rpc_request_exec() instead.
+[[nodiscard]] bool tr_rpc_torrent_get_to_json(tr_session* session, tr_variant const& request, std::string& setme);
@@ -33,6 +33,7 @@
 
 #include "libtransmission/api-compat.h"
 #include "libtransmission/bandwidth.h"
+#include "libtransmission/block-pool.h"
 #include "libtransmission/blocklist.h"
 #include "libtransmission/cache.h"
 #include "libtransmission/crypto-utils.h"
@@ -790,6 +791,21 @@ void tr_session::setSettings(tr_session::Settings&& settings_in, bool force)
         tr_sessionSetCacheLimit_MB(this, val);
     }
 
+    if (auto const& val = new_settings.read_cache_size_mbytes; force || val != old_settings.read_cache_size_mbytes)
+    {
+        cache->set_read_limit(Memory{ val, Memory::Units::MBytes });
+    }
+
+    if (auto const& val = new_settings.open_file_limit; force || val != old_settings.open_file_limit)
+    {
+        open_files_.set_limit(val);
+    }
+
+    if (auto const& val = new_settings.huge_pages_enabled; force || val != old_settings.huge_pages_enabled)
+    {
+        tr_block_pool::instance().set_huge_pages_enabled(val);
+    }
+
     if (auto const& val = new_settings.bind_address_ipv4; force || val != old_settings.bind_address_ipv4)
     {
         ip_cache_->update_addr(TR_AF_INET);
@@ -885,6 +901,11 @@ void tr_session::setSettings(tr_session::Settings&& settings_in, bool force)
         verifier_->set_sleep_per_seconds_during_verify(val);
     }
 
+    if (auto const& val = new_settings.verify_threads; force || val != old_settings.verify_threads)
+    {
+        verifier_->set_thread_count(val);
+    }
+
     // We need to update bandwidth if speed settings changed.
     // It's a harmless call, so just call it instead of checking for settings changes
     update_bandwidth(tr_direction::Up);
@@ -1385,6 +1406,7 @@ void tr_session::closeImplPart1(std::promise<void>* closed_promise, std::chrono:
     // close the low-hanging fruit that can be closed immediately w/o consequences
     utp_timer.reset();
     verifier_.reset();
+    sweeper_.reset();
     save_timer_.reset();
     queue_timer_.reset();
     now_timer_.reset();
@@ -1424,12 +1446,13 @@ void tr_session::closeImplPart1(std::promise<void>* closed_promise, std::chrono:
     // we tell it to stop updating before web_ starts to refuse new requests.
     // But we keep it intact for now, so that udp_core_ can continue.
     this->ip_cache_->try_shutdown();
-    // ...and now that those are done, tell web_ that we're shutting
-    // down soon. This leaves the `event=stopped` going but refuses any
-    // new tasks.
+    // ...and now that those are done, tell web_ and tracker_web_ that
+    // we're shutting down soon. This leaves the `event=stopped` going
+    // but refuses any new tasks.
     auto const now = std::chrono::steady_clock::now();
     auto const remaining_ms = now < deadline ? std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) : 0ms;
     this->web_->startShutdown(remaining_ms);
+    this->tracker_web_->startShutdown(remaining_ms);
     this->cache.reset();
 
     // recycle the now-unused save_timer_ here to wait for UDP shutdown
@@ -1440,11 +1463,11 @@ void tr_session::closeImplPart1(std::promise<void>* closed_promise, std::chrono:
 
 void tr_session::closeImplPart2(std::promise<void>* closed_promise, std::chrono::time_point<std::chrono::steady_clock> deadline)
 {
-    // try to keep web_ and the UDP announcer alive long enough to send out
-    // all the &event=stopped tracker announces.
+    // try to keep tracker_web_ and the UDP announcer alive long enough to
+    // send out all the &event=stopped tracker announces.
     // also wait for all ip cache updates to finish so that web_ can
     // safely destruct.
-    if ((!web_->is_idle() || !announcer_udp_->is_idle() || !ip_cache_->try_shutdown()) &&
+    if ((!web_->is_idle() || !tracker_web_->is_idle() || !announcer_udp_->is_idle() || !ip_cache_->try_shutdown()) &&
         std::chrono::steady_clock::now() < deadline)
     {
         announcer_->upkeep();
@@ -2078,6 +2101,41 @@ void tr_session::verify_add(tr_torrent* const tor)
     }
 }
 
+void tr_session::sweep_add(tr_torrent* const tor)
+{
+    if (!sweeper_ || !tor->has_metainfo())
+    {
+        return;
+    }
+
+    if (auto const pieces = tor->unchecked_pieces(); !std::empty(pieces))
+    {
+        sweeper_->add(std::make_unique<tr_torrent::SweepMediator>(tor), pieces);
+    }
+}
+
+void tr_session::sweep_prioritize(tr_torrent* const tor, tr_piece_index_t const piece)
+{
+    if (!sweeper_)
+    {
+        return;
+    }
+
+    if (!sweeper_->prioritize(tor->info_hash(), piece))
+    {
+        sweeper_->add(std::make_unique<tr_torrent::SweepMediator>(tor), { piece });
+        sweeper_->prioritize(tor->info_hash(), piece);
+    }
+}
+
+void tr_session::sweep_remove(tr_torrent const* const tor)
+{
+    if (sweeper_)
+    {
+        sweeper_->remove(tor->info_hash());
+    }
+}
+
 // ---
 void tr_session::flush_torrent_files(tr_torrent_id_t const tor_id) const noexcept
 {
@@ -2087,6 +2145,8 @@ void tr_session::flush_torrent_files(tr_torrent_id_t const tor_id) const noexcep
 void tr_session::close_torrent_files(tr_torrent_id_t const tor_id) noexcept
 {
     this->cache->flush_torrent(tor_id);
+    this->cache->drop_piece_hashes(tor_id);
+    this->cache->drop_read_pieces(tor_id);
     openFiles().close_torrent(tor_id);
 }
 
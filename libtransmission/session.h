@@ -48,6 +48,7 @@
 #include "libtransmission/net.h" // for tr_port, tr_tos_t
 #include "libtransmission/open-files.h"
 #include "libtransmission/peer-io.h" // tr_preferred_transport
+#include "libtransmission/piece-sweeper.h"
 #include "libtransmission/platform.h"
 #include "libtransmission/port-forwarding.h"
 #include "libtransmission/quark.h"
@@ -360,7 +361,9 @@ private:
         tr_udp_core& operator=(tr_udp_core const&) = delete;
         tr_udp_core& operator=(tr_udp_core&&) = delete;
 
-        void sendto(void const* buf, size_t buflen, struct sockaddr const* to, socklen_t tolen) const;
+        // Queues a datagram. Queued datagrams are sent in batches
+        // at the end of the current event loop iteration.
+        void sendto(void const* buf, size_t buflen, struct sockaddr const* to, socklen_t tolen);
 
         [[nodiscard]] constexpr auto socket4() const noexcept
         {
@@ -373,12 +376,39 @@ private:
         }
 
     private:
+        struct Datagram
+        {
+            sockaddr_storage to = {};
+            socklen_t tolen = {};
+            tr_socket_t sock = TR_BAD_SOCKET;
+            size_t offset = {}; // where this datagram is in `outbox_bytes_`
+            size_t len = {};
+        };
+
+        static void on_can_read(evutil_socket_t sock, short type, void* vself);
+        static void on_flush(evutil_socket_t sock, short type, void* vself);
+
+        void read_datagrams(tr_socket_t sock);
+        [[nodiscard]] bool handle_datagram(unsigned char* buf, size_t buflen, struct sockaddr* from, socklen_t fromlen);
+
+        void flush_outbox();
+        void send_one(Datagram const& datagram) const;
+
         tr_port const udp_port_;
         tr_session& session_;
         tr_socket_t udp4_socket_ = TR_BAD_SOCKET;
         tr_socket_t udp6_socket_ = TR_BAD_SOCKET;
         tr::evhelpers::event_unique_ptr udp4_event_;
         tr::evhelpers::event_unique_ptr udp6_event_;
+        tr::evhelpers::event_unique_ptr flush_event_;
+
+        std::vector<unsigned char> inbox_bytes_;
+
+        std::vector<Datagram> outbox_;
+        std::vector<unsigned char> outbox_bytes_;
+
+        // cleared if the kernel rejects UDP generic segmentation offload
+        bool gso_enabled_ = true;
     };
 
 public:
@@ -423,6 +453,7 @@ public:
         bool blocklist_enabled = false;
         bool dht_enabled = true;
         bool download_queue_enabled = true;
+        bool huge_pages_enabled = false;
         bool idle_seeding_limit_enabled = false;
         bool incomplete_dir_enabled = false;
         bool is_incomplete_file_naming_enabled = true;
@@ -436,6 +467,7 @@ public:
         bool script_torrent_done_enabled = false;
         bool script_torrent_done_seeding_enabled = false;
         bool seed_queue_enabled = false;
+        bool sendfile_enabled = true;
         bool sequential_download = false;
         bool should_delete_source_torrents = false;
         bool should_scrape_paused_torrents = true;
@@ -449,14 +481,17 @@ public:
         size_t cache_size_mbytes = 4U;
         size_t download_queue_size = 5U;
         size_t idle_seeding_limit_minutes = 30U;
+        size_t open_file_limit = tr_open_files::DefaultLimit;
         size_t peer_limit_global = TrDefaultPeerLimitGlobal;
         size_t peer_limit_per_torrent = TrDefaultPeerLimitTorrent;
         size_t queue_stalled_minutes = 30U;
+        size_t read_cache_size_mbytes = 8U;
         size_t reqq = 2000U;
         size_t seed_queue_size = 10U;
         size_t speed_limit_down = 100U;
         size_t speed_limit_up = 100U;
         size_t upload_slots_per_torrent = 8U;
+        size_t verify_threads = 1U;
         small::max_size_vector<tr_preferred_transport, TR_NUM_PREFERRED_TRANSPORT> preferred_transports = {
             TR_PREFER_UTP,
             TR_PREFER_TCP,
@@ -504,12 +539,14 @@ public:
             Field<&Settings::download_queue_enabled>{ TR_KEY_download_queue_enabled },
             Field<&Settings::download_queue_size>{ TR_KEY_download_queue_size },
             Field<&Settings::encryption_mode>{ TR_KEY_encryption },
+            Field<&Settings::huge_pages_enabled>{ TR_KEY_huge_pages_enabled },
             Field<&Settings::idle_seeding_limit_minutes>{ TR_KEY_idle_seeding_limit },
             Field<&Settings::idle_seeding_limit_enabled>{ TR_KEY_idle_seeding_limit_enabled },
             Field<&Settings::incomplete_dir>{ TR_KEY_incomplete_dir },
             Field<&Settings::incomplete_dir_enabled>{ TR_KEY_incomplete_dir_enabled },
             Field<&Settings::lpd_enabled>{ TR_KEY_lpd_enabled },
             Field<&Settings::log_level>{ TR_KEY_message_level },
+            Field<&Settings::open_file_limit>{ TR_KEY_open_file_limit },
             Field<&Settings::peer_congestion_algorithm>{ TR_KEY_peer_congestion_algorithm },
             Field<&Settings::peer_limit_global>{ TR_KEY_peer_limit_global },
             Field<&Settings::peer_limit_per_torrent>{ TR_KEY_peer_limit_per_torrent },
@@ -527,6 +564,7 @@ public:
             Field<&Settings::queue_stalled_minutes>{ TR_KEY_queue_stalled_minutes },
             Field<&Settings::ratio_limit>{ TR_KEY_ratio_limit },
             Field<&Settings::ratio_limit_enabled>{ TR_KEY_ratio_limit_enabled },
+            Field<&Settings::read_cache_size_mbytes>{ TR_KEY_read_cache_size_mib },
             Field<&Settings::is_incomplete_file_naming_enabled>{ TR_KEY_rename_partial_files },
             Field<&Settings::reqq>{ TR_KEY_reqq },
             Field<&Settings::should_scrape_paused_torrents>{ TR_KEY_scrape_paused_torrents_enabled },
@@ -538,6 +576,7 @@ public:
             Field<&Settings::script_torrent_done_seeding_filename>{ TR_KEY_script_torrent_done_seeding_filename },
             Field<&Settings::seed_queue_enabled>{ TR_KEY_seed_queue_enabled },
             Field<&Settings::seed_queue_size>{ TR_KEY_seed_queue_size },
+            Field<&Settings::sendfile_enabled>{ TR_KEY_sendfile_enabled },
             Field<&Settings::sequential_download>{ TR_KEY_sequential_download },
             Field<&Settings::sleep_per_seconds_during_verify>{ TR_KEY_sleep_per_seconds_during_verify },
             Field<&Settings::speed_limit_down>{ TR_KEY_speed_limit_down },
@@ -552,6 +591,7 @@ public:
             Field<&Settings::umask>{ TR_KEY_umask },
             Field<&Settings::upload_slots_per_torrent>{ TR_KEY_upload_slots_per_torrent },
             Field<&Settings::utp_enabled>{ TR_KEY_utp_enabled },
+            Field<&Settings::verify_threads>{ TR_KEY_verify_threads },
         };
     };
 
@@ -773,6 +813,11 @@ public:
         settings_.reqq = reqq;
     }
 
+    [[nodiscard]] constexpr auto is_sendfile_enabled() const noexcept
+    {
+        return settings().sendfile_enabled;
+    }
+
     [[nodiscard]] constexpr auto sequential_download() const noexcept
     {
         return settings().sequential_download;
@@ -1170,6 +1215,10 @@ public:
     void verify_add(tr_torrent* tor);
     void verify_remove(tr_torrent const* tor);
 
+    void sweep_add(tr_torrent* tor);
+    void sweep_prioritize(tr_torrent* tor, tr_piece_index_t piece);
+    void sweep_remove(tr_torrent const* tor);
+
     void fetch(tr_web::FetchOptions&& options) const
     {
         if (web_)
@@ -1178,6 +1227,17 @@ public:
         }
     }
 
+    // Like fetch(), but for tracker announces and scrapes. These get their
+    // own connection pool and limits so that they can keep connections to
+    // trackers alive and don't wait behind webseed or blocklist downloads.
+    void fetch_tracker(tr_web::FetchOptions&& options) const
+    {
+        if (tracker_web_)
+        {
+            tracker_web_->fetch(std::move(options));
+        }
+    }
+
     [[nodiscard]] constexpr auto const& bandwidthGroups() const noexcept
     {
         return bandwidth_groups_;
@@ -1457,9 +1517,12 @@ private:
     WebMediator web_mediator_{ this };
     std::unique_ptr<tr_web> web_ = tr_web::create(this->web_mediator_);
 
+    // depends-on: web_mediator_
+    std::unique_ptr<tr_web> tracker_web_ = tr_web::create(this->web_mediator_);
+
 public:
-    // depends-on: settings_, open_files_, torrents_
-    std::unique_ptr<Cache> cache = std::make_unique<Cache>(torrents_, Memory{ 2U, Memory::Units::MBytes });
+    // depends-on: settings_, open_files_, torrents_, session_thread_
+    std::unique_ptr<Cache> cache = std::make_unique<Cache>(torrents_, *session_thread_, Memory{ 2U, Memory::Units::MBytes });
 
 private:
     // depends-on: timer_maker_, blocklists_, top_bandwidth_, utp_context, torrents_, web_
@@ -1481,7 +1544,7 @@ public:
     // depends-on: announcer_udp_mediator_
     std::unique_ptr<tr_announcer_udp> announcer_udp_ = tr_announcer_udp::create(announcer_udp_mediator_);
 
-    // depends-on: settings_, torrents_, web_, announcer_udp_
+    // depends-on: settings_, torrents_, tracker_web_, announcer_udp_
     std::unique_ptr<tr_announcer> announcer_ = tr_announcer::create(this, *announcer_udp_);
 
     // depends-on: public_peer_port_, udp_core_, dht_mediator_
@@ -1502,6 +1565,8 @@ private:
 
     std::unique_ptr<tr_verify_worker> verifier_ = std::make_unique<tr_verify_worker>();
 
+    std::unique_ptr<tr_piece_sweeper> sweeper_ = std::make_unique<tr_piece_sweeper>();
+
 public:
     std::unique_ptr<tr::Timer> utp_timer;
 };
@@ -7,8 +7,11 @@
 #include <cerrno> // for EINVAL
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <fmt/format.h>
@@ -19,6 +22,7 @@
 #include "libtransmission/file-utils.h"
 #include "libtransmission/file.h"
 #include "libtransmission/log.h"
+#include "libtransmission/merkle.h"
 #include "libtransmission/string-utils.h"
 #include "libtransmission/torrent-files.h"
 #include "libtransmission/torrent-metainfo.h"
@@ -70,6 +74,20 @@ struct MetainfoHandler final : public tr::benc::BasicHandler<MaxBencDepth>
     tr_pathbuf file_subpath_;
     int64_t file_length_ = 0;
 
+    // BitTorrent v2 "file tree" entries
+    struct FileTreeFile
+    {
+        std::string subpath;
+        int64_t length = 0;
+        std::optional<tr_sha256_digest_t> pieces_root;
+    };
+    std::vector<FileTreeFile> file_tree_files_;
+    std::vector<std::string_view> file_tree_path_;
+    std::optional<tr_sha256_digest_t> pieces_root_;
+
+    // BitTorrent v2 "piece layers", keyed by the file's pieces root
+    std::unordered_map<std::string_view, std::string_view> piece_layers_;
+
     enum class State : uint8_t
     {
         UsePath,
@@ -92,7 +110,6 @@ struct MetainfoHandler final : public tr::benc::BasicHandler<MaxBencDepth>
 
     bool StartDict(Context const& context) override
     {
-        // TODO Bittorrent v2. For now just parse and throw away.
         if (state_ == State::FileTree)
         {
             auto const path_element = currentKey();
@@ -101,11 +118,13 @@ struct MetainfoHandler final : public tr::benc::BasicHandler<MaxBencDepth>
                 return false;
             }
 
-            if (!std::empty(file_subpath_))
+            // BEP 52: a dict with an empty key is a file; anything else is a directory
+            file_tree_path_.emplace_back(*path_element);
+            if (std::empty(*path_element))
             {
-                file_subpath_ += '/';
+                file_length_ = 0;
+                pieces_root_.reset();
             }
-            tr_torrent_files::sanitize_subpath(tr_strv_to_utf8_string(*path_element), file_subpath_);
         }
         else if (pathIs(InfoKey))
         {
@@ -115,7 +134,7 @@ struct MetainfoHandler final : public tr::benc::BasicHandler<MaxBencDepth>
         else if (pathIs(InfoKey, FileTreeKey))
         {
             state_ = State::FileTree;
-            file_subpath_.clear();
+            file_tree_path_.clear();
             file_length_ = 0;
         }
         else if (pathIs(PieceLayersKey))
@@ -142,9 +161,19 @@ struct MetainfoHandler final : public tr::benc::BasicHandler<MaxBencDepth>
 
         if (state_ == State::FileTree) // bittorrent v2 format
         {
-            // v2, ignore for today
-            tr_logAddInfo("'file tree' is ignored");
-            state_ = State::UsePath;
+            if (std::empty(file_tree_path_)) // end of the "file tree" dict itself
+            {
+                state_ = State::UsePath;
+            }
+            else
+            {
+                if (std::empty(file_tree_path_.back()))
+                {
+                    addFileTreeFile();
+                }
+
+                file_tree_path_.pop_back();
+            }
         }
         else if (state_ == State::Files) // bittorrent v1 format
         {
@@ -288,7 +317,20 @@ struct MetainfoHandler final : public tr::benc::BasicHandler<MaxBencDepth>
         }
         else if (state_ == State::FileTree)
         {
-            if (current_key == AttrKey || current_key == PiecesRootKey)
+            if (current_key == PiecesRootKey)
+            {
+                // v1 metadata is still used to check the data, so don't fail here
+                if (std::size(value) != std::tuple_size_v<tr_sha256_digest_t>)
+                {
+                    tr_logAddWarn(fmt::format("ignoring invalid 'pieces root' size: {}", std::size(value)));
+                }
+                else
+                {
+                    auto& root = pieces_root_.emplace();
+                    std::copy_n(std::data(value), std::size(value), reinterpret_cast<char*>(std::data(root)));
+                }
+            }
+            else if (current_key == AttrKey)
             {
                 // currently unused. TODO support for BEP0047
                 // TODO https://github.com/transmission/transmission/issues/3387
@@ -386,8 +428,10 @@ struct MetainfoHandler final : public tr::benc::BasicHandler<MaxBencDepth>
         }
         else if (pathStartsWith(PieceLayersKey))
         {
-            // currently unused. TODO support for bittorrent v2
-            // TODO https://github.com/transmission/transmission/issues/458
+            if (curdepth == 2 && current_key)
+            {
+                piece_layers_.try_emplace(*current_key, value);
+            }
         }
         else if (pathStartsWith(AnnounceListKey))
         {
@@ -456,6 +500,89 @@ struct MetainfoHandler final : public tr::benc::BasicHandler<MaxBencDepth>
     }
 
 private:
+    void addFileTreeFile()
+    {
+        // the last path element is the empty key that marks a file
+        auto subpath = tr_pathbuf{};
+        for (size_t i = 0U, n = std::size(file_tree_path_) - 1U; i < n; ++i)
+        {
+            if (!std::empty(subpath))
+            {
+                subpath += '/';
+            }
+            tr_torrent_files::sanitize_subpath(tr_strv_to_utf8_string(file_tree_path_[i]), subpath);
+        }
+
+        file_tree_files_.push_back({ .subpath = std::string{ subpath.sv() }, .length = file_length_, .pieces_root = pieces_root_ });
+        file_length_ = 0;
+        pieces_root_.reset();
+    }
+
+    // Match the v2 "file tree" to the v1 files of a hybrid torrent and keep
+    // what's needed to build their Merkle trees. Nothing is hashed here.
+    void finishMerkleData(bool const is_single_file)
+    {
+        if (std::empty(file_tree_files_))
+        {
+            return;
+        }
+
+        // in multifile torrents, the v1 paths have the torrent's name prepended
+        auto prefix = tr_pathbuf{};
+        if (!is_single_file)
+        {
+            tr_torrent_files::sanitize_subpath(tm_.name_, prefix);
+            if (!std::empty(prefix))
+            {
+                prefix += '/';
+            }
+        }
+
+        auto const n_files = tm_.file_count();
+        auto file_indices = std::unordered_map<std::string_view, tr_file_index_t>{};
+        file_indices.reserve(n_files);
+        for (tr_file_index_t i = 0U; i < n_files; ++i)
+        {
+            file_indices.try_emplace(tm_.file_subpath(i), i);
+        }
+
+        tm_.merkle_data_.resize(n_files);
+
+        for (auto const& file : file_tree_files_)
+        {
+            if (!file.pieces_root || file.length <= 0)
+            {
+                continue;
+            }
+
+            auto const iter = file_indices.find(tr_pathbuf{ prefix, file.subpath }.sv());
+            if (iter == std::end(file_indices) || tm_.file_size(iter->second) != static_cast<uint64_t>(file.length))
+            {
+                tr_logAddWarn(fmt::format("'file tree' entry '{}' has no matching file", file.subpath));
+                continue;
+            }
+
+            auto& data = tm_.merkle_data_[iter->second].emplace();
+            data.pieces_root = *file.pieces_root;
+            auto const& root = data.pieces_root;
+            auto const root_key = std::string_view{ reinterpret_cast<char const*>(std::data(root)), std::size(root) };
+            if (auto const layer_iter = piece_layers_.find(root_key); layer_iter != std::end(piece_layers_))
+            {
+                static auto constexpr Sha256Len = std::tuple_size_v<tr_sha256_digest_t>;
+                auto const& hashes = layer_iter->second;
+                if (std::size(hashes) % Sha256Len != 0U)
+                {
+                    tr_logAddWarn(fmt::format("invalid 'piece layers' size for '{}': {}", file.subpath, std::size(hashes)));
+                    tm_.merkle_data_[iter->second].reset();
+                    continue;
+                }
+
+                data.piece_layer.resize(std::size(hashes) / Sha256Len);
+                std::copy_n(std::data(hashes), std::size(hashes), reinterpret_cast<char*>(std::data(data.piece_layer)));
+            }
+        }
+    }
+
     [[nodiscard]] bool addFile(Context const& context)
     {
         bool ok = true;
@@ -534,7 +661,8 @@ private:
         // If 'length' is present then the download represents a single file,
         // otherwise it represents a set of files which go in a directory structure.
         // In the single file case, 'length' maps to the length of the file in bytes."
-        if (tm_.file_count() == 0 && length_ != 0 && !std::empty(tm_.name_))
+        auto const is_single_file = tm_.file_count() == 0 && length_ != 0 && !std::empty(tm_.name_);
+        if (is_single_file)
         {
             tm_.files_.add(tr_torrent_files::sanitize_subpath(tm_.name_), length_);
         }
@@ -575,6 +703,7 @@ private:
                 return false;
             }
 
+            finishMerkleData(is_single_file);
             return true;
         }
 
@@ -681,6 +810,24 @@ bool tr_torrent_metainfo::parse_benc(std::string_view benc, tr_error* error)
     return true;
 }
 
+std::optional<tr_merkle_file> tr_torrent_metainfo::merkle_file(tr_file_index_t const i) const
+{
+    if (i >= std::size(merkle_data_) || !merkle_data_[i])
+    {
+        return {};
+    }
+
+    auto const& data = *merkle_data_[i];
+    auto merkle = tr_merkle_file{ data.pieces_root, file_size(i), piece_size(), data.piece_layer };
+    if (!merkle.is_valid())
+    {
+        tr_logAddWarn(fmt::format("'piece layers' entry for '{}' doesn't match its 'pieces root'", file_subpath(i)));
+        return {};
+    }
+
+    return merkle;
+}
+
 bool tr_torrent_metainfo::parse_torrent_file(std::string_view filename, std::vector<char>* contents, tr_error* error)
 {
     auto local_contents = std::vector<char>{};
@@ -7,12 +7,14 @@
 
 #include <cstdint> // uint32_t, uint64_t
 #include <ctime>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include "libtransmission/block-info.h"
 #include "libtransmission/magnet-metainfo.h"
+#include "libtransmission/merkle.h"
 #include "libtransmission/torrent-files.h"
 #include "libtransmission/tr-macros.h"
 #include "libtransmission/types.h"
@@ -148,6 +150,12 @@ public:
         return is_v2_;
     }
 
+    // The file's BitTorrent v2 Merkle tree, or std::nullopt if it has none,
+    // e.g. because this isn't a hybrid torrent, the file is a padding file,
+    // or its piece layer doesn't match its pieces root. The tree is built
+    // and checked on demand so that loading a torrent doesn't hash anything.
+    [[nodiscard]] std::optional<tr_merkle_file> merkle_file(tr_file_index_t i) const;
+
     [[nodiscard]] constexpr auto const& date_created() const noexcept
     {
         return date_created_;
@@ -221,6 +229,14 @@ private:
 
     std::vector<tr_sha1_digest_t> pieces_;
 
+    // BitTorrent v2 file data, indexed by file. Empty if there is none.
+    struct MerkleData
+    {
+        tr_sha256_digest_t pieces_root = {};
+        std::vector<tr_sha256_digest_t> piece_layer;
+    };
+    std::vector<std::optional<MerkleData>> merkle_data_;
+
     std::string comment_;
     std::string creator_;
     std::string source_;
@@ -644,6 +644,9 @@ void tr_torrent::start_in_session_thread()
     session->announcer_->startTorrent(this);
     lpdAnnounceAt = now;
     started_(this);
+
+    // check any pieces whose files changed while we weren't looking
+    session->sweep_add(this);
 }
 
 void tr_torrent::stop_now()
@@ -665,6 +668,7 @@ void tr_torrent::stop_now()
     }
 
     session->verify_remove(this);
+    session->sweep_remove(this);
 
     stopped_(this);
     session->announcer_->stopTorrent(this);
@@ -692,6 +696,7 @@ void tr_torrentRemoveInSessionThread(
         // ensure the files are all closed and idle before moving
         tor->session->close_torrent_files(tor->id());
         tor->session->verify_remove(tor);
+        tor->session->sweep_remove(tor);
 
         if (!remove_func)
         {
@@ -810,6 +815,7 @@ void tr_torrent::on_metainfo_updated()
     completion_ = tr_completion{ this, &block_info() };
     obfuscated_hash_ = tr_sha1::digest("req2"sv, info_hash());
     fpm_ = tr_file_piece_map{ metainfo_ };
+    merkle_pieces_.reset();
     file_mtimes_.resize(file_count());
     file_priorities_ = tr_file_priorities{ &fpm_ };
     files_wanted_ = tr_files_wanted{ &fpm_ };
@@ -1056,6 +1062,7 @@ void tr_torrent::set_location_in_session_thread(std::string_view const path, boo
         // ensure the files are all closed and idle before moving
         session->close_torrent_files(id());
         session->verify_remove(this);
+        session->sweep_remove(this);
 
         auto error = tr_error{};
         ok = files().move(current_dir(), path, name(), &error);
@@ -1084,6 +1091,12 @@ void tr_torrent::set_location_in_session_thread(std::string_view const path, boo
         }
     }
 
+    // resume the sweep that was stopped for the move
+    if (move_from_old_path && is_running())
+    {
+        session->sweep_add(this);
+    }
+
     if (setme_state != nullptr)
     {
         *setme_state = ok ? TR_LOC_DONE : TR_LOC_ERROR;
@@ -1524,6 +1537,7 @@ void tr_torrentVerify(tr_torrent* tor)
             }
 
             session->verify_remove(tor);
+            session->sweep_remove(tor);
 
             if (!tor->has_metainfo())
             {
@@ -1683,6 +1697,60 @@ void tr_torrent::VerifyMediator::on_verify_done(bool const aborted)
 
 // ---
 
+tr_torrent::SweepMediator::SweepMediator(tr_torrent* const tor)
+    : tor_{ tor }
+{
+}
+
+tr_torrent_metainfo const& tr_torrent::SweepMediator::metainfo() const
+{
+    return tor_->metainfo_;
+}
+
+// (called from tr_piece_sweeper's thread)
+std::optional<std::string> tr_torrent::SweepMediator::find_file(tr_file_index_t const file_index) const
+{
+    // Renaming or relocating the torrent stops the sweep and queues a new one,
+    // so its paths don't change under us. A ".part" suffix can still be dropped,
+    // which is why the sweeper looks files up again before failing a piece.
+    if (auto const found = tor_->find_file(file_index); found)
+    {
+        return std::string{ found->filename().sv() };
+    }
+
+    return {};
+}
+
+// (called from tr_piece_sweeper's thread)
+void tr_torrent::SweepMediator::on_piece_checked(tr_piece_index_t const piece, bool const passed)
+{
+    tor_->session->run_in_session_thread(
+        // Do not capture the torrent pointer directly; it may be freed before this runs.
+        [tor_id = tor_->id(), session = tor_->session, piece, passed]()
+        {
+            auto* const tor = session->torrents().get(tor_id);
+            if (tor == nullptr || tor->is_deleting_ || !tor->has_piece(piece) || tor->is_piece_checked(piece))
+            {
+                return;
+            }
+
+            tr_logAddTraceTor(tor, fmt::format("[LAZY] swept piece {}, pass=={}", piece, passed));
+
+            if (!passed)
+            {
+                tor->error().set_local_error(fmt::format("Please Verify Local Data! Piece #{:d} is corrupt.", piece));
+                tor->set_has_piece(piece, false);
+                tor->set_needs_completeness_check();
+            }
+
+            tor->checked_pieces_.set(piece, true);
+            tor->mark_changed();
+            tor->set_dirty();
+        });
+}
+
+// ---
+
 void tr_torrent::save_resume_file()
 {
     if (!is_dirty())
@@ -2119,6 +2187,9 @@ void tr_torrent::on_file_completed(tr_file_index_t const file)
 
 void tr_torrent::on_piece_completed(tr_piece_index_t const piece)
 {
+    // it was just hashed, so there's no need to check it again before uploading it
+    checked_pieces_.set(piece, true);
+
     piece_completed_(this, piece);
 
     // bookkeeping
@@ -2406,6 +2477,9 @@ void tr_torrent::rename_path_in_session_thread(
     }
     else
     {
+        // the piece sweeper looked up the files' old names
+        session->sweep_remove(this);
+
         error = renamePath(this, oldpath, newname);
 
         if (error == 0)
@@ -2425,6 +2499,11 @@ void tr_torrent::rename_path_in_session_thread(
             mark_edited();
             set_dirty();
         }
+
+        if (is_running())
+        {
+            session->sweep_add(this);
+        }
     }
 
     mark_changed();
@@ -2503,6 +2582,34 @@ void tr_torrent::mark_changed()
     return checked;
 }
 
+[[nodiscard]] bool tr_torrent::ensure_piece_is_checked_async(tr_piece_index_t piece)
+{
+    TR_ASSERT(piece < this->piece_count());
+
+    if (is_piece_checked(piece))
+    {
+        return true;
+    }
+
+    session->sweep_prioritize(this, piece);
+    return false;
+}
+
+std::vector<tr_piece_index_t> tr_torrent::unchecked_pieces() const
+{
+    auto pieces = std::vector<tr_piece_index_t>{};
+
+    for (tr_piece_index_t piece = 0U, n = piece_count(); piece < n; ++piece)
+    {
+        if (has_piece(piece) && !is_piece_checked(piece))
+        {
+            pieces.emplace_back(piece);
+        }
+    }
+
+    return pieces;
+}
+
 // --- RESUME HELPER
 
 tr_bitfield const& tr_torrent::ResumeHelper::checked_pieces() const noexcept
@@ -31,6 +31,8 @@
 #include "libtransmission/file-piece-map.h"
 #include "libtransmission/interned-string.h"
 #include "libtransmission/log.h"
+#include "libtransmission/merkle.h"
+#include "libtransmission/piece-sweeper.h"
 #include "libtransmission/session.h"
 #include "libtransmission/torrent-files.h"
 #include "libtransmission/torrent-magnet.h"
@@ -170,6 +172,22 @@ struct tr_torrent
         std::optional<time_t> time_started_;
     };
 
+    class SweepMediator : public tr_piece_sweeper::Mediator
+    {
+    public:
+        explicit SweepMediator(tr_torrent* tor);
+
+        ~SweepMediator() override = default;
+
+        [[nodiscard]] tr_torrent_metainfo const& metainfo() const override;
+        [[nodiscard]] std::optional<std::string> find_file(tr_file_index_t file_index) const override;
+
+        void on_piece_checked(tr_piece_index_t piece, bool passed) override;
+
+    private:
+        tr_torrent* const tor_;
+    };
+
     // ---
 
     explicit tr_torrent(tr_torrent_metainfo&& tm)
@@ -529,6 +547,18 @@ struct tr_torrent
         return metainfo_.piece_hash(i);
     }
 
+    // The v2 trees that a hybrid torrent's pieces are checked against too.
+    // Built the first time they're needed, so that loading doesn't hash anything.
+    [[nodiscard]] tr_merkle_pieces const& merkle_pieces() const
+    {
+        if (!merkle_pieces_)
+        {
+            merkle_pieces_.emplace(metainfo_);
+        }
+
+        return *merkle_pieces_;
+    }
+
     void set_name(std::string_view name)
     {
         metainfo_.set_name(name);
@@ -631,8 +661,21 @@ struct tr_torrent
 
     /// METAINFO - PIECE CHECKSUMS
 
+    [[nodiscard]] constexpr bool is_piece_checked(tr_piece_index_t piece) const
+    {
+        return checked_pieces_.test(piece);
+    }
+
     [[nodiscard]] bool ensure_piece_is_checked(tr_piece_index_t piece);
 
+    // Like ensure_piece_is_checked(), but never hashes on the caller's thread:
+    // if `piece` needs checking, it's moved to the front of the piece sweeper's
+    // queue and this returns false. Try again after the sweeper gets to it.
+    [[nodiscard]] bool ensure_piece_is_checked_async(tr_piece_index_t piece);
+
+    // The pieces we have that haven't been checked since their files last changed.
+    [[nodiscard]] std::vector<tr_piece_index_t> unchecked_pieces() const;
+
     /// METAINFO - MAGNET
 
     void maybe_start_metadata_transfer(int64_t size) noexcept;
@@ -812,11 +855,17 @@ struct tr_torrent
 
     void start(bool bypass_queue, std::optional<bool> has_any_local_data);
 
+    // Transfer speeds are averaged over the last couple of seconds,
+    // so they keep changing for a little while after the last transfer.
+    static auto constexpr SpeedSettleSeconds = time_t{ 3 };
+
     [[nodiscard]] constexpr auto has_changed_since(time_t when) const noexcept
     {
-        return date_changed_ > when;
+        return date_changed_ > when || date_active_ + SpeedSettleSeconds > when;
     }
 
+    void mark_changed();
+
     void set_bandwidth_group(std::string_view group_name) noexcept;
 
     [[nodiscard]] constexpr auto get_priority() const noexcept
@@ -1181,11 +1230,6 @@ private:
         return n_secs;
     }
 
-    [[nodiscard]] constexpr bool is_piece_checked(tr_piece_index_t piece) const
-    {
-        return checked_pieces_.test(piece);
-    }
-
     [[nodiscard]] bool check_piece(tr_piece_index_t piece) const;
 
     [[nodiscard]] constexpr std::optional<uint16_t> effective_idle_limit_minutes() const noexcept
@@ -1295,8 +1339,6 @@ private:
         date_changed_ = std::max(date_changed_, when);
     }
 
-    void mark_changed();
-
     constexpr void bump_date_edited(time_t when)
     {
         date_edited_ = std::max(date_edited_, when);
@@ -1371,6 +1413,8 @@ private:
 
     tr_file_piece_map fpm_ = tr_file_piece_map{ metainfo_ };
 
+    mutable std::optional<tr_merkle_pieces> merkle_pieces_;
+
     // when Transmission thinks the torrent's files were last changed
     std::vector<time_t> file_mtimes_;
 
@@ -5,12 +5,20 @@
 #include <array>
 #include <cerrno>
 #include <cstddef>
+#include <cstdint> // uint16_t
+#include <cstring> // memcmp, memcpy
 #include <string>
 
 #ifdef _WIN32
 #include <ws2tcpip.h>
 #else
-#include <sys/socket.h> // setsockopt, SOL_SOCKET, bind
+#include <sys/socket.h> // setsockopt, SOL_SOCKET, bind, recvmmsg, sendmmsg
+#include <sys/uio.h> // iovec
+#endif
+
+#ifdef __linux__
+#include <netinet/in.h> // IPPROTO_UDP
+#include <netinet/udp.h> // UDP_SEGMENT
 #endif
 
 #include <event2/event.h>
@@ -28,6 +36,19 @@
 namespace
 {
 
+// How many datagrams to read or send per syscall
+auto constexpr BatchSize = size_t{ 32U };
+
+// Big enough for any µTP, DHT, or UDP tracker packet
+auto constexpr MaxDatagramSize = size_t{ 8192U };
+
+#if defined(HAVE_SENDMMSG) && defined(UDP_SEGMENT)
+// Limits for sending several same-sized datagrams to the same address
+// as one buffer that the kernel (or NIC) splits up, i.e. UDP GSO
+auto constexpr MaxGsoSegments = size_t{ 64U };
+auto constexpr MaxGsoBytes = size_t{ 65000U };
+#endif
+
 // Since we use a single UDP socket in order to implement multiple
 // µTP sockets, try to set up huge buffers.
 void set_socket_buffers(tr_socket_t fd, bool large)
@@ -83,76 +104,20 @@ void set_socket_buffers(tr_socket_t fd, bool large)
     }
 }
 
-void event_callback(evutil_socket_t s, [[maybe_unused]] short type, void* vsession)
+void log_send_error(struct sockaddr const* to, int const error_code)
 {
-    TR_ASSERT(vsession != nullptr);
-    TR_ASSERT(type == EV_READ);
-
-    auto buf = std::array<unsigned char, 8192>{};
-    auto from = sockaddr_storage{};
-    auto fromlen = socklen_t{ sizeof(from) };
-    auto* const from_sa = reinterpret_cast<sockaddr*>(&from);
-    auto* const session = static_cast<tr_session*>(vsession);
-    auto got_utp_packet = false;
-
-    auto const from_str = [from_sa]
-    {
-        return tr_socket_address::from_sockaddr(from_sa).value_or(tr_socket_address{}).display_name();
-    };
-
-    for (;;)
+    auto display_name = std::string{};
+    if (auto const addrport = tr_socket_address::from_sockaddr(to); addrport)
     {
-        auto const n_read = recvfrom(s, reinterpret_cast<char*>(std::data(buf)), std::size(buf) - 1, 0, from_sa, &fromlen);
-        if (n_read <= 0)
-        {
-            if (got_utp_packet)
-            {
-                // To reduce protocol overhead, we wait until we've read all UDP packets
-                // we can, then send one ACK for each µTP socket that received packet(s).
-                tr_utp_issue_deferred_acks(session);
-            }
-            return;
-        }
-
-        // Since most packets we receive here are µTP, make quick inline
-        // checks for the other protocols. The logic is as follows:
-        // - all DHT packets start with 'd' (100)
-        // - all UDP tracker packets start with a 32-bit (!) "action", which
-        //   is between 0 and 3
-        // - the above cannot be µTP packets, since these start with a 4-bit
-        //   "type" between 0 and 4, followed by a 4-bit version number (1)
-        if (buf[0] == 'd')
-        {
-            if (session->dht_)
-            {
-                buf[n_read] = '\0'; // libdht requires zero-terminated messages
-                session->dht_->handle_message(std::data(buf), n_read, from_sa, fromlen);
-            }
-        }
-        else if (n_read >= 8 && buf[0] == 0 && buf[1] == 0 && buf[2] == 0 && buf[3] <= 3)
-        {
-            if (!session->announcer_udp_->handle_message(std::data(buf), n_read, from_sa, fromlen))
-            {
-                tr_logAddTrace(fmt::format("{} Couldn't parse UDP tracker packet.", from_str()));
-            }
-        }
-        else if (session->allowsUTP() && session->utp_context != nullptr)
-        {
-            if (tr_utp_packet(std::data(buf), n_read, from_sa, fromlen, session))
-            {
-                got_utp_packet = true;
-            }
-            else
-            {
-                tr_logAddTrace(
-                    fmt::format(
-                        "{} Unexpected UDP packet... len {} [{}]",
-                        from_str(),
-                        n_read,
-                        tr_base64_encode({ reinterpret_cast<char const*>(std::data(buf)), static_cast<size_t>(n_read) })));
-            }
-        }
+        display_name = addrport->display_name();
     }
+
+    tr_logAddWarn(
+        fmt::format(
+            "Couldn't send to {address}: {errno} ({error})",
+            fmt::arg("address", display_name),
+            fmt::arg("errno", error_code),
+            fmt::arg("error", tr_strerror(error_code))));
 }
 } // namespace
 
@@ -213,8 +178,8 @@ tr_session::tr_udp_core::tr_udp_core(tr_session& session, tr_port udp_port)
                     session_.event_base(),
                     udp4_socket_,
                     EV_READ | EV_PERSIST,
-                    event_callback,
-                    &session_));
+                    &tr_udp_core::on_can_read,
+                    this));
             event_add(udp4_event_.get(), nullptr);
         }
     }
@@ -266,8 +231,8 @@ tr_session::tr_udp_core::tr_udp_core(tr_session& session, tr_port udp_port)
                     session_.event_base(),
                     udp6_socket_,
                     EV_READ | EV_PERSIST,
-                    event_callback,
-                    &session_));
+                    &tr_udp_core::on_can_read,
+                    this));
             event_add(udp6_event_.get(), nullptr);
         }
     }
@@ -275,11 +240,17 @@ tr_session::tr_udp_core::tr_udp_core(tr_session& session, tr_port udp_port)
     if (udp4_socket_ == TR_BAD_SOCKET && udp6_socket_ == TR_BAD_SOCKET)
     {
         tr_logAddError(_("Couldn't create any UDP sockets."));
+        return;
     }
+
+    flush_event_.reset(tr::evhelpers::event_new_pri2(session_.event_base(), -1, 0, &tr_udp_core::on_flush, this));
 }
 
 tr_session::tr_udp_core::~tr_udp_core()
 {
+    flush_outbox();
+    flush_event_.reset();
+
     udp6_event_.reset();
 
     if (udp6_socket_ != TR_BAD_SOCKET)
@@ -297,40 +268,367 @@ tr_session::tr_udp_core::~tr_udp_core()
     }
 }
 
-void tr_session::tr_udp_core::sendto(void const* buf, size_t buflen, struct sockaddr const* to, socklen_t const tolen) const
+void tr_session::tr_udp_core::sendto(void const* buf, size_t buflen, struct sockaddr const* to, socklen_t const tolen)
 {
     auto const addrport = tr_socket_address::from_sockaddr(to);
     if (to->sa_family != AF_INET && to->sa_family != AF_INET6)
     {
         errno = EAFNOSUPPORT;
+        log_send_error(to, errno);
+        return;
     }
-    else if (auto const sock = to->sa_family == AF_INET ? udp4_socket_ : udp6_socket_; sock == TR_BAD_SOCKET)
+
+    auto const sock = to->sa_family == AF_INET ? udp4_socket_ : udp6_socket_;
+    if (sock == TR_BAD_SOCKET)
     {
         // don't warn on bad sockets; the system may not support IPv6
         return;
     }
-    else if (
-        addrport && !addrport->address().is_ipv4_loopback() && !addrport->address().is_ipv6_loopback() &&
+
+    if (addrport && !addrport->address().is_ipv4_loopback() && !addrport->address().is_ipv6_loopback() &&
         !session_.source_address(tr_af_to_ip_protocol(to->sa_family)))
     {
         // don't try to send if we don't have a route in this IP protocol
         return;
     }
-    else if (::sendto(sock, static_cast<char const*>(buf), buflen, 0, to, tolen) != -1)
+
+    if (buflen > MaxDatagramSize || tolen > static_cast<socklen_t>(sizeof(sockaddr_storage)))
     {
+        errno = EMSGSIZE;
+        log_send_error(to, errno);
         return;
     }
 
-    auto display_name = std::string{};
-    if (addrport)
+    if (std::size(outbox_) >= BatchSize * 2U)
     {
-        display_name = addrport->display_name();
+        flush_outbox();
     }
 
-    tr_logAddWarn(
-        fmt::format(
-            "Couldn't send to {address}: {errno} ({error})",
-            fmt::arg("address", display_name),
-            fmt::arg("errno", errno),
-            fmt::arg("error", tr_strerror(errno))));
+    auto& datagram = outbox_.emplace_back();
+    std::memcpy(&datagram.to, to, tolen);
+    datagram.tolen = tolen;
+    datagram.sock = sock;
+    datagram.offset = std::size(outbox_bytes_);
+    datagram.len = buflen;
+    auto const* const bytes = static_cast<unsigned char const*>(buf);
+    outbox_bytes_.insert(std::end(outbox_bytes_), bytes, bytes + buflen);
+
+    // send everything that's been queued once this event loop iteration is done
+    if (std::size(outbox_) == 1U && flush_event_)
+    {
+        event_active(flush_event_.get(), 0, 0);
+    }
+}
+
+// ---
+
+void tr_session::tr_udp_core::on_can_read(evutil_socket_t sock, [[maybe_unused]] short type, void* vself)
+{
+    TR_ASSERT(vself != nullptr);
+    TR_ASSERT(type == EV_READ);
+
+    static_cast<tr_udp_core*>(vself)->read_datagrams(sock);
+}
+
+void tr_session::tr_udp_core::on_flush(evutil_socket_t /*sock*/, short /*type*/, void* vself)
+{
+    static_cast<tr_udp_core*>(vself)->flush_outbox();
+}
+
+void tr_session::tr_udp_core::read_datagrams(tr_socket_t const sock)
+{
+    auto got_utp_packet = false;
+
+#ifdef HAVE_RECVMMSG
+    inbox_bytes_.resize(BatchSize * MaxDatagramSize);
+    auto froms = std::array<sockaddr_storage, BatchSize>{};
+    auto iovs = std::array<iovec, BatchSize>{};
+    auto msgs = std::array<mmsghdr, BatchSize>{};
+
+    for (;;)
+    {
+        for (size_t i = 0U; i < BatchSize; ++i)
+        {
+            // leave room for the '\0' that libdht wants
+            iovs[i] = { &inbox_bytes_[i * MaxDatagramSize], MaxDatagramSize - 1U };
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_name = &froms[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(froms[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        auto const n_msgs = recvmmsg(sock, std::data(msgs), static_cast<unsigned int>(BatchSize), 0, nullptr);
+        if (n_msgs <= 0)
+        {
+            break;
+        }
+
+        for (int i = 0; i < n_msgs; ++i)
+        {
+            auto const& hdr = msgs[i].msg_hdr;
+            got_utp_packet |= handle_datagram(
+                static_cast<unsigned char*>(iovs[i].iov_base),
+                msgs[i].msg_len,
+                static_cast<sockaddr*>(hdr.msg_name),
+                hdr.msg_namelen);
+        }
+
+        if (static_cast<size_t>(n_msgs) < BatchSize)
+        {
+            break; // drained
+        }
+    }
+#else
+    inbox_bytes_.resize(MaxDatagramSize);
+    auto from = sockaddr_storage{};
+    auto* const from_sa = reinterpret_cast<sockaddr*>(&from);
+
+    for (;;)
+    {
+        auto fromlen = socklen_t{ sizeof(from) };
+        auto const n_read = recvfrom(
+            sock,
+            reinterpret_cast<char*>(std::data(inbox_bytes_)),
+            std::size(inbox_bytes_) - 1U,
+            0,
+            from_sa,
+            &fromlen);
+        if (n_read <= 0)
+        {
+            break;
+        }
+
+        got_utp_packet |= handle_datagram(std::data(inbox_bytes_), static_cast<size_t>(n_read), from_sa, fromlen);
+    }
+#endif
+
+    if (got_utp_packet)
+    {
+        // To reduce protocol overhead, we wait until we've read all UDP packets
+        // we can, then send one ACK for each µTP socket that received packet(s).
+        tr_utp_issue_deferred_acks(&session_);
+    }
+
+    // send the replies together
+    flush_outbox();
+}
+
+// @return true if it was a µTP packet
+bool tr_session::tr_udp_core::handle_datagram(
+    unsigned char* const buf,
+    size_t const buflen,
+    struct sockaddr* const from,
+    socklen_t const fromlen)
+{
+    auto const from_str = [from]
+    {
+        return tr_socket_address::from_sockaddr(from).value_or(tr_socket_address{}).display_name();
+    };
+
+    if (buflen == 0U)
+    {
+        return false;
+    }
+
+    // Since most packets we receive here are µTP, make quick inline
+    // checks for the other protocols. The logic is as follows:
+    // - all DHT packets start with 'd' (100)
+    // - all UDP tracker packets start with a 32-bit (!) "action", which
+    //   is between 0 and 3
+    // - the above cannot be µTP packets, since these start with a 4-bit
+    //   "type" between 0 and 4, followed by a 4-bit version number (1)
+    if (buf[0] == 'd')
+    {
+        if (session_.dht_)
+        {
+            buf[buflen] = '\0'; // libdht requires zero-terminated messages
+            session_.dht_->handle_message(buf, buflen, from, fromlen);
+        }
+    }
+    else if (buflen >= 8U && buf[0] == 0 && buf[1] == 0 && buf[2] == 0 && buf[3] <= 3)
+    {
+        if (!session_.announcer_udp_->handle_message(buf, buflen, from, fromlen))
+        {
+            tr_logAddTrace(fmt::format("{} Couldn't parse UDP tracker packet.", from_str()));
+        }
+    }
+    else if (session_.allowsUTP() && session_.utp_context != nullptr)
+    {
+        if (tr_utp_packet(buf, buflen, from, fromlen, &session_))
+        {
+            return true;
+        }
+
+        tr_logAddTrace(
+            fmt::format(
+                "{} Unexpected UDP packet... len {} [{}]",
+                from_str(),
+                buflen,
+                tr_base64_encode({ reinterpret_cast<char const*>(buf), buflen })));
+    }
+
+    return false;
+}
+
+// ---
+
+void tr_session::tr_udp_core::send_one(Datagram const& datagram) const
+{
+    auto const* const to = reinterpret_cast<sockaddr const*>(&datagram.to);
+    auto const* const buf = reinterpret_cast<char const*>(&outbox_bytes_[datagram.offset]);
+
+    if (::sendto(datagram.sock, buf, datagram.len, 0, to, datagram.tolen) == -1)
+    {
+        log_send_error(to, sockerrno);
+    }
+}
+
+void tr_session::tr_udp_core::flush_outbox()
+{
+    if (std::empty(outbox_))
+    {
+        return;
+    }
+
+#ifdef HAVE_SENDMMSG
+    // One message per datagram -- or, with GSO, per run of same-sized
+    // datagrams to the same address, which are already contiguous in
+    // `outbox_bytes_` and get split up again by the kernel.
+    struct Message
+    {
+        size_t first = {}; // index into `outbox_`
+        size_t count = {};
+        size_t segment_size = {};
+    };
+
+    auto const same_destination = [](Datagram const& a, Datagram const& b)
+    {
+        return a.sock == b.sock && a.tolen == b.tolen && std::memcmp(&a.to, &b.to, a.tolen) == 0;
+    };
+
+    auto messages = std::vector<Message>{};
+    messages.reserve(std::size(outbox_));
+    for (size_t i = 0U; i < std::size(outbox_);)
+    {
+        auto msg = Message{ i, 1U, outbox_[i].len };
+
+#ifdef UDP_SEGMENT
+        if (gso_enabled_)
+        {
+            auto total = outbox_[i].len;
+            for (auto j = i + 1U; j < std::size(outbox_) && msg.count < MaxGsoSegments; ++j)
+            {
+                auto const& prev = outbox_[j - 1U];
+                auto const& next = outbox_[j];
+
+                // every segment but the last must be full-sized
+                if (prev.len != msg.segment_size || next.len > msg.segment_size ||
+                    total + next.len > MaxGsoBytes || !same_destination(outbox_[i], next))
+                {
+                    break;
+                }
+
+                total += next.len;
+                ++msg.count;
+            }
+        }
+#endif
+
+        messages.push_back(msg);
+        i += msg.count;
+    }
+
+#ifdef UDP_SEGMENT
+    struct alignas(cmsghdr) GsoControl
+    {
+        std::array<char, CMSG_SPACE(sizeof(uint16_t))> bytes;
+    };
+    auto controls = std::vector<GsoControl>(std::size(messages));
+#endif
+    auto iovs = std::vector<iovec>(std::size(messages));
+    auto hdrs = std::vector<mmsghdr>(std::size(messages));
+
+    for (size_t i = 0U; i < std::size(messages); ++i)
+    {
+        auto const& msg = messages[i];
+        auto& datagram = outbox_[msg.first];
+        auto len = size_t{};
+        for (size_t j = 0U; j < msg.count; ++j)
+        {
+            len += outbox_[msg.first + j].len;
+        }
+
+        iovs[i] = { &outbox_bytes_[datagram.offset], len };
+        auto& hdr = hdrs[i].msg_hdr;
+        hdr.msg_name = &datagram.to;
+        hdr.msg_namelen = datagram.tolen;
+        hdr.msg_iov = &iovs[i];
+        hdr.msg_iovlen = 1;
+
+#ifdef UDP_SEGMENT
+        if (msg.count > 1U)
+        {
+            hdr.msg_control = std::data(controls[i].bytes);
+            hdr.msg_controllen = std::size(controls[i].bytes);
+            auto* const cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            auto const segment_size = static_cast<uint16_t>(msg.segment_size);
+            std::memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+        }
+#endif
+    }
+
+    // sendmmsg() takes one socket, so send each run of messages for the same socket together
+    for (size_t i = 0U; i < std::size(messages);)
+    {
+        auto const sock = outbox_[messages[i].first].sock;
+        auto n_msgs = size_t{ 1U };
+        while (i + n_msgs < std::size(messages) && outbox_[messages[i + n_msgs].first].sock == sock &&
+               n_msgs < BatchSize)
+        {
+            ++n_msgs;
+        }
+
+        auto const n_sent = sendmmsg(sock, &hdrs[i], static_cast<unsigned int>(n_msgs), 0);
+        if (n_sent > 0)
+        {
+            i += static_cast<size_t>(n_sent);
+            continue;
+        }
+
+        // the first message failed, so deal with it and move on to the rest
+        auto const error_code = errno;
+        auto const& msg = messages[i];
+#ifdef UDP_SEGMENT
+        if (msg.count > 1U && (error_code == EIO || error_code == EINVAL || error_code == ENOPROTOOPT))
+        {
+            // this kernel or NIC doesn't do GSO, so send the datagrams one at a time
+            tr_logAddDebug(fmt::format("Disabling UDP GSO: {} ({})", tr_strerror(error_code), error_code));
+            gso_enabled_ = false;
+
+            for (size_t j = 0U; j < msg.count; ++j)
+            {
+                send_one(outbox_[msg.first + j]);
+            }
+        }
+        else
+#endif
+        {
+            log_send_error(reinterpret_cast<sockaddr const*>(&outbox_[msg.first].to), error_code);
+        }
+
+        ++i;
+    }
+#else
+    for (auto const& datagram : outbox_)
+    {
+        send_one(datagram);
+    }
+#endif
+
+    outbox_.clear();
+    outbox_bytes_.clear();
 }
@@ -4,12 +4,17 @@
 // License text can be found in the licenses/ folder.
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
-#include <cstddef> // std::byte
+#include <condition_variable>
+#include <cstddef> // std::byte, size_t
 #include <cstdint> // uint64_t, uint32_t
+#include <iterator> // std::distance
 #include <memory>
 #include <mutex>
+#include <new> // std::align_val_t
+#include <optional>
 #include <ranges>
 #include <thread>
 #include <utility> // for std::move()
@@ -17,96 +22,208 @@
 
 #include "libtransmission/crypto-utils.h"
 #include "libtransmission/file.h"
+#include "libtransmission/merkle.h"
 #include "libtransmission/types.h"
 #include "libtransmission/verify.h"
 
-using namespace std::chrono_literals;
-
 namespace
 {
+// Pieces are handed out to worker threads in spans of about this many bytes.
+// Big enough that a thread reads sequentially for a while before moving on,
+// small enough that several threads can share the work of one large torrent.
+auto constexpr BytesPerSpan = uint64_t{ 32U } * 1024U * 1024U;
+
+auto constexpr ReadBufferSize = size_t{ 1024U } * 1024U;
+
+// Read buffers start on a page boundary, so that the kernel
+// can copy whole pages into them.
+auto constexpr ReadBufferAlignment = size_t{ 4096U };
+
+// How far ahead of the reader to ask the OS to prefetch.
+auto constexpr ReadAheadBytes = uint64_t{ 16U } * 1024U * 1024U;
+
 [[nodiscard]] auto current_time_secs()
 {
     return std::chrono::time_point_cast<std::chrono::seconds>(std::chrono::steady_clock::now());
 }
-} // namespace
 
-void tr_verify_worker::verify_torrent(
-    Mediator& verify_mediator,
+// A ring of read buffers shared by a span's reader and its hasher,
+// so that the disk and the CPU can work at the same time.
+class ReadRing
+{
+public:
+    struct Chunk
+    {
+        struct AlignedDelete
+        {
+            void operator()(std::byte* const ptr) const noexcept
+            {
+                ::operator delete(ptr, std::align_val_t{ ReadBufferAlignment });
+            }
+        };
+
+        std::unique_ptr<std::byte, AlignedDelete> buf{ static_cast<std::byte*>(
+            ::operator new(ReadBufferSize, std::align_val_t{ ReadBufferAlignment })) };
+        uint64_t size = {}; // the number of span bytes this chunk covers
+        uint64_t n_valid = {}; // how many of those were actually read
+    };
+
+    // --- reader side
+
+    [[nodiscard]] Chunk* next_empty()
+    {
+        auto lock = std::unique_lock{ mutex_ };
+        cv_.wait(lock, [this]() { return is_closed_ || n_full_ < std::size(chunks_); });
+        return is_closed_ ? nullptr : &chunks_[(head_ + n_full_) % std::size(chunks_)];
+    }
+
+    void push_full()
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        ++n_full_;
+        cv_.notify_all();
+    }
+
+    void finish_writing()
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        is_writing_done_ = true;
+        cv_.notify_all();
+    }
+
+    // --- hasher side
+
+    [[nodiscard]] Chunk const* next_full()
+    {
+        auto lock = std::unique_lock{ mutex_ };
+        cv_.wait(lock, [this]() { return n_full_ > 0U || is_writing_done_; });
+        return n_full_ > 0U ? &chunks_[head_] : nullptr;
+    }
+
+    void pop_full()
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        head_ = (head_ + 1U) % std::size(chunks_);
+        --n_full_;
+        cv_.notify_all();
+    }
+
+    void close()
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        is_closed_ = true;
+        cv_.notify_all();
+    }
+
+    // Get ready for the next span, keeping the buffers.
+    // Only call this when neither side is using the ring.
+    void reset()
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        head_ = {};
+        n_full_ = {};
+        is_writing_done_ = false;
+        is_closed_ = false;
+    }
+
+private:
+    std::array<Chunk, 4U> chunks_;
+    size_t head_ = {};
+    size_t n_full_ = {};
+    bool is_writing_done_ = false;
+    bool is_closed_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+// Read the bytes [begin_byte, end_byte) of a torrent into `ring`.
+// Chunks never cross a file boundary, so a missing or short file
+// can't spoil the neighbouring pieces that don't touch it.
+void read_span(
+    tr_verify_worker::Mediator const& verify_mediator,
+    std::vector<uint64_t> const& file_ends,
+    uint64_t const begin_byte,
+    uint64_t const end_byte,
     std::atomic<bool> const& abort_flag,
-    std::chrono::milliseconds const sleep_per_seconds_during_verify)
+    ReadRing& ring)
 {
-    verify_mediator.on_verify_started();
+    auto const& metainfo = verify_mediator.metainfo();
+
+    // find the first non-empty file that holds the span's first byte
+    auto const file_iter = std::ranges::upper_bound(file_ends, begin_byte);
+    if (file_iter == std::ranges::end(file_ends))
+    {
+        ring.finish_writing();
+        return;
+    }
 
     tr_sys_file_t fd = TR_BAD_SYS_FILE;
-    uint64_t file_pos = 0U;
-    uint32_t piece_pos = 0U;
-    tr_file_index_t file_index = 0U;
+    auto file_index = static_cast<tr_file_index_t>(std::distance(std::ranges::begin(file_ends), file_iter));
+    uint64_t file_pos = begin_byte - (*file_iter - metainfo.file_size(file_index));
     tr_file_index_t prev_file_index = ~file_index;
-    tr_piece_index_t piece = 0U;
-    auto buffer = std::vector<std::byte>(1024U * 256U);
-    auto sha = tr_sha1{};
-    auto last_slept_at = current_time_secs();
+    uint64_t advised_until = 0U;
+    uint64_t pos = begin_byte;
 
-    auto const& metainfo = verify_mediator.metainfo();
-    while (!abort_flag && piece < metainfo.piece_count())
+    while (!abort_flag && pos < end_byte && file_index < metainfo.file_count())
     {
         auto const file_length = metainfo.file_size(file_index);
 
         /* if we're starting a new file... */
-        if (file_pos == 0U && fd == TR_BAD_SYS_FILE && file_index != prev_file_index)
+        if (fd == TR_BAD_SYS_FILE && file_index != prev_file_index && file_pos < file_length)
         {
             auto const found = verify_mediator.find_file(file_index);
             fd = !found ? TR_BAD_SYS_FILE : tr_sys_file_open(*found, TR_SYS_FILE_READ | TR_SYS_FILE_SEQUENTIAL, 0);
             prev_file_index = file_index;
+            advised_until = file_pos;
         }
 
-        /* figure out how much we can read this pass */
-        uint64_t left_in_piece = metainfo.piece_size(piece) - piece_pos;
-        uint64_t left_in_file = file_length - file_pos;
-        uint64_t bytes_this_pass = std::min(left_in_file, left_in_piece);
-        bytes_this_pass = std::min(bytes_this_pass, uint64_t(std::size(buffer)));
-
-        /* read a bit */
-        if (fd != TR_BAD_SYS_FILE)
+        if (file_pos < file_length)
         {
-            auto num_read = uint64_t{};
-            if (tr_sys_file_read_at(fd, std::data(buffer), bytes_this_pass, file_pos, &num_read) && num_read > 0U)
+            auto* const chunk = ring.next_empty();
+            if (chunk == nullptr)
             {
-                bytes_this_pass = num_read;
-                sha.add(std::data(buffer), bytes_this_pass);
+                break;
             }
-        }
 
-        /* move our offsets */
-        left_in_piece -= bytes_this_pass;
-        left_in_file -= bytes_this_pass;
-        piece_pos += bytes_this_pass;
-        file_pos += bytes_this_pass;
+            chunk->size = std::min({ uint64_t{ ReadBufferSize }, file_length - file_pos, end_byte - pos });
+            chunk->n_valid = 0U;
 
-        /* if we're finishing a piece... */
-        if (left_in_piece == 0U)
-        {
-            auto const has_piece = sha.finish() == metainfo.piece_hash(piece);
-            verify_mediator.on_piece_checked(piece, has_piece);
-
-            if (sleep_per_seconds_during_verify > std::chrono::milliseconds::zero())
+            if (fd != TR_BAD_SYS_FILE)
             {
-                /* sleeping even just a few msec per second goes a long
-                 * way towards reducing IO load... */
-                if (auto const now = current_time_secs(); last_slept_at != now)
+                // let the OS prefetch further ahead than our own buffers go
+                if (file_pos + chunk->size > advised_until)
                 {
-                    last_slept_at = now;
-                    std::this_thread::sleep_for(sleep_per_seconds_during_verify);
+                    auto const n_bytes = std::min(ReadAheadBytes, file_length - file_pos);
+                    tr_sys_file_advise(fd, file_pos, n_bytes, TR_SYS_FILE_ADVICE_WILL_NEED);
+                    advised_until = file_pos + n_bytes;
+                }
+
+                while (chunk->n_valid < chunk->size)
+                {
+                    auto num_read = uint64_t{};
+                    if (!tr_sys_file_read_at(
+                            fd,
+                            chunk->buf.get() + chunk->n_valid,
+                            chunk->size - chunk->n_valid,
+                            file_pos + chunk->n_valid,
+                            &num_read) ||
+                        num_read == 0U)
+                    {
+                        break;
+                    }
+
+                    chunk->n_valid += num_read;
                 }
             }
 
-            sha.clear();
-            ++piece;
-            piece_pos = 0U;
+            pos += chunk->size;
+            file_pos += chunk->size;
+            ring.push_full();
         }
 
         /* if we're finishing a file... */
-        if (left_in_file == 0U)
+        if (file_pos >= file_length)
         {
             if (fd != TR_BAD_SYS_FILE)
             {
@@ -125,33 +242,379 @@ void tr_verify_worker::verify_torrent(
         tr_sys_file_close(fd);
     }
 
-    verify_mediator.on_verify_done(abort_flag);
+    ring.finish_writing();
 }
+} // namespace
 
-void tr_verify_worker::verify_thread_func()
+// Reads spans into a ring on a thread of its own, so that a worker can hash
+// one chunk while the next one is being read. Each worker thread keeps one
+// of these for as long as it lives instead of starting a thread per span.
+class tr_verify_worker::SpanReader
 {
-    for (;;)
+public:
+    SpanReader()
+        : thread_{ &SpanReader::thread_func, this }
+    {
+    }
+
+    SpanReader(SpanReader const&) = delete;
+    SpanReader(SpanReader&&) = delete;
+    SpanReader& operator=(SpanReader const&) = delete;
+    SpanReader& operator=(SpanReader&&) = delete;
+
+    ~SpanReader()
+    {
+        {
+            auto const lock = std::scoped_lock{ mutex_ };
+            is_quitting_ = true;
+            cv_.notify_all();
+        }
+
+        thread_.join();
+    }
+
+    [[nodiscard]] ReadRing& start(Job const& job, uint64_t const begin_byte, uint64_t const end_byte)
+    {
+        auto const lock = std::scoped_lock{ mutex_ };
+        span_ = Span{ &job, begin_byte, end_byte };
+        cv_.notify_all();
+        return ring_;
+    }
+
+    // Stop reading the current span, if it's not done yet,
+    // and wait for the reader to let go of the ring.
+    void finish()
+    {
+        ring_.close();
+
+        auto lock = std::unique_lock{ mutex_ };
+        cv_.wait(lock, [this]() { return !span_; });
+        ring_.reset();
+    }
+
+private:
+    struct Span
+    {
+        Job const* job;
+        uint64_t begin_byte;
+        uint64_t end_byte;
+    };
+
+    void thread_func()
+    {
+        auto lock = std::unique_lock{ mutex_ };
+
+        for (;;)
+        {
+            cv_.wait(lock, [this]() { return is_quitting_ || span_; });
+            if (is_quitting_)
+            {
+                return;
+            }
+
+            auto const span = *span_;
+            lock.unlock();
+            read_span(span.job->mediator(), span.job->file_ends_, span.begin_byte, span.end_byte, span.job->abort_, ring_);
+            lock.lock();
+
+            span_.reset();
+            cv_.notify_all();
+        }
+    }
+
+    ReadRing ring_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::optional<Span> span_;
+    bool is_quitting_ = false;
+
+    std::thread thread_;
+};
+
+tr_verify_worker::Job::Job(Node&& node)
+    : node_{ std::move(node) }
+    , merkle_{ mediator().metainfo() }
+{
+    auto const& metainfo = mediator().metainfo();
+
+    piece_count_ = metainfo.piece_count();
+    pieces_per_span_ = static_cast<tr_piece_index_t>(
+        std::max(uint64_t{ 1U }, BytesPerSpan / std::max(uint64_t{ metainfo.piece_size() }, uint64_t{ 1U })));
+
+    auto const n_files = metainfo.file_count();
+    file_ends_.reserve(n_files);
+    auto file_end = uint64_t{};
+    for (tr_file_index_t file_index = 0U; file_index < n_files; ++file_index)
+    {
+        file_end += metainfo.file_size(file_index);
+        file_ends_.emplace_back(file_end);
+    }
+}
+
+tr_verify_worker::Throttle::Throttle()
+    : last_slept_at_{ current_time_secs() }
+{
+}
+
+void tr_verify_worker::Throttle::maybe_sleep(std::chrono::milliseconds const sleep_per_seconds_during_verify)
+{
+    if (sleep_per_seconds_during_verify <= std::chrono::milliseconds::zero())
+    {
+        return;
+    }
+
+    /* sleeping even just a few msec per second goes a long
+     * way towards reducing IO load... */
+    if (auto const now = current_time_secs(); last_slept_at_ != now)
+    {
+        last_slept_at_ = now;
+        std::this_thread::sleep_for(sleep_per_seconds_during_verify);
+    }
+}
+
+std::vector<bool> tr_verify_worker::hash_span(
+    Job const& job,
+    PieceSpan const span,
+    std::atomic<bool> const& abort_flag,
+    std::chrono::milliseconds const sleep_per_seconds_during_verify,
+    Throttle& throttle,
+    SpanReader& reader)
+{
+    auto results = std::vector<bool>{};
+    if (span.begin >= span.end)
+    {
+        return results;
+    }
+
+    results.reserve(span.end - span.begin);
+
+    auto const& verify_mediator = job.mediator();
+    auto const& metainfo = verify_mediator.metainfo();
+    auto const begin_byte = metainfo.piece_loc(span.begin).byte;
+    auto const end_byte = metainfo.block_info().byte_span_for_piece(span.end - 1U).end;
+
+    // read on one thread while hashing on this one
+    auto& ring = reader.start(job, begin_byte, end_byte);
+
+    auto sha = tr_sha1{};
+    auto v2 = tr_merkle_piece_checker{};
+    auto piece = span.begin;
+    uint64_t left_in_piece = metainfo.piece_size(piece);
+    auto piece_is_intact = true;
+    v2.start(job.merkle_, piece);
+
+    while (!abort_flag && piece < span.end)
     {
+        auto const* const chunk = ring.next_full();
+        if (chunk == nullptr)
         {
-            auto const lock = std::scoped_lock{ verify_mutex_ };
+            break;
+        }
+
+        for (uint64_t chunk_pos = 0U; chunk_pos < chunk->size && piece < span.end;)
+        {
+            auto const bytes_this_pass = std::min(left_in_piece, chunk->size - chunk_pos);
 
-            if (stop_current_)
+            if (chunk_pos + bytes_this_pass <= chunk->n_valid)
             {
-                stop_current_ = false;
-                stop_current_cv_.notify_one();
+                sha.add(chunk->buf.get() + chunk_pos, bytes_this_pass);
+                v2.add(chunk->buf.get() + chunk_pos, bytes_this_pass);
             }
+            else
+            {
+                piece_is_intact = false;
+            }
+
+            chunk_pos += bytes_this_pass;
+            left_in_piece -= bytes_this_pass;
 
-            if (std::empty(todo_))
+            /* if we're finishing a piece... */
+            if (left_in_piece == 0U)
             {
-                current_node_.reset();
-                verify_thread_id_.reset();
-                return;
+                auto const hash_matches = sha.finish() == metainfo.piece_hash(piece);
+                auto const tree_matches = v2.finish();
+                results.emplace_back(piece_is_intact && hash_matches && tree_matches);
+                throttle.maybe_sleep(sleep_per_seconds_during_verify);
+
+                sha.clear();
+                piece_is_intact = true;
+                if (++piece < span.end)
+                {
+                    left_in_piece = metainfo.piece_size(piece);
+                    v2.start(job.merkle_, piece);
+                }
             }
+        }
+
+        ring.pop_full();
+    }
+
+    reader.finish();
+
+    return results;
+}
+
+// Must be called with verify_mutex_ locked.
+tr_verify_worker::Job* tr_verify_worker::start_next_job()
+{
+    if (std::empty(todo_))
+    {
+        return nullptr;
+    }
+
+    auto& job = active_.emplace_back(std::make_unique<Job>(std::move(todo_.extract(std::begin(todo_)).value())));
+    job->mediator().on_verify_started();
+    return job.get();
+}
+
+// Must be called with verify_mutex_ locked.
+tr_verify_worker::Job* tr_verify_worker::claim_job(Job const* const preferred)
+{
+    // keep working on the same torrent if possible so that reads stay sequential
+    if (preferred != nullptr)
+    {
+        auto const iter = std::ranges::find_if(active_, [preferred](auto const& job) { return job.get() == preferred; });
+        if (iter != std::ranges::end(active_) && (*iter)->has_unclaimed_pieces())
+        {
+            return iter->get();
+        }
+    }
+
+    // if there's a thread to spare, start verifying another torrent
+    if (std::size(active_) < thread_count_)
+    {
+        if (auto* const job = start_next_job(); job != nullptr)
+        {
+            return job;
+        }
+    }
+
+    // otherwise, help out with the highest-priority torrent that has unclaimed pieces
+    auto* best = static_cast<Job*>(nullptr);
+    for (auto const& job : active_)
+    {
+        if (job->has_unclaimed_pieces() && (best == nullptr || job->node_ < best->node_))
+        {
+            best = job.get();
+        }
+    }
+
+    return best != nullptr ? best : start_next_job();
+}
+
+// Report hashed pieces to the mediator in piece order, and finish the job
+// if there's nothing left to do. Only one thread reports for a given job at
+// a time; results that arrive while it's busy are picked up in its loop.
+// Returns true iff the job was finished and freed.
+bool tr_verify_worker::report_pieces(std::unique_lock<std::mutex>& lock, Job& job)
+{
+    if (job.is_reporting_)
+    {
+        return false;
+    }
+
+    job.is_reporting_ = true;
+
+    while (!job.abort_)
+    {
+        auto node = job.finished_.extract(job.next_to_report_);
+        if (!node)
+        {
+            break;
+        }
+
+        auto const first_piece = node.key();
+        auto const& results = node.mapped();
+        job.next_to_report_ = first_piece + static_cast<tr_piece_index_t>(std::size(results));
 
-            current_node_ = std::move(todo_.extract(std::begin(todo_)).value());
+        // the job can't be finished while we're reporting, so it's safe to unlock
+        lock.unlock();
+        for (size_t i = 0U, n = std::size(results); i < n; ++i)
+        {
+            job.mediator().on_piece_checked(first_piece + static_cast<tr_piece_index_t>(i), results[i]);
         }
+        lock.lock();
+    }
+
+    job.is_reporting_ = false;
+
+    if (!job.is_done())
+    {
+        return false;
+    }
+
+    // Keep the job in `active_` until its mediator is notified, so that
+    // `remove()` doesn't return while the callback is still running.
+    job.is_reporting_ = true;
+    auto const aborted = job.abort_.load();
+    lock.unlock();
+    job.mediator().on_verify_done(aborted);
+    lock.lock();
+
+    auto const iter = std::ranges::find_if(active_, [&job](auto const& candidate) { return candidate.get() == &job; });
+    active_.erase(iter);
+    job_done_cv_.notify_all();
+    return true;
+}
+
+void tr_verify_worker::verify_thread_func()
+{
+    auto throttle = Throttle{};
+    auto reader = SpanReader{};
+    auto* job = static_cast<Job*>(nullptr);
+    auto lock = std::unique_lock{ verify_mutex_ };
+
+    for (;;)
+    {
+        // retire if there are more threads than wanted or nothing left to do
+        job = n_threads_ > thread_count_ ? nullptr : claim_job(job);
+        if (job == nullptr)
+        {
+            --n_threads_;
+            job_done_cv_.notify_all();
+            return;
+        }
+
+        auto const span = PieceSpan{ job->next_unclaimed_,
+                                     std::min(job->piece_count_, job->next_unclaimed_ + job->pieces_per_span_) };
+        job->next_unclaimed_ = span.end;
+        ++job->n_spans_in_flight_;
+        auto const sleep_per_seconds_during_verify = sleep_per_seconds_during_verify_;
+
+        lock.unlock();
+        auto results = hash_span(*job, span, job->abort_, sleep_per_seconds_during_verify, throttle, reader);
+        lock.lock();
+
+        --job->n_spans_in_flight_;
+        if (!job->abort_)
+        {
+            // pieces we couldn't get to, e.g. because of a short file, are missing
+            results.resize(span.end - span.begin, false);
+            job->finished_.try_emplace(span.begin, std::move(results));
+        }
+
+        if (report_pieces(lock, *job))
+        {
+            job = nullptr;
+        }
+    }
+}
 
-        verify_torrent(*current_node_->mediator_, stop_current_, sleep_per_seconds_during_verify_);
+// Must be called with verify_mutex_ locked.
+void tr_verify_worker::maybe_start_threads()
+{
+    auto const has_work = !std::empty(todo_) ||
+        std::ranges::any_of(active_, [](auto const& job) { return job->has_unclaimed_pieces(); });
+    if (!has_work)
+    {
+        return;
+    }
+
+    while (n_threads_ < thread_count_)
+    {
+        std::thread(&tr_verify_worker::verify_thread_func, this).detach();
+        ++n_threads_;
     }
 }
 
@@ -161,23 +624,28 @@ void tr_verify_worker::add(std::unique_ptr<Mediator> mediator, tr_priority_t pri
 
     mediator->on_verify_queued();
     todo_.emplace(std::move(mediator), priority);
-
-    if (!verify_thread_id_)
-    {
-        auto thread = std::thread(&tr_verify_worker::verify_thread_func, this);
-        verify_thread_id_ = thread.get_id();
-        thread.detach();
-    }
+    maybe_start_threads();
 }
 
 void tr_verify_worker::remove(tr_sha1_digest_t const& info_hash)
 {
     auto lock = std::unique_lock(verify_mutex_);
 
-    if (current_node_ && current_node_->matches(info_hash))
+    auto const matches = [&info_hash](auto const& job)
+    {
+        return job->node_.matches(info_hash);
+    };
+
+    if (auto const iter = std::ranges::find_if(active_, matches); iter != std::ranges::end(active_))
     {
-        stop_current_ = true;
-        stop_current_cv_.wait(lock, [this]() { return !stop_current_; });
+        auto& job = **iter;
+        job.abort_ = true;
+
+        // if no thread is working on it right now, finish it here
+        if (!report_pieces(lock, job))
+        {
+            job_done_cv_.wait(lock, [this, &matches]() { return std::ranges::none_of(active_, matches); });
+        }
     }
     else if (auto const iter = std::ranges::find_if(todo_, [&info_hash](auto const& node) { return node.matches(info_hash); });
              iter != std::ranges::end(todo_))
@@ -189,16 +657,31 @@ void tr_verify_worker::remove(tr_sha1_digest_t const& info_hash)
 
 tr_verify_worker::~tr_verify_worker()
 {
+    auto lock = std::unique_lock{ verify_mutex_ };
+
+    todo_.clear();
+
+    for (auto const& job : active_)
     {
-        auto const lock = std::scoped_lock{ verify_mutex_ };
-        stop_current_ = true;
-        todo_.clear();
+        job->abort_ = true;
+    }
+
+    // finish the jobs that no thread is working on right now
+    auto idle = std::vector<Job*>{};
+    for (auto const& job : active_)
+    {
+        if (job->is_done())
+        {
+            idle.emplace_back(job.get());
+        }
     }
 
-    while (verify_thread_id_.has_value())
+    for (auto* const job : idle)
     {
-        std::this_thread::sleep_for(20ms);
+        report_pieces(lock, *job);
     }
+
+    job_done_cv_.wait(lock, [this]() { return n_threads_ == 0U && std::empty(active_); });
 }
 
 void tr_verify_worker::set_sleep_per_seconds_during_verify(std::chrono::milliseconds const sleep_per_seconds_during_verify)
@@ -206,6 +689,14 @@ void tr_verify_worker::set_sleep_per_seconds_during_verify(std::chrono::millisec
     sleep_per_seconds_during_verify_ = sleep_per_seconds_during_verify;
 }
 
+void tr_verify_worker::set_thread_count(size_t const thread_count)
+{
+    auto const lock = std::scoped_lock{ verify_mutex_ };
+
+    thread_count_ = std::max(thread_count, size_t{ 1U });
+    maybe_start_threads();
+}
+
 int tr_verify_worker::Node::compare(Node const& that) const noexcept
 {
     // prefer higher-priority torrents
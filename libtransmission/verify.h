@@ -10,15 +10,20 @@
 #endif
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <set>
 #include <string>
-#include <thread>
 #include <utility> // std::move
+#include <vector>
 
+#include "libtransmission/merkle.h"
 #include "libtransmission/torrent-metainfo.h"
 #include "libtransmission/types.h"
 
@@ -58,6 +63,16 @@ public:
         return sleep_per_seconds_during_verify_;
     }
 
+    // How many threads may hash at the same time.
+    // Each thread prefers to verify a torrent of its own, but
+    // idle threads will help out with the pieces of a large one.
+    void set_thread_count(size_t thread_count);
+
+    [[nodiscard]] auto thread_count() const noexcept
+    {
+        return thread_count_.load();
+    }
+
 private:
     struct Node
     {
@@ -83,22 +98,93 @@ private:
         tr_priority_t priority_;
     };
 
-    static void verify_torrent(
-        Mediator& verify_mediator,
+    // A torrent that is being verified. Its pieces are handed out to the
+    // worker threads in spans, and the results are reported back to the
+    // mediator in piece order no matter which thread finishes first.
+    struct Job
+    {
+        explicit Job(Node&& node);
+
+        [[nodiscard]] auto& mediator() const noexcept
+        {
+            return *node_.mediator_;
+        }
+
+        [[nodiscard]] bool has_unclaimed_pieces() const noexcept
+        {
+            return !abort_ && next_unclaimed_ < piece_count_;
+        }
+
+        [[nodiscard]] bool is_done() const noexcept
+        {
+            return n_spans_in_flight_ == 0U && !is_reporting_ && (abort_ || next_to_report_ >= piece_count_);
+        }
+
+        Node node_;
+
+        // the byte offset where each file ends, used to find a span's first file
+        std::vector<uint64_t> file_ends_;
+
+        // hybrid torrents' pieces are checked against their files' v2 trees too
+        tr_merkle_pieces merkle_;
+
+        tr_piece_index_t piece_count_ = {};
+        tr_piece_index_t pieces_per_span_ = {};
+
+        tr_piece_index_t next_unclaimed_ = {};
+        tr_piece_index_t next_to_report_ = {};
+
+        // hashed spans waiting for their turn to be reported, keyed by first piece
+        std::map<tr_piece_index_t, std::vector<bool>> finished_;
+
+        size_t n_spans_in_flight_ = {};
+        bool is_reporting_ = false;
+
+        std::atomic<bool> abort_ = false;
+    };
+
+    struct PieceSpan
+    {
+        tr_piece_index_t begin;
+        tr_piece_index_t end;
+    };
+
+    class Throttle
+    {
+    public:
+        Throttle();
+
+        void maybe_sleep(std::chrono::milliseconds sleep_per_seconds_during_verify);
+
+    private:
+        std::chrono::time_point<std::chrono::steady_clock, std::chrono::seconds> last_slept_at_;
+    };
+
+    class SpanReader;
+
+    [[nodiscard]] static std::vector<bool> hash_span(
+        Job const& job,
+        PieceSpan span,
         std::atomic<bool> const& abort_flag,
-        std::chrono::milliseconds sleep_per_seconds_during_verify);
+        std::chrono::milliseconds sleep_per_seconds_during_verify,
+        Throttle& throttle,
+        SpanReader& reader);
+
+    [[nodiscard]] Job* claim_job(Job const* preferred);
+    [[nodiscard]] Job* start_next_job();
+    bool report_pieces(std::unique_lock<std::mutex>& lock, Job& job);
+    void maybe_start_threads();
 
     void verify_thread_func();
 
     std::mutex verify_mutex_;
+    std::condition_variable job_done_cv_;
 
     std::set<Node> todo_;
-    std::optional<Node> current_node_;
-
-    std::optional<std::thread::id> verify_thread_id_;
+    std::vector<std::unique_ptr<Job>> active_;
 
-    std::atomic<bool> stop_current_ = false;
-    std::condition_variable stop_current_cv_;
+    size_t n_threads_ = {};
+    std::atomic<size_t> thread_count_ = 1U;
 
     std::chrono::milliseconds sleep_per_seconds_during_verify_ = {};
 };
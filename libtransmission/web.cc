@@ -328,6 +328,11 @@ public:
             return options_.timeout_secs;
         }
 
+        [[nodiscard]] constexpr auto prefer_reuse() const
+        {
+            return options_.prefer_reuse;
+        }
+
         [[nodiscard]] constexpr auto ipProtocol() const
         {
             switch (options_.ip_proto)
@@ -675,6 +680,12 @@ public:
         {
             (void)curl_easy_setopt(e, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
         }
+#if LIBCURL_VERSION_NUM >= 0x072B00 /* 7.43.0 */
+        else if (task.prefer_reuse())
+        {
+            (void)curl_easy_setopt(e, CURLOPT_PIPEWAIT, 1L);
+        }
+#endif
     }
 
     void resumePausedTasks()
@@ -90,6 +90,11 @@ public:
         // IP protocol to use when making the request
         IPProtocol ip_proto = IPProtocol::ANY;
 
+        // If true, prefer to wait for an existing connection to the host
+        // -- and multiplex over it, if it's HTTP/2 -- instead of opening
+        // a new one. Useful for many small requests to the same server.
+        bool prefer_reuse = false;
+
         static auto constexpr DefaultTimeoutSecs = std::chrono::seconds{ 120 };
     };
 
@@ -0,0 +1,222 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef> // size_t, std::byte
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <event2/util.h>
+
+#include <fmt/format.h>
+
+#include <gtest/gtest.h>
+
+#define LIBTRANSMISSION_ANNOUNCER_MODULE
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/announcer-common.h>
+#include <libtransmission/interned-string.h>
+#include <libtransmission/net.h>
+#include <libtransmission/session.h>
+#include <libtransmission/string-utils.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+namespace tr::test
+{
+
+class AnnouncerHttpTest : public SessionTest
+{
+protected:
+    // A minimal HTTP/1.1 tracker on the loopback interface that answers
+    // every request with the same scrape response and keeps the connection open
+    class Tracker
+    {
+    public:
+        Tracker()
+            : sock_{ socket(AF_INET, SOCK_STREAM, 0) }
+        {
+            EXPECT_NE(TR_BAD_SOCKET, sock_) << tr_strerror(sockerrno);
+
+            auto const [ss, sslen] = tr_socket_address::to_sockaddr(*tr_address::from_string("127.0.0.1"sv), tr_port{});
+            EXPECT_EQ(0, bind(sock_, reinterpret_cast<sockaddr const*>(&ss), sslen)) << tr_strerror(sockerrno);
+            EXPECT_EQ(0, listen(sock_, 8)) << tr_strerror(sockerrno);
+            EXPECT_EQ(0, evutil_make_socket_nonblocking(sock_));
+
+            // find out which port we got
+            auto addr = sockaddr_storage{};
+            auto addr_len = socklen_t{ sizeof(addr) };
+            EXPECT_EQ(0, getsockname(sock_, reinterpret_cast<sockaddr*>(&addr), &addr_len)) << tr_strerror(sockerrno);
+            port_ = tr_socket_address::from_sockaddr(reinterpret_cast<sockaddr const*>(&addr))->port();
+
+            thread_ = std::thread{ [this]() { run(); } };
+        }
+
+        ~Tracker()
+        {
+            stop_ = true;
+            thread_.join();
+            evutil_closesocket(sock_);
+        }
+
+        Tracker(Tracker const&) = delete;
+        Tracker(Tracker&&) = delete;
+        Tracker& operator=(Tracker const&) = delete;
+        Tracker& operator=(Tracker&&) = delete;
+
+        [[nodiscard]] auto scrape_url() const
+        {
+            return fmt::format("http://127.0.0.1:{:d}/scrape", port_.host());
+        }
+
+        [[nodiscard]] auto n_connections() const noexcept
+        {
+            return n_connections_.load();
+        }
+
+        [[nodiscard]] auto n_requests() const noexcept
+        {
+            return n_requests_.load();
+        }
+
+        // clang-format off
+        static auto constexpr Body =
+            "d"
+                "5:files" "d"
+                    "20:aaaaaaaaaaaaaaaaaaaa" "d"
+                        "8:complete" "i1e"
+                        "10:downloaded" "i2e"
+                        "10:incomplete" "i3e"
+                    "e"
+                "e"
+            "e"sv;
+        // clang-format on
+
+    private:
+        struct Connection
+        {
+            tr_socket_t sock = TR_BAD_SOCKET;
+            std::string buf;
+        };
+
+        void run()
+        {
+            auto const response = fmt::format(
+                "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: {:d}\r\n\r\n{:s}",
+                std::size(Body),
+                Body);
+
+            auto conns = std::vector<Connection>{};
+            auto buf = std::array<char, 4096U>{};
+            while (!stop_)
+            {
+                if (auto const sock = accept(sock_, nullptr, nullptr); sock != TR_BAD_SOCKET)
+                {
+                    EXPECT_EQ(0, evutil_make_socket_nonblocking(sock));
+                    conns.push_back({ sock, {} });
+                    ++n_connections_;
+                }
+
+                for (auto& conn : conns)
+                {
+                    if (auto const n = recv(conn.sock, std::data(buf), std::size(buf), 0); n > 0)
+                    {
+                        conn.buf.append(std::data(buf), static_cast<size_t>(n));
+                    }
+
+                    for (auto pos = conn.buf.find("\r\n\r\n"); pos != std::string::npos; pos = conn.buf.find("\r\n\r\n"))
+                    {
+                        conn.buf.erase(0U, pos + 4U);
+                        ++n_requests_;
+                        auto const n_sent = send(conn.sock, std::data(response), std::size(response), 0);
+                        EXPECT_EQ(std::size(response), static_cast<size_t>(n_sent)) << tr_strerror(sockerrno);
+                    }
+                }
+
+                std::this_thread::sleep_for(10ms);
+            }
+
+            for (auto const& conn : conns)
+            {
+                evutil_closesocket(conn.sock);
+            }
+        }
+
+        tr_socket_t sock_ = TR_BAD_SOCKET;
+        tr_port port_;
+        std::thread thread_;
+        std::atomic<bool> stop_ = false;
+        std::atomic<size_t> n_connections_ = 0U;
+        std::atomic<size_t> n_requests_ = 0U;
+    };
+
+    [[nodiscard]] tr_scrape_response scrape(Tracker const& tracker)
+    {
+        auto request = tr_scrape_request{};
+        request.scrape_url = tr_interned_string{ tracker.scrape_url() };
+        request.log_name = "test"sv;
+        request.info_hash[0].fill(std::byte{ 'a' });
+        request.info_hash_count = 1U;
+
+        // shared, so that a response that comes in after we give up is harmless
+        auto promise = std::make_shared<std::promise<tr_scrape_response>>();
+        auto future = promise->get_future();
+        session_->run_in_session_thread(
+            [this, request, promise]()
+            {
+                tr_tracker_http_scrape(
+                    session_,
+                    request,
+                    [promise](tr_scrape_response const& response) { promise->set_value(response); });
+            });
+
+        if (future.wait_for(30s) != std::future_status::ready)
+        {
+            ADD_FAILURE() << "scrape timed out";
+            return {};
+        }
+
+        return future.get();
+    }
+};
+
+TEST_F(AnnouncerHttpTest, scrapesReuseTheTrackerConnection)
+{
+    auto const tracker = Tracker{};
+
+    for (size_t i = 1U; i <= 3U; ++i)
+    {
+        auto const response = scrape(tracker);
+        EXPECT_TRUE(response.did_connect);
+        EXPECT_FALSE(response.did_timeout);
+        EXPECT_EQ(""sv, response.errmsg);
+        ASSERT_EQ(1U, response.row_count);
+        EXPECT_EQ(1, response.rows[0].seeders);
+        EXPECT_EQ(3, response.rows[0].leechers);
+        EXPECT_EQ(2, response.rows[0].downloads);
+        EXPECT_EQ(i, tracker.n_requests());
+    }
+
+    // the tracker client kept the first connection alive for the others
+    EXPECT_EQ(1U, tracker.n_connections());
+}
+
+} // namespace tr::test
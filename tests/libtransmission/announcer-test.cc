@@ -7,12 +7,15 @@
 #include <array>
 #include <cassert>
 #include <cstddef> // std::byte
+#include <ctime>
 #include <optional>
 #include <string_view>
+#include <vector>
 
 #define LIBTRANSMISSION_ANNOUNCER_MODULE
 
 #include <libtransmission/announcer-common.h>
+#include <libtransmission/interned-string.h>
 #include <libtransmission/net.h>
 
 #include "test-fixtures.h"
@@ -307,3 +310,162 @@ TEST_F(AnnouncerTest, parseHttpScrapeResponseMultiWithMissing)
     EXPECT_EQ(8, response.rows[2].leechers);
     EXPECT_EQ(9, response.rows[2].downloads);
 }
+
+TEST_F(AnnouncerTest, wakeupsPopOnlyWhatIsDue)
+{
+    auto wakeups = tr_announcer_wakeups{};
+    wakeups.wake_at(300, 1, 0U);
+    wakeups.wake_at(100, 2, 1U);
+    wakeups.wake_at(200, 3, 0U);
+    wakeups.wake_at(0, 4, 0U); // nothing scheduled
+    EXPECT_EQ(3U, std::size(wakeups));
+
+    EXPECT_TRUE(std::empty(wakeups.pop_due(99)));
+
+    using Keys = std::vector<tr_announcer_wakeups::Key>;
+    EXPECT_EQ((Keys{ { 2, 1U }, { 3, 0U } }), wakeups.pop_due(250));
+    EXPECT_EQ(1U, std::size(wakeups));
+    EXPECT_EQ((Keys{ { 1, 0U } }), wakeups.pop_due(1000));
+    EXPECT_EQ(0U, std::size(wakeups));
+}
+
+TEST_F(AnnouncerTest, wakeupsReturnEachTierOnce)
+{
+    auto wakeups = tr_announcer_wakeups{};
+    wakeups.wake_at(10, 1, 0U);
+    wakeups.wake_at(20, 1, 0U);
+    wakeups.wake_at(15, 1, 1U);
+    wakeups.wake_at(30, 1, 0U);
+
+    using Keys = std::vector<tr_announcer_wakeups::Key>;
+    EXPECT_EQ((Keys{ { 1, 0U }, { 1, 1U } }), wakeups.pop_due(20));
+
+    // the later wakeup for the same tier stays queued
+    EXPECT_EQ(1U, std::size(wakeups));
+    EXPECT_EQ((Keys{ { 1, 0U } }), wakeups.pop_due(30));
+}
+
+TEST_F(AnnouncerTest, wakeupsRewakeBusyOrOverCapTiers)
+{
+    auto constexpr Now = time_t{ 1000 };
+
+    // an announce that couldn't go out -- because the tier was busy, or
+    // because upkeep ran out of announce slots -- is still overdue
+    EXPECT_TRUE(tr_announcer_wakeups::is_overdue(Now, Now - 5, true, 0, false));
+    EXPECT_TRUE(tr_announcer_wakeups::is_overdue(Now, Now, true, 0, false));
+    // ...and so is a scrape that couldn't go out
+    EXPECT_TRUE(tr_announcer_wakeups::is_overdue(Now, 0, false, Now - 5, true));
+
+    // nothing to announce, can't scrape, or not due yet
+    EXPECT_FALSE(tr_announcer_wakeups::is_overdue(Now, Now - 5, false, 0, false));
+    EXPECT_FALSE(tr_announcer_wakeups::is_overdue(Now, 0, false, Now - 5, false));
+    EXPECT_FALSE(tr_announcer_wakeups::is_overdue(Now, Now + 1, true, Now + 1, true));
+
+    // an overdue tier is re-woken for the next upkeep rather than dropped
+    auto wakeups = tr_announcer_wakeups{};
+    wakeups.wake_at(Now - 5, 7, 2U);
+    using Keys = std::vector<tr_announcer_wakeups::Key>;
+    auto const due = wakeups.pop_due(Now);
+    EXPECT_EQ((Keys{ { 7, 2U } }), due);
+    for (auto const& [tor_id, tier_id] : due)
+    {
+        if (tr_announcer_wakeups::is_overdue(Now, Now - 5, true, 0, false))
+        {
+            wakeups.wake_at(Now + 1, tor_id, tier_id);
+        }
+    }
+
+    EXPECT_TRUE(std::empty(wakeups.pop_due(Now)));
+    EXPECT_EQ((Keys{ { 7, 2U } }), wakeups.pop_due(Now + 1));
+}
+
+TEST_F(AnnouncerTest, scrapesCoalesceIntoBatches)
+{
+    auto info = tr_scrape_info{ tr_interned_string{ "https://example.org/scrape"sv }, 3U };
+    auto constexpr Slack = time_t{ 60 };
+
+    // the first tier starts a batch
+    EXPECT_EQ(1000, info.coalesce(1000, Slack));
+
+    // a tier due a little earlier joins it...
+    EXPECT_EQ(1000, info.coalesce(990, Slack));
+    EXPECT_EQ(1000, info.coalesce(950, Slack));
+
+    // ...until the batch holds multiscrape_max tiers
+    EXPECT_EQ(3U, info.batch_size);
+    EXPECT_EQ(970, info.coalesce(970, Slack));
+    EXPECT_EQ(1000, info.batch_at);
+
+    // a tier due too long before the batch keeps its own time
+    info.batch_size = 1U;
+    EXPECT_EQ(900, info.coalesce(900, Slack));
+    EXPECT_EQ(1000, info.batch_at);
+
+    // a tier due after the batch starts a new one
+    EXPECT_EQ(1100, info.coalesce(1100, Slack));
+    EXPECT_EQ(1100, info.batch_at);
+    EXPECT_EQ(1U, info.batch_size);
+    EXPECT_EQ(1100, info.coalesce(1080, Slack));
+    EXPECT_EQ(2U, info.batch_size);
+}
+
+TEST_F(AnnouncerTest, multiscrapeMaxGrowsBackAfterFullBatches)
+{
+    auto info = tr_scrape_info{ tr_interned_string{ "https://example.org/scrape"sv }, TrMultiscrapeMax };
+
+    // the tracker rejects a full batch, so shrink
+    EXPECT_EQ(std::optional<size_t>{ TrMultiscrapeMax - TrMultiscrapeStep }, info.on_batch_too_big(TrMultiscrapeMax));
+    // parallel failures at the old size don't shrink it again
+    EXPECT_EQ(std::nullopt, info.on_batch_too_big(TrMultiscrapeMax));
+    EXPECT_EQ(TrMultiscrapeMax - TrMultiscrapeStep, info.multiscrape_max);
+
+    // a second rejection shrinks it again
+    EXPECT_EQ(std::optional<size_t>{ TrMultiscrapeMax - TrMultiscrapeStep * 2U }, info.on_batch_too_big(info.multiscrape_max));
+    auto const small = info.multiscrape_max;
+
+    // partial batches say nothing about whether a bigger one would work
+    for (size_t i = 0U; i < TrMultiscrapeGrowAfter * 2U; ++i)
+    {
+        EXPECT_EQ(std::nullopt, info.on_batch_accepted(small - 1U));
+    }
+    EXPECT_EQ(small, info.multiscrape_max);
+
+    // enough full batches in a row grow it back,
+    // but only up to just below the smallest size that was rejected
+    EXPECT_EQ(TrMultiscrapeMax - TrMultiscrapeStep, info.multiscrape_too_big);
+    for (size_t i = 1U; i < TrMultiscrapeGrowAfter; ++i)
+    {
+        EXPECT_EQ(std::nullopt, info.on_batch_accepted(small));
+    }
+    EXPECT_EQ(std::optional<size_t>{ info.multiscrape_too_big - 1U }, info.on_batch_accepted(small));
+
+    // and no further
+    for (size_t i = 0U; i < TrMultiscrapeGrowAfter * 4U; ++i)
+    {
+        EXPECT_EQ(std::nullopt, info.on_batch_accepted(info.multiscrape_max));
+    }
+    EXPECT_EQ(info.multiscrape_too_big - 1U, info.multiscrape_max);
+}
+
+TEST_F(AnnouncerTest, multiscrapeMaxGrowthRestartsAfterAnError)
+{
+    auto info = tr_scrape_info{ tr_interned_string{ "https://example.org/scrape"sv }, 20U };
+
+    for (size_t i = 1U; i < TrMultiscrapeGrowAfter; ++i)
+    {
+        EXPECT_EQ(std::nullopt, info.on_batch_accepted(20U));
+    }
+
+    // a too-long error for a bigger batch doesn't lower the max,
+    // but does restart the count of full batches
+    EXPECT_EQ(std::nullopt, info.on_batch_too_big(40U));
+    EXPECT_EQ(20U, info.multiscrape_max);
+    EXPECT_EQ(std::nullopt, info.on_batch_accepted(20U));
+
+    for (size_t i = 2U; i < TrMultiscrapeGrowAfter; ++i)
+    {
+        EXPECT_EQ(std::nullopt, info.on_batch_accepted(20U));
+    }
+    // well below the rejected size, so it grows by a whole step
+    EXPECT_EQ(std::optional<size_t>{ 20U + TrMultiscrapeStep }, info.on_batch_accepted(20U));
+}
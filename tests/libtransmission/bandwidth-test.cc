@@ -0,0 +1,279 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <array>
+#include <cerrno>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <future>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <event2/util.h>
+
+#include <gtest/gtest.h>
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/bandwidth.h>
+#include <libtransmission/net.h>
+#include <libtransmission/peer-io.h>
+#include <libtransmission/peer-socket.h>
+#include <libtransmission/session.h>
+#include <libtransmission/string-utils.h>
+#include <libtransmission/tr-macros.h>
+#include <libtransmission/utils.h>
+#include <libtransmission/values.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+#define LOCAL_SOCKETPAIR_AF TR_IF_WIN32(AF_INET, AF_UNIX)
+
+namespace tr::test
+{
+
+class BandwidthTest : public SessionTest
+{
+protected:
+    using Speed = tr::Values::Speed;
+
+    static auto constexpr Up = tr_direction::Up;
+
+    // A peer-io with a local socket pair, so that we can see what it sends
+    class Peer
+    {
+    public:
+        Peer(tr_session* const session, tr_bandwidth* const parent)
+        {
+            auto sockpair = std::array<evutil_socket_t, 2>{ -1, -1 };
+            EXPECT_EQ(0, evutil_socketpair(LOCAL_SOCKETPAIR_AF, SOCK_STREAM, 0, std::data(sockpair))) << tr_strerror(errno);
+            EXPECT_EQ(0, evutil_make_socket_nonblocking(sockpair[0]));
+            EXPECT_EQ(0, evutil_make_socket_nonblocking(sockpair[1]));
+            remote_ = sockpair[1];
+
+            auto const peer_addr = tr_socket_address{ *tr_address::from_string("127.0.0.1"sv), tr_port::from_host(8080) };
+            io_ = tr_peerIo::new_incoming(session, parent, tr_peer_socket(session, peer_addr, sockpair[0]));
+        }
+
+        ~Peer()
+        {
+            io_->clear();
+            evutil_closesocket(remote_);
+        }
+
+        Peer(Peer const&) = delete;
+        Peer(Peer&&) = delete;
+        Peer& operator=(Peer const&) = delete;
+        Peer& operator=(Peer&&) = delete;
+
+        [[nodiscard]] auto& bandwidth() noexcept
+        {
+            return io_->bandwidth();
+        }
+
+        // queue piece data so that `allocate()` doesn't send it early as a protocol message
+        void write(size_t const n_bytes)
+        {
+            auto const payload = std::vector<char>(n_bytes, 'x');
+            io_->write_bytes(std::data(payload), std::size(payload), true);
+            bandwidth().set_pending(Up);
+        }
+
+        // @return the number of bytes that have arrived at the other end
+        [[nodiscard]] size_t received()
+        {
+            auto buf = std::array<char, 4096>{};
+            for (;;)
+            {
+                auto const n = recv(remote_, std::data(buf), std::size(buf), 0);
+                if (n <= 0)
+                {
+                    break;
+                }
+
+                n_received_ += static_cast<size_t>(n);
+            }
+
+            return n_received_;
+        }
+
+    private:
+        std::shared_ptr<tr_peerIo> io_;
+        evutil_socket_t remote_ = TR_BAD_SOCKET;
+        size_t n_received_ = {};
+    };
+
+    // Run the test body in the session thread,
+    // so that the peer-ios' own flush timers can't run in the middle of it.
+    template<typename Func>
+    void inSessionThread(Func&& func)
+    {
+        auto promise = std::promise<void>{};
+        session_->run_in_session_thread(
+            [&func, &promise]()
+            {
+                func();
+                promise.set_value();
+            });
+        promise.get_future().wait();
+    }
+
+    static void setBytesLeft(tr_bandwidth& bw, tr_direction const dir, size_t const bytes_left, uint64_t const refilled_at)
+    {
+        auto& band = bw.band_[static_cast<uint8_t>(dir)];
+        band.bytes_left_ = bytes_left;
+        band.refilled_at_ = refilled_at;
+    }
+
+    // Give `bw` exactly `n_bytes` to spend, and keep it from refilling
+    // so that the test doesn't depend on how long it takes to run.
+    static void setBudget(tr_bandwidth& bw, tr_direction const dir, size_t const n_bytes)
+    {
+        bw.set_limited(dir, true);
+        bw.set_desired_speed(dir, Speed{ n_bytes * 4U, Speed::Units::Byps });
+        setBytesLeft(bw, dir, n_bytes, tr_time_msec() + 3600000U);
+    }
+
+    static size_t refill(tr_bandwidth& bw, tr_direction const dir, uint64_t const now)
+    {
+        auto& band = bw.band_[static_cast<uint8_t>(dir)];
+        tr_bandwidth::refill(band, now);
+        return band.bytes_left_;
+    }
+
+    [[nodiscard]] static auto isPending(tr_bandwidth const& bw, tr_direction const dir)
+    {
+        return bw.is_pending_[static_cast<uint8_t>(dir)];
+    }
+
+    [[nodiscard]] static auto activeChildren(tr_bandwidth const& bw, tr_direction const dir)
+    {
+        return bw.active_children_[static_cast<uint8_t>(dir)];
+    }
+
+    [[nodiscard]] static auto deficit(tr_bandwidth const& bw, tr_direction const dir)
+    {
+        return bw.deficit_[static_cast<uint8_t>(dir)];
+    }
+};
+
+TEST_F(BandwidthTest, refillsUpToTheBurst)
+{
+    auto bw = tr_bandwidth{};
+    bw.set_limited(Up, true);
+    bw.set_desired_speed(Up, Speed{ 10000U, Speed::Units::Byps });
+    auto const burst = size_t{ 10000U * tr_bandwidth::BurstMSec / 1000U };
+
+    setBytesLeft(bw, Up, 0U, 1000U);
+    EXPECT_EQ(1000U, refill(bw, Up, 1100U));
+    EXPECT_EQ(1000U, refill(bw, Up, 1100U));
+    EXPECT_EQ(4000U, refill(bw, Up, 1400U));
+
+    // no matter how long it's been, only `BurstMSec` worth can be banked
+    EXPECT_EQ(burst, refill(bw, Up, 60000U));
+
+    // lowering the speed trims what's already in the bank
+    bw.set_desired_speed(Up, Speed{ 2000U, Speed::Units::Byps });
+    EXPECT_EQ(1000U, refill(bw, Up, 60000U));
+
+    // slow speeds aren't rounded down to nothing
+    bw.set_desired_speed(Up, Speed{ 5U, Speed::Units::Byps });
+    setBytesLeft(bw, Up, 0U, 1000U);
+    EXPECT_EQ(0U, refill(bw, Up, 1100U));
+    EXPECT_EQ(1U, refill(bw, Up, 1200U));
+}
+
+TEST_F(BandwidthTest, prunesPeersThatAreNoLongerPending)
+{
+    inSessionThread(
+        [this]()
+        {
+            auto top = tr_bandwidth{ true };
+            auto tor = tr_bandwidth{ &top };
+            auto peer = Peer{ session_, &tor };
+
+            // the peer's whole branch gets in line, and only once
+            peer.write(10U);
+            peer.bandwidth().set_pending(Up);
+            EXPECT_TRUE(isPending(peer.bandwidth(), Up));
+            EXPECT_EQ(std::vector<tr_bandwidth*>{ &tor }, activeChildren(top, Up));
+            EXPECT_EQ(std::vector<tr_bandwidth*>{ &peer.bandwidth() }, activeChildren(tor, Up));
+
+            // the peer gets what it wanted and has bandwidth to spare,
+            // so it drops out of line...
+            top.allocate();
+            EXPECT_EQ(10U, peer.received());
+            EXPECT_FALSE(isPending(peer.bandwidth(), Up));
+
+            // ...and the next pass prunes its branch
+            top.allocate();
+            EXPECT_TRUE(std::empty(activeChildren(tor, Up)));
+            EXPECT_TRUE(std::empty(activeChildren(top, Up)));
+        });
+}
+
+TEST_F(BandwidthTest, higherPriorityPeersGoFirst)
+{
+    inSessionThread(
+        [this]()
+        {
+            auto top = tr_bandwidth{ true };
+            auto low_tor = tr_bandwidth{ &top };
+            auto normal_tor = tr_bandwidth{ &top };
+            low_tor.set_priority(TR_PRI_LOW);
+
+            // the low-priority peer gets in line first
+            auto low_peer = Peer{ session_, &low_tor };
+            auto normal_peer = Peer{ session_, &normal_tor };
+            low_peer.write(5000U);
+            normal_peer.write(5000U);
+
+            setBudget(top, Up, 3000U);
+            top.allocate();
+            EXPECT_EQ(3000U, normal_peer.received());
+            EXPECT_EQ(0U, low_peer.received());
+
+            // both are still waiting for more
+            EXPECT_TRUE(isPending(low_peer.bandwidth(), Up));
+            EXPECT_TRUE(isPending(normal_peer.bandwidth(), Up));
+        });
+}
+
+TEST_F(BandwidthTest, carriesTheDeficitOverToTheNextTurn)
+{
+    inSessionThread(
+        [this]()
+        {
+            auto top = tr_bandwidth{ true };
+            auto peer = Peer{ session_, &top };
+            peer.write(20000U);
+
+            // The peer is offered 3000 bytes twice, but only 1500 of the
+            // second 3000 are left. It's owed the other 1500.
+            setBudget(top, Up, 4500U);
+            top.allocate();
+            EXPECT_EQ(4500U, peer.received());
+            EXPECT_EQ(1500U, deficit(peer.bandwidth(), Up));
+
+            // The peer is offered 1500 + 3000 bytes, then 3000, but only 1500
+            // of those are left. Without the carry-over it'd be offered 3000
+            // three times and be owed 3000.
+            setBudget(top, Up, 6000U);
+            top.allocate();
+            EXPECT_EQ(10500U, peer.received());
+            EXPECT_EQ(1500U, deficit(peer.bandwidth(), Up));
+        });
+}
+
+} // namespace tr::test
@@ -494,3 +494,51 @@ TEST(Bitfield, intersects)
     EXPECT_TRUE(a.intersects(b));
     EXPECT_TRUE(b.intersects(a));
 }
+
+TEST(Bitfield, bulkOpsMatchBitwiseResults)
+{
+    // exercise the word-at-a-time paths along with the leftover bytes at the end
+    for (auto const bit_count : { size_t{ 61U }, size_t{ 64U }, size_t{ 127U }, size_t{ 1000U }, size_t{ 4099U } })
+    {
+        auto a = tr_bitfield{ bit_count };
+        auto b = tr_bitfield{ bit_count };
+        for (size_t i = 0; i < bit_count; ++i)
+        {
+            a.set(i, tr_rand_int(3U) == 0U);
+            b.set(i, tr_rand_int(3U) == 0U);
+        }
+
+        auto expected_or = size_t{};
+        auto expected_and = size_t{};
+        for (size_t i = 0; i < bit_count; ++i)
+        {
+            expected_or += a.test(i) || b.test(i) ? 1U : 0U;
+            expected_and += a.test(i) && b.test(i) ? 1U : 0U;
+        }
+
+        auto or_bf = a;
+        or_bf |= b;
+        EXPECT_EQ(expected_or, or_bf.count());
+        auto and_bf = a;
+        and_bf &= b;
+        EXPECT_EQ(expected_and, and_bf.count());
+        for (size_t i = 0; i < bit_count; ++i)
+        {
+            EXPECT_EQ(a.test(i) || b.test(i), or_bf.test(i));
+            EXPECT_EQ(a.test(i) && b.test(i), and_bf.test(i));
+        }
+
+        EXPECT_EQ(expected_and != 0U, a.intersects(b));
+
+        // only the last bit overlaps
+        a.set_has_none();
+        b.set_has_none();
+        a.set_span(0U, bit_count);
+        a.unset(bit_count - 1U);
+        b.set(bit_count - 1U);
+        EXPECT_FALSE(a.intersects(b));
+        b.set(bit_count - 2U);
+        EXPECT_TRUE(a.intersects(b));
+        EXPECT_EQ(bit_count - 2U, a.count(1U, bit_count - 1U));
+    }
+}
@@ -0,0 +1,118 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <cstddef> // size_t
+#include <cstdint> // uintptr_t
+#include <cstring> // memset
+#include <iterator> // std::next
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libtransmission/block-info.h>
+#include <libtransmission/block-pool.h>
+#include <libtransmission/cache.h>
+
+TEST(BlockPool, reusesFreedSlots)
+{
+    auto& pool = tr_block_pool::instance();
+    auto const before = pool.stats();
+
+    auto* const a = pool.allocate();
+    ASSERT_NE(nullptr, a);
+    std::memset(a, 0xA5, tr_block_pool::SlotSize);
+    EXPECT_EQ(before.buffers_in_use + 1U, pool.stats().buffers_in_use);
+    EXPECT_EQ(before.allocation_count + 1U, pool.stats().allocation_count);
+
+    // the most recently freed slot is handed out first
+    pool.deallocate(a);
+    EXPECT_EQ(before.buffers_in_use, pool.stats().buffers_in_use);
+    auto* const b = pool.allocate();
+    EXPECT_EQ(a, b);
+    pool.deallocate(b);
+
+    // freeing nothing is a no-op
+    pool.deallocate(nullptr);
+    EXPECT_EQ(before.buffers_in_use, pool.stats().buffers_in_use);
+}
+
+TEST(BlockPool, slotsDontOverlap)
+{
+    static auto constexpr N = tr_block_pool::SlotsPerArena * 3U;
+
+    auto& pool = tr_block_pool::instance();
+    auto const before = pool.stats();
+
+    auto slots = std::vector<void*>{};
+    for (size_t i = 0U; i < N; ++i)
+    {
+        slots.emplace_back(pool.allocate());
+    }
+
+    auto const during = pool.stats();
+    EXPECT_EQ(before.buffers_in_use + N, during.buffers_in_use);
+    EXPECT_GE(during.arena_count, 3U);
+    EXPECT_EQ(during.arena_count * tr_block_pool::ArenaSize, during.bytes_reserved);
+
+    auto addresses = std::set<uintptr_t>{};
+    for (auto* const slot : slots)
+    {
+        addresses.emplace(reinterpret_cast<uintptr_t>(slot));
+    }
+    ASSERT_EQ(N, std::size(addresses));
+    for (auto it = std::begin(addresses), next = std::next(it); next != std::end(addresses); ++it, ++next)
+    {
+        EXPECT_GE(*next - *it, tr_block_pool::SlotSize);
+    }
+
+    for (auto* const slot : slots)
+    {
+        pool.deallocate(slot);
+    }
+
+    // unused arenas are given back, save for a spare and whatever this thread keeps on hand
+    auto const after = pool.stats();
+    EXPECT_EQ(before.buffers_in_use, after.buffers_in_use);
+    EXPECT_LE(after.arena_count, before.arena_count + tr_block_pool::MaxIdleArenas + 1U);
+}
+
+TEST(BlockPool, freesFromOtherThreads)
+{
+    auto& pool = tr_block_pool::instance();
+    auto const before = pool.stats();
+
+    auto slots = std::vector<void*>{};
+    auto producer = std::thread{ [&pool, &slots]()
+                                 {
+                                     for (size_t i = 0U; i < 100U; ++i)
+                                     {
+                                         slots.emplace_back(pool.allocate());
+                                     }
+                                 } };
+    producer.join();
+    EXPECT_EQ(before.buffers_in_use + 100U, pool.stats().buffers_in_use);
+
+    for (auto* const slot : slots)
+    {
+        pool.deallocate(slot);
+    }
+    EXPECT_EQ(before.buffers_in_use, pool.stats().buffers_in_use);
+}
+
+TEST(BlockPool, backsCacheBlocks)
+{
+    auto& pool = tr_block_pool::instance();
+    auto const before = pool.stats();
+
+    auto block = std::make_unique<Cache::BlockData>(tr_block_info::BlockSize);
+    EXPECT_EQ(tr_block_info::BlockSize, std::size(*block));
+    EXPECT_EQ(before.buffers_in_use + 1U, pool.stats().buffers_in_use);
+
+    block.reset();
+    EXPECT_EQ(before.buffers_in_use, pool.stats().buffers_in_use);
+}
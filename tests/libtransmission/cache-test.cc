@@ -0,0 +1,337 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno> // EAGAIN
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint32_t
+#include <future>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libtransmission/block-info.h>
+#include <libtransmission/cache.h>
+#include <libtransmission/crypto-utils.h>
+#include <libtransmission/file-utils.h>
+#include <libtransmission/session.h>
+#include <libtransmission/torrent.h>
+#include <libtransmission/tr-strbuf.h>
+#include <libtransmission/types.h>
+#include <libtransmission/values.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+namespace tr::test
+{
+
+class CacheTest : public SessionTest
+{
+protected:
+    using Memory = Cache::Memory;
+
+    static auto constexpr BlockSize = size_t{ tr_block_info::BlockSize };
+
+    // The cache belongs to the session thread, so only touch it there.
+    template<typename Func>
+    auto inSessionThread(Func&& func)
+    {
+        auto promise = std::promise<decltype(func())>{};
+        auto future = promise.get_future();
+        session_->run_in_session_thread([&func, &promise]() { promise.set_value(func()); });
+        return future.get();
+    }
+
+    [[nodiscard]] static auto makeBlock(uint8_t const ch)
+    {
+        auto block = std::make_unique<Cache::BlockData>(BlockSize);
+        std::fill(std::begin(*block), std::end(*block), ch);
+        return block;
+    }
+
+    int writeBlock(tr_torrent const* const tor, tr_block_index_t const block, uint8_t const ch)
+    {
+        return inSessionThread([this, tor, block, ch]()
+                               { return session_->cache->write_block(tor->id(), block, makeBlock(ch)); });
+    }
+
+    // The first `n_bytes` of the torrent's first file, as they are on disk
+    [[nodiscard]] static std::vector<char> readFirstFile(tr_torrent const* const tor, size_t const n_bytes)
+    {
+        auto contents = std::vector<char>{};
+        EXPECT_TRUE(tr_file_read(tr_pathbuf{ tor->current_dir(), '/', tor->file_subpath(0) }, contents));
+        contents.resize(std::min(std::size(contents), n_bytes));
+        return contents;
+    }
+
+    [[nodiscard]] static bool blockOnDiskIs(std::vector<char> const& contents, tr_block_index_t const block, char const ch)
+    {
+        auto const begin = block * BlockSize;
+        auto const end = begin + BlockSize;
+        return end <= std::size(contents) &&
+            std::all_of(std::begin(contents) + begin, std::begin(contents) + end, [ch](char const c) { return c == ch; });
+    }
+
+    // Read a block for uploading and check that it holds `expected`.
+    int readUploadBlock(
+        tr_torrent const* const tor,
+        tr_piece_index_t const piece,
+        tr_piece_index_t const n_more_pieces = 0U,
+        uint32_t const offset = 0U,
+        uint8_t const expected = 0U)
+    {
+        return inSessionThread(
+            [this, tor, piece, n_more_pieces, offset, expected]()
+            {
+                auto buf = std::vector<uint8_t>(BlockSize, uint8_t{ 0xFF });
+                auto const loc = tor->piece_loc(piece, offset);
+                auto const err = session_->cache->read_upload_block(*tor, loc, BlockSize, std::data(buf), n_more_pieces);
+                EXPECT_TRUE(err != 0 || std::ranges::all_of(buf, [expected](auto const ch) { return ch == expected; }));
+                return err;
+            });
+    }
+};
+
+TEST_F(CacheTest, flushBiggestWritesTheLongestSpan)
+{
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::Complete);
+    ASSERT_NE(nullptr, tor);
+
+    inSessionThread([this]() { return session_->cache->set_limit(Memory{ 4U * BlockSize, Memory::Units::Bytes }); });
+
+    // a lone block, then three blocks that arrive out of order but merge into one span
+    EXPECT_EQ(0, writeBlock(tor, 20U, 'b'));
+    EXPECT_EQ(0, writeBlock(tor, 0U, 'a'));
+    EXPECT_EQ(0, writeBlock(tor, 2U, 'a'));
+    EXPECT_EQ(0, writeBlock(tor, 1U, 'a'));
+
+    // nothing has been written yet
+    auto contents = readFirstFile(tor, 21U * BlockSize);
+    for (tr_block_index_t block = 0U; block <= 20U; ++block)
+    {
+        EXPECT_TRUE(blockOnDiskIs(contents, block, '\0')) << block;
+    }
+
+    // going over the limit flushes the biggest span, and only that one
+    EXPECT_EQ(0, writeBlock(tor, 40U, 'c'));
+    EXPECT_TRUE(waitFor(
+        [tor]()
+        {
+            auto const now = readFirstFile(tor, 3U * BlockSize);
+            return blockOnDiskIs(now, 0U, 'a') && blockOnDiskIs(now, 1U, 'a') && blockOnDiskIs(now, 2U, 'a');
+        },
+        5s));
+    contents = readFirstFile(tor, 41U * BlockSize);
+    EXPECT_TRUE(blockOnDiskIs(contents, 20U, '\0'));
+    EXPECT_TRUE(blockOnDiskIs(contents, 40U, '\0'));
+
+    // the rest are still readable from the cache
+    auto const cached = inSessionThread(
+        [this, tor]()
+        {
+            auto buf = std::vector<uint8_t>(BlockSize);
+            auto const err = session_->cache->read_block(*tor, tor->block_loc(20U), BlockSize, std::data(buf));
+            return err == 0 && std::ranges::all_of(buf, [](auto const ch) { return ch == 'b'; });
+        });
+    EXPECT_TRUE(cached);
+
+    auto const has_unflushed_blocks = [this, tor](tr_piece_index_t const piece)
+    { return inSessionThread([this, tor, piece]() { return session_->cache->has_unflushed_blocks(*tor, piece); }); };
+    EXPECT_TRUE(has_unflushed_blocks(10U));
+    EXPECT_TRUE(has_unflushed_blocks(20U));
+    EXPECT_FALSE(has_unflushed_blocks(11U));
+
+    // and are written when the torrent is flushed
+    EXPECT_EQ(0, inSessionThread([this, tor]() { return session_->cache->flush_torrent(tor->id()); }));
+    contents = readFirstFile(tor, 41U * BlockSize);
+    EXPECT_TRUE(blockOnDiskIs(contents, 20U, 'b'));
+    EXPECT_TRUE(blockOnDiskIs(contents, 40U, 'c'));
+    for (tr_piece_index_t piece = 0U; piece <= 20U; ++piece)
+    {
+        EXPECT_FALSE(has_unflushed_blocks(piece)) << piece;
+    }
+}
+
+TEST_F(CacheTest, flushesWithTheSessionsOpenFiles)
+{
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::Complete);
+    ASSERT_NE(nullptr, tor);
+
+    auto const n_misses = [this]() { return inSessionThread([this]() { return session_->openFiles().stats().misses; }); };
+    auto const flush = [this, tor]()
+    {
+        return inSessionThread([this, tor]() { return session_->cache->flush_torrent(tor->id()); });
+    };
+    inSessionThread(
+        [this, tor]()
+        {
+            session_->openFiles().close_torrent(tor->id());
+            return 0;
+        });
+    auto const misses_before = n_misses();
+
+    // the disk threads borrow the file from the session's pool,
+    // so it's opened once and stays open for the next flush
+    EXPECT_EQ(0, writeBlock(tor, 0U, 'a'));
+    EXPECT_EQ(0, flush());
+    EXPECT_EQ(0, writeBlock(tor, 5U, 'b'));
+    EXPECT_EQ(0, flush());
+    EXPECT_EQ(misses_before + 1U, n_misses());
+    EXPECT_TRUE(inSessionThread([this, tor]() { return session_->openFiles().get(tor->id(), 0U, true).has_value(); }));
+
+    auto const contents = readFirstFile(tor, 6U * BlockSize);
+    EXPECT_TRUE(blockOnDiskIs(contents, 0U, 'a'));
+    EXPECT_TRUE(blockOnDiskIs(contents, 5U, 'b'));
+}
+
+TEST_F(CacheTest, hashesPiecesAsTheyAreWritten)
+{
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
+    ASSERT_NE(nullptr, tor);
+    ASSERT_EQ(2U * BlockSize, tor->piece_size());
+
+    inSessionThread([this]() { return session_->cache->set_limit(Memory{ 1U, Memory::Units::MBytes }); });
+
+    auto const take_piece_hash = [this, tor](tr_piece_index_t const piece)
+    {
+        return inSessionThread([this, tor, piece]() { return session_->cache->take_piece_hash(*tor, piece); });
+    };
+
+    // piece #1's blocks arrive out of order; the later one waits in the cache for the earlier one
+    EXPECT_EQ(0, writeBlock(tor, 3U, 'y'));
+    EXPECT_EQ(0, writeBlock(tor, 2U, 'x'));
+    auto const expected = tr_sha1::digest(std::vector<char>(BlockSize, 'x'), std::vector<char>(BlockSize, 'y'));
+    EXPECT_EQ(std::optional{ expected }, take_piece_hash(1U));
+
+    // a running hash is only good for one check
+    EXPECT_EQ(std::nullopt, take_piece_hash(1U));
+
+    // a piece that isn't finished has no hash
+    EXPECT_EQ(0, writeBlock(tor, 4U, 'x'));
+    EXPECT_EQ(std::nullopt, take_piece_hash(2U));
+
+    // nor does one with a block that changed after it was hashed
+    EXPECT_EQ(0, writeBlock(tor, 6U, 'x'));
+    EXPECT_EQ(0, writeBlock(tor, 7U, 'y'));
+    EXPECT_EQ(0, writeBlock(tor, 6U, 'z'));
+    EXPECT_EQ(std::nullopt, take_piece_hash(3U));
+
+    // nor does a piece whose first block never arrived
+    EXPECT_EQ(0, writeBlock(tor, 9U, 'y'));
+    EXPECT_EQ(std::nullopt, take_piece_hash(4U));
+}
+
+TEST_F(CacheTest, readAheadEvictsLeastRecentlyUsedPieces)
+{
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::Complete);
+    ASSERT_NE(nullptr, tor);
+    auto const piece_size = size_t{ tor->piece_size() };
+
+    // room for two pieces
+    inSessionThread(
+        [this, piece_size]()
+        {
+            session_->cache->set_read_limit(Memory{ 2U * piece_size, Memory::Units::Bytes });
+            return true;
+        });
+
+    // a miss starts reading the piece on a disk thread
+    for (tr_piece_index_t piece = 0U; piece < 3U; ++piece)
+    {
+        EXPECT_EQ(EAGAIN, readUploadBlock(tor, piece));
+        EXPECT_TRUE(waitFor([this, tor, piece]() { return readUploadBlock(tor, piece) == 0; }, 5s)) << piece;
+    }
+
+    // piece #0 was the least recently used, so it made room for piece #2
+    EXPECT_EQ(0, readUploadBlock(tor, 2U));
+    EXPECT_EQ(0, readUploadBlock(tor, 1U));
+    EXPECT_EQ(EAGAIN, readUploadBlock(tor, 0U));
+    EXPECT_TRUE(waitFor([this, tor]() { return readUploadBlock(tor, 0U) == 0; }, 5s));
+
+    // the piece after the wanted one is read ahead with it, as far as there's room
+    EXPECT_EQ(EAGAIN, readUploadBlock(tor, 10U, 5U));
+    EXPECT_TRUE(waitFor([this, tor]() { return readUploadBlock(tor, 10U) == 0; }, 5s));
+    EXPECT_EQ(0, readUploadBlock(tor, 11U));
+    EXPECT_EQ(EAGAIN, readUploadBlock(tor, 12U));
+
+    // writing a block drops its piece, since the piece on disk is about to change
+    EXPECT_EQ(0, writeBlock(tor, 23U, 'q'));
+    EXPECT_EQ(0, inSessionThread([this, tor]() { return session_->cache->flush_torrent(tor->id()); }));
+    auto const offset = uint32_t{ BlockSize };
+    EXPECT_EQ(EAGAIN, readUploadBlock(tor, 11U, 0U, offset, 'q'));
+    EXPECT_TRUE(waitFor([this, tor, offset]() { return readUploadBlock(tor, 11U, 0U, offset, 'q') == 0; }, 5s));
+}
+
+TEST_F(CacheTest, readsWindowsOfPiecesBiggerThanTheReadCache)
+{
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::Complete);
+    ASSERT_NE(nullptr, tor);
+    ASSERT_EQ(2U * BlockSize, tor->piece_size());
+
+    // room for one block, so only half a piece
+    inSessionThread(
+        [this]()
+        {
+            session_->cache->set_read_limit(Memory{ BlockSize, Memory::Units::Bytes });
+            return true;
+        });
+
+    // the piece is still read ahead, a window at a time
+    auto const offset = uint32_t{ BlockSize };
+    EXPECT_EQ(EAGAIN, readUploadBlock(tor, 0U));
+    EXPECT_TRUE(waitFor([this, tor]() { return readUploadBlock(tor, 0U) == 0; }, 5s));
+    EXPECT_EQ(EAGAIN, readUploadBlock(tor, 0U, 0U, offset));
+    EXPECT_TRUE(waitFor([this, tor, offset]() { return readUploadBlock(tor, 0U, 0U, offset) == 0; }, 5s));
+
+    // moving on to the next window dropped the first one
+    EXPECT_EQ(EAGAIN, readUploadBlock(tor, 0U));
+}
+
+TEST_F(CacheTest, wakesReadersWhenTheReadIsDone)
+{
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::Complete);
+    ASSERT_NE(nullptr, tor);
+
+    inSessionThread(
+        [this]()
+        {
+            session_->cache->set_read_limit(Memory{ 1U, Memory::Units::MBytes });
+            return true;
+        });
+
+    // both the reader that started the read and one that found it in progress are told
+    auto n_woken = std::atomic<size_t>{};
+    auto const read = [this, tor, &n_woken]()
+    {
+        return inSessionThread(
+            [this, tor, &n_woken]()
+            {
+                auto buf = std::vector<uint8_t>(BlockSize);
+                return session_->cache->read_upload_block(
+                    *tor,
+                    tor->piece_loc(0U),
+                    BlockSize,
+                    std::data(buf),
+                    0U,
+                    [&n_woken]() { ++n_woken; });
+            });
+    };
+    EXPECT_EQ(EAGAIN, read());
+    EXPECT_EQ(EAGAIN, read());
+    EXPECT_TRUE(waitFor([&n_woken]() { return n_woken == 2U; }, 5s));
+
+    // and once the piece is cached, nobody needs waking
+    EXPECT_EQ(0, read());
+    EXPECT_EQ(0, readUploadBlock(tor, 0U));
+    EXPECT_EQ(2U, n_woken);
+}
+
+} // namespace tr::test
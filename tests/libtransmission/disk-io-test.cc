@@ -0,0 +1,209 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libtransmission/disk-io.h>
+#include <libtransmission/error.h>
+#include <libtransmission/session-thread.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+namespace tr::test
+{
+
+class DiskIoTest : public SandboxedTest
+{
+protected:
+    // Holds queued callbacks until the test runs them,
+    // standing in for the libevent session thread.
+    class MockSessionThread final : public tr_session_thread
+    {
+    public:
+        [[nodiscard]] struct event_base* event_base() noexcept override
+        {
+            return nullptr;
+        }
+
+        [[nodiscard]] bool am_in_session_thread() const noexcept override
+        {
+            return true;
+        }
+
+        void queue(callback_t&& func) override
+        {
+            auto const lock = std::scoped_lock{ mutex_ };
+            queued_.emplace_back(std::move(func));
+        }
+
+        void run(callback_t&& func) override
+        {
+            func();
+        }
+
+        // @return how many callbacks were run
+        size_t run_queued()
+        {
+            auto queued = std::vector<callback_t>{};
+            {
+                auto const lock = std::scoped_lock{ mutex_ };
+                std::swap(queued, queued_);
+            }
+
+            for (auto& func : queued)
+            {
+                func();
+            }
+
+            return std::size(queued);
+        }
+
+    private:
+        std::mutex mutex_;
+        std::vector<callback_t> queued_;
+    };
+
+    MockSessionThread session_thread_;
+};
+
+TEST_F(DiskIoTest, callsDoneOnSessionThread)
+{
+    auto disk_io = tr_disk_io{ session_thread_ };
+    auto const dir = sandboxDir();
+
+    auto const main_thread = std::this_thread::get_id();
+    auto work_thread = std::thread::id{};
+    auto done_thread = std::thread::id{};
+    auto done_code = -1;
+
+    disk_io.add(
+        dir,
+        1,
+        [&work_thread](tr_error& error)
+        {
+            work_thread = std::this_thread::get_id();
+            error.set(EIO, "oops"sv);
+        },
+        [&done_thread, &done_code](tr_error const& error)
+        {
+            done_thread = std::this_thread::get_id();
+            done_code = error.code();
+        });
+
+    disk_io.wait(1);
+    EXPECT_EQ(0U, std::size(disk_io));
+    EXPECT_NE(std::thread::id{}, work_thread);
+    EXPECT_NE(main_thread, work_thread);
+
+    // the callback doesn't run until the session thread gets to it
+    EXPECT_EQ(-1, done_code);
+    EXPECT_TRUE(waitFor([this]() { return session_thread_.run_queued() != 0U; }, 5s));
+    EXPECT_EQ(main_thread, done_thread);
+    EXPECT_EQ(EIO, done_code);
+}
+
+TEST_F(DiskIoTest, runsJobsOnTheSameDeviceInOrder)
+{
+    static auto constexpr NumJobs = 100;
+
+    auto disk_io = tr_disk_io{ session_thread_ };
+    auto const dir = sandboxDir();
+
+    auto order = std::vector<int>{};
+    auto order_mutex = std::mutex{};
+    auto n_running = std::atomic<int>{};
+    auto max_running = std::atomic<int>{};
+
+    for (int i = 0; i < NumJobs; ++i)
+    {
+        disk_io.add(
+            dir,
+            1,
+            [&, i](tr_error& /*error*/)
+            {
+                auto const running = ++n_running;
+                max_running = std::max(max_running.load(), running);
+                {
+                    auto const lock = std::scoped_lock{ order_mutex };
+                    order.emplace_back(i);
+                }
+                --n_running;
+            },
+            {});
+    }
+
+    disk_io.wait(1);
+    EXPECT_EQ(1, max_running.load());
+    ASSERT_EQ(static_cast<size_t>(NumJobs), std::size(order));
+    for (int i = 0; i < NumJobs; ++i)
+    {
+        EXPECT_EQ(i, order[i]);
+    }
+}
+
+TEST_F(DiskIoTest, waitOnlyWaitsForThatTorrent)
+{
+    auto disk_io = tr_disk_io{ session_thread_ };
+    auto const dir = sandboxDir();
+
+    auto n_done = std::atomic<int>{};
+    for (tr_torrent_id_t tor_id = 1; tor_id <= 3; ++tor_id)
+    {
+        disk_io.add(dir, tor_id, [&n_done](tr_error& /*error*/) { ++n_done; }, {});
+    }
+
+    disk_io.wait(2);
+
+    // jobs for the same device run in order, so 1 and 2 are done
+    EXPECT_GE(n_done.load(), 2);
+
+    disk_io.wait(3);
+    EXPECT_EQ(3, n_done.load());
+    EXPECT_EQ(0U, std::size(disk_io));
+}
+
+TEST_F(DiskIoTest, finishesQueuedJobsWhenDestroyed)
+{
+    auto const dir = sandboxDir();
+    auto n_done = std::atomic<int>{};
+    auto n_callbacks = 0;
+
+    {
+        auto disk_io = tr_disk_io{ session_thread_ };
+        for (int i = 0; i < 10; ++i)
+        {
+            disk_io.add(
+                dir,
+                1,
+                [&n_done](tr_error& /*error*/)
+                {
+                    std::this_thread::sleep_for(1ms);
+                    ++n_done;
+                },
+                [&n_callbacks](tr_error const& /*error*/) { ++n_callbacks; });
+        }
+    }
+
+    EXPECT_EQ(10, n_done.load());
+
+    // the callbacks were dropped along with the tr_disk_io
+    session_thread_.run_queued();
+    EXPECT_EQ(0, n_callbacks);
+}
+
+} // namespace tr::test
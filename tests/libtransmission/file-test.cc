@@ -3,6 +3,7 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
+#include <algorithm> // std::min
 #include <array>
 #include <cassert>
 #include <cstdint> // uint64_t
@@ -1253,6 +1254,98 @@ TEST_F(FileTest, filePreallocate)
     tr_sys_path_remove(path1);
 }
 
+TEST_F(FileTest, fileAdvise)
+{
+    auto const test_dir = createTestDir(currentTestName());
+
+    auto const path1 = tr_pathbuf{ test_dir, "/a"sv };
+    createFileWithContents(path1, "test"sv);
+    auto fd = tr_sys_file_open(path1, TR_SYS_FILE_READ, 0);
+
+    // advice is only a hint, so it should work even past the end of the file
+    auto error = tr_error{};
+    EXPECT_TRUE(tr_sys_file_advise(fd, 0U, 1024U * 1024U, TR_SYS_FILE_ADVICE_WILL_NEED, &error));
+    EXPECT_FALSE(error) << error;
+    EXPECT_TRUE(tr_sys_file_advise(fd, 0U, 4U, TR_SYS_FILE_ADVICE_DONT_NEED, &error));
+    EXPECT_FALSE(error) << error;
+
+    // the file is still readable afterwards
+    auto buf = std::array<char, 4>{};
+    auto n_read = uint64_t{};
+    EXPECT_TRUE(tr_sys_file_read_at(fd, std::data(buf), std::size(buf), 0U, &n_read, &error));
+    EXPECT_EQ(std::size(buf), n_read);
+    EXPECT_EQ("test"sv, std::string_view(std::data(buf), std::size(buf)));
+
+    tr_sys_file_close(fd);
+
+    tr_sys_path_remove(path1);
+}
+
+TEST_F(FileTest, fileReadWriteVectored)
+{
+    auto const test_dir = createTestDir(currentTestName());
+
+    auto const path1 = tr_pathbuf{ test_dir, "/a"sv };
+    auto fd = tr_sys_file_open(path1, TR_SYS_FILE_READ | TR_SYS_FILE_WRITE | TR_SYS_FILE_CREATE, 0600);
+
+    // write "hello world" from three buffers, one of them empty
+    auto hello = std::array<char, 6>{ 'h', 'e', 'l', 'l', 'o', ' ' };
+    auto world = std::array<char, 5>{ 'w', 'o', 'r', 'l', 'd' };
+    auto out = std::array<tr_sys_file_iovec, 3>{ {
+        { std::data(hello), std::size(hello) },
+        { nullptr, 0U },
+        { std::data(world), std::size(world) },
+    } };
+
+    auto error = tr_error{};
+    auto n_total = uint64_t{};
+    while (n_total < std::size(hello) + std::size(world))
+    {
+        // platforms without pwritev() may write less, so skip what's done
+        auto n_written = uint64_t{};
+        auto n_skip = n_total;
+        auto vecs = out;
+        auto* vec = std::data(vecs);
+        for (; n_skip >= vec->len; ++vec)
+        {
+            n_skip -= vec->len;
+        }
+        vec->base = static_cast<char*>(vec->base) + n_skip;
+        vec->len -= n_skip;
+        EXPECT_TRUE(tr_sys_file_write_at_v(
+            fd,
+            vec,
+            std::size(vecs) - (vec - std::data(vecs)),
+            n_total,
+            &n_written,
+            &error));
+        EXPECT_FALSE(error) << error;
+        ASSERT_NE(0U, n_written);
+        n_total += n_written;
+    }
+
+    // read it back into two differently-sized buffers
+    auto buf1 = std::array<char, 3>{};
+    auto buf2 = std::array<char, 8>{};
+    auto in = std::array<tr_sys_file_iovec, 2>{ {
+        { std::data(buf1), std::size(buf1) },
+        { std::data(buf2), std::size(buf2) },
+    } };
+    auto n_read = uint64_t{};
+    EXPECT_TRUE(tr_sys_file_read_at_v(fd, std::data(in), std::size(in), 0U, &n_read, &error));
+    EXPECT_FALSE(error) << error;
+    EXPECT_LE(n_read, std::size(buf1) + std::size(buf2));
+    EXPECT_EQ("hel"sv, std::string_view(std::data(buf1), std::min(n_read, uint64_t{ std::size(buf1) })));
+    if (n_read == std::size(buf1) + std::size(buf2))
+    {
+        EXPECT_EQ("lo world"sv, std::string_view(std::data(buf2), std::size(buf2)));
+    }
+
+    tr_sys_file_close(fd);
+
+    tr_sys_path_remove(path1);
+}
+
 TEST_F(FileTest, dirCreate)
 {
     auto const test_dir = createTestDir(currentTestName());
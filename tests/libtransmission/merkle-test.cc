@@ -0,0 +1,162 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <cstddef> // std::byte, size_t
+#include <cstdint>
+#include <utility> // std::swap
+#include <vector>
+
+#include <libtransmission/crypto-utils.h>
+#include <libtransmission/merkle.h>
+#include <libtransmission/types.h>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+auto constexpr BlockSize = size_t{ tr_merkle_file::BlockSize };
+
+[[nodiscard]] std::vector<std::byte> make_data(size_t const len)
+{
+    auto data = std::vector<std::byte>(len);
+    for (size_t i = 0U; i < len; ++i)
+    {
+        data[i] = static_cast<std::byte>((i * 7U) + (i / BlockSize));
+    }
+    return data;
+}
+
+[[nodiscard]] auto block_hash(std::vector<std::byte> const& data, size_t const block)
+{
+    auto const begin = block * BlockSize;
+    auto const len = std::min(BlockSize, std::size(data) - begin);
+    auto sha = tr_sha256{};
+    sha.add(std::data(data) + begin, len);
+    return sha.finish();
+}
+} // namespace
+
+TEST(Merkle, padHash)
+{
+    auto const zero = tr_sha256_digest_t{};
+    EXPECT_EQ(zero, tr_merkle_file::pad_hash(0U));
+
+    auto const one = tr_sha256::digest(zero, zero);
+    EXPECT_EQ(one, tr_merkle_file::pad_hash(1U));
+    EXPECT_EQ(tr_sha256::digest(one, one), tr_merkle_file::pad_hash(2U));
+}
+
+TEST(Merkle, rootPadsMissingLeaves)
+{
+    auto const data = make_data(BlockSize * 3U);
+    auto const l0 = block_hash(data, 0U);
+    auto const l1 = block_hash(data, 1U);
+    auto const l2 = block_hash(data, 2U);
+    auto const pad = tr_sha256_digest_t{};
+
+    auto const expected = tr_sha256::digest(tr_sha256::digest(l0, l1), tr_sha256::digest(l2, pad));
+    EXPECT_EQ(expected, tr_merkle_file::root({ l0, l1, l2 }, 4U));
+
+    // an 8-slot tree pads a whole 4-leaf subtree on the right
+    EXPECT_EQ(tr_sha256::digest(expected, tr_merkle_file::pad_hash(2U)), tr_merkle_file::root({ l0, l1, l2 }, 8U));
+
+    // too many hashes for the slots, or no hashes at all
+    EXPECT_EQ(tr_sha256_digest_t{}, tr_merkle_file::root({ l0, l1, l2 }, 2U));
+    EXPECT_EQ(tr_sha256_digest_t{}, tr_merkle_file::root({}, 2U));
+}
+
+TEST(Merkle, singlePieceFile)
+{
+    // three blocks, the last one short; no piece layer needed
+    auto const data = make_data((BlockSize * 2U) + 100U);
+    auto const pieces_root = tr_merkle_file::root(tr_merkle_file::block_hashes(std::data(data), std::size(data)), 4U);
+
+    auto const file = tr_merkle_file{ pieces_root, std::size(data), BlockSize * 4U };
+    EXPECT_TRUE(file.is_valid());
+    EXPECT_EQ(1U, file.piece_count());
+    EXPECT_EQ(std::size(data), file.piece_size(0U));
+    EXPECT_EQ(3U, file.block_count(0U));
+    EXPECT_TRUE(file.check_piece(0U, std::data(data), std::size(data)));
+
+    auto corrupt = data;
+    corrupt[BlockSize + 1U] ^= std::byte{ 1 };
+    EXPECT_FALSE(file.check_piece(0U, std::data(corrupt), std::size(corrupt)));
+    EXPECT_FALSE(file.check_piece(0U, std::data(data), std::size(data) - 1U));
+    EXPECT_FALSE(file.check_piece(1U, std::data(data), std::size(data)));
+}
+
+TEST(Merkle, multiPieceFile)
+{
+    // two blocks per piece, five blocks in all: the last piece is short
+    static auto constexpr PieceSize = uint32_t{ BlockSize * 2U };
+    auto const data = make_data((BlockSize * 4U) + 1000U);
+    auto const leaves = tr_merkle_file::block_hashes(std::data(data), std::size(data));
+    ASSERT_EQ(5U, std::size(leaves));
+
+    auto const pad = tr_sha256_digest_t{};
+    auto const layer = std::vector<tr_sha256_digest_t>{
+        tr_sha256::digest(leaves[0], leaves[1]),
+        tr_sha256::digest(leaves[2], leaves[3]),
+        tr_sha256::digest(leaves[4], pad),
+    };
+    auto const pieces_root = tr_sha256::digest(
+        tr_sha256::digest(layer[0], layer[1]),
+        tr_sha256::digest(layer[2], tr_merkle_file::pad_hash(1U)));
+
+    auto const file = tr_merkle_file{ pieces_root, std::size(data), PieceSize, layer };
+    ASSERT_TRUE(file.is_valid());
+    EXPECT_EQ(3U, file.piece_count());
+    EXPECT_EQ(PieceSize, file.piece_size(0U));
+    EXPECT_EQ(1000U, file.piece_size(2U));
+    EXPECT_EQ(1U, file.block_count(2U));
+
+    for (size_t piece = 0U; piece < file.piece_count(); ++piece)
+    {
+        auto const* const begin = std::data(data) + (piece * PieceSize);
+        EXPECT_TRUE(file.check_piece(piece, begin, file.piece_size(piece)));
+    }
+
+    // block hashes from a peer can be checked against the piece layer...
+    auto const piece1_hashes = std::vector<tr_sha256_digest_t>{ leaves[2], leaves[3] };
+    EXPECT_TRUE(file.check_block_hashes(1U, piece1_hashes));
+    EXPECT_FALSE(file.check_block_hashes(1U, { leaves[3], leaves[2] }));
+    EXPECT_FALSE(file.check_block_hashes(1U, { leaves[2] }));
+
+    // ...and then used to find the bad block in a failed piece
+    auto corrupt = std::vector<std::byte>(std::data(data) + PieceSize, std::data(data) + (PieceSize * 2U));
+    corrupt[BlockSize + 5U] ^= std::byte{ 0x80 };
+    EXPECT_FALSE(file.check_piece(1U, std::data(corrupt), std::size(corrupt)));
+    EXPECT_EQ(std::vector<size_t>{ 1U }, tr_merkle_file::find_bad_blocks(std::data(corrupt), std::size(corrupt), piece1_hashes));
+    EXPECT_EQ(std::vector<size_t>{}, tr_merkle_file::find_bad_blocks(std::data(data) + PieceSize, PieceSize, piece1_hashes));
+}
+
+TEST(Merkle, rejectsBadLayers)
+{
+    static auto constexpr PieceSize = uint32_t{ BlockSize * 2U };
+    auto const data = make_data(BlockSize * 4U);
+    auto const leaves = tr_merkle_file::block_hashes(std::data(data), std::size(data));
+    auto const layer = std::vector<tr_sha256_digest_t>{ tr_sha256::digest(leaves[0], leaves[1]),
+                                                        tr_sha256::digest(leaves[2], leaves[3]) };
+    auto const pieces_root = tr_sha256::digest(layer[0], layer[1]);
+
+    EXPECT_TRUE((tr_merkle_file{ pieces_root, std::size(data), PieceSize, layer }.is_valid()));
+
+    // layer doesn't match the root
+    auto swapped = layer;
+    std::swap(swapped[0], swapped[1]);
+    EXPECT_FALSE((tr_merkle_file{ pieces_root, std::size(data), PieceSize, swapped }.is_valid()));
+
+    // wrong number of pieces in the layer
+    EXPECT_FALSE((tr_merkle_file{ pieces_root, std::size(data), PieceSize, { layer[0] } }.is_valid()));
+    EXPECT_FALSE((tr_merkle_file{ pieces_root, std::size(data), PieceSize }.is_valid()));
+
+    // piece sizes must be powers of two, at least one block
+    EXPECT_FALSE((tr_merkle_file{ pieces_root, std::size(data), PieceSize + 1U, layer }.is_valid()));
+    EXPECT_FALSE((tr_merkle_file{ pieces_root, std::size(data), BlockSize / 2U, layer }.is_valid()));
+
+    // empty files have no tree
+    EXPECT_FALSE((tr_merkle_file{ pieces_root, 0U, PieceSize }.is_valid()));
+}
@@ -175,12 +175,42 @@ TEST_F(OpenFilesTest, closeTorrentClosesTheTorrentFiles)
     EXPECT_FALSE(session_->openFiles().get(TorId, 3, false));
 }
 
+TEST_F(OpenFilesTest, sharedFdOutlivesTheCachedFile)
+{
+    static auto constexpr Contents = "Hello, World!\n"sv;
+    static auto constexpr TorId = tr_torrent_id_t{ 0 };
+
+    auto const filename = tr_pathbuf{ sandboxDir(), "/a.txt" };
+    createFileWithContents(filename, Contents);
+
+    // only files that are already open can be shared
+    EXPECT_FALSE(session_->openFiles().get_shared(TorId, 0));
+    auto const fd = session_->openFiles().get(TorId, 0, false, filename, PreallocateFull, std::size(Contents));
+    ASSERT_TRUE(fd);
+    auto const shared = session_->openFiles().get_shared(TorId, 0);
+    ASSERT_TRUE(shared);
+    EXPECT_EQ(*fd, *shared);
+
+    // a file that's only open for reading isn't shared with writers
+    EXPECT_FALSE(session_->openFiles().get_shared(TorId, 0, true));
+
+    // closing the torrent uncaches the file, but the shared fd is still usable
+    session_->openFiles().close_torrent(TorId);
+    EXPECT_FALSE(session_->openFiles().get_shared(TorId, 0));
+    auto buf = std::array<char, std::size(Contents)>{};
+    auto n_read = uint64_t{};
+    EXPECT_TRUE(tr_sys_file_read_at(*shared, std::data(buf), std::size(buf), 0U, &n_read));
+    EXPECT_EQ(Contents, std::string_view(std::data(buf), n_read));
+}
+
 TEST_F(OpenFilesTest, closesLeastRecentlyUsedFile)
 {
     static auto constexpr Contents = "Hello, World!\n"sv;
     static auto constexpr TorId = tr_torrent_id_t{ 0 };
     static auto constexpr LargerThanCacheLimit = 100;
 
+    session_->openFiles().set_limit(32U);
+
     // Walk through a number of files. Confirm that they all succeed
     // even when the number exhausts the cache size, and newer files
     // supplant older ones.
@@ -206,3 +236,41 @@ TEST_F(OpenFilesTest, closesLeastRecentlyUsedFile)
     EXPECT_EQ(sorted, results);
     EXPECT_GT(std::count(std::begin(results), std::end(results), true), 0);
 }
+
+TEST_F(OpenFilesTest, setLimitEvictsOldestFiles)
+{
+    static auto constexpr Contents = "Hello, World!\n"sv;
+    static auto constexpr TorId = tr_torrent_id_t{ 0 };
+    static auto constexpr NumFiles = 32;
+    static auto constexpr Limit = size_t{ 20U };
+
+    auto& open_files = session_->openFiles();
+    auto const stats_before = open_files.stats();
+    open_files.set_limit(Limit);
+    EXPECT_EQ(Limit, open_files.limit());
+
+    for (int i = 0; i < NumFiles; ++i)
+    {
+        auto filename = tr_pathbuf{ sandboxDir(), fmt::format("/file-{:d}.txt"sv, i) };
+        EXPECT_TRUE(open_files.get(TorId, i, true, filename, PreallocateFull, std::size(Contents)));
+    }
+
+    // only the newest files are still open
+    EXPECT_EQ(Limit, std::size(open_files));
+    for (int i = 0; i < NumFiles; ++i)
+    {
+        EXPECT_EQ(i >= NumFiles - static_cast<int>(Limit), open_files.get(TorId, i, false).has_value()) << i;
+    }
+
+    auto const stats = open_files.stats();
+    EXPECT_EQ(stats_before.misses + NumFiles, stats.misses);
+    EXPECT_EQ(stats_before.evictions + NumFiles - Limit, stats.evictions);
+    EXPECT_EQ(stats_before.hits + Limit, stats.hits);
+
+    // shrinking the limit closes the least-recently-used files
+    open_files.set_limit(Limit / 2U);
+    EXPECT_EQ(Limit / 2U, std::size(open_files));
+    EXPECT_EQ(stats_before.evictions + NumFiles - Limit / 2U, open_files.stats().evictions);
+    EXPECT_TRUE(open_files.get(TorId, NumFiles - 1, false));
+    EXPECT_FALSE(open_files.get(TorId, NumFiles - static_cast<int>(Limit), false));
+}
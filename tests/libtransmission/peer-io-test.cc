@@ -0,0 +1,102 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <array>
+#include <cerrno>
+#include <cstddef> // size_t
+#include <cstdint> // SIZE_MAX
+#include <memory>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <event2/util.h>
+
+#include <gtest/gtest.h>
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/file.h>
+#include <libtransmission/net.h>
+#include <libtransmission/peer-io.h>
+#include <libtransmission/peer-socket.h>
+#include <libtransmission/session.h>
+#include <libtransmission/string-utils.h>
+#include <libtransmission/tr-macros.h>
+#include <libtransmission/tr-strbuf.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+#define LOCAL_SOCKETPAIR_AF TR_IF_WIN32(AF_INET, AF_UNIX)
+
+namespace tr::test
+{
+
+using PeerIoTest = SessionTest;
+
+TEST_F(PeerIoTest, writeFileKeepsOrderWithBufferedData)
+{
+    auto sockpair = std::array<evutil_socket_t, 2>{ -1, -1 };
+    ASSERT_EQ(0, evutil_socketpair(LOCAL_SOCKETPAIR_AF, SOCK_STREAM, 0, std::data(sockpair))) << tr_strerror(errno);
+    EXPECT_EQ(0, evutil_make_socket_nonblocking(sockpair[0]));
+    EXPECT_EQ(0, evutil_make_socket_nonblocking(sockpair[1]));
+
+    auto const peer_addr = tr_socket_address{ *tr_address::from_string("127.0.0.1"sv), tr_port::from_host(8080) };
+    auto io = tr_peerIo::new_incoming(session_, &session_->top_bandwidth_, tr_peer_socket(session_, peer_addr, sockpair[0]));
+    if (!io->can_write_file())
+    {
+        evutil_closesocket(sockpair[1]);
+        GTEST_SKIP() << "sendfile() isn't supported here";
+    }
+
+    auto const filename = tr_pathbuf{ sandboxDir(), "/piece-data"sv };
+    createFileWithContents(filename, "0123456789"sv);
+    auto const fd = tr_sys_file_open(filename, TR_SYS_FILE_READ, 0);
+    ASSERT_NE(TR_BAD_SYS_FILE, fd);
+    auto const file = tr_peerIo::SendFile{ new tr_sys_file_t{ fd },
+                                           [](tr_sys_file_t const* pfd)
+                                           {
+                                               tr_sys_file_close(*pfd);
+                                               delete pfd;
+                                           } };
+
+    // interleave buffered data with data sent straight from the file
+    io->write_bytes("head", 4U, false);
+    io->write_file(file, 2U, 5U);
+    io->write_bytes("-", 1U, false);
+    io->write_file(file, 7U, 3U);
+    io->write_bytes("tail", 4U, false);
+
+    static auto constexpr Expected = "head23456-789tail"sv;
+    EXPECT_EQ(std::size(Expected), io->flush(tr_direction::Up, SIZE_MAX));
+
+    auto got = std::string{};
+    auto buf = std::array<char, 64>{};
+    auto const got_all = waitFor(
+        [&]()
+        {
+            if (auto const n = recv(sockpair[1], std::data(buf), std::size(buf), 0); n > 0)
+            {
+                got.append(std::data(buf), static_cast<size_t>(n));
+            }
+
+            return std::size(got) >= std::size(Expected);
+        },
+        5s);
+    EXPECT_TRUE(got_all);
+    EXPECT_EQ(Expected, got);
+
+    io->clear();
+    evutil_closesocket(sockpair[1]);
+}
+
+} // namespace tr::test
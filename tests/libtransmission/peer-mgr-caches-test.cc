@@ -0,0 +1,191 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <cstddef> // size_t, std::byte
+#include <cstdint> // uint64_t
+#include <string_view>
+#include <vector>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/bitfield.h>
+#include <libtransmission/error.h>
+#include <libtransmission/makemeta.h>
+#include <libtransmission/peer-mgr-caches.h>
+#include <libtransmission/torrent.h>
+#include <libtransmission/tr-strbuf.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+namespace tr::test
+{
+
+class PeerMgrCachesTest : public SessionTest
+{
+protected:
+    struct MockSwarm
+    {
+        std::vector<int> peers;
+        bool is_listed_as_having_peers = false;
+    };
+
+    using Candidates = std::vector<int>;
+
+    static auto constexpr PieceSize = uint32_t{ 16384U };
+    static auto constexpr TtlMsec = uint64_t{ 2000U };
+
+    // Two files of the same size, each exactly two pieces long.
+    // The files aren't in the session's download dir, so we have none of it.
+    [[nodiscard]] tr_torrent* makeTwoFileTorrent()
+    {
+        auto const top = tr_pathbuf{ sandboxDir(), "/source/folder"sv };
+        auto const payload = std::vector<std::byte>(PieceSize * 2U, std::byte{ 'x' });
+        createFileWithContents(tr_pathbuf{ top, "/a.bin"sv }, std::data(payload), std::size(payload));
+        createFileWithContents(tr_pathbuf{ top, "/b.bin"sv }, std::data(payload), std::size(payload));
+
+        auto builder = tr_metainfo_builder{ top };
+        EXPECT_TRUE(builder.set_piece_size(PieceSize));
+        auto const checksum_error = builder.make_checksums().get();
+        EXPECT_FALSE(checksum_error) << checksum_error;
+        auto const benc = builder.benc();
+
+        auto* const ctor = tr_ctorNew(session_);
+        auto error = tr_error{};
+        EXPECT_TRUE(tr_ctorSetMetainfo(ctor, std::data(benc), std::size(benc), &error));
+        EXPECT_FALSE(error) << error;
+        tr_ctorSetPaused(ctor, TR_FORCE, true);
+        auto* const tor = createTorrentAndWaitForVerifyDone(ctor);
+        tr_ctorFree(ctor);
+        return tor;
+    }
+
+    [[nodiscard]] static auto toVector(tr_bitfield const& bitfield)
+    {
+        auto ret = std::vector<bool>{};
+        for (size_t i = 0U; i < bitfield.size(); ++i)
+        {
+            ret.emplace_back(bitfield.test(i));
+        }
+        return ret;
+    }
+
+    [[nodiscard]] static bool contains(tr_swarms_with_peers<MockSwarm> const& swarms, MockSwarm* const swarm)
+    {
+        return std::ranges::find(swarms, swarm) != std::end(swarms);
+    }
+};
+
+TEST_F(PeerMgrCachesTest, swarmLeavesListWhenItsLastPeerGoes)
+{
+    auto swarms = tr_swarms_with_peers<MockSwarm>{};
+    auto a = MockSwarm{};
+    auto b = MockSwarm{};
+
+    // listing a swarm twice doesn't duplicate it
+    a.peers = { 1, 2 };
+    swarms.on_got_peer(&a);
+    swarms.on_got_peer(&a);
+    b.peers = { 3 };
+    swarms.on_got_peer(&b);
+    EXPECT_EQ(2U, std::size(swarms.get()));
+
+    // a swarm that still has a peer stays listed
+    a.peers = { 2 };
+    swarms.prune();
+    EXPECT_TRUE(contains(swarms, &a));
+    EXPECT_TRUE(contains(swarms, &b));
+
+    // a swarm whose last peer left is dropped...
+    a.peers.clear();
+    swarms.prune();
+    EXPECT_FALSE(contains(swarms, &a));
+    EXPECT_FALSE(a.is_listed_as_having_peers);
+    EXPECT_TRUE(contains(swarms, &b));
+
+    // ...and is listed again when it gets a new one
+    a.peers = { 4 };
+    swarms.on_got_peer(&a);
+    EXPECT_TRUE(contains(swarms, &a));
+    EXPECT_EQ(2U, std::size(swarms.get()));
+}
+
+TEST_F(PeerMgrCachesTest, swarmLeavesListWhenItsTorrentIsRemoved)
+{
+    auto swarms = tr_swarms_with_peers<MockSwarm>{};
+    auto a = MockSwarm{ { 1 } };
+    auto b = MockSwarm{ { 2 } };
+    swarms.on_got_peer(&a);
+    swarms.on_got_peer(&b);
+
+    // the swarm is gone right away, even though it still has peers,
+    // so that the next pulse doesn't visit a freed swarm
+    swarms.on_doomed(&a);
+    EXPECT_FALSE(contains(swarms, &a));
+    EXPECT_TRUE(contains(swarms, &b));
+    EXPECT_EQ(1U, std::size(swarms.get()));
+}
+
+TEST_F(PeerMgrCachesTest, staleCandidateListIsRebuiltAfterAChange)
+{
+    auto candidates = tr_outbound_candidates<Candidates>{ TtlMsec };
+    auto n_rebuilds = size_t{};
+    auto const rebuild = [&n_rebuilds](Candidates& setme)
+    {
+        ++n_rebuilds;
+        setme = { 1, 2, 3 };
+    };
+
+    // the first call builds the list
+    auto now_msec = uint64_t{ 1000U };
+    EXPECT_EQ((Candidates{ 1, 2, 3 }), candidates.get(now_msec, rebuild));
+    EXPECT_EQ(1U, n_rebuilds);
+
+    // consume some of it; nothing changed, so the rest is reused
+    candidates.get(now_msec, rebuild).pop_back();
+    EXPECT_EQ((Candidates{ 1, 2 }), candidates.get(now_msec + 1U, rebuild));
+    EXPECT_EQ(1U, n_rebuilds);
+
+    // something changed, so the list is rebuilt even though it isn't used up
+    candidates.mark_dirty();
+    EXPECT_EQ((Candidates{ 1, 2, 3 }), candidates.get(now_msec + 2U, rebuild));
+    EXPECT_EQ(2U, n_rebuilds);
+
+    // and it's rebuilt when its TTL is up
+    now_msec += 2U + TtlMsec;
+    candidates.get(now_msec, rebuild).clear();
+    EXPECT_EQ(3U, n_rebuilds);
+    EXPECT_TRUE(std::empty(candidates.get(now_msec + 1U, rebuild)));
+    EXPECT_EQ(3U, n_rebuilds);
+}
+
+TEST_F(PeerMgrCachesTest, swappingWantedFilesOfTheSameSizeChangesInterest)
+{
+    auto* const tor = makeTwoFileTorrent();
+    ASSERT_NE(nullptr, tor);
+    ASSERT_EQ(2U, tor->file_count());
+    ASSERT_EQ(4U, tor->piece_count());
+
+    auto interesting = tr_interesting_pieces{ *tor };
+    auto const file_a = tr_file_index_t{ 0U };
+    auto const file_b = tr_file_index_t{ 1U };
+
+    tor->set_files_wanted(&file_b, 1U, false);
+    EXPECT_EQ((std::vector<bool>{ true, true, false, false }), toVector(interesting.get()));
+
+    // This leaves how much we have left to download unchanged,
+    // but the pieces that we're interested in are different.
+    auto const left_until_done = tor->left_until_done();
+    tor->set_files_wanted(&file_a, 1U, false);
+    tor->set_files_wanted(&file_b, 1U, true);
+    EXPECT_EQ(left_until_done, tor->left_until_done());
+    EXPECT_EQ((std::vector<bool>{ false, false, true, true }), toVector(interesting.get()));
+}
+
+} // namespace tr::test
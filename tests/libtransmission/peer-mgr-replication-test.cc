@@ -0,0 +1,136 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <array>
+#include <cstddef> // size_t
+#include <memory>
+#include <utility>
+#include <vector>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/bitfield.h>
+#include <libtransmission/peer-mgr-replication.h>
+
+#include "test-fixtures.h"
+
+namespace tr::test
+{
+
+class PeerMgrReplicationTest : public TransmissionTest
+{
+protected:
+    static auto constexpr PieceCount = tr_piece_index_t{ 8U };
+
+    // What tr_swarm hears from a peer, applied to its bitfield the way tr_peerMsgs does.
+    struct MockPeer
+    {
+        [[nodiscard]] tr_bitfield const& has() const noexcept
+        {
+            return have;
+        }
+
+        void got_have(tr_piece_index_t const piece, tr_piece_replication& replication)
+        {
+            have.set(piece);
+            replication.add_piece(piece, have);
+        }
+
+        void got_bitfield(std::vector<tr_piece_index_t> const& pieces, tr_piece_replication& replication)
+        {
+            auto bitfield = tr_bitfield{ PieceCount };
+            for (auto const piece : pieces)
+            {
+                bitfield.set(piece);
+            }
+
+            auto const old_have = std::exchange(have, std::move(bitfield));
+            replication.replace(old_have, have);
+        }
+
+        void got_have_all(tr_piece_replication& replication)
+        {
+            auto const old_have = have;
+            have.set_has_all();
+            replication.replace(old_have, have);
+        }
+
+        void got_have_none(tr_piece_replication& replication)
+        {
+            auto const old_have = have;
+            have.set_has_none();
+            replication.replace(old_have, have);
+        }
+
+        tr_bitfield have{ PieceCount };
+    };
+
+    [[nodiscard]] static auto counts(tr_piece_replication const& replication)
+    {
+        auto ret = std::array<size_t, PieceCount>{};
+        for (tr_piece_index_t piece = 0U; piece < PieceCount; ++piece)
+        {
+            ret[piece] = replication.count(piece);
+        }
+        return ret;
+    }
+};
+
+TEST_F(PeerMgrReplicationTest, countsFollowWhatPeersSayTheyHave)
+{
+    using Counts = std::array<size_t, PieceCount>;
+
+    auto peers = std::vector<std::unique_ptr<MockPeer>>{};
+    peers.emplace_back(std::make_unique<MockPeer>());
+    peers.emplace_back(std::make_unique<MockPeer>());
+    peers.emplace_back(std::make_unique<MockPeer>());
+    auto& a = *peers[0];
+    auto& b = *peers[1];
+    auto& c = *peers[2];
+
+    auto replication = tr_piece_replication{};
+    replication.rebuild(PieceCount, peers);
+    EXPECT_EQ((Counts{}), counts(replication));
+
+    // BITFIELD, then HAVE
+    a.got_bitfield({ 0U, 1U }, replication);
+    a.got_have(2U, replication);
+    EXPECT_EQ((Counts{ 1U, 1U, 1U, 0U, 0U, 0U, 0U, 0U }), counts(replication));
+
+    // a second BITFIELD replaces the first, rather than adding to it
+    a.got_bitfield({ 3U }, replication);
+    EXPECT_EQ((Counts{ 0U, 0U, 0U, 1U, 0U, 0U, 0U, 0U }), counts(replication));
+
+    // HAVE_ALL, then HAVE_NONE
+    b.got_have_all(replication);
+    EXPECT_TRUE(replication.any_peer_has_all());
+    EXPECT_EQ((Counts{ 1U, 1U, 1U, 2U, 1U, 1U, 1U, 1U }), counts(replication));
+    b.got_have_none(replication);
+    EXPECT_FALSE(replication.any_peer_has_all());
+    EXPECT_EQ((Counts{ 0U, 0U, 0U, 1U, 0U, 0U, 0U, 0U }), counts(replication));
+
+    // a HAVE that fills in a peer's last missing piece makes it a seed
+    c.got_bitfield({ 0U, 1U, 2U, 3U, 4U, 5U, 6U }, replication);
+    c.got_have(7U, replication);
+    EXPECT_TRUE(replication.any_peer_has_all());
+    EXPECT_EQ((Counts{ 1U, 1U, 1U, 2U, 1U, 1U, 1U, 1U }), counts(replication));
+
+    // a rebuild from scratch agrees with the running counts
+    auto rebuilt = tr_piece_replication{};
+    rebuilt.rebuild(PieceCount, peers);
+    EXPECT_EQ(counts(rebuilt), counts(replication));
+
+    // disconnecting takes away what the peer had
+    replication.remove(c.has());
+    EXPECT_FALSE(replication.any_peer_has_all());
+    EXPECT_EQ((Counts{ 0U, 0U, 0U, 1U, 0U, 0U, 0U, 0U }), counts(replication));
+    replication.remove(b.has());
+    replication.remove(a.has());
+    EXPECT_EQ((Counts{}), counts(replication));
+}
+
+} // namespace tr::test
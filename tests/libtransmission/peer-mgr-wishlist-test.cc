@@ -181,6 +181,66 @@ TEST_F(PeerMgrWishlistTest, onlyRequestBlocksThePeerHas)
     EXPECT_EQ(0U, requested.count(200, 250));
 }
 
+TEST_F(PeerMgrWishlistTest, onlyRequestBlocksThePeerHasBitfield)
+{
+    auto mediator = MockMediator{};
+
+    // setup: three pieces, all missing
+    mediator.block_span_[0] = { .begin = 0, .end = 100 };
+    mediator.block_span_[1] = { .begin = 100, .end = 200 };
+    mediator.block_span_[2] = { .begin = 200, .end = 250 };
+
+    // peers have pieces 1 and 2
+    mediator.piece_replication_[0] = 0;
+    mediator.piece_replication_[1] = 1;
+    mediator.piece_replication_[2] = 1;
+
+    // and we want all three pieces
+    mediator.client_wants_piece_.insert(0);
+    mediator.client_wants_piece_.insert(1);
+    mediator.client_wants_piece_.insert(2);
+
+    auto wishlist = Wishlist{ mediator };
+
+    // a peer that has nothing gets nothing
+    auto peer_has = tr_bitfield{ 3 };
+    EXPECT_TRUE(std::empty(wishlist.next(250, peer_has)));
+
+    // this peer only has the second piece
+    peer_has.set(1);
+    auto spans = wishlist.next(250, peer_has);
+    auto requested = tr_bitfield{ 250 };
+    for (auto const& [begin, end] : spans)
+    {
+        requested.set_span(begin, end);
+    }
+    EXPECT_EQ(100U, requested.count());
+    EXPECT_EQ(100U, requested.count(100, 200));
+
+    // once all of the second piece's blocks have been requested,
+    // there's nothing left to request from this peer
+    wishlist.on_sent_request({ .begin = 100, .end = 200 });
+    EXPECT_TRUE(std::empty(wishlist.next(250, peer_has)));
+
+    // ...until one of them gets rejected
+    wishlist.on_got_reject(150);
+    spans = wishlist.next(250, peer_has);
+    ASSERT_EQ(1U, std::size(spans));
+    EXPECT_EQ(150U, spans[0].begin);
+    EXPECT_EQ(151U, spans[0].end);
+
+    // a peer with every piece gets the rest of what the swarm has
+    peer_has.set_has_all();
+    requested = tr_bitfield{ 250 };
+    for (auto const& [begin, end] : wishlist.next(250, peer_has))
+    {
+        requested.set_span(begin, end);
+    }
+    EXPECT_EQ(51U, requested.count());
+    EXPECT_TRUE(requested.test(150));
+    EXPECT_EQ(50U, requested.count(200, 250));
+}
+
 TEST_F(PeerMgrWishlistTest, doesNotRequestSameBlockTwice)
 {
     auto mediator = MockMediator{};
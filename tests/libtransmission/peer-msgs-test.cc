@@ -3,8 +3,211 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
+#include <array>
+#include <cerrno>
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint32_t, SIZE_MAX
+#include <future>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <event2/util.h>
+
 #include <gtest/gtest.h>
 
-TEST(PeerMsgs, placeholder)
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/block-info.h>
+#include <libtransmission/cache.h>
+#include <libtransmission/net.h>
+#include <libtransmission/peer-common.h>
+#include <libtransmission/peer-io.h>
+#include <libtransmission/peer-mgr.h>
+#include <libtransmission/peer-msgs.h>
+#include <libtransmission/peer-socket.h>
+#include <libtransmission/session.h>
+#include <libtransmission/string-utils.h>
+#include <libtransmission/torrent.h>
+#include <libtransmission/tr-macros.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+#define LOCAL_SOCKETPAIR_AF TR_IF_WIN32(AF_INET, AF_UNIX)
+
+namespace tr::test
+{
+
+class PeerMsgsTest : public SessionTest
+{
+protected:
+    static auto constexpr BlockSize = tr_block_info::BlockSize;
+    static auto constexpr PieceMsgId = uint8_t{ 7U };
+
+    void SetUp() override
+    {
+        SessionTest::SetUp();
+
+        tor_ = zeroTorrentInit(ZeroTorrentState::NoFiles);
+        ASSERT_NE(nullptr, tor_);
+
+        auto sockpair = std::array<evutil_socket_t, 2>{ -1, -1 };
+        ASSERT_EQ(0, evutil_socketpair(LOCAL_SOCKETPAIR_AF, SOCK_STREAM, 0, std::data(sockpair))) << tr_strerror(errno);
+        EXPECT_EQ(0, evutil_make_socket_nonblocking(sockpair[0]));
+        EXPECT_EQ(0, evutil_make_socket_nonblocking(sockpair[1]));
+        remote_ = sockpair[1];
+
+        inSessionThread(
+            [this, sock = sockpair[0]]()
+            {
+                auto const peer_addr = tr_socket_address{ *tr_address::from_string("127.0.0.1"sv), tr_port::from_host(8080) };
+                io_ = tr_peerIo::new_incoming(session_, &session_->top_bandwidth_, tr_peer_socket(session_, peer_addr, sock));
+                auto peer_info = std::make_shared<tr_peer_info>(
+                    peer_addr.address(),
+                    0U,
+                    TR_PEER_FROM_INCOMING,
+                    []() { return tr_port{}; });
+                msgs_ = tr_peerMsgs::create(*tor_, std::move(peer_info), io_, tr_peer_id_t{}, &PeerMsgsTest::on_event, this);
+            });
+    }
+
+    void TearDown() override
+    {
+        inSessionThread(
+            [this]()
+            {
+                msgs_.reset();
+                io_.reset();
+            });
+        evutil_closesocket(remote_);
+
+        SessionTest::TearDown();
+    }
+
+    template<typename Func>
+    void inSessionThread(Func&& func)
+    {
+        auto promise = std::promise<void>{};
+        session_->run_in_session_thread(
+            [&func, &promise]()
+            {
+                func();
+                promise.set_value();
+            });
+        promise.get_future().wait();
+    }
+
+    [[nodiscard]] static auto makeBlock(size_t const size)
+    {
+        auto block = std::vector<uint8_t>(size);
+        for (size_t i = 0U; i < size; ++i)
+        {
+            block[i] = static_cast<uint8_t>(i * 7U + i / 251U);
+        }
+        return block;
+    }
+
+    // <length prefix><message ID><index><begin><block>
+    [[nodiscard]] static auto makePieceMessage(uint32_t const piece, uint32_t const begin, uint8_t const* block, size_t len)
+    {
+        auto msg = std::vector<uint8_t>{};
+        auto const add_uint32 = [&msg](uint32_t const val)
+        {
+            for (auto shift = 24; shift >= 0; shift -= 8)
+            {
+                msg.push_back(static_cast<uint8_t>(val >> shift));
+            }
+        };
+
+        add_uint32(static_cast<uint32_t>(1U + sizeof(uint32_t) * 2U + len));
+        msg.push_back(PieceMsgId);
+        add_uint32(piece);
+        add_uint32(begin);
+        msg.insert(std::end(msg), block, block + len);
+        return msg;
+    }
+
+    // Have the peer send `msg`, split at `splits`, and read each part
+    // before the next one is sent so that the message arrives in pieces.
+    void receiveInParts(std::vector<uint8_t> const& msg, std::vector<size_t> const& splits)
+    {
+        auto begin = size_t{};
+        for (size_t i = 0U; i <= std::size(splits); ++i)
+        {
+            auto const end = i < std::size(splits) ? splits[i] : std::size(msg);
+            inSessionThread(
+                [this, &msg, begin, end]()
+                {
+                    auto const len = end - begin;
+                    auto const* const buf = reinterpret_cast<char const*>(std::data(msg) + begin);
+                    auto const n_sent = send(remote_, buf, len, 0);
+                    EXPECT_EQ(len, static_cast<size_t>(n_sent)) << tr_strerror(errno);
+                    io_->flush(tr_direction::Down, SIZE_MAX);
+                });
+            begin = end;
+        }
+    }
+
+    [[nodiscard]] auto readBlock(tr_block_index_t const block)
+    {
+        auto buf = std::vector<uint8_t>(tor_->block_size(block));
+        inSessionThread(
+            [this, block, &buf]()
+            { EXPECT_EQ(0, session_->cache->read_block(*tor_, tor_->block_loc(block), std::size(buf), std::data(buf))); });
+        return buf;
+    }
+
+    static void on_event(tr_peerMsgs* /*msgs*/, tr_peer_event const& event, void* vself)
+    {
+        if (event.type == tr_peer_event::Type::ClientGotBlock)
+        {
+            auto* const self = static_cast<PeerMsgsTest*>(vself);
+            self->got_blocks_.push_back(self->tor_->piece_loc(event.pieceIndex, event.offset).block);
+        }
+    }
+
+    tr_torrent* tor_ = nullptr;
+    evutil_socket_t remote_ = TR_BAD_SOCKET;
+    std::shared_ptr<tr_peerIo> io_;
+    std::shared_ptr<tr_peerMsgs> msgs_;
+
+    // only touched in the session thread
+    std::vector<tr_block_index_t> got_blocks_;
+};
+
+TEST_F(PeerMsgsTest, readsABlockThatArrivesInSeveralReads)
+{
+    auto const block = makeBlock(BlockSize);
+    auto const msg = makePieceMessage(0U, 0U, std::data(block), std::size(block));
+
+    // split the length prefix, the <index><begin> header, and the block itself
+    receiveInParts(msg, { 3U, 9U, 13U + 100U, 13U + BlockSize / 2U });
+    EXPECT_EQ(std::vector<tr_block_index_t>{ 0U }, got_blocks_);
+    EXPECT_EQ(block, readBlock(0U));
+}
+
+TEST_F(PeerMsgsTest, reassemblesABlockSentInSeveralPieceMessages)
 {
+    // the second block of the first piece, sent in two halves
+    auto const block = makeBlock(BlockSize);
+    auto const half = BlockSize / 2U;
+    auto const first = makePieceMessage(0U, BlockSize, std::data(block), half);
+    auto const second = makePieceMessage(0U, BlockSize + half, std::data(block) + half, half);
+
+    receiveInParts(first, { 11U, 13U + 1000U });
+    EXPECT_TRUE(std::empty(got_blocks_));
+
+    receiveInParts(second, { 2U, 13U + half - 1U });
+    EXPECT_EQ(std::vector<tr_block_index_t>{ 1U }, got_blocks_);
+    EXPECT_EQ(block, readBlock(1U));
 }
+
+} // namespace tr::test
@@ -0,0 +1,226 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <chrono>
+#include <cstddef> // size_t, std::byte
+#include <cstdint> // uint32_t
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libtransmission/file.h>
+#include <libtransmission/makemeta.h>
+#include <libtransmission/piece-sweeper.h>
+#include <libtransmission/torrent-metainfo.h>
+#include <libtransmission/tr-strbuf.h>
+#include <libtransmission/types.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+namespace tr::test
+{
+
+class PieceSweeperTest : public SandboxedTest
+{
+protected:
+    static auto constexpr PieceSize = uint32_t{ 16384U };
+
+    struct Results
+    {
+        [[nodiscard]] auto size() const
+        {
+            auto const lock = std::scoped_lock{ mutex };
+            return std::size(passed);
+        }
+
+        [[nodiscard]] auto get() const
+        {
+            auto const lock = std::scoped_lock{ mutex };
+            return passed;
+        }
+
+        mutable std::mutex mutex;
+        std::map<tr_piece_index_t, bool> passed;
+        std::string suffix; // appended to the filenames that the mediator finds
+        size_t n_lookups = {};
+    };
+
+    class MockMediator final : public tr_piece_sweeper::Mediator
+    {
+    public:
+        MockMediator(
+            tr_torrent_metainfo const& metainfo,
+            std::string top,
+            Results& results,
+            std::function<void(tr_piece_index_t)> on_checked = {})
+            : metainfo_{ metainfo }
+            , top_{ std::move(top) }
+            , results_{ results }
+            , on_checked_{ std::move(on_checked) }
+        {
+        }
+
+        [[nodiscard]] tr_torrent_metainfo const& metainfo() const override
+        {
+            return metainfo_;
+        }
+
+        [[nodiscard]] std::optional<std::string> find_file(tr_file_index_t const file_index) const override
+        {
+            auto const lock = std::scoped_lock{ results_.mutex };
+            ++results_.n_lookups;
+            return std::string{ tr_pathbuf{ top_, '/', metainfo_.file_subpath(file_index), results_.suffix } };
+        }
+
+        void on_piece_checked(tr_piece_index_t const piece, bool const passed) override
+        {
+            {
+                auto const lock = std::scoped_lock{ results_.mutex };
+                results_.passed[piece] = passed;
+            }
+
+            if (on_checked_)
+            {
+                on_checked_(piece);
+            }
+        }
+
+    private:
+        tr_torrent_metainfo const& metainfo_;
+        std::string const top_;
+        Results& results_;
+        std::function<void(tr_piece_index_t)> on_checked_;
+    };
+
+    // Two files whose sizes aren't multiples of the piece size,
+    // so that piece #2 straddles the boundary between them.
+    [[nodiscard]] tr_torrent_metainfo makeTorrent()
+    {
+        auto const top = tr_pathbuf{ sandboxDir(), "/folder"sv };
+
+        for (auto const& [name, size] : { std::pair{ "a.bin"sv, size_t{ 40000U } }, std::pair{ "b.bin"sv, size_t{ 30000U } } })
+        {
+            auto payload = std::vector<std::byte>(size);
+            for (size_t i = 0U; i < size; ++i)
+            {
+                payload[i] = static_cast<std::byte>(i * 13U);
+            }
+
+            createFileWithContents(tr_pathbuf{ top, '/', name }, std::data(payload), std::size(payload));
+        }
+
+        auto builder = tr_metainfo_builder{ top };
+        EXPECT_TRUE(builder.set_piece_size(PieceSize));
+        auto const error = builder.make_checksums().get();
+        EXPECT_FALSE(error) << error;
+
+        auto metainfo = tr_torrent_metainfo{};
+        EXPECT_TRUE(metainfo.parse_benc(builder.benc()));
+        return metainfo;
+    }
+
+    [[nodiscard]] static auto allPieces(tr_torrent_metainfo const& metainfo)
+    {
+        auto pieces = std::vector<tr_piece_index_t>{};
+        for (tr_piece_index_t piece = 0U; piece < metainfo.piece_count(); ++piece)
+        {
+            pieces.emplace_back(piece);
+        }
+        return pieces;
+    }
+};
+
+TEST_F(PieceSweeperTest, checksQueuedPieces)
+{
+    auto const metainfo = makeTorrent();
+    ASSERT_EQ(5U, metainfo.piece_count());
+
+    // corrupt the first byte of the second file
+    auto const filename = tr_pathbuf{ sandboxDir(), "/folder/b.bin"sv };
+    auto const fd = tr_sys_file_open(filename, TR_SYS_FILE_WRITE, 0);
+    ASSERT_NE(TR_BAD_SYS_FILE, fd);
+    blockingFileWrite(fd, "\xff", 1U);
+    tr_sys_file_close(fd);
+
+    auto results = Results{};
+    auto sweeper = tr_piece_sweeper{};
+    sweeper.add(std::make_unique<MockMediator>(metainfo, sandboxDir(), results), allPieces(metainfo));
+
+    EXPECT_TRUE(waitFor([&results, &metainfo]() { return std::size(results) == metainfo.piece_count(); }, 5s));
+    auto const expected = std::map<tr_piece_index_t, bool>{
+        { 0U, true }, { 1U, true }, { 2U, false }, { 3U, true }, { 4U, true },
+    };
+    EXPECT_EQ(expected, results.get());
+    EXPECT_EQ(0U, sweeper.size());
+}
+
+TEST_F(PieceSweeperTest, prioritizeAndRemove)
+{
+    auto const metainfo = makeTorrent();
+
+    auto results = Results{};
+    auto sweeper = tr_piece_sweeper{};
+
+    // nothing to prioritize in a torrent that isn't queued
+    EXPECT_FALSE(sweeper.prioritize(metainfo.info_hash(), 0U));
+
+    sweeper.add(std::make_unique<MockMediator>(metainfo, sandboxDir(), results), { 4U });
+    EXPECT_TRUE(waitFor([&results]() { return std::size(results) == 1U; }, 5s));
+
+    sweeper.add(std::make_unique<MockMediator>(metainfo, sandboxDir(), results), allPieces(metainfo));
+    sweeper.remove(metainfo.info_hash());
+    EXPECT_EQ(0U, sweeper.size());
+    EXPECT_FALSE(sweeper.prioritize(metainfo.info_hash(), 0U));
+
+    // no more callbacks once remove() returns
+    auto const n_results = std::size(results);
+    std::this_thread::sleep_for(100ms);
+    EXPECT_EQ(n_results, std::size(results));
+}
+
+TEST_F(PieceSweeperTest, looksFilesUpAgainBeforeFailingAPiece)
+{
+    auto const metainfo = makeTorrent();
+    auto const filename = tr_pathbuf{ sandboxDir(), "/folder/a.bin"sv };
+    auto const partial_filename = tr_pathbuf{ filename, ".part"sv };
+    ASSERT_TRUE(tr_sys_path_rename(filename, partial_filename));
+
+    // Piece #0 is found in "a.bin.part". Once it's checked, the file gets
+    // renamed, so the path that the sweeper remembers for piece #1 is stale.
+    auto results = Results{};
+    results.suffix = ".part"sv;
+    auto const on_checked = [&](tr_piece_index_t const piece)
+    {
+        if (piece == 0U)
+        {
+            EXPECT_TRUE(tr_sys_path_rename(partial_filename, filename));
+            auto const lock = std::scoped_lock{ results.mutex };
+            results.suffix.clear();
+        }
+    };
+
+    auto sweeper = tr_piece_sweeper{};
+    sweeper.add(std::make_unique<MockMediator>(metainfo, sandboxDir(), results, on_checked), { 0U, 1U });
+    EXPECT_TRUE(waitFor([&results]() { return std::size(results) == 2U; }, 5s));
+
+    auto const expected = std::map<tr_piece_index_t, bool>{ { 0U, true }, { 1U, true } };
+    EXPECT_EQ(expected, results.get());
+
+    // "a.bin" was looked up once for each piece: the second time, after piece #1 failed
+    auto const lock = std::scoped_lock{ results.mutex };
+    EXPECT_EQ(2U, results.n_lookups);
+}
+
+} // namespace tr::test
@@ -10,6 +10,7 @@
 #include <future>
 #include <iterator> // std::inserter
 #include <set>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -736,6 +737,238 @@ TEST_F(RpcTest, torrentGet)
     tr_torrentRemove(tor, false);
 }
 
+TEST_F(RpcTest, torrentGetWithoutStatFields)
+{
+    auto* tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
+    EXPECT_NE(nullptr, tor);
+
+    // none of these need the torrent's tr_stat
+    auto request_map = tr_variant::Map{ 4U };
+    request_map.try_emplace(TR_KEY_jsonrpc, JsonRpc::Version);
+    request_map.try_emplace(TR_KEY_method, tr_variant::unmanaged_string(TR_KEY_torrent_get));
+    request_map.try_emplace(TR_KEY_id, 12345);
+
+    auto params = tr_variant::Map{ 1U };
+    auto fields = tr_variant::Vector{};
+    fields.emplace_back(tr_quark_get_string_view(TR_KEY_id));
+    fields.emplace_back(tr_quark_get_string_view(TR_KEY_name));
+    fields.emplace_back(tr_quark_get_string_view(TR_KEY_hash_string));
+    fields.emplace_back(tr_quark_get_string_view(TR_KEY_total_size));
+    params.try_emplace(TR_KEY_fields, std::move(fields));
+    request_map.try_emplace(TR_KEY_params, std::move(params));
+
+    auto request = tr_variant{ std::move(request_map) };
+    auto response = tr_variant{};
+    tr_rpc_request_exec(session_, request, [&response](tr_variant&& resp) { response = std::move(resp); });
+
+    auto* response_map = response.get_if<tr_variant::Map>();
+    ASSERT_NE(response_map, nullptr);
+    auto* result = response_map->find_if<tr_variant::Map>(TR_KEY_result);
+    ASSERT_NE(result, nullptr);
+
+    auto* torrents = result->find_if<tr_variant::Vector>(TR_KEY_torrents);
+    ASSERT_NE(torrents, nullptr);
+    ASSERT_EQ(1UL, std::size(*torrents));
+
+    auto* first_torrent = (*torrents)[0].get_if<tr_variant::Map>();
+    ASSERT_NE(first_torrent, nullptr);
+    auto const view = tr_torrentView(tor);
+    EXPECT_EQ(4UL, std::size(*first_torrent));
+    EXPECT_EQ(tr_torrentId(tor), first_torrent->value_if<int64_t>(TR_KEY_id));
+    EXPECT_EQ(tr_torrentName(tor), first_torrent->value_if<std::string_view>(TR_KEY_name));
+    EXPECT_EQ(std::string_view{ view.hash_string }, first_torrent->value_if<std::string_view>(TR_KEY_hash_string));
+    EXPECT_EQ(static_cast<int64_t>(view.total_size), first_torrent->value_if<int64_t>(TR_KEY_total_size));
+
+    // cleanup
+    tr_torrentRemove(tor, false);
+}
+
+TEST_F(RpcTest, torrentGetChangedSince)
+{
+    auto* tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
+    EXPECT_NE(nullptr, tor);
+    auto const tor_id = int64_t{ tr_torrentId(tor) };
+
+    auto const rpc = [this](tr_quark const method, tr_variant::Map&& params)
+    {
+        auto request_map = tr_variant::Map{ 4U };
+        request_map.try_emplace(TR_KEY_jsonrpc, JsonRpc::Version);
+        request_map.try_emplace(TR_KEY_method, tr_variant::unmanaged_string(method));
+        request_map.try_emplace(TR_KEY_id, 12345);
+        request_map.try_emplace(TR_KEY_params, std::move(params));
+
+        auto request = tr_variant{ std::move(request_map) };
+        auto response = tr_variant{};
+        tr_rpc_request_exec(session_, request, [&response](tr_variant&& resp) { response = std::move(resp); });
+        return response;
+    };
+
+    struct Changes
+    {
+        int64_t cursor = {};
+        std::vector<int64_t> changed;
+        std::vector<int64_t> removed;
+    };
+
+    auto const poll = [&rpc](int64_t const changed_since)
+    {
+        auto params = tr_variant::Map{ 2U };
+        auto fields = tr_variant::Vector{};
+        fields.emplace_back(tr_quark_get_string_view(TR_KEY_id));
+        params.try_emplace(TR_KEY_fields, std::move(fields));
+        params.try_emplace(TR_KEY_changed_since, changed_since);
+        auto const response = rpc(TR_KEY_torrent_get, std::move(params));
+
+        auto changes = Changes{};
+        auto const* const result = response.get_if<tr_variant::Map>()->find_if<tr_variant::Map>(TR_KEY_result);
+        EXPECT_NE(result, nullptr);
+        if (result == nullptr)
+        {
+            return changes;
+        }
+
+        auto const cursor = result->value_if<int64_t>(TR_KEY_change_cursor);
+        EXPECT_TRUE(cursor);
+        changes.cursor = cursor.value_or(0);
+
+        if (auto const* const torrents = result->find_if<tr_variant::Vector>(TR_KEY_torrents); torrents != nullptr)
+        {
+            for (auto const& torrent : *torrents)
+            {
+                if (auto const* const map = torrent.get_if<tr_variant::Map>(); map != nullptr)
+                {
+                    changes.changed.push_back(map->value_if<int64_t>(TR_KEY_id).value_or(0));
+                }
+            }
+        }
+
+        if (auto const* const removed = result->find_if<tr_variant::Vector>(TR_KEY_removed); removed != nullptr)
+        {
+            for (auto const& id : *removed)
+            {
+                changes.removed.push_back(id.value_if<int64_t>().value_or(0));
+            }
+        }
+
+        return changes;
+    };
+
+    // the torrent has changed since the epoch
+    auto changes = poll(0);
+    EXPECT_EQ(std::vector<int64_t>{ tor_id }, changes.changed);
+    EXPECT_TRUE(std::empty(changes.removed));
+
+    // Keep polling with the latest cursor until the torrent has settled down.
+    // It can take a second or two, since a torrent that changes during the
+    // cursor's second is sent again.
+    auto cursor = changes.cursor;
+    auto const settled = waitFor(
+        [&]()
+        {
+            changes = poll(cursor);
+            cursor = changes.cursor;
+            return std::empty(changes.changed);
+        },
+        5s);
+    EXPECT_TRUE(settled);
+
+    // change the torrent; the next poll should include it
+    auto params = tr_variant::Map{ 2U };
+    auto ids = tr_variant::Vector{};
+    ids.emplace_back(tor_id);
+    params.try_emplace(TR_KEY_ids, std::move(ids));
+    auto labels = tr_variant::Vector{};
+    labels.emplace_back("changed"sv);
+    params.try_emplace(TR_KEY_labels, std::move(labels));
+    (void)rpc(TR_KEY_torrent_set, std::move(params));
+
+    changes = poll(cursor);
+    EXPECT_EQ(std::vector<int64_t>{ tor_id }, changes.changed);
+    EXPECT_TRUE(std::empty(changes.removed));
+    cursor = changes.cursor;
+
+    // remove the torrent; the next poll should say so
+    tr_torrentRemove(tor, false);
+    auto const got_removed = waitFor(
+        [&]()
+        {
+            changes = poll(cursor);
+            return !std::empty(changes.removed);
+        },
+        5s);
+    EXPECT_TRUE(got_removed);
+    EXPECT_EQ(std::vector<int64_t>{ tor_id }, changes.removed);
+    EXPECT_TRUE(std::empty(changes.changed));
+}
+
+TEST_F(RpcTest, torrentGetToJsonMatchesVariantReply)
+{
+    auto* tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
+    EXPECT_NE(nullptr, tor);
+
+    auto const make_request = [](std::string_view const format)
+    {
+        auto request_map = tr_variant::Map{ 4U };
+        request_map.try_emplace(TR_KEY_jsonrpc, JsonRpc::Version);
+        request_map.try_emplace(TR_KEY_method, tr_variant::unmanaged_string(TR_KEY_torrent_get));
+        request_map.try_emplace(TR_KEY_id, "some-id"sv);
+
+        // a mix of tr_stat and tr_torrent fields, scalars and lists
+        auto params = tr_variant::Map{ 2U };
+        auto fields = tr_variant::Vector{};
+        for (auto const key : { TR_KEY_id,
+                                TR_KEY_name,
+                                TR_KEY_hash_string,
+                                TR_KEY_is_private,
+                                TR_KEY_status,
+                                TR_KEY_percent_done,
+                                TR_KEY_error_string,
+                                TR_KEY_files,
+                                TR_KEY_labels,
+                                TR_KEY_peers_from,
+                                TR_KEY_id })
+        {
+            fields.emplace_back(tr_quark_get_string_view(key));
+        }
+        params.try_emplace(TR_KEY_fields, std::move(fields));
+        params.try_emplace(TR_KEY_format, format);
+        request_map.try_emplace(TR_KEY_params, std::move(params));
+        return tr_variant{ std::move(request_map) };
+    };
+
+    for (auto const format : { "object"sv, "table"sv })
+    {
+        auto request = make_request(format);
+
+        auto json = std::string{};
+        ASSERT_TRUE(tr_rpc_torrent_get_to_json(session_, request, json));
+        auto const streamed = tr_variant_serde::json().parse(json);
+        ASSERT_TRUE(streamed) << json;
+
+        auto response = tr_variant{};
+        tr_rpc_request_exec(session_, request, [&response](tr_variant&& resp) { response = std::move(resp); });
+
+        auto serde = tr_variant_serde::json();
+        EXPECT_EQ(serde.to_string(response), serde.to_string(*streamed)) << format;
+    }
+
+    // other requests are left to tr_rpc_request_exec()
+    auto json = std::string{ "untouched" };
+    auto request = make_request("object"sv);
+    request.get_if<tr_variant::Map>()->erase(TR_KEY_id);
+    EXPECT_FALSE(tr_rpc_torrent_get_to_json(session_, request, json)); // notification
+    request = make_request("object"sv);
+    request.get_if<tr_variant::Map>()->erase(TR_KEY_jsonrpc);
+    EXPECT_FALSE(tr_rpc_torrent_get_to_json(session_, request, json)); // legacy
+    request = make_request("object"sv);
+    request.get_if<tr_variant::Map>()->find_if<tr_variant::Map>(TR_KEY_params)->erase(TR_KEY_fields);
+    EXPECT_FALSE(tr_rpc_torrent_get_to_json(session_, request, json)); // error
+    EXPECT_EQ("untouched"sv, json);
+
+    // cleanup
+    tr_torrentRemove(tor, false);
+}
+
 TEST_F(RpcTest, torrentGetLegacy)
 {
     auto* tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
@@ -6,6 +6,7 @@
 #include <array>
 #include <cerrno>
 #include <cstddef> // size_t
+#include <cstdint> // uint8_t
 #include <string_view>
 #include <vector>
 
@@ -273,6 +274,75 @@ TEST_F(TorrentMetainfoTest, pathKeyTest)
     }
 }
 
+TEST_F(TorrentMetainfoTest, hybridFileTree)
+{
+    // a.bin is two 32 KiB pieces long and has a piece layer; b.bin fits in one piece
+    static auto constexpr Path = LIBTRANSMISSION_TEST_ASSETS_DIR "/hybrid-merkle.torrent"sv;
+    auto tm = tr_torrent_metainfo{};
+    EXPECT_TRUE(tm.parse_torrent_file(Path));
+    EXPECT_TRUE(tm.has_v1_metadata());
+    EXPECT_TRUE(tm.has_v2_metadata());
+    ASSERT_EQ(2U, tm.file_count());
+    EXPECT_EQ("hybrid/a.bin"sv, tm.file_subpath(0));
+    EXPECT_EQ("hybrid/b.bin"sv, tm.file_subpath(1));
+    EXPECT_FALSE(tm.merkle_file(2));
+
+    auto const make_payload = [](size_t const len, size_t const seed)
+    {
+        auto payload = std::vector<uint8_t>(len);
+        for (size_t i = 0U; i < len; ++i)
+        {
+            payload[i] = static_cast<uint8_t>(i * 13U + seed);
+        }
+        return payload;
+    };
+
+    auto const a = make_payload(40000U, 1U);
+    auto const merkle_a = tm.merkle_file(0);
+    ASSERT_TRUE(merkle_a);
+    EXPECT_EQ(2U, merkle_a->piece_count());
+    EXPECT_TRUE(merkle_a->check_piece(0U, std::data(a), 32768U));
+    EXPECT_TRUE(merkle_a->check_piece(1U, std::data(a) + 32768U, std::size(a) - 32768U));
+    EXPECT_FALSE(merkle_a->check_piece(1U, std::data(a), std::size(a) - 32768U));
+
+    auto const b = make_payload(1000U, 2U);
+    auto const merkle_b = tm.merkle_file(1);
+    ASSERT_TRUE(merkle_b);
+    EXPECT_EQ(1U, merkle_b->piece_count());
+    EXPECT_TRUE(merkle_b->check_piece(0U, std::data(b), std::size(b)));
+}
+
+TEST_F(TorrentMetainfoTest, hybridFileTreeMalformed)
+{
+    // The v1 metadata is still good, so these should load without v2 trees for the broken files.
+    {
+        static auto constexpr Path = LIBTRANSMISSION_TEST_ASSETS_DIR "/hybrid-bad-pieces-root.torrent"sv;
+        auto tm = tr_torrent_metainfo{};
+        EXPECT_TRUE(tm.parse_torrent_file(Path));
+        EXPECT_EQ(2U, tm.file_count());
+        EXPECT_FALSE(tm.merkle_file(0));
+        EXPECT_TRUE(tm.merkle_file(1));
+    }
+
+    {
+        static auto constexpr Path = LIBTRANSMISSION_TEST_ASSETS_DIR "/hybrid-bad-piece-layer.torrent"sv;
+        auto tm = tr_torrent_metainfo{};
+        EXPECT_TRUE(tm.parse_torrent_file(Path));
+        EXPECT_EQ(2U, tm.file_count());
+        EXPECT_FALSE(tm.merkle_file(0));
+        EXPECT_TRUE(tm.merkle_file(1));
+    }
+
+    // v1-only torrents have no trees at all
+    {
+        static auto constexpr Path = LIBTRANSMISSION_TEST_ASSETS_DIR "/perfect-pieces.torrent"sv;
+        auto tm = tr_torrent_metainfo{};
+        EXPECT_TRUE(tm.parse_torrent_file(Path));
+        EXPECT_FALSE(tm.has_v2_metadata());
+        EXPECT_FALSE(tm.merkle_file(0));
+    }
+}
+
 TEST_F(TorrentMetainfoTest, utf8Test)
 {
 // MacOS implementation uses non-deterministic conversion for illegal UTF-8
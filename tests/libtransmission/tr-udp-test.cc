@@ -0,0 +1,162 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef> // size_t
+#include <future>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <event2/util.h>
+
+#include <gtest/gtest.h>
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/net.h>
+#include <libtransmission/session.h>
+#include <libtransmission/string-utils.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+namespace tr::test
+{
+
+class UdpTest : public SessionTest
+{
+protected:
+    // A UDP socket on the loopback interface that the session can send to
+    class Receiver
+    {
+    public:
+        Receiver()
+            : sock_{ socket(AF_INET, SOCK_DGRAM, 0) }
+        {
+            EXPECT_NE(TR_BAD_SOCKET, sock_) << tr_strerror(sockerrno);
+            EXPECT_EQ(0, evutil_make_socket_nonblocking(sock_));
+
+            auto const [ss, sslen] = tr_socket_address::to_sockaddr(*tr_address::from_string("127.0.0.1"sv), tr_port{});
+            EXPECT_EQ(0, bind(sock_, reinterpret_cast<sockaddr const*>(&ss), sslen)) << tr_strerror(sockerrno);
+
+            // find out which port we got
+            addr_len_ = sizeof(addr_);
+            EXPECT_EQ(0, getsockname(sock_, reinterpret_cast<sockaddr*>(&addr_), &addr_len_)) << tr_strerror(sockerrno);
+        }
+
+        ~Receiver()
+        {
+            evutil_closesocket(sock_);
+        }
+
+        Receiver(Receiver const&) = delete;
+        Receiver(Receiver&&) = delete;
+        Receiver& operator=(Receiver const&) = delete;
+        Receiver& operator=(Receiver&&) = delete;
+
+        [[nodiscard]] auto const* addr() const noexcept
+        {
+            return reinterpret_cast<sockaddr const*>(&addr_);
+        }
+
+        [[nodiscard]] constexpr auto addr_len() const noexcept
+        {
+            return addr_len_;
+        }
+
+        // @return the datagrams received so far, in the order they arrived
+        [[nodiscard]] auto const& received()
+        {
+            auto buf = std::array<char, 8192U>{};
+            for (;;)
+            {
+                auto const n = recv(sock_, std::data(buf), std::size(buf), 0);
+                if (n < 0)
+                {
+                    break;
+                }
+
+                received_.emplace_back(std::data(buf), static_cast<size_t>(n));
+            }
+
+            return received_;
+        }
+
+    private:
+        tr_socket_t sock_ = TR_BAD_SOCKET;
+        sockaddr_storage addr_ = {};
+        socklen_t addr_len_ = {};
+        std::vector<std::string> received_;
+    };
+};
+
+TEST_F(UdpTest, sendsQueuedDatagramsIntactAndInOrder)
+{
+    if (session_->udp_core_->socket4() == TR_BAD_SOCKET)
+    {
+        GTEST_SKIP() << "no IPv4 UDP socket";
+    }
+
+    auto receivers = std::array<Receiver, 2U>{};
+
+    // Runs of full-sized datagrams, some ending in a shorter one, that switch
+    // destinations now and then -- and more of them than fit in one batch,
+    // so that they're sent in more than one go.
+    auto expected = std::array<std::vector<std::string>, 2U>{};
+    auto datagrams = std::vector<std::pair<size_t, std::string>>{};
+    for (size_t i = 0U; i < 100U; ++i)
+    {
+        auto const dest = (i / 10U + (i % 13U == 12U ? 1U : 0U)) % 2U;
+        auto const size = i % 7U == 6U ? 100U + i : 1200U;
+
+        auto payload = std::string(size, '\0');
+        for (size_t j = 0U; j < size; ++j)
+        {
+            payload[j] = static_cast<char>((i + j) % 251U);
+        }
+
+        expected[dest].push_back(payload);
+        datagrams.emplace_back(dest, std::move(payload));
+    }
+
+    // queue them all in one event loop iteration, so that they're sent together
+    auto queued = std::promise<void>{};
+    session_->run_in_session_thread(
+        [this, &receivers, &datagrams, &queued]()
+        {
+            for (auto const& [dest, payload] : datagrams)
+            {
+                auto const& receiver = receivers[dest];
+                session_->udp_core_->sendto(std::data(payload), std::size(payload), receiver.addr(), receiver.addr_len());
+            }
+
+            queued.set_value();
+        });
+    queued.get_future().wait();
+
+    auto const got_all = waitFor(
+        [&receivers, &expected]()
+        {
+            return std::size(receivers[0].received()) >= std::size(expected[0]) &&
+                std::size(receivers[1].received()) >= std::size(expected[1]);
+        },
+        5s);
+    EXPECT_TRUE(got_all);
+    EXPECT_EQ(expected[0], receivers[0].received());
+    EXPECT_EQ(expected[1], receivers[1].received());
+}
+
+} // namespace tr::test
@@ -0,0 +1,415 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <array>
+#include <bit> // std::bit_ceil
+#include <chrono>
+#include <cstddef> // size_t, std::byte
+#include <cstdint> // uint32_t, uint64_t
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libtransmission/crypto-utils.h>
+#include <libtransmission/file.h>
+#include <libtransmission/makemeta.h>
+#include <libtransmission/merkle.h>
+#include <libtransmission/torrent-metainfo.h>
+#include <libtransmission/tr-strbuf.h>
+#include <libtransmission/types.h>
+#include <libtransmission/verify.h>
+
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+namespace tr::test
+{
+
+class VerifyTest : public SandboxedTest
+{
+protected:
+    static auto constexpr PieceSize = uint32_t{ 65536U };
+
+    // bigger than the verify worker's read buffers, and not a multiple of them
+    static auto constexpr FileSizes = std::array<size_t, 2U>{ size_t{ 2621440U + 5000U }, size_t{ 1048576U + 3000U } };
+
+    struct Results
+    {
+        [[nodiscard]] auto is_done() const
+        {
+            auto const lock = std::scoped_lock{ mutex };
+            return aborted.has_value();
+        }
+
+        [[nodiscard]] auto is_reading() const
+        {
+            auto const lock = std::scoped_lock{ mutex };
+            return reading;
+        }
+
+        mutable std::mutex mutex;
+        std::vector<std::pair<tr_piece_index_t, bool>> checked;
+        std::optional<bool> aborted;
+        size_t n_done = {};
+        bool reading = false;
+    };
+
+    class MockMediator final : public tr_verify_worker::Mediator
+    {
+    public:
+        MockMediator(tr_torrent_metainfo const& metainfo, std::string top, Results& results, std::shared_future<void> gate = {})
+            : metainfo_{ metainfo }
+            , top_{ std::move(top) }
+            , results_{ results }
+            , gate_{ std::move(gate) }
+        {
+        }
+
+        [[nodiscard]] tr_torrent_metainfo const& metainfo() const override
+        {
+            return metainfo_;
+        }
+
+        [[nodiscard]] std::optional<std::string> find_file(tr_file_index_t const file_index) const override
+        {
+            {
+                auto const lock = std::scoped_lock{ results_.mutex };
+                results_.reading = true;
+            }
+
+            if (gate_.valid())
+            {
+                gate_.wait();
+            }
+
+            auto const filename = tr_pathbuf{ top_, '/', metainfo_.file_subpath(file_index) };
+            if (!tr_sys_path_exists(filename))
+            {
+                return {};
+            }
+
+            return std::string{ filename.sv() };
+        }
+
+        void on_verify_queued() override
+        {
+        }
+
+        void on_verify_started() override
+        {
+        }
+
+        void on_piece_checked(tr_piece_index_t const piece, bool const has_piece) override
+        {
+            auto const lock = std::scoped_lock{ results_.mutex };
+            results_.checked.emplace_back(piece, has_piece);
+        }
+
+        void on_verify_done(bool const aborted) override
+        {
+            auto const lock = std::scoped_lock{ results_.mutex };
+            results_.aborted = aborted;
+            ++results_.n_done;
+        }
+
+    private:
+        tr_torrent_metainfo const& metainfo_;
+        std::string const top_;
+        Results& results_;
+        std::shared_future<void> gate_;
+    };
+
+    [[nodiscard]] static auto makePayload(size_t const size, size_t const seed)
+    {
+        auto payload = std::vector<std::byte>(size);
+        for (size_t i = 0U; i < size; ++i)
+        {
+            payload[i] = static_cast<std::byte>(i * 13U + seed + i / 4093U);
+        }
+        return payload;
+    }
+
+    // Each file's size is not a multiple of the piece size,
+    // so that some pieces straddle the boundary between two files.
+    [[nodiscard]] tr_torrent_metainfo makeTorrent(std::string_view const name, std::vector<size_t> const& file_sizes)
+    {
+        auto const top = tr_pathbuf{ sandboxDir(), '/', name };
+
+        for (size_t i = 0U; i < std::size(file_sizes); ++i)
+        {
+            auto const payload = makePayload(file_sizes[i], std::size(name) + i);
+            createFileWithContents(tr_pathbuf{ top, "/file"sv, std::to_string(i) }, std::data(payload), std::size(payload));
+        }
+
+        auto builder = tr_metainfo_builder{ top };
+        EXPECT_TRUE(builder.set_piece_size(PieceSize));
+        auto const error = builder.make_checksums().get();
+        EXPECT_FALSE(error) << error;
+
+        auto metainfo = tr_torrent_metainfo{};
+        EXPECT_TRUE(metainfo.parse_benc(builder.benc()));
+        return metainfo;
+    }
+
+    // A hybrid torrent of two files whose v1 piece hashes and v2 trees can
+    // describe different data. The first file fills whole pieces, so both
+    // files start on a piece boundary and get checked against their trees.
+    [[nodiscard]] static tr_torrent_metainfo makeHybridTorrent(
+        std::array<std::vector<std::byte>, 2U> const& v1_payloads,
+        std::array<std::vector<std::byte>, 2U> const& v2_payloads)
+    {
+        static auto constexpr BlocksPerPiece = size_t{ HybridPieceSize / tr_merkle_file::BlockSize };
+        auto const str = [](std::string_view const sv)
+        {
+            return std::to_string(std::size(sv)) + ':' + std::string{ sv };
+        };
+        auto const bytes = [](auto const& digest)
+        {
+            return std::string_view{ reinterpret_cast<char const*>(std::data(digest)), std::size(digest) };
+        };
+
+        auto v1_data = std::vector<std::byte>{};
+        auto file_tree = std::string{};
+        auto files = std::string{};
+        auto piece_layers = std::map<std::string, std::string>{};
+        for (size_t i = 0U; i < std::size(HybridFiles); ++i)
+        {
+            auto const& payload = v2_payloads[i];
+            auto const n_pieces = (std::size(payload) + HybridPieceSize - 1U) / HybridPieceSize;
+            auto layer = std::string{};
+            for (size_t piece = 0U; piece < n_pieces; ++piece)
+            {
+                auto const begin = piece * HybridPieceSize;
+                auto const len = std::min(size_t{ HybridPieceSize }, std::size(payload) - begin);
+                auto const leaves = tr_merkle_file::block_hashes(std::data(payload) + begin, len);
+                layer += bytes(tr_merkle_file::root(leaves, BlocksPerPiece));
+            }
+
+            auto const leaves = tr_merkle_file::block_hashes(std::data(payload), std::size(payload));
+            auto const root = tr_merkle_file::root(leaves, std::bit_ceil(n_pieces) * BlocksPerPiece);
+            piece_layers.try_emplace(std::string{ bytes(root) }, std::move(layer));
+
+            auto const length = "i" + std::to_string(std::size(payload)) + 'e';
+            file_tree += str(HybridFiles[i]) + "d0:d6:length" + length + "11:pieces root" + str(bytes(root)) + "ee";
+            files += "d6:length" + length + "4:pathl" + str(HybridFiles[i]) + "ee";
+            v1_data.insert(std::end(v1_data), std::begin(v1_payloads[i]), std::end(v1_payloads[i]));
+        }
+
+        auto pieces = std::string{};
+        for (size_t begin = 0U; begin < std::size(v1_data); begin += HybridPieceSize)
+        {
+            auto sha = tr_sha1{};
+            sha.add(std::data(v1_data) + begin, std::min(size_t{ HybridPieceSize }, std::size(v1_data) - begin));
+            pieces += bytes(sha.finish());
+        }
+
+        auto layers = std::string{};
+        for (auto const& [root, layer] : piece_layers)
+        {
+            layers += str(root) + str(layer);
+        }
+
+        auto const benc = "d4:infod9:file treed" + file_tree + "e5:filesl" + files + "e12:meta versioni2e4:name" +
+            str(HybridName) + "12:piece lengthi" + std::to_string(HybridPieceSize) + "e6:pieces" + str(pieces) +
+            "e12:piece layersd" + layers + "ee";
+
+        auto metainfo = tr_torrent_metainfo{};
+        EXPECT_TRUE(metainfo.parse_benc(benc));
+        EXPECT_TRUE(metainfo.has_v2_metadata());
+        return metainfo;
+    }
+
+    // two 16 KiB blocks per piece; "a.bin" is three whole pieces and "b.bin" is two, the last one short
+    static auto constexpr HybridPieceSize = uint32_t{ 32768U };
+    static auto constexpr HybridName = "hybrid"sv;
+    static auto constexpr HybridFiles = std::array{ "a.bin"sv, "b.bin"sv };
+    static auto constexpr HybridFileSizes = std::array{ size_t{ 98304U }, size_t{ 40000U } };
+
+    // Write the hybrid torrent's files, with one byte flipped in the second block of piece `bad_piece`.
+    // Returns what was written.
+    std::array<std::vector<std::byte>, 2U> writeHybridFiles(tr_piece_index_t const bad_piece)
+    {
+        auto payloads = std::array<std::vector<std::byte>, 2U>{};
+        auto offset = size_t{};
+        for (size_t i = 0U; i < std::size(HybridFiles); ++i)
+        {
+            payloads[i] = makePayload(HybridFileSizes[i], i);
+            auto const bad_byte = (size_t{ bad_piece } * HybridPieceSize) + tr_merkle_file::BlockSize + 1U;
+            if (offset <= bad_byte && bad_byte < offset + HybridFileSizes[i])
+            {
+                payloads[i][bad_byte - offset] ^= std::byte{ 0x40 };
+            }
+
+            createFileWithContents(
+                tr_pathbuf{ sandboxDir(), '/', HybridName, '/', HybridFiles[i] },
+                std::data(payloads[i]),
+                std::size(payloads[i]));
+            offset += HybridFileSizes[i];
+        }
+
+        return payloads;
+    }
+
+    static void expectOnlyPieceFailed(tr_torrent_metainfo const& metainfo, Results const& results, tr_piece_index_t const bad)
+    {
+        auto const lock = std::scoped_lock{ results.mutex };
+        EXPECT_EQ(std::optional<bool>{ false }, results.aborted);
+        ASSERT_EQ(metainfo.piece_count(), std::size(results.checked));
+        for (tr_piece_index_t piece = 0U; piece < metainfo.piece_count(); ++piece)
+        {
+            EXPECT_EQ(piece, results.checked[piece].first);
+            EXPECT_EQ(piece != bad, results.checked[piece].second) << piece;
+        }
+    }
+
+    static void expectAllPiecesPassed(tr_torrent_metainfo const& metainfo, Results const& results)
+    {
+        auto const lock = std::scoped_lock{ results.mutex };
+        EXPECT_EQ(1U, results.n_done);
+        EXPECT_EQ(std::optional<bool>{ false }, results.aborted);
+        ASSERT_EQ(metainfo.piece_count(), std::size(results.checked));
+        for (tr_piece_index_t piece = 0U; piece < metainfo.piece_count(); ++piece)
+        {
+            // pieces are reported in order, even when several threads hash them
+            EXPECT_EQ(piece, results.checked[piece].first);
+            EXPECT_TRUE(results.checked[piece].second) << piece;
+        }
+    }
+};
+
+TEST_F(VerifyTest, checksSeveralTorrentsWithSeveralWorkers)
+{
+    auto const names = std::array{ "a"sv, "bb"sv, "ccc"sv, "dddd"sv };
+
+    auto metainfos = std::vector<tr_torrent_metainfo>{};
+    metainfos.reserve(std::size(names));
+    for (auto const& name : names)
+    {
+        metainfos.emplace_back(makeTorrent(name, { std::begin(FileSizes), std::end(FileSizes) }));
+    }
+
+    auto results = std::vector<Results>(std::size(names));
+    auto worker = tr_verify_worker{};
+    worker.set_thread_count(3U);
+    for (size_t i = 0U; i < std::size(names); ++i)
+    {
+        worker.add(std::make_unique<MockMediator>(metainfos[i], sandboxDir(), results[i]), TR_PRI_NORMAL);
+    }
+
+    for (size_t i = 0U; i < std::size(names); ++i)
+    {
+        EXPECT_TRUE(waitFor([&results, i]() { return results[i].is_done(); }, 20s));
+        expectAllPiecesPassed(metainfos[i], results[i]);
+    }
+}
+
+TEST_F(VerifyTest, sharesOneLargeTorrentBetweenWorkers)
+{
+    // big enough to be split into several spans
+    auto const metainfo = makeTorrent("large"sv, { size_t{ 25165824U + 777U }, size_t{ 16777216U + 333U } });
+
+    auto results = Results{};
+    auto worker = tr_verify_worker{};
+    worker.set_thread_count(4U);
+    worker.add(std::make_unique<MockMediator>(metainfo, sandboxDir(), results), TR_PRI_NORMAL);
+
+    EXPECT_TRUE(waitFor([&results]() { return results.is_done(); }, 30s));
+    expectAllPiecesPassed(metainfo, results);
+}
+
+TEST_F(VerifyTest, shortAndMissingFilesOnlySpoilTheirOwnPieces)
+{
+    auto const name = "short"sv;
+    auto const metainfo = makeTorrent(name, { std::begin(FileSizes), std::end(FileSizes) });
+
+    // cut the first file short in the middle of a read buffer, and lose the second one
+    auto const short_size = size_t{ 1572864U + 7U };
+    auto const payload = makePayload(FileSizes[0], std::size(name));
+    createFileWithContents(tr_pathbuf{ sandboxDir(), '/', name, "/file0"sv }, std::data(payload), short_size);
+    EXPECT_TRUE(tr_sys_path_remove(tr_pathbuf{ sandboxDir(), '/', name, "/file1"sv }));
+
+    auto results = Results{};
+    auto worker = tr_verify_worker{};
+    worker.set_thread_count(2U);
+    worker.add(std::make_unique<MockMediator>(metainfo, sandboxDir(), results), TR_PRI_NORMAL);
+    EXPECT_TRUE(waitFor([&results]() { return results.is_done(); }, 20s));
+
+    auto const lock = std::scoped_lock{ results.mutex };
+    EXPECT_EQ(std::optional<bool>{ false }, results.aborted);
+    ASSERT_EQ(metainfo.piece_count(), std::size(results.checked));
+    for (tr_piece_index_t piece = 0U; piece < metainfo.piece_count(); ++piece)
+    {
+        auto const expected = metainfo.block_info().byte_span_for_piece(piece).end <= short_size;
+        EXPECT_EQ(piece, results.checked[piece].first);
+        EXPECT_EQ(expected, results.checked[piece].second) << piece;
+    }
+}
+
+TEST_F(VerifyTest, removeAbortsMidSpan)
+{
+    auto const metainfo = makeTorrent("abort"sv, { std::begin(FileSizes), std::end(FileSizes) });
+
+    // hold the reader at the start of the span until the job is aborted
+    auto gate = std::promise<void>{};
+    auto results = Results{};
+    auto worker = tr_verify_worker{};
+    worker.add(std::make_unique<MockMediator>(metainfo, sandboxDir(), results, gate.get_future().share()), TR_PRI_NORMAL);
+    EXPECT_TRUE(waitFor([&results]() { return results.is_reading(); }, 5s));
+
+    auto remover = std::thread{ [&worker, &metainfo]() { worker.remove(metainfo.info_hash()); } };
+    std::this_thread::sleep_for(100ms);
+    gate.set_value();
+    remover.join();
+
+    // `remove()` doesn't return until the mediator has been told
+    auto const lock = std::scoped_lock{ results.mutex };
+    EXPECT_EQ(1U, results.n_done);
+    EXPECT_EQ(std::optional<bool>{ true }, results.aborted);
+    EXPECT_TRUE(std::empty(results.checked));
+}
+
+TEST_F(VerifyTest, corruptBlockInHybridTorrentOnlyFailsItsPiece)
+{
+    static auto constexpr BadPiece = tr_piece_index_t{ 1U };
+    auto const originals = std::array{ makePayload(HybridFileSizes[0], 0U), makePayload(HybridFileSizes[1], 1U) };
+    auto const metainfo = makeHybridTorrent(originals, originals);
+    ASSERT_EQ(5U, metainfo.piece_count());
+    writeHybridFiles(BadPiece);
+
+    auto results = Results{};
+    auto worker = tr_verify_worker{};
+    worker.add(std::make_unique<MockMediator>(metainfo, sandboxDir(), results), TR_PRI_NORMAL);
+    EXPECT_TRUE(waitFor([&results]() { return results.is_done(); }, 20s));
+    expectOnlyPieceFailed(metainfo, results, BadPiece);
+}
+
+TEST_F(VerifyTest, hybridPiecesAreCheckedAgainstTheirV2Trees)
+{
+    // The v1 hashes match the corrupt data on disk, so only the v2 tree can catch
+    // the bad block. The bad piece is in the second file, to check its tree is found.
+    static auto constexpr BadPiece = tr_piece_index_t{ 3U };
+    auto const originals = std::array{ makePayload(HybridFileSizes[0], 0U), makePayload(HybridFileSizes[1], 1U) };
+    auto const on_disk = writeHybridFiles(BadPiece);
+    auto const metainfo = makeHybridTorrent(on_disk, originals);
+
+    auto results = Results{};
+    auto worker = tr_verify_worker{};
+    worker.add(std::make_unique<MockMediator>(metainfo, sandboxDir(), results), TR_PRI_NORMAL);
+    EXPECT_TRUE(waitFor([&results]() { return results.is_done(); }, 20s));
+    expectOnlyPieceFailed(metainfo, results, BadPiece);
+}
+
+} // namespace tr::test